@@ -113,6 +113,9 @@ typedef struct
     // be used to prevent infinite loops.
     gboolean retry;         // Signals the calling function that it should retry (the error handler detected
     // transient error and managed to resolve it, but it can't run the original query)
+    GString* insert_batch;  // Multi-row INSERT being accumulated by conn_queue_insert
+    gchar* insert_prefix;   // "INSERT INTO ... VALUES" prefix of insert_batch
+    guint insert_rows;      // Number of rows in insert_batch
 
 } GncDbiSqlConnection;
 /* external access required for tests */
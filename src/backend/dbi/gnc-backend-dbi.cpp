@@ -227,6 +227,11 @@ static GncDbiTestResult conn_test_dbi_library (dbi_conn conn);
 
 
 #define DBI_MAX_CONN_ATTEMPTS 5
+/* Limits for one batched multi-row INSERT. SQLite before 3.8.8 caps a
+ * VALUES list at 500 rows and MySQL rejects statements larger than
+ * max_allowed_packet, which defaults to 1MB on older servers. */
+#define DBI_MAX_INSERT_BATCH_ROWS 250
+#define DBI_MAX_INSERT_BATCH_SIZE (256 * 1024)
 
 /* ================================================================= */
 
@@ -1587,6 +1592,7 @@ gnc_dbi_destroy_backend (QofBackend* be)
     /* Stop transaction logging */
     xaccLogSetBaseName (NULL);
 
+    gnc_sql_finalize (&((GncDbiBackend*)be)->sql_be);
     qof_backend_destroy (be);
 
     g_free (be);
@@ -1791,8 +1797,25 @@ conn_table_operation (GncSqlConnection* sql_conn, GSList* table_name_list,
 }
 
 /**
- * Safely resave a database by renaming all of its tables, recreating
- * everything, and then dropping the backup tables only if there were
+ * Whether the database already holds book in the current schema, so that
+ * saving it only needs to write what changed. That is the case once the
+ * book has been loaded from or fully saved to this database, unless the
+ * database was written by a version of Gnucash that requires a resave.
+ */
+static gboolean
+gnc_dbi_can_sync_dirty (GncDbiBackend* be, QofBook* book)
+{
+    if (be->primary_book != book || be->sql_be.versions == NULL)
+        return FALSE;
+    return gnc_sql_get_table_version (&be->sql_be, "Gnucash-Resave") >=
+           GNUCASH_RESAVE_VERSION;
+}
+
+/**
+ * Safely resave a database. If the database is already up to date apart
+ * from the book's unsaved changes, those are written in a single
+ * transaction. Otherwise rename all of its tables, recreate
+ * everything, and then drop the backup tables only if there were
  * no errors. If there are errors, drop the new tables and restore the
  * originals.
  *
@@ -1812,6 +1835,12 @@ gnc_dbi_safe_sync_all (QofBackend* qbe, QofBook* book)
     g_return_if_fail (book != NULL);
 
     ENTER ("book=%p, primary=%p", book, be->primary_book);
+    if (gnc_dbi_can_sync_dirty (be, book))
+    {
+        gnc_sql_sync_dirty (&be->sql_be, book);
+        LEAVE ("book=%p, changes only", book);
+        return;
+    }
     dbname = dbi_conn_get_option (be->conn, "dbname");
     table_list = conn->provider->get_table_list (conn->conn, dbname);
     if (!conn_table_operation ((GncSqlConnection*)conn, table_list,
@@ -1930,6 +1959,7 @@ init_sql_backend (GncDbiBackend* dbi_be)
 
     dbi_be->sql_be.conn = NULL;
     dbi_be->sql_be.book = NULL;
+    dbi_be->sql_be.insert_prefixes = NULL;
 }
 
 static QofBackend*
@@ -2150,37 +2180,79 @@ gnc_module_finalize_backend_dbi (void)
 }
 
 /* --------------------------------------------------------- */
+/* A result has a single row object which is reused for every row.  The
+ * field names, types and attributes are looked up once when it is created,
+ * and each field has a GValue slot that is overwritten in place, so reading
+ * a row allocates nothing.  Values are therefore only valid until the next
+ * row is fetched, and strings point into the libdbi result. */
 typedef struct
 {
     GncSqlRow base;
 
     dbi_result result;
-    GList* gvalue_list;
+    guint num_fields;
+    GHashTable* col_index;  /* field name -> 1-based field index */
+    gushort* types;
+    guint* attribs;
+    GValue* values;         /* one slot per field */
 } GncDbiSqlRow;
 
 static void
 row_dispose (GncSqlRow* row)
 {
     GncDbiSqlRow* dbi_row = (GncDbiSqlRow*)row;
-    GList* node;
+    guint i;
 
-    if (dbi_row->gvalue_list != NULL)
+    for (i = 0; i < dbi_row->num_fields; i++)
     {
-        for (node = dbi_row->gvalue_list; node != NULL; node = node->next)
+        if (G_IS_VALUE (&dbi_row->values[i]))
+            g_value_unset (&dbi_row->values[i]);
+    }
+    g_free (dbi_row->values);
+    g_free (dbi_row->types);
+    g_free (dbi_row->attribs);
+    g_hash_table_destroy (dbi_row->col_index);
+    g_free (dbi_row);
+}
+
+static guint
+row_get_field_idx (GncDbiSqlRow* dbi_row, const gchar* col_name)
+{
+    guint idx;
+
+    idx = GPOINTER_TO_UINT (g_hash_table_lookup (dbi_row->col_index, col_name));
+    if (idx != 0)
+        return idx;
+
+    /* libdbi matches field names case-insensitively; remember any spelling
+     * that needed that so it's found directly next time. */
+    for (idx = 1; idx <= dbi_row->num_fields; idx++)
+    {
+        const gchar* name = dbi_result_get_field_name (dbi_row->result, idx);
+        if (name != NULL && g_ascii_strcasecmp (name, col_name) == 0)
         {
-            GValue* value;
-            if (!G_IS_VALUE (node->data))
-                continue;
-            value = (GValue*)node->data;
-            if (G_VALUE_HOLDS_STRING (value))
-            {
-                g_free ((gpointer)g_value_get_string (value));
-            }
-            g_free (value);
+            g_hash_table_insert (dbi_row->col_index, g_strdup (col_name),
+                                 GUINT_TO_POINTER (idx));
+            return idx;
         }
-        g_list_free (dbi_row->gvalue_list);
     }
-    g_free (dbi_row);
+    return 0;
+}
+
+/* Prepares a field's value slot to hold type, keeping it if it already
+ * does. */
+static GValue*
+row_value_slot (GncDbiSqlRow* dbi_row, guint idx, GType type)
+{
+    GValue* value = &dbi_row->values[idx - 1];
+
+    if (G_VALUE_TYPE (value) != type)
+    {
+        if (G_IS_VALUE (value))
+            g_value_unset (value);
+        (void)g_value_init (value, type);
+    }
+    return value;
 }
 
 static  const GValue*
@@ -2189,44 +2261,56 @@ row_get_value_at_col_name (GncSqlRow* row, const gchar* col_name)
     GncDbiSqlRow* dbi_row = (GncDbiSqlRow*)row;
     gushort type;
     guint attrs;
+    guint idx;
     GValue* value;
 
-    type = dbi_result_get_field_type (dbi_row->result, col_name);
-    attrs = dbi_result_get_field_attribs (dbi_row->result, col_name);
-    value = g_new0 (GValue, 1);
-    g_assert (value != NULL);
+    idx = row_get_field_idx (dbi_row, col_name);
+    if (idx == 0)
+    {
+        PERR ("Field %s: not in result\n", col_name);
+        return NULL;
+    }
+    type = dbi_row->types[idx - 1];
+    attrs = dbi_row->attribs[idx - 1];
 
     switch (type)
     {
     case DBI_TYPE_INTEGER:
-        (void)g_value_init (value, G_TYPE_INT64);
-        g_value_set_int64 (value, dbi_result_get_longlong (dbi_row->result, col_name));
+        value = row_value_slot (dbi_row, idx, G_TYPE_INT64);
+        g_value_set_int64 (value, dbi_result_get_longlong_idx (dbi_row->result,
+                                                               idx));
         break;
     case DBI_TYPE_DECIMAL:
-        gnc_push_locale (LC_NUMERIC, "C");
         if ((attrs & DBI_DECIMAL_SIZEMASK) == DBI_DECIMAL_SIZE4)
         {
-            (void)g_value_init (value, G_TYPE_FLOAT);
-            g_value_set_float (value, dbi_result_get_float (dbi_row->result, col_name));
+            gnc_push_locale (LC_NUMERIC, "C");
+            value = row_value_slot (dbi_row, idx, G_TYPE_FLOAT);
+            g_value_set_float (value, dbi_result_get_float_idx (dbi_row->result,
+                                                                idx));
+            gnc_pop_locale (LC_NUMERIC);
         }
         else if ((attrs & DBI_DECIMAL_SIZEMASK) == DBI_DECIMAL_SIZE8)
         {
-            (void)g_value_init (value, G_TYPE_DOUBLE);
-            g_value_set_double (value, dbi_result_get_double (dbi_row->result, col_name));
+            gnc_push_locale (LC_NUMERIC, "C");
+            value = row_value_slot (dbi_row, idx, G_TYPE_DOUBLE);
+            g_value_set_double (value, dbi_result_get_double_idx (dbi_row->result,
+                                                                  idx));
+            gnc_pop_locale (LC_NUMERIC);
         }
         else
         {
             PERR ("Field %s: strange decimal length attrs=%d\n", col_name, attrs);
+            return NULL;
         }
-        gnc_pop_locale (LC_NUMERIC);
         break;
     case DBI_TYPE_STRING:
-        (void)g_value_init (value, G_TYPE_STRING);
-        g_value_take_string (value, dbi_result_get_string_copy (dbi_row->result,
-                                                                col_name));
+        value = row_value_slot (dbi_row, idx, G_TYPE_STRING);
+        g_value_set_static_string (value,
+                                   dbi_result_get_string_idx (dbi_row->result,
+                                                              idx));
         break;
     case DBI_TYPE_DATETIME:
-        if (dbi_result_field_is_null (dbi_row->result, col_name))
+        if (dbi_result_field_is_null_idx (dbi_row->result, idx))
         {
             return NULL;
         }
@@ -2239,19 +2323,16 @@ row_get_value_at_col_name (GncSqlRow* row, const gchar* col_name)
              */
             dbi_result_t* result = (dbi_result_t*) (dbi_row->result);
             guint64 row = dbi_result_get_currow (result);
-            guint idx = dbi_result_get_field_idx (result, col_name) - 1;
-            time64 time = result->rows[row]->field_values[idx].d_datetime;
-            (void)g_value_init (value, G_TYPE_INT64);
+            time64 time = result->rows[row]->field_values[idx - 1].d_datetime;
+            value = row_value_slot (dbi_row, idx, G_TYPE_INT64);
             g_value_set_int64 (value, time);
         }
         break;
     default:
         PERR ("Field %s: unknown DBI_TYPE: %d\n", col_name, type);
-        g_free (value);
         return NULL;
     }
 
-    dbi_row->gvalue_list = g_list_prepend (dbi_row->gvalue_list, value);
     return value;
 }
 
@@ -2259,6 +2340,7 @@ static GncSqlRow*
 create_dbi_row (dbi_result result)
 {
     GncDbiSqlRow* row;
+    guint idx;
 
     row = g_new0 (GncDbiSqlRow, 1);
     g_assert (row != NULL);
@@ -2266,6 +2348,23 @@ create_dbi_row (dbi_result result)
     row->base.getValueAtColName = row_get_value_at_col_name;
     row->base.dispose = row_dispose;
     row->result = result;
+    row->num_fields = dbi_result_get_numfields (result);
+    if (row->num_fields == (guint)DBI_FIELD_ERROR)
+        row->num_fields = 0;
+    row->col_index = g_hash_table_new_full (g_str_hash, g_str_equal, g_free,
+                                            NULL);
+    row->types = g_new0 (gushort, row->num_fields);
+    row->attribs = g_new0 (guint, row->num_fields);
+    row->values = g_new0 (GValue, row->num_fields);
+    for (idx = 1; idx <= row->num_fields; idx++)
+    {
+        const gchar* name = dbi_result_get_field_name (result, idx);
+        if (name != NULL && !g_hash_table_lookup (row->col_index, name))
+            g_hash_table_insert (row->col_index, g_strdup (name),
+                                 GUINT_TO_POINTER (idx));
+        row->types[idx - 1] = dbi_result_get_field_type_idx (result, idx);
+        row->attribs[idx - 1] = dbi_result_get_field_attribs_idx (result, idx);
+    }
 
     return (GncSqlRow*)row;
 }
@@ -2317,11 +2416,6 @@ result_get_first_row (GncSqlResult* result)
 {
     GncDbiSqlResult* dbi_result = (GncDbiSqlResult*)result;
 
-    if (dbi_result->row != NULL)
-    {
-        gnc_sql_row_dispose (dbi_result->row);
-        dbi_result->row = NULL;
-    }
     if (dbi_result->num_rows > 0)
     {
         gint status = dbi_result_first_row (dbi_result->result);
@@ -2331,7 +2425,8 @@ result_get_first_row (GncSqlResult* result)
             qof_backend_set_error (dbi_result->dbi_conn->qbe, ERR_BACKEND_SERVER_ERR);
         }
         dbi_result->cur_row = 1;
-        dbi_result->row = create_dbi_row (dbi_result->result);
+        if (dbi_result->row == NULL)
+            dbi_result->row = create_dbi_row (dbi_result->result);
         return dbi_result->row;
     }
     else
@@ -2345,11 +2440,6 @@ result_get_next_row (GncSqlResult* result)
 {
     GncDbiSqlResult* dbi_result = (GncDbiSqlResult*)result;
 
-    if (dbi_result->row != NULL)
-    {
-        gnc_sql_row_dispose (dbi_result->row);
-        dbi_result->row = NULL;
-    }
     if (dbi_result->cur_row < dbi_result->num_rows)
     {
         gint status = dbi_result_next_row (dbi_result->result);
@@ -2359,7 +2449,8 @@ result_get_next_row (GncSqlResult* result)
             qof_backend_set_error (dbi_result->dbi_conn->qbe, ERR_BACKEND_SERVER_ERR);
         }
         dbi_result->cur_row++;
-        dbi_result->row = create_dbi_row (dbi_result->result);
+        if (dbi_result->row == NULL)
+            dbi_result->row = create_dbi_row (dbi_result->result);
         return dbi_result->row;
     }
     else
@@ -2449,11 +2540,95 @@ create_dbi_statement (GncSqlConnection* conn, const gchar* sql)
     return (GncSqlStatement*)stmt;
 }
 /* --------------------------------------------------------- */
+static void
+conn_discard_inserts (GncDbiSqlConnection* dbi_conn)
+{
+    if (dbi_conn->insert_batch != NULL)
+        g_string_truncate (dbi_conn->insert_batch, 0);
+    g_free (dbi_conn->insert_prefix);
+    dbi_conn->insert_prefix = NULL;
+    dbi_conn->insert_rows = 0;
+}
+
+/* Executes the multi-row INSERT accumulated by conn_queue_insert, if any. */
+static gboolean
+conn_flush_inserts (GncSqlConnection* conn)
+{
+    GncDbiSqlConnection* dbi_conn = (GncDbiSqlConnection*)conn;
+    dbi_result result;
+    gint status;
+
+    if (dbi_conn->insert_rows == 0) return TRUE;
+
+    DEBUG ("SQL: %d rows into %s\n", dbi_conn->insert_rows,
+           dbi_conn->insert_prefix);
+    do
+    {
+        gnc_dbi_init_error (dbi_conn);
+        result = dbi_conn_query (dbi_conn->conn, dbi_conn->insert_batch->str);
+    }
+    while (dbi_conn->retry);
+    conn_discard_inserts (dbi_conn);
+    if (result == NULL)
+    {
+        PERR ("Error executing batched INSERT\n");
+        qof_backend_set_error (dbi_conn->qbe, ERR_BACKEND_SERVER_ERR);
+        return FALSE;
+    }
+    status = dbi_result_free (result);
+    if (status < 0)
+    {
+        PERR ("Error in dbi_result_free() result\n");
+        qof_backend_set_error (dbi_conn->qbe, ERR_BACKEND_SERVER_ERR);
+    }
+    return TRUE;
+}
+
+/* Appends row to the pending multi-row INSERT, first executing the pending
+ * one if it is for a different prefix or has reached the batch limits. */
+static gboolean
+conn_queue_insert (GncSqlConnection* conn, const gchar* prefix,
+                   const gchar* row)
+{
+    GncDbiSqlConnection* dbi_conn = (GncDbiSqlConnection*)conn;
+
+    g_return_val_if_fail (prefix != NULL, FALSE);
+    g_return_val_if_fail (row != NULL, FALSE);
+
+    if (dbi_conn->insert_rows > 0
+        && (dbi_conn->insert_rows >= DBI_MAX_INSERT_BATCH_ROWS
+            || dbi_conn->insert_batch->len >= DBI_MAX_INSERT_BATCH_SIZE
+            || strcmp (dbi_conn->insert_prefix, prefix) != 0))
+    {
+        if (!conn_flush_inserts (conn))
+            return FALSE;
+    }
+
+    if (dbi_conn->insert_batch == NULL)
+        dbi_conn->insert_batch = g_string_sized_new (DBI_MAX_INSERT_BATCH_SIZE);
+    if (dbi_conn->insert_rows == 0)
+    {
+        g_string_assign (dbi_conn->insert_batch, prefix);
+        dbi_conn->insert_prefix = g_strdup (prefix);
+    }
+    else
+    {
+        (void)g_string_append_c (dbi_conn->insert_batch, ',');
+    }
+    (void)g_string_append (dbi_conn->insert_batch, row);
+    dbi_conn->insert_rows++;
+
+    return TRUE;
+}
+
 static void
 conn_dispose (GncSqlConnection* conn)
 {
-    //GncDbiSqlConnection* dbi_conn = (GncDbiSqlConnection*)conn;
+    GncDbiSqlConnection* dbi_conn = (GncDbiSqlConnection*)conn;
 
+    conn_discard_inserts (dbi_conn);
+    if (dbi_conn->insert_batch != NULL)
+        g_string_free (dbi_conn->insert_batch, TRUE);
     g_free (conn);
 }
 
@@ -2464,6 +2639,9 @@ conn_execute_select_statement (GncSqlConnection* conn, GncSqlStatement* stmt)
     GncDbiSqlStatement* dbi_stmt = (GncDbiSqlStatement*)stmt;
     dbi_result result;
 
+    if (!conn_flush_inserts (conn))
+        return NULL;
+
     DEBUG ("SQL: %s\n", dbi_stmt->sql->str);
     gnc_push_locale (LC_NUMERIC, "C");
     do
@@ -2491,6 +2669,9 @@ conn_execute_nonselect_statement (GncSqlConnection* conn,
     gint num_rows;
     gint status;
 
+    if (!conn_flush_inserts (conn))
+        return -1;
+
     DEBUG ("SQL: %s\n", dbi_stmt->sql->str);
     do
     {
@@ -2532,6 +2713,8 @@ conn_does_table_exist (GncSqlConnection* conn, const gchar* table_name)
 
     g_return_val_if_fail (conn != NULL, FALSE);
     g_return_val_if_fail (table_name != NULL, FALSE);
+    if (!conn_flush_inserts (conn))
+        return FALSE;
 
     dbname = dbi_conn_get_option (dbi_conn->conn, "dbname");
     tables = dbi_conn_get_table_list (dbi_conn->conn, dbname, table_name);
@@ -2563,6 +2746,9 @@ conn_begin_transaction (GncSqlConnection* conn)
 
     DEBUG ("BEGIN\n");
 
+    if (!conn_flush_inserts (conn))
+        return FALSE;
+
     if (!gnc_dbi_verify_conn (dbi_conn))
     {
         PERR ("gnc_dbi_verify_conn() failed\n");
@@ -2602,6 +2788,7 @@ conn_rollback_transaction (GncSqlConnection* conn)
     gboolean success = FALSE;
 
     DEBUG ("ROLLBACK\n");
+    conn_discard_inserts (dbi_conn);
     result = dbi_conn_queryf (dbi_conn->conn, "ROLLBACK");
     success = (result != NULL);
 
@@ -2629,6 +2816,8 @@ conn_commit_transaction (GncSqlConnection* conn)
     gboolean success = FALSE;
 
     DEBUG ("COMMIT\n");
+    if (!conn_flush_inserts (conn))
+        return FALSE;
     result = dbi_conn_queryf (dbi_conn->conn, "COMMIT");
     success = (result != NULL);
 
@@ -2986,6 +3175,11 @@ conn_create_table (GncSqlConnection* conn, const gchar* table_name,
     g_return_val_if_fail (conn != NULL, FALSE);
     g_return_val_if_fail (table_name != NULL, FALSE);
     g_return_val_if_fail (col_info_list != NULL, FALSE);
+    if (!conn_flush_inserts (conn))
+    {
+        g_list_free (col_info_list);
+        return FALSE;
+    }
 
 
     ddl = dbi_conn->provider->create_table_ddl (conn, table_name,
@@ -3025,6 +3219,8 @@ conn_create_index (GncSqlConnection* conn,  const gchar* index_name,
     g_return_val_if_fail (index_name != NULL, FALSE);
     g_return_val_if_fail (table_name != NULL, FALSE);
     g_return_val_if_fail (col_table != NULL, FALSE);
+    if (!conn_flush_inserts (conn))
+        return FALSE;
 
     ddl = create_index_ddl (conn, index_name, table_name, col_table);
     if (ddl != NULL)
@@ -3060,6 +3256,8 @@ conn_add_columns_to_table (GncSqlConnection* conn,  const gchar* table_name,
     g_return_val_if_fail (conn != NULL, FALSE);
     g_return_val_if_fail (table_name != NULL, FALSE);
     g_return_val_if_fail (col_info_list != NULL, FALSE);
+    if (!conn_flush_inserts (conn))
+        return FALSE;
 
     ddl = add_columns_ddl (conn, table_name, col_info_list);
     if (ddl != NULL)
@@ -3294,6 +3492,8 @@ create_dbi_connection (provider_functions_t* provider,
     dbi_conn->base.createIndex = conn_create_index;
     dbi_conn->base.addColumnsToTable = conn_add_columns_to_table;
     dbi_conn->base.quoteString = conn_quote_string;
+    dbi_conn->base.queueInsert = conn_queue_insert;
+    dbi_conn->base.flushInserts = conn_flush_inserts;
     dbi_conn->qbe = qbe;
     dbi_conn->conn = conn;
     dbi_conn->provider = provider;
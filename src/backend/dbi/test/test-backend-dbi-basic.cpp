@@ -423,6 +423,217 @@ test_dbi_store_and_reload (Fixture* fixture, gconstpointer pData)
     qof_session_destroy (session_3);
 }
 
+static guint
+count_rows (dbi_conn conn, const gchar* query)
+{
+    auto result = dbi_conn_query (conn, query);
+    guint rows;
+
+    g_assert (result != NULL);
+    rows = dbi_result_get_numrows (result);
+    dbi_result_free (result);
+    return rows;
+}
+
+/* Compare every table of the sqlite database in filename with the same
+ * table of the one in other_filename. */
+static void
+compare_sqlite_tables (const gchar* filename, const gchar* other_filename)
+{
+    auto dirname = g_path_get_dirname (filename);
+    auto basename = g_path_get_basename (filename);
+    dbi_conn conn;
+    dbi_result tables;
+    GSList* list = NULL, *node;
+    gchar* query;
+
+#if HAVE_LIBDBI_R
+    conn = dbi_conn_new_r ("sqlite3", dbi_instance);
+#else
+    conn = dbi_conn_new ("sqlite3");
+#endif
+    g_assert (conn != NULL);
+    dbi_conn_set_option (conn, "host", "localhost");
+    dbi_conn_set_option (conn, "dbname", basename);
+    dbi_conn_set_option (conn, "sqlite3_dbdir", dirname);
+    g_assert_cmpint (dbi_conn_connect (conn), == , 0);
+    query = g_strdup_printf ("ATTACH DATABASE '%s' AS other", other_filename);
+    dbi_result_free (dbi_conn_query (conn, query));
+    g_free (query);
+
+    tables = dbi_conn_get_table_list (conn, basename, NULL);
+    while (dbi_result_next_row (tables) != 0)
+        list = g_slist_prepend (list,
+                                g_strdup (dbi_result_get_string_idx (tables, 1)));
+    dbi_result_free (tables);
+    g_assert (list != NULL);
+
+    for (node = list; node != NULL; node = node->next)
+    {
+        auto table = static_cast<const gchar*> (node->data);
+        auto all = g_strdup_printf ("SELECT * FROM main.%s", table);
+        auto other_all = g_strdup_printf ("SELECT * FROM other.%s", table);
+        auto missing = g_strdup_printf ("%s EXCEPT %s", all, other_all);
+        auto extra = g_strdup_printf ("%s EXCEPT %s", other_all, all);
+
+        g_test_message ("Comparing table %s", table);
+        g_assert_cmpuint (count_rows (conn, all), == ,
+                          count_rows (conn, other_all));
+        g_assert_cmpuint (count_rows (conn, missing), == , 0);
+        g_assert_cmpuint (count_rows (conn, extra), == , 0);
+        g_free (all);
+        g_free (other_all);
+        g_free (missing);
+        g_free (extra);
+    }
+
+    g_slist_free_full (list, g_free);
+    dbi_conn_close (conn);
+    g_free (dirname);
+    g_free (basename);
+}
+
+/* Save the same book once with the rows of each table batched into
+ * multi-row INSERTs and once with an INSERT for each row, and check that
+ * both databases hold the same rows. */
+static void
+test_dbi_batched_insert (Fixture* fixture, gconstpointer pData)
+{
+    QofSession* session_1, *session_2;
+    QofBackend* qbe;
+    auto row_filename = g_strdup_printf ("%s-rows", fixture->filename);
+
+    auto msg = "[gnc_dbi_unlock()] There was no lock entry in the Lock table";
+    auto log_domain = "gnc.backend.dbi";
+    auto loglevel = static_cast<GLogLevelFlags> (G_LOG_LEVEL_WARNING |
+                                                 G_LOG_FLAG_FATAL);
+    TestErrorStruct* check = test_error_struct_new (log_domain, loglevel, msg);
+    fixture->hdlrs = test_log_set_fatal_handler (fixture->hdlrs, check,
+                                                 (GLogFunc)test_checked_handler);
+
+    // Batched
+    session_1 = qof_session_new ();
+    qof_session_begin (session_1, fixture->filename, FALSE, TRUE, TRUE);
+    g_assert_cmpint (qof_session_get_error (session_1), == , ERR_BACKEND_NO_ERR);
+    qbe = qof_session_get_backend (session_1);
+    g_assert (((GncSqlBackend*)qbe)->conn->queueInsert != NULL);
+    qof_session_swap_data (fixture->session, session_1);
+    qof_session_save (session_1, NULL);
+    g_assert_cmpint (qof_session_get_error (session_1), == , ERR_BACKEND_NO_ERR);
+    g_assert (((GncSqlBackend*)qbe)->insert_prefixes != NULL);
+
+    // One row at a time
+    session_2 = qof_session_new ();
+    qof_session_begin (session_2, row_filename, FALSE, TRUE, TRUE);
+    g_assert_cmpint (qof_session_get_error (session_2), == , ERR_BACKEND_NO_ERR);
+    qbe = qof_session_get_backend (session_2);
+    ((GncSqlBackend*)qbe)->conn->queueInsert = NULL;
+    qof_session_swap_data (session_1, session_2);
+    qof_session_save (session_2, NULL);
+    g_assert_cmpint (qof_session_get_error (session_2), == , ERR_BACKEND_NO_ERR);
+
+    compare_sqlite_tables (fixture->filename, row_filename);
+
+    qof_session_end (session_2);
+    qof_session_destroy (session_2);
+    qof_session_end (session_1);
+    qof_session_destroy (session_1);
+    g_unlink (row_filename);
+    g_free (row_filename);
+}
+
+/* Save a large synthetic book and time how long it takes to load it
+ * back. Only run in perf mode (-m perf). */
+static void
+test_dbi_load_perf (Fixture* fixture, gconstpointer pData)
+{
+    const gchar* url = (const gchar*)pData;
+    const int num_accounts = 50, num_transactions = 100000;
+    QofSession* session_1, *session_2;
+    QofBook* book;
+    Account* root;
+    Account* accounts[num_accounts];
+    gnc_commodity* currency;
+    gdouble elapsed;
+    int i;
+
+    if (!g_test_perf ())
+        return;
+
+    auto msg = "[gnc_dbi_unlock()] There was no lock entry in the Lock table";
+    auto log_domain = "gnc.backend.dbi";
+    auto loglevel = static_cast<GLogLevelFlags> (G_LOG_LEVEL_WARNING |
+                                                 G_LOG_FLAG_FATAL);
+    TestErrorStruct* check = test_error_struct_new (log_domain, loglevel, msg);
+    fixture->hdlrs = test_log_set_fatal_handler (fixture->hdlrs, check,
+                                                 (GLogFunc)test_checked_handler);
+    if (fixture->filename)
+        url = fixture->filename;
+
+    session_1 = qof_session_new ();
+    book = qof_session_get_book (session_1);
+    root = gnc_book_get_root_account (book);
+    currency = gnc_commodity_table_lookup (gnc_commodity_table_get_table (book),
+                                           GNC_COMMODITY_NS_CURRENCY, "CAD");
+    for (i = 0; i < num_accounts; i++)
+    {
+        auto name = g_strdup_printf ("Account %d", i);
+        accounts[i] = xaccMallocAccount (book);
+        xaccAccountBeginEdit (accounts[i]);
+        xaccAccountSetType (accounts[i], ACCT_TYPE_BANK);
+        xaccAccountSetName (accounts[i], name);
+        xaccAccountSetCommodity (accounts[i], currency);
+        gnc_account_append_child (root, accounts[i]);
+        xaccAccountCommitEdit (accounts[i]);
+        g_free (name);
+    }
+    for (i = 0; i < num_transactions; i++)
+    {
+        auto tx = xaccMallocTransaction (book);
+        auto spl1 = xaccMallocSplit (book);
+        auto spl2 = xaccMallocSplit (book);
+        auto amount = gnc_numeric_create (i + 1, 100);
+
+        xaccTransBeginEdit (tx);
+        xaccTransSetCurrency (tx, currency);
+        xaccTransSetDatePostedSecs (tx, 86400 * (i / 100));
+        xaccTransSetDescription (tx, "Performance test transaction");
+        xaccTransAppendSplit (tx, spl1);
+        xaccTransAppendSplit (tx, spl2);
+        xaccSplitSetAccount (spl1, accounts[i % num_accounts]);
+        xaccSplitSetAccount (spl2, accounts[(i + 1) % num_accounts]);
+        xaccSplitSetValue (spl1, amount);
+        xaccSplitSetAmount (spl1, amount);
+        xaccSplitSetValue (spl2, gnc_numeric_neg (amount));
+        xaccSplitSetAmount (spl2, gnc_numeric_neg (amount));
+        xaccTransCommitEdit (tx);
+    }
+
+    session_2 = qof_session_new ();
+    qof_session_begin (session_2, url, FALSE, TRUE, TRUE);
+    g_assert_cmpint (qof_session_get_error (session_2), == , ERR_BACKEND_NO_ERR);
+    qof_session_swap_data (session_1, session_2);
+    qof_session_save (session_2, NULL);
+    g_assert_cmpint (qof_session_get_error (session_2), == , ERR_BACKEND_NO_ERR);
+    qof_session_end (session_2);
+    qof_session_destroy (session_2);
+    qof_session_destroy (session_1);
+
+    session_2 = qof_session_new ();
+    qof_session_begin (session_2, url, TRUE, FALSE, FALSE);
+    g_assert_cmpint (qof_session_get_error (session_2), == , ERR_BACKEND_NO_ERR);
+    g_test_timer_start ();
+    qof_session_load (session_2, NULL);
+    elapsed = g_test_timer_elapsed ();
+    g_assert_cmpint (qof_session_get_error (session_2), == , ERR_BACKEND_NO_ERR);
+    g_assert_cmpint (gnc_book_count_transactions (qof_session_get_book (session_2)),
+                     == , num_transactions);
+    g_test_minimized_result (elapsed, "Loaded %d transactions in %6.3f s",
+                             num_transactions, elapsed);
+    qof_session_end (session_2);
+    qof_session_destroy (session_2);
+}
+
 /** Test the safe_save mechanism.  Beware that this test used on its
  * own doesn't ensure that the resave is done safely, only that the
  * database is intact and unchanged after the save. To observe the
@@ -504,6 +715,162 @@ cleanup:
     }
     return;
 }
+static Account*
+add_account (QofBook* book, const char* name, gnc_commodity* currency)
+{
+    auto acct = xaccMallocAccount (book);
+
+    xaccAccountBeginEdit (acct);
+    xaccAccountSetType (acct, ACCT_TYPE_BANK);
+    xaccAccountSetName (acct, name);
+    xaccAccountSetCommodity (acct, currency);
+    gnc_account_append_child (gnc_book_get_root_account (book), acct);
+    xaccAccountCommitEdit (acct);
+    return acct;
+}
+
+static Transaction*
+add_transaction (Account* from, Account* to, const char* description,
+                 gint64 cents)
+{
+    auto book = gnc_account_get_book (from);
+    auto tx = xaccMallocTransaction (book);
+    auto spl1 = xaccMallocSplit (book);
+    auto spl2 = xaccMallocSplit (book);
+    auto amount = gnc_numeric_create (cents, 100);
+
+    xaccTransBeginEdit (tx);
+    xaccTransSetCurrency (tx, xaccAccountGetCommodity (from));
+    xaccTransSetDatePostedSecsNormalized (tx, gnc_time (NULL));
+    xaccTransSetDescription (tx, description);
+    xaccSplitSetParent (spl1, tx);
+    xaccSplitSetAccount (spl1, from);
+    xaccSplitSetAmount (spl1, gnc_numeric_neg (amount));
+    xaccSplitSetValue (spl1, gnc_numeric_neg (amount));
+    xaccSplitSetParent (spl2, tx);
+    xaccSplitSetAccount (spl2, to);
+    xaccSplitSetAmount (spl2, amount);
+    xaccSplitSetValue (spl2, amount);
+    xaccTransCommitEdit (tx);
+    return tx;
+}
+
+/* Load a book that is up to date in the database, change it and
+ * safe-save it, which then writes only the changes. The backend writes
+ * each change as it is committed, so to leave something for the save to
+ * do the additions and edits are made with the backend's commit
+ * disconnected, as if it had failed. Deletions leave the book when they
+ * commit, so those are made with it connected. */
+static void
+test_dbi_safe_sync_changes (Fixture* fixture, gconstpointer pData)
+{
+    auto url = (gchar*)pData;
+    QofSession* session_1, *session_2, *session_3;
+    QofBook* book;
+    QofBackend* qbe;
+    GncGUID acct_gone, tx_gone, acct_edited, tx_edited;
+    Account* bank, *cash, *savings, *added_acct;
+    Transaction* tx, *added_tx;
+    gnc_commodity* currency;
+
+    auto msg = "[gnc_dbi_unlock()] There was no lock entry in the Lock table";
+    auto log_domain = "gnc.backend.dbi";
+    auto loglevel = static_cast<GLogLevelFlags> (G_LOG_LEVEL_WARNING |
+                                                 G_LOG_FLAG_FATAL);
+    TestErrorStruct* check = test_error_struct_new (log_domain, loglevel, msg);
+    fixture->hdlrs = test_log_set_fatal_handler (fixture->hdlrs, check,
+                                                 (GLogFunc)test_checked_handler);
+    if (fixture->filename)
+        url = fixture->filename;
+
+    // Save a book with something in it to change
+    session_1 = qof_session_new ();
+    qof_session_begin (session_1, url, FALSE, TRUE, TRUE);
+    g_assert_cmpint (qof_session_get_error (session_1), == , ERR_BACKEND_NO_ERR);
+    qof_session_swap_data (fixture->session, session_1);
+    book = qof_session_get_book (session_1);
+    currency = gnc_commodity_table_lookup (gnc_commodity_table_get_table (book),
+                                           GNC_COMMODITY_NS_CURRENCY, "CAD");
+    bank = gnc_account_lookup_by_name (gnc_book_get_root_account (book),
+                                       "Bank 1");
+    cash = add_account (book, "Cash", currency);
+    savings = add_account (book, "Savings", currency);
+    acct_edited = *qof_instance_get_guid (QOF_INSTANCE (cash));
+    acct_gone = *qof_instance_get_guid (QOF_INSTANCE (savings));
+    tx = add_transaction (bank, cash, "Withdrawal", 5000);
+    tx_edited = *qof_instance_get_guid (QOF_INSTANCE (tx));
+    tx = add_transaction (bank, cash, "Withdrawal", 2500);
+    tx_gone = *qof_instance_get_guid (QOF_INSTANCE (tx));
+    qof_session_save (session_1, NULL);
+    g_assert_cmpint (qof_session_get_error (session_1), == , ERR_BACKEND_NO_ERR);
+    qof_session_end (session_1);
+    qof_session_destroy (session_1);
+
+    // Load it back; the database needs no resave, so only changes are synced
+    session_2 = qof_session_new ();
+    qof_session_begin (session_2, url, FALSE, FALSE, FALSE);
+    g_assert_cmpint (qof_session_get_error (session_2), == , ERR_BACKEND_NO_ERR);
+    qof_session_load (session_2, NULL);
+    g_assert_cmpint (qof_session_get_error (session_2), == , ERR_BACKEND_NO_ERR);
+    book = qof_session_get_book (session_2);
+    qbe = qof_session_get_backend (session_2);
+    g_assert_cmpint (gnc_sql_get_table_version ((GncSqlBackend*)qbe,
+                                                "Gnucash-Resave"), >= ,
+                     GNUCASH_RESAVE_VERSION);
+    g_assert (!qof_book_session_not_saved (book));
+
+    savings = xaccAccountLookup (&acct_gone, book);
+    g_assert (savings != NULL);
+    xaccAccountBeginEdit (savings);
+    xaccAccountDestroy (savings);
+    tx = xaccTransLookup (&tx_gone, book);
+    g_assert (tx != NULL);
+    xaccTransDestroy (tx);
+
+    auto commit = qbe->commit;
+    qbe->commit = NULL;
+    cash = xaccAccountLookup (&acct_edited, book);
+    xaccAccountBeginEdit (cash);
+    xaccAccountSetName (cash, "Petty Cash");
+    xaccAccountSetDescription (cash, "Coins in the drawer");
+    xaccAccountCommitEdit (cash);
+    tx = xaccTransLookup (&tx_edited, book);
+    xaccTransBeginEdit (tx);
+    xaccTransSetDescription (tx, "Float for the drawer");
+    xaccSplitSetMemo (xaccTransGetSplit (tx, 0), "Counted twice");
+    xaccTransCommitEdit (tx);
+    added_acct = add_account (book, "Expenses", currency);
+    added_tx = add_transaction (cash, added_acct, "Stamps", 1234);
+    qbe->commit = commit;
+    g_assert (qof_instance_get_dirty_flag (QOF_INSTANCE (cash)));
+    g_assert (qof_instance_get_dirty_flag (QOF_INSTANCE (added_tx)));
+
+    qof_session_safe_save (session_2, NULL);
+    g_assert_cmpint (qof_session_get_error (session_2), == , ERR_BACKEND_NO_ERR);
+    g_assert (!qof_instance_get_dirty_flag (QOF_INSTANCE (cash)));
+    g_assert (!qof_instance_get_dirty_flag (QOF_INSTANCE (added_tx)));
+    g_assert (!qof_book_session_not_saved (book));
+
+    // Reload and compare; the deletions must stay deleted
+    session_3 = qof_session_new ();
+    qof_session_begin (session_3, url, TRUE, FALSE, FALSE);
+    g_assert_cmpint (qof_session_get_error (session_3), == , ERR_BACKEND_NO_ERR);
+    qof_session_load (session_3, NULL);
+    g_assert_cmpint (qof_session_get_error (session_3), == , ERR_BACKEND_NO_ERR);
+    compare_books (book, qof_session_get_book (session_3));
+    g_assert (xaccAccountLookup (&acct_gone, qof_session_get_book (session_3))
+              == NULL);
+    g_assert (xaccTransLookup (&tx_gone, qof_session_get_book (session_3))
+              == NULL);
+    g_assert_cmpstr (xaccAccountGetName (xaccAccountLookup (&acct_edited,
+                     qof_session_get_book (session_3))), == , "Petty Cash");
+
+    qof_session_end (session_2);
+    qof_session_destroy (session_2);
+    qof_session_end (session_3);
+    qof_session_destroy (session_3);
+}
+
 /* Test the gnc_dbi_load logic that forces a newer database to be
  * opened read-only and an older one to be safe-saved. Again, it would
  * be better to do this starting from a fresh file, but instead we're
@@ -651,6 +1018,8 @@ create_dbi_test_suite (const char* dbm_name, const char* url)
                   test_dbi_store_and_reload, teardown);
     GNC_TEST_ADD (subsuite, "safe_save", Fixture, url, setup_memory,
                   test_dbi_safe_save, teardown);
+    GNC_TEST_ADD (subsuite, "safe_sync_changes", Fixture, url, setup_memory,
+                  test_dbi_safe_sync_changes, teardown);
     GNC_TEST_ADD (subsuite, "version_control", Fixture, url, setup_memory,
                   test_dbi_version_control, teardown);
     GNC_TEST_ADD (subsuite, "business_store_and_reload", Fixture, url,
@@ -677,7 +1046,13 @@ test_suite_gnc_backend_dbi (void)
                                   (gchar*)dbi_driver_get_name (driver));
     }
     if (g_list_find_custom (drivers, "sqlite3", (GCompareFunc)g_strcmp0))
+    {
         create_dbi_test_suite ("sqlite3", "sqlite3");
+        GNC_TEST_ADD ("/backend/dbi/sqlite3", "batched_insert", Fixture,
+                      "sqlite3", setup, test_dbi_batched_insert, teardown);
+        GNC_TEST_ADD ("/backend/dbi/sqlite3", "load_perf", Fixture, "sqlite3",
+                      setup_memory, test_dbi_load_perf, teardown);
+    }
     if (strlen (TEST_MYSQL_URL) > 0 &&
         g_list_find_custom (drivers, "mysql", (GCompareFunc)g_strcmp0))
         create_dbi_test_suite ("mysql", TEST_MYSQL_URL);
@@ -28,6 +28,7 @@
 extern "C"
 {
 #include <stdlib.h>
+#include <string.h>
 #include "config.h"
 
 #include <errno.h>
@@ -88,6 +89,12 @@ static GncSqlStatement* build_insert_statement (GncSqlBackend* be,
                                                 const gchar* table_name,
                                                 QofIdTypeConst obj_name, gpointer pObject,
                                                 const GncSqlColumnTableEntry* table);
+static gchar* build_insert_values (GncSqlBackend* be,
+                                   QofIdTypeConst obj_name, gpointer pObject,
+                                   const GncSqlColumnTableEntry* table);
+static const gchar* get_insert_prefix (GncSqlBackend* be,
+                                       const gchar* table_name,
+                                       const GncSqlColumnTableEntry* table);
 static GncSqlStatement* build_update_statement (GncSqlBackend* be,
                                                 const gchar* table_name,
                                                 QofIdTypeConst obj_name, gpointer pObject,
@@ -138,6 +145,18 @@ gnc_sql_init (GncSqlBackend* be)
     }
 }
 
+void
+gnc_sql_finalize (GncSqlBackend* be)
+{
+    g_return_if_fail (be != NULL);
+
+    if (be->insert_prefixes != NULL)
+    {
+        g_hash_table_destroy (be->insert_prefixes);
+        be->insert_prefixes = NULL;
+    }
+}
+
 /* ================================================================= */
 
 static void
@@ -428,6 +447,26 @@ write_cb (const gchar* type, gpointer data_p, gpointer be_p)
     }
 }
 
+static void
+mark_instance_clean_cb (QofInstance* inst, gpointer unused)
+{
+    qof_instance_mark_clean (inst);
+}
+
+static void
+mark_collection_clean_cb (const gchar* type, gpointer data_p, gpointer be_p)
+{
+    GncSqlObjectBackend* pData = static_cast<decltype (pData)> (data_p);
+    GncSqlBackend* be = static_cast<decltype (be)> (be_p);
+    QofCollection* col;
+
+    g_return_if_fail (type != NULL && data_p != NULL && be_p != NULL);
+
+    col = qof_book_get_collection (be->book, pData->type_name);
+    qof_collection_foreach (col, mark_instance_clean_cb, NULL);
+    qof_collection_mark_clean (col);
+}
+
 static void
 update_progress (GncSqlBackend* be)
 {
@@ -494,6 +533,10 @@ gnc_sql_sync_all (GncSqlBackend* be,  QofBook* book)
     {
         qof_object_foreach_backend (GNC_SQL_BACKEND, write_cb, be);
     }
+    if (is_ok && be->conn->flushInserts != NULL)
+    {
+        is_ok = gnc_sql_connection_flush_inserts (be->conn);
+    }
     if (is_ok)
     {
         is_ok = gnc_sql_connection_commit_transaction (be->conn);
@@ -502,6 +545,11 @@ gnc_sql_sync_all (GncSqlBackend* be,  QofBook* book)
     {
         be->is_pristine_db = FALSE;
 
+        /* The database now matches the book, so a later
+         * gnc_sql_sync_dirty() has nothing left over to write. */
+        qof_object_foreach_backend (GNC_SQL_BACKEND, mark_collection_clean_cb,
+                                    be);
+
         /* Mark the session as clean -- though it shouldn't ever get
         * marked dirty with this backend
          */
@@ -654,6 +702,117 @@ gnc_sql_commit_edit (GncSqlBackend* be, QofInstance* inst)
 
     LEAVE ("");
 }
+/* ---------------------------------------------------------------------- */
+/* Incremental sync: write only what changed since the last save. */
+
+typedef struct
+{
+    GncSqlBackend* be;
+    GList* insts;
+    GList* colls;
+} sync_dirty_data;
+
+static void
+collect_dirty_cb (QofInstance* inst, gpointer data_p)
+{
+    sync_dirty_data* data = static_cast<decltype (data)> (data_p);
+
+    /* Instances still being edited are written when their edit commits. */
+    if (qof_instance_get_editlevel (inst) > 0)
+        return;
+    if (qof_instance_get_dirty_flag (inst))
+        data->insts = g_list_prepend (data->insts, inst);
+}
+
+static void
+collect_dirty_collection_cb (const gchar* type, gpointer data_p,
+                             gpointer sync_p)
+{
+    GncSqlObjectBackend* pData = static_cast<decltype (pData)> (data_p);
+    sync_dirty_data* data = static_cast<decltype (data)> (sync_p);
+    QofCollection* col;
+
+    g_return_if_fail (type != NULL && data_p != NULL && sync_p != NULL);
+    g_return_if_fail (pData->version == GNC_SQL_BACKEND_VERSION);
+
+    if (pData->commit == NULL) return;
+    col = qof_book_get_collection (data->be->book, pData->type_name);
+    if (!qof_collection_is_dirty (col)) return;
+
+    qof_collection_foreach (col, collect_dirty_cb, data);
+    data->colls = g_list_prepend (data->colls, col);
+}
+
+void
+gnc_sql_sync_dirty (GncSqlBackend* be, QofBook* book)
+{
+    sync_dirty_data data;
+    gboolean is_ok;
+    GList* node;
+
+    g_return_if_fail (be != NULL);
+    g_return_if_fail (book != NULL);
+
+    ENTER ("book=%p, be->book=%p", book, be->book);
+    if (qof_book_is_readonly (book))
+    {
+        qof_backend_set_error ((QofBackend*)be, ERR_BACKEND_READONLY);
+        LEAVE ("Book is read-only");
+        return;
+    }
+
+    be->book = book;
+    data.be = be;
+    data.insts = NULL;
+    data.colls = NULL;
+    qof_object_foreach_backend (GNC_SQL_BACKEND, collect_dirty_collection_cb,
+                                &data);
+    data.insts = g_list_reverse (data.insts);
+
+    be->obj_total = g_list_length (data.insts);
+    be->operations_done = 0;
+    update_progress (be);
+
+    is_ok = gnc_sql_connection_begin_transaction (be->conn);
+    for (node = data.insts; is_ok && node != NULL; node = node->next)
+    {
+        sql_backend be_data;
+
+        be_data.is_known = FALSE;
+        be_data.be = be;
+        be_data.inst = QOF_INSTANCE (node->data);
+        be_data.is_ok = TRUE;
+        qof_object_foreach_backend (GNC_SQL_BACKEND, commit_cb, &be_data);
+        is_ok = be_data.is_ok;
+        be->operations_done++;
+        update_progress (be);
+    }
+    if (is_ok)
+    {
+        is_ok = gnc_sql_connection_commit_transaction (be->conn);
+    }
+    if (is_ok)
+    {
+        /* Only now that the transaction is committed may anything be
+         * marked clean; on error everything stays dirty for the next save. */
+        for (node = data.insts; node != NULL; node = node->next)
+            qof_instance_mark_clean (QOF_INSTANCE (node->data));
+        for (node = data.colls; node != NULL; node = node->next)
+            qof_collection_mark_clean (static_cast<QofCollection*> (node->data));
+        qof_book_mark_session_saved (book);
+    }
+    else
+    {
+        if (!qof_backend_check_error ((QofBackend*)be))
+            qof_backend_set_error ((QofBackend*)be, ERR_BACKEND_SERVER_ERR);
+        (void)gnc_sql_connection_rollback_transaction (be->conn);
+    }
+    g_list_free (data.insts);
+    g_list_free (data.colls);
+    finish_progress (be);
+    LEAVE ("book=%p", book);
+}
+
 /* ---------------------------------------------------------------------- */
 
 /* Query processing */
@@ -1729,12 +1888,28 @@ static GncSqlColumnTypeHandler double_handler
 };
 /* ----------------------------------------------------------------- */
 
+/* Decode the GUID in column col_name straight into guid. Returns FALSE,
+ * leaving guid alone, if the column is missing or NULL. */
+static gboolean
+load_guid_from_column (GncSqlRow* row, const gchar* col_name, GncGUID* guid)
+{
+    const GValue* val;
+    const gchar* guid_str;
+
+    val = gnc_sql_row_get_value_at_col_name (row, col_name);
+    if (val == NULL || (guid_str = g_value_get_string (val)) == NULL)
+        return FALSE;
+
+    if (!guid_from_hex_buff (guid_str, strlen (guid_str), guid))
+        (void)string_to_guid (guid_str, guid);
+    return TRUE;
+}
+
 static void
 load_guid (const GncSqlBackend* be, GncSqlRow* row,
            QofSetterFunc setter, gpointer pObject,
            const GncSqlColumnTableEntry* table_row)
 {
-    const GValue* val;
     GncGUID guid;
     const GncGUID* pGuid;
 
@@ -1744,14 +1919,12 @@ load_guid (const GncSqlBackend* be, GncSqlRow* row,
     g_return_if_fail (table_row != NULL);
     g_return_if_fail (table_row->gobj_param_name != NULL || setter != NULL);
 
-    val = gnc_sql_row_get_value_at_col_name (row, table_row->col_name);
-    if (val == NULL || g_value_get_string (val) == NULL)
+    if (!load_guid_from_column (row, table_row->col_name, &guid))
     {
         pGuid = NULL;
     }
     else
     {
-        (void)string_to_guid (g_value_get_string (val), &guid);
         pGuid = &guid;
     }
     if (pGuid != NULL)
@@ -2436,13 +2609,9 @@ _retrieve_guid_ (gpointer pObject,  gpointer pValue)
 }
 
 
-// Table to retrieve just the guid
-static GncSqlColumnTableEntry guid_table[] =
-{
-    { "guid", CT_GUID, 0, 0, NULL, NULL, NULL, _retrieve_guid_ },
-    { NULL }
-};
-
+/* These read the column directly rather than going through
+ * gnc_sql_load_object() with a one-entry table: they run once per row of
+ * every object loaded. */
 const GncGUID*
 gnc_sql_load_guid (const GncSqlBackend* be, GncSqlRow* row)
 {
@@ -2451,19 +2620,11 @@ gnc_sql_load_guid (const GncSqlBackend* be, GncSqlRow* row)
     g_return_val_if_fail (be != NULL, NULL);
     g_return_val_if_fail (row != NULL, NULL);
 
-    gnc_sql_load_object (be, row, NULL, &guid, guid_table);
+    (void)load_guid_from_column (row, "guid", &guid);
 
     return &guid;
 }
 
-// Table to retrieve just the guid
-static GncSqlColumnTableEntry tx_guid_table[] =
-{
-    { "tx_guid", CT_GUID, 0, 0, NULL, NULL, NULL, _retrieve_guid_ },
-    { NULL }
-};
-
-
 const GncGUID*
 gnc_sql_load_tx_guid (const GncSqlBackend* be, GncSqlRow* row)
 {
@@ -2472,7 +2633,7 @@ gnc_sql_load_tx_guid (const GncSqlBackend* be, GncSqlRow* row)
     g_return_val_if_fail (be != NULL, NULL);
     g_return_val_if_fail (row != NULL, NULL);
 
-    gnc_sql_load_object (be, row, NULL, &guid, tx_guid_table);
+    (void)load_guid_from_column (row, "tx_guid", &guid);
 
     return &guid;
 }
@@ -2734,7 +2895,23 @@ gnc_sql_do_db_operation (GncSqlBackend* be,
     g_return_val_if_fail (pObject != NULL, FALSE);
     g_return_val_if_fail (table != NULL, FALSE);
 
-    if (op == OP_DB_INSERT)
+    if (op == OP_DB_INSERT && be->is_pristine_db
+        && be->conn->queueInsert != NULL)
+    {
+        /* Saving a whole book: let the connection batch the rows. */
+        const gchar* prefix = get_insert_prefix (be, table_name, table);
+        gchar* row = build_insert_values (be, obj_name, pObject, table);
+
+        ok = gnc_sql_connection_queue_insert (be->conn, prefix, row);
+        if (!ok)
+        {
+            PERR ("SQL error: %s%s\n", prefix, row);
+            qof_backend_set_error (&be->be, ERR_BACKEND_SERVER_ERR);
+        }
+        g_free (row);
+        return ok;
+    }
+    else if (op == OP_DB_INSERT)
     {
         stmt = build_insert_statement (be, table_name, obj_name, pObject, table);
     }
@@ -2793,8 +2970,9 @@ create_gslist_from_values (GncSqlBackend* be,
     return list;
 }
 
-gchar*
-gnc_sql_get_sql_value (const GncSqlConnection* conn, const GValue* value)
+static void
+append_sql_value (const GncSqlConnection* conn, GString* sql,
+                  const GValue* value)
 {
     if (value != NULL && G_IS_VALUE (value))
     {
@@ -2808,22 +2986,24 @@ gnc_sql_get_sql_value (const GncSqlConnection* conn, const GValue* value)
                 gchar* after_str;
                 before_str = g_value_dup_string (value);
                 after_str = gnc_sql_connection_quote_string (conn, before_str);
+                (void)g_string_append (sql, after_str);
                 g_free (before_str);
-                return after_str;
+                g_free (after_str);
             }
             else
             {
-                return g_strdup ("NULL");
+                (void)g_string_append (sql, "NULL");
             }
         }
         else if (type == G_TYPE_INT64)
         {
-            return g_strdup_printf ("%" G_GINT64_FORMAT, g_value_get_int64 (value));
+            g_string_append_printf (sql, "%" G_GINT64_FORMAT,
+                                    g_value_get_int64 (value));
 
         }
         else if (type == G_TYPE_INT)
         {
-            return g_strdup_printf ("%d", g_value_get_int (value));
+            g_string_append_printf (sql, "%d", g_value_get_int (value));
 
         }
         else if (type == G_TYPE_DOUBLE)
@@ -2831,37 +3011,40 @@ gnc_sql_get_sql_value (const GncSqlConnection* conn, const GValue* value)
             gchar doublestr[G_ASCII_DTOSTR_BUF_SIZE];
             g_ascii_dtostr (doublestr, sizeof (doublestr),
                             g_value_get_double (value));
-            return g_strdup (doublestr);
+            (void)g_string_append (sql, doublestr);
 
         }
         else if (g_value_type_transformable (type, G_TYPE_STRING))
         {
-            GValue* string;
-            gchar* str;
-
-            string = g_new0 (GValue, 1);
-            g_assert (string != NULL);
-            (void)g_value_init (string, G_TYPE_STRING);
-            (void)g_value_transform (value, string);
-            str = g_value_dup_string (string);
-            g_value_unset (string);
-            g_free (string);
+            GValue string = G_VALUE_INIT;
+
+            (void)g_value_init (&string, G_TYPE_STRING);
+            (void)g_value_transform (value, &string);
+            (void)g_string_append (sql, g_value_get_string (&string));
+            g_value_unset (&string);
             PWARN ("using g_value_transform(), gtype = '%s'\n", g_type_name (type));
-            return str;
         }
         else
         {
             PWARN ("not transformable, gtype = '%s'\n", g_type_name (type));
-            return g_strdup ("$$$");
+            (void)g_string_append (sql, "$$$");
         }
     }
     else
     {
         PWARN ("value is NULL or not G_IS_VALUE()\n");
-        return g_strdup ("");
     }
 }
 
+gchar*
+gnc_sql_get_sql_value (const GncSqlConnection* conn, const GValue* value)
+{
+    GString* sql = g_string_sized_new (32);
+
+    append_sql_value (conn, sql, value);
+    return g_string_free (sql, FALSE);
+}
+
 static void
 free_gvalue_list (GSList* list)
 {
@@ -2878,32 +3061,64 @@ free_gvalue_list (GSList* list)
     g_slist_free (list);
 }
 
-static GncSqlStatement*
-build_insert_statement (GncSqlBackend* be,
-                        const gchar* table_name,
-                        QofIdTypeConst obj_name, gpointer pObject,
-                        const GncSqlColumnTableEntry* table)
+/* INSERT prefixes depend only on the table name and column table, so they
+ * are built once per pair and kept in be->insert_prefixes for every row. */
+typedef struct
 {
-    GncSqlStatement* stmt;
+    gchar* table_name;
+    const GncSqlColumnTableEntry* table;
+} InsertPrefixKey;
+
+static guint
+insert_prefix_key_hash (gconstpointer key)
+{
+    const InsertPrefixKey* k = static_cast<decltype (k)> (key);
+    return g_str_hash (k->table_name) ^ g_direct_hash (k->table);
+}
+
+static gboolean
+insert_prefix_key_equal (gconstpointer a, gconstpointer b)
+{
+    const InsertPrefixKey* ka = static_cast<decltype (ka)> (a);
+    const InsertPrefixKey* kb = static_cast<decltype (kb)> (b);
+    return ka->table == kb->table && g_strcmp0 (ka->table_name,
+                                                kb->table_name) == 0;
+}
+
+static void
+insert_prefix_key_free (gpointer key)
+{
+    InsertPrefixKey* k = static_cast<decltype (k)> (key);
+    g_free (k->table_name);
+    g_free (k);
+}
+
+static const gchar*
+get_insert_prefix (GncSqlBackend* be, const gchar* table_name,
+                   const GncSqlColumnTableEntry* table)
+{
+    InsertPrefixKey lookup = { const_cast<gchar*> (table_name), table };
+    InsertPrefixKey* key;
     GString* sql;
-    GSList* values;
-    GSList* node;
-    gchar* sqlbuf;
     GList* colnames = NULL;
     GList* colname;
     const GncSqlColumnTableEntry* table_row;
+    const gchar* prefix;
+
+    if (be->insert_prefixes == NULL)
+        be->insert_prefixes = g_hash_table_new_full (insert_prefix_key_hash,
+                                                     insert_prefix_key_equal,
+                                                     insert_prefix_key_free,
+                                                     g_free);
+    prefix = static_cast<const gchar*> (g_hash_table_lookup (be->insert_prefixes,
+                                                             &lookup));
+    if (prefix != NULL)
+        return prefix;
 
-    g_return_val_if_fail (be != NULL, NULL);
-    g_return_val_if_fail (table_name != NULL, NULL);
-    g_return_val_if_fail (obj_name != NULL, NULL);
-    g_return_val_if_fail (pObject != NULL, NULL);
-    g_return_val_if_fail (table != NULL, NULL);
-
-    sqlbuf = g_strdup_printf ("INSERT INTO %s(", table_name);
-    sql = g_string_new (sqlbuf);
-    g_free (sqlbuf);
+    sql = g_string_new ("");
+    g_string_printf (sql, "INSERT INTO %s(", table_name);
 
-    // Get all col names and all values
+    // Get all col names
     for (table_row = table; table_row->col_name != NULL; table_row++)
     {
         if ((table_row->flags & COL_AUTOINC) == 0)
@@ -2928,27 +3143,64 @@ build_insert_statement (GncSqlBackend* be,
         g_free (colname->data);
     }
     g_list_free (colnames);
+    g_string_append (sql, ") VALUES");
+
+    key = g_new (InsertPrefixKey, 1);
+    key->table_name = g_strdup (table_name);
+    key->table = table;
+    prefix = g_string_free (sql, FALSE);
+    g_hash_table_insert (be->insert_prefixes, key, (gpointer)prefix);
+    return prefix;
+}
+
+/* Returns the parenthesized value list of an INSERT for pObject. */
+static gchar*
+build_insert_values (GncSqlBackend* be,
+                     QofIdTypeConst obj_name, gpointer pObject,
+                     const GncSqlColumnTableEntry* table)
+{
+    GString* sql;
+    GSList* values;
+    GSList* node;
 
-    g_string_append (sql, ") VALUES(");
+    sql = g_string_sized_new (256);
+    g_string_append (sql, "(");
     values = create_gslist_from_values (be, obj_name, pObject, table);
     for (node = values; node != NULL; node = node->next)
     {
-        GValue* value = (GValue*)node->data;
-        gchar* value_str;
         if (node != values)
         {
             (void)g_string_append (sql, ",");
         }
-        value_str = gnc_sql_get_sql_value (be->conn, value);
-        (void)g_string_append (sql, value_str);
-        g_free (value_str);
-        (void)g_value_reset (value);
+        append_sql_value (be->conn, sql, (GValue*)node->data);
     }
     free_gvalue_list (values);
     (void)g_string_append (sql, ")");
 
-    stmt = gnc_sql_connection_create_statement_from_sql (be->conn, sql->str);
-    (void)g_string_free (sql, TRUE);
+    return g_string_free (sql, FALSE);
+}
+
+static GncSqlStatement*
+build_insert_statement (GncSqlBackend* be,
+                        const gchar* table_name,
+                        QofIdTypeConst obj_name, gpointer pObject,
+                        const GncSqlColumnTableEntry* table)
+{
+    GncSqlStatement* stmt;
+    gchar* row;
+    gchar* sql;
+
+    g_return_val_if_fail (be != NULL, NULL);
+    g_return_val_if_fail (table_name != NULL, NULL);
+    g_return_val_if_fail (obj_name != NULL, NULL);
+    g_return_val_if_fail (pObject != NULL, NULL);
+    g_return_val_if_fail (table != NULL, NULL);
+
+    row = build_insert_values (be, obj_name, pObject, table);
+    sql = g_strconcat (get_insert_prefix (be, table_name, table), row, NULL);
+    stmt = gnc_sql_connection_create_statement_from_sql (be->conn, sql);
+    g_free (row);
+    g_free (sql);
 
     return stmt;
 }
@@ -3001,16 +3253,13 @@ build_update_statement (GncSqlBackend* be,
          colname != NULL && value != NULL;
          colname = colname->next, value = value->next)
     {
-        gchar* value_str;
         if (!firstCol)
         {
             (void)g_string_append (sql, ",");
         }
         (void)g_string_append (sql, (gchar*)colname->data);
         (void)g_string_append (sql, "=");
-        value_str = gnc_sql_get_sql_value (be->conn, (GValue*) (value->data));
-        (void)g_string_append (sql, value_str);
-        g_free (value_str);
+        append_sql_value (be->conn, sql, (GValue*) (value->data));
         firstCol = FALSE;
     }
     for (colname = colnames; colname != NULL; colname = colname->next)
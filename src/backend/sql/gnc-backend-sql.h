@@ -63,6 +63,7 @@ struct GncSqlBackend
     gint operations_done;    /**< Number of operations (save/load) done */
     GHashTable* versions;    /**< Version number for each table */
     const gchar* timespec_format;   /**< Format string for SQL for timespec values */
+    GHashTable* insert_prefixes;    /**< INSERT prefix for each table and column table */
 };
 typedef struct GncSqlBackend GncSqlBackend;
 
@@ -73,6 +74,14 @@ typedef struct GncSqlBackend GncSqlBackend;
  */
 void gnc_sql_init (GncSqlBackend* be);
 
+/**
+ * Free what the SQL backend has cached in be.  Call it when the backend
+ * is destroyed.
+ *
+ * @param be SQL backend
+ */
+void gnc_sql_finalize (GncSqlBackend* be);
+
 /**
  * Load the contents of an SQL database into a book.
  *
@@ -100,6 +109,17 @@ void gnc_sql_push_commodity_for_postload_processing (GncSqlBackend* be,
  */
 void gnc_sql_sync_all (GncSqlBackend* be,  QofBook* book);
 
+/**
+ * Save only the objects of a book that changed since it was last loaded
+ * from or saved to the database: every dirty or destroyed instance in a
+ * dirty collection is committed, all in one database transaction.  The
+ * database must already hold the rest of the book in the current schema.
+ *
+ * @param be SQL backend
+ * @param book Book to be saved
+ */
+void gnc_sql_sync_dirty (GncSqlBackend* be,  QofBook* book);
+
 /**
  * An object is about to be edited.
  *
@@ -155,7 +175,15 @@ struct GncSqlStatement
  * @struct GncSqlConnection
  *
  * Struct which represents the connection to an SQL database.  SQL backends
- * must provide a structure which implements all of the functions.
+ * must provide a structure which implements all of the functions except
+ * queueInsert and flushInserts.
+ *
+ * If queueInsert is provided, gnc_sql_sync_all() hands it the rows of a
+ * full save instead of executing one INSERT per object: prefix is a cached
+ * "INSERT INTO table(columns) VALUES" string and row is a parenthesized value
+ * list.  The connection may combine consecutive rows with the same prefix
+ * into one multi-row INSERT, but must execute anything it has queued before
+ * running any other statement or committing.
  */
 struct GncSqlConnection
 {
@@ -180,6 +208,10 @@ struct GncSqlConnection
     gboolean (*addColumnsToTable) (GncSqlConnection*, const gchar* table,
                                    GList*);  /**< Returns TRUE if successful, FALSE if error */
     gchar* (*quoteString) (const GncSqlConnection*, gchar*);
+    gboolean (*queueInsert) (GncSqlConnection*, const gchar* prefix,
+                             const gchar* row);  /**< Optional; returns TRUE if successful, FALSE if error */
+    gboolean (*flushInserts) (
+        GncSqlConnection*);  /**< Optional; returns TRUE if successful, FALSE if error */
 };
 #define gnc_sql_connection_dispose(CONN) (CONN)->dispose(CONN)
 #define gnc_sql_connection_execute_select_statement(CONN,STMT) \
@@ -204,6 +236,10 @@ struct GncSqlConnection
         (CONN)->addColumnsToTable(CONN,TABLENAME,COLLIST)
 #define gnc_sql_connection_quote_string(CONN,STR) \
         (CONN)->quoteString(CONN,STR)
+#define gnc_sql_connection_queue_insert(CONN,PREFIX,ROW) \
+        (CONN)->queueInsert(CONN,PREFIX,ROW)
+#define gnc_sql_connection_flush_inserts(CONN) \
+        (CONN)->flushInserts(CONN)
 
 /**
  * @struct GncSqlRow
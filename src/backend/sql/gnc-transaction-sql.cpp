@@ -29,6 +29,8 @@ extern "C"
 {
 #include "config.h"
 
+#include <string.h>
+
 #include <glib/gi18n.h>
 
 #include "qof.h"
@@ -1458,7 +1460,8 @@ load_tx_guid (const GncSqlBackend* be, GncSqlRow* row,
     guid_str = g_value_get_string (val);
     if (guid_str != NULL)
     {
-        (void)string_to_guid (guid_str, &guid);
+        if (!guid_from_hex_buff (guid_str, strlen (guid_str), &guid))
+            (void)string_to_guid (guid_str, &guid);
         tx = xaccTransLookup (&guid, be->book);
 
         // If the transaction is not found, try loading it
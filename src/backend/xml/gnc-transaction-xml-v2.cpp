@@ -41,12 +41,17 @@ extern "C"
 #include "sixtp-utils.h"
 #include "sixtp-dom-parsers.h"
 #include "sixtp-dom-generators.h"
+#include "sixtp-xml-writer.h"
 
 #include "gnc-xml.h"
 
 #include "io-gncxml-gen.h"
 
 #include "sixtp-dom-parsers.h"
+#include <kvp_frame.hpp>
+#include <vector>
+
+static QofLogModule log_module = GNC_MOD_IO;
 
 const gchar* transaction_version_string = "2.0.0";
 
@@ -194,6 +199,89 @@ gnc_transaction_dom_tree_create (Transaction* trn)
     return ret;
 }
 
+/* The streaming counterparts of the above: they write exactly what
+ * xmlElemDump() makes of the trees, without building them. */
+static void
+write_timespec (xml_writer* w, const gchar* tag, Timespec tms,
+                gboolean always)
+{
+    if (always || ! ((tms.tv_sec == 0) && (tms.tv_nsec == 0)))
+        xml_writer_timespec (w, tag, &tms);
+}
+
+static void
+write_nonempty_text (xml_writer* w, const gchar* tag, const char* text)
+{
+    if (text && g_strcmp0 (text, "") != 0)
+        xml_writer_text_element (w, tag, text);
+}
+
+static void
+write_split (xml_writer* w, Split* spl)
+{
+    char reconciled[2];
+    gnc_numeric num;
+
+    xml_writer_start (w, "trn:split");
+    xml_writer_guid (w, "split:id", xaccSplitGetGUID (spl));
+    write_nonempty_text (w, "split:memo", xaccSplitGetMemo (spl));
+    write_nonempty_text (w, "split:action", xaccSplitGetAction (spl));
+
+    reconciled[0] = xaccSplitGetReconcile (spl);
+    reconciled[1] = '\0';
+    xml_writer_text_element (w, "split:reconciled-state", reconciled);
+
+    write_timespec (w, "split:reconcile-date",
+                    xaccSplitRetDateReconciledTS (spl), FALSE);
+    num = xaccSplitGetValue (spl);
+    xml_writer_numeric (w, "split:value", &num);
+    num = xaccSplitGetAmount (spl);
+    xml_writer_numeric (w, "split:quantity", &num);
+
+    xml_writer_guid (w, "split:account",
+                     xaccAccountGetGUID (xaccSplitGetAccount (spl)));
+    {
+        GNCLot* lot = xaccSplitGetLot (spl);
+
+        if (lot)
+            xml_writer_guid (w, "split:lot", gnc_lot_get_guid (lot));
+    }
+    xml_writer_slots (w, "split:slots", QOF_INSTANCE (spl));
+    xml_writer_end (w);
+}
+
+void
+gnc_transaction_write_xml (xml_writer* w, Transaction* trn)
+{
+    const char* str;
+
+    xml_writer_start (w, "gnc:transaction");
+    xml_writer_attr (w, "version", transaction_version_string);
+
+    xml_writer_guid (w, "trn:id", xaccTransGetGUID (trn));
+
+    xml_writer_commodity_ref (w, "trn:currency", xaccTransGetCurrency (trn));
+
+    write_nonempty_text (w, "trn:num", xaccTransGetNum (trn));
+
+    write_timespec (w, "trn:date-posted", xaccTransRetDatePostedTS (trn), TRUE);
+    write_timespec (w, "trn:date-entered",
+                    xaccTransRetDateEnteredTS (trn), TRUE);
+
+    str = xaccTransGetDescription (trn);
+    if (str)
+        xml_writer_text_element (w, "trn:description", str);
+
+    xml_writer_slots (w, "trn:slots", QOF_INSTANCE (trn));
+
+    xml_writer_start (w, "trn:splits");
+    for (GList* n = xaccTransGetSplitList (trn); n; n = n->next)
+        write_split (w, static_cast<Split*> (n->data));
+    xml_writer_end (w);
+
+    xml_writer_end (w);
+}
+
 /***********************************************************************/
 
 struct split_pdata
@@ -573,77 +661,1083 @@ struct dom_tree_handler trn_dom_handlers[] =
     { NULL, NULL, 0, 0 },
 };
 
+Transaction*
+dom_tree_to_transaction (xmlNodePtr node, QofBook* book)
+{
+    Transaction* trn;
+    gboolean successful;
+    struct trans_pdata pdata;
+
+    g_return_val_if_fail (node, NULL);
+    g_return_val_if_fail (book, NULL);
+
+    trn = xaccMallocTransaction (book);
+    g_return_val_if_fail (trn, NULL);
+    xaccTransBeginEdit (trn);
+
+    pdata.trans = trn;
+    pdata.book = book;
+
+    successful = dom_tree_generic_parse (node, trn_dom_handlers, &pdata);
+
+    xaccTransCommitEdit (trn);
+
+    if (!successful)
+    {
+        xmlElemDump (stdout, NULL, node);
+        xaccTransBeginEdit (trn);
+        xaccTransDestroy (trn);
+        xaccTransCommitEdit (trn);
+        trn = NULL;
+    }
+
+    return trn;
+}
+
+/***********************************************************************/
+/* Streaming transaction parser
+ *
+ * Transactions and their splits make up most of a book, so instead of
+ * building a DOM tree for each <gnc:transaction> and handing it to
+ * dom_tree_to_transaction(), the sixtp node below decodes each element as
+ * soon as its close tag arrives, and builds the transaction from what it
+ * decoded once </gnc:transaction> does. The decoding doesn't touch the
+ * book, so the loader can also run it on worker threads; see
+ * GncTransactionStage. It accepts the same input as trn_dom_handlers and
+ * spl_dom_handlers: the same tags are required, an unknown tag fails the
+ * transaction or split, and slots are built the way
+ * dom_tree_to_kvp_frame_given() builds them.
+ *
+ * Tags are interned into trn_tag_ids once, so each element costs a single
+ * hash lookup, and character data is collected into one GString shared by
+ * the whole transaction.
+ */
+
+typedef enum
+{
+    TRN_TAG_UNKNOWN = 0,
+    TRN_TAG_TRANSACTION,
+    TRN_TAG_ID,
+    TRN_TAG_CURRENCY,
+    TRN_TAG_NUM,
+    TRN_TAG_DATE_POSTED,
+    TRN_TAG_DATE_ENTERED,
+    TRN_TAG_DESCRIPTION,
+    TRN_TAG_SLOTS,
+    TRN_TAG_SPLITS,
+    TRN_TAG_SPLIT,
+    SPL_TAG_ID,
+    SPL_TAG_MEMO,
+    SPL_TAG_ACTION,
+    SPL_TAG_RECONCILED_STATE,
+    SPL_TAG_RECONCILE_DATE,
+    SPL_TAG_VALUE,
+    SPL_TAG_QUANTITY,
+    SPL_TAG_ACCOUNT,
+    SPL_TAG_LOT,
+    SPL_TAG_SLOTS,
+    CMDTY_TAG_SPACE,
+    CMDTY_TAG_ID,
+    TS_TAG_DATE,
+    TS_TAG_NS,
+    SLOT_TAG_SLOT,
+    SLOT_TAG_KEY,
+    SLOT_TAG_VALUE,
+    GDATE_TAG,
+    /* Elements that are skipped along with their contents. */
+    TRN_TAG_IGNORED,
+} TrnTag;
+
+static const struct
+{
+    const char* name;
+    TrnTag tag;
+} trn_tag_names[] =
+{
+    { "gnc:transaction", TRN_TAG_TRANSACTION },
+    { "trn:id", TRN_TAG_ID },
+    { "trn:currency", TRN_TAG_CURRENCY },
+    { "trn:num", TRN_TAG_NUM },
+    { "trn:date-posted", TRN_TAG_DATE_POSTED },
+    { "trn:date-entered", TRN_TAG_DATE_ENTERED },
+    { "trn:description", TRN_TAG_DESCRIPTION },
+    { "trn:slots", TRN_TAG_SLOTS },
+    { "trn:splits", TRN_TAG_SPLITS },
+    { "trn:split", TRN_TAG_SPLIT },
+    { "split:id", SPL_TAG_ID },
+    { "split:memo", SPL_TAG_MEMO },
+    { "split:action", SPL_TAG_ACTION },
+    { "split:reconciled-state", SPL_TAG_RECONCILED_STATE },
+    { "split:reconcile-date", SPL_TAG_RECONCILE_DATE },
+    { "split:value", SPL_TAG_VALUE },
+    { "split:quantity", SPL_TAG_QUANTITY },
+    { "split:account", SPL_TAG_ACCOUNT },
+    { "split:lot", SPL_TAG_LOT },
+    { "split:slots", SPL_TAG_SLOTS },
+    { "cmdty:space", CMDTY_TAG_SPACE },
+    { "cmdty:id", CMDTY_TAG_ID },
+    { "ts:date", TS_TAG_DATE },
+    { "ts:ns", TS_TAG_NS },
+    { "slot", SLOT_TAG_SLOT },
+    { "slot:key", SLOT_TAG_KEY },
+    { "slot:value", SLOT_TAG_VALUE },
+    { "gdate", GDATE_TAG },
+};
+
+static GHashTable*
+trn_tag_ids (void)
+{
+    static gsize initialized = 0;
+    static GHashTable* ids = NULL;
+
+    if (g_once_init_enter (&initialized))
+    {
+        ids = g_hash_table_new (g_str_hash, g_str_equal);
+        for (auto& entry : trn_tag_names)
+            g_hash_table_insert (ids, (gpointer)entry.name,
+                                 GINT_TO_POINTER (entry.tag));
+        g_once_init_leave (&initialized, 1);
+    }
+    return ids;
+}
+
+static inline TrnTag
+trn_tag_lookup (const gchar* name)
+{
+    return static_cast<TrnTag> (GPOINTER_TO_INT (
+                                    g_hash_table_lookup (trn_tag_ids (), name)));
+}
+
+/* The kvp value types understood by dom_tree_to_kvp_value(). */
+typedef enum
+{
+    SLOT_TYPE_NONE,
+    SLOT_TYPE_INTEGER,
+    SLOT_TYPE_DOUBLE,
+    SLOT_TYPE_NUMERIC,
+    SLOT_TYPE_STRING,
+    SLOT_TYPE_GUID,
+    SLOT_TYPE_TIMESPEC,
+    SLOT_TYPE_GDATE,
+    SLOT_TYPE_LIST,
+    SLOT_TYPE_FRAME,
+} SlotType;
+
+static SlotType
+slot_type_from_attrs (gchar** attrs)
+{
+    static const struct
+    {
+        const char* name;
+        SlotType type;
+    } types[] =
+    {
+        { "integer", SLOT_TYPE_INTEGER },
+        { "double", SLOT_TYPE_DOUBLE },
+        { "numeric", SLOT_TYPE_NUMERIC },
+        { "string", SLOT_TYPE_STRING },
+        { "guid", SLOT_TYPE_GUID },
+        { "timespec", SLOT_TYPE_TIMESPEC },
+        { "gdate", SLOT_TYPE_GDATE },
+        { "list", SLOT_TYPE_LIST },
+        { "frame", SLOT_TYPE_FRAME },
+    };
+
+    for (auto attr = attrs; attr && *attr; attr += 2)
+    {
+        if (g_strcmp0 (attr[0], "type") != 0)
+            continue;
+        for (auto& entry : types)
+            if (g_strcmp0 (attr[1], entry.name) == 0)
+                return entry.type;
+        break;
+    }
+    return SLOT_TYPE_NONE;
+}
+
+/* Matches the attribute checks of dom_tree_to_guid(). */
 static gboolean
-gnc_transaction_end_handler (gpointer data_for_children,
-                             GSList* data_from_children, GSList* sibling_data,
-                             gpointer parent_data, gpointer global_data,
-                             gpointer* result, const gchar* tag)
+guid_attrs_valid (gchar** attrs, const gchar* tag)
+{
+    if (!attrs || !attrs[0])
+        return FALSE;
+
+    if (g_strcmp0 (attrs[0], "type") != 0)
+    {
+        PERR ("Unknown attribute for id tag: %s", attrs[0]);
+        return FALSE;
+    }
+    if (g_strcmp0 (attrs[1], "guid") != 0 && g_strcmp0 (attrs[1], "new") != 0)
+    {
+        PERR ("Unknown type %s for attribute type for tag %s",
+              attrs[1] ? attrs[1] : "(null)", tag);
+        return FALSE;
+    }
+    return TRUE;
+}
+
+/* One open element inside a transaction. Only the fields relevant to the
+ * element's tag are used. */
+struct trn_parse_node
+{
+    TrnTag tag;
+    gsize text_start;
+
+    gboolean guid_ok;
+
+    /* Elements holding a <ts:date>/<ts:ns> pair, as dom_tree_to_timespec(). */
+    Timespec ts;
+    gboolean seen_s;
+    gboolean seen_ns;
+    gboolean ts_failed;
+
+    /* trn:currency */
+    gchar* space;
+    gchar* id;
+    gboolean cmdty_failed;
+
+    /* slot */
+    gchar* key;
+    KvpValue* value;
+
+    /* slot:value */
+    SlotType type;
+    KvpFrame* frame;
+    GList* list;
+    GDate date;
+    gboolean seen_date;
+    gboolean date_failed;
+};
+
+/* An element decoded from the file, to be applied to the transaction or
+ * split by trn_stage_apply(). Only the fields relevant to the tag are
+ * used. */
+struct trn_op
+{
+    TrnTag tag;
+    GncGUID guid;
+    gboolean new_guid;  /* The text wasn't a GUID; one is made up. */
+    Timespec ts;
+    gnc_numeric num;
+    gchar* text;        /* Also a slot's key or the currency's namespace. */
+    gchar* id;          /* The currency's mnemonic. */
+    KvpValue* value;
+    gboolean ok;        /* TRN_TAG_SPLIT: whether the split is kept. */
+};
+
+struct trn_parse_state
+{
+    GString* text;
+    std::vector<trn_parse_node> nodes;
+    std::vector<trn_op> ops;
+    guint trn_gotten;
+    guint spl_gotten;
+    gboolean trn_failed;
+    gboolean spl_failed;
+    gboolean splits_failed;
+    /* Off the main thread, where no KvpFrame can be made (their keys go
+     * through the string cache) nor a GUID made up, a transaction that
+     * needs either is given up on and left to the main thread. */
+    gboolean off_thread;
+    gboolean deferred;
+};
+
+#define TRN_GOT(tag) (1u << ((tag) - TRN_TAG_TRANSACTION))
+#define SPL_GOT(tag) (1u << ((tag) - SPL_TAG_ID))
+
+static const guint trn_required = TRN_GOT (TRN_TAG_ID) |
+                                  TRN_GOT (TRN_TAG_DATE_POSTED) |
+                                  TRN_GOT (TRN_TAG_DATE_ENTERED) |
+                                  TRN_GOT (TRN_TAG_SPLITS);
+static const guint spl_required = SPL_GOT (SPL_TAG_ID) |
+                                  SPL_GOT (SPL_TAG_RECONCILED_STATE) |
+                                  SPL_GOT (SPL_TAG_VALUE) |
+                                  SPL_GOT (SPL_TAG_QUANTITY) |
+                                  SPL_GOT (SPL_TAG_ACCOUNT);
+
+static void
+trn_parse_node_clear (trn_parse_node* node)
+{
+    g_free (node->space);
+    g_free (node->id);
+    g_free (node->key);
+    delete node->value;
+    delete node->frame;
+    for (auto mark = node->list; mark; mark = mark->next)
+        delete static_cast<KvpValue*> (mark->data);
+    g_list_free (node->list);
+}
+
+static trn_parse_state*
+trn_parse_state_new (gboolean off_thread)
+{
+    auto state = new trn_parse_state {};
+
+    state->text = g_string_sized_new (64);
+    state->off_thread = off_thread;
+    return state;
+}
+
+static void
+trn_parse_state_free (trn_parse_state* state)
 {
-    Transaction* trn = NULL;
-    xmlNodePtr tree = (xmlNodePtr)data_for_children;
-    gxpf_data* gdata = (gxpf_data*)global_data;
+    for (auto& node : state->nodes)
+        trn_parse_node_clear (&node);
+    for (auto& op : state->ops)
+    {
+        g_free (op.text);
+        g_free (op.id);
+        delete op.value;
+    }
+    g_string_free (state->text, TRUE);
+    delete state;
+}
 
-    if (parent_data)
+static trn_op*
+trn_parse_add_op (trn_parse_state* state, TrnTag tag)
+{
+    state->ops.push_back (trn_op {});
+    state->ops.back ().tag = tag;
+    return &state->ops.back ();
+}
+
+/* Work out what an element means from its parent, the way the DOM
+ * handlers would see it. */
+static TrnTag
+trn_parse_child_tag (trn_parse_state* state, const trn_parse_node& parent,
+                     const gchar* name)
+{
+    auto tag = trn_tag_lookup (name);
+
+    switch (parent.tag)
     {
+    case TRN_TAG_TRANSACTION:
+        if (tag >= TRN_TAG_ID && tag <= TRN_TAG_SPLITS)
+            return tag;
+        PERR ("Unhandled tag: %s", name);
+        state->trn_failed = TRUE;
+        return TRN_TAG_IGNORED;
+
+    case TRN_TAG_SPLITS:
+        /* As in trn_splits_handler, anything but a split, or a split that
+         * failed, ends the split list. */
+        if (tag == TRN_TAG_SPLIT && !state->splits_failed)
+            return tag;
+        state->splits_failed = TRUE;
+        return TRN_TAG_IGNORED;
+
+    case TRN_TAG_SPLIT:
+        if (tag >= SPL_TAG_ID && tag <= SPL_TAG_SLOTS)
+            return tag;
+        PERR ("Unhandled tag: %s", name);
+        state->spl_failed = TRUE;
+        return TRN_TAG_IGNORED;
+
+    case TRN_TAG_CURRENCY:
+        return (tag == CMDTY_TAG_SPACE || tag == CMDTY_TAG_ID) ?
+               tag : TRN_TAG_IGNORED;
+
+    case TRN_TAG_DATE_POSTED:
+    case TRN_TAG_DATE_ENTERED:
+    case SPL_TAG_RECONCILE_DATE:
+        return (tag == TS_TAG_DATE || tag == TS_TAG_NS) ?
+               tag : TRN_TAG_IGNORED;
+
+    case TRN_TAG_SLOTS:
+    case SPL_TAG_SLOTS:
+        return tag == SLOT_TAG_SLOT ? tag : TRN_TAG_IGNORED;
+
+    case SLOT_TAG_SLOT:
+        return (tag == SLOT_TAG_KEY || tag == SLOT_TAG_VALUE) ?
+               tag : TRN_TAG_IGNORED;
+
+    case SLOT_TAG_VALUE:
+        switch (parent.type)
+        {
+        case SLOT_TYPE_TIMESPEC:
+            return (tag == TS_TAG_DATE || tag == TS_TAG_NS) ?
+                   tag : TRN_TAG_IGNORED;
+        case SLOT_TYPE_GDATE:
+            return tag == GDATE_TAG ? tag : TRN_TAG_IGNORED;
+        case SLOT_TYPE_FRAME:
+            return tag == SLOT_TAG_SLOT ? tag : TRN_TAG_IGNORED;
+        case SLOT_TYPE_LIST:
+            /* Every child element of a list is a value, whatever its name. */
+            return SLOT_TAG_VALUE;
+        default:
+            return TRN_TAG_IGNORED;
+        }
+
+    default:
+        return TRN_TAG_IGNORED;
+    }
+}
+
+static gboolean
+trn_parse_collects_text (const trn_parse_node& node)
+{
+    switch (node.tag)
+    {
+    case TRN_TAG_ID:
+    case TRN_TAG_NUM:
+    case TRN_TAG_DESCRIPTION:
+    case SPL_TAG_ID:
+    case SPL_TAG_MEMO:
+    case SPL_TAG_ACTION:
+    case SPL_TAG_RECONCILED_STATE:
+    case SPL_TAG_VALUE:
+    case SPL_TAG_QUANTITY:
+    case SPL_TAG_ACCOUNT:
+    case SPL_TAG_LOT:
+    case CMDTY_TAG_SPACE:
+    case CMDTY_TAG_ID:
+    case TS_TAG_DATE:
+    case TS_TAG_NS:
+    case SLOT_TAG_KEY:
+    case GDATE_TAG:
         return TRUE;
+    case SLOT_TAG_VALUE:
+        return node.type != SLOT_TYPE_TIMESPEC && node.type != SLOT_TYPE_GDATE &&
+               node.type != SLOT_TYPE_LIST && node.type != SLOT_TYPE_FRAME;
+    default:
+        return FALSE;
     }
+}
 
-    /* OK.  For some messed up reason this is getting called again with a
-       NULL tag.  So we ignore those cases */
-    if (!tag)
+void
+gnc_transaction_stage_start_element (GncTransactionStage* state,
+                                     const gchar* tag, gchar** attrs)
+{
+    trn_parse_node node {};
+
+    if (state->deferred)
+        return;
+
+    if (state->nodes.empty ())
+    {
+        /* The <gnc:transaction> element itself. */
+        node.tag = TRN_TAG_TRANSACTION;
+        state->nodes.push_back (node);
+        return;
+    }
+
+    node.tag = trn_parse_child_tag (state, state->nodes.back (), tag);
+    node.text_start = state->text->len;
+
+    switch (node.tag)
     {
+    case TRN_TAG_SPLIT:
+        state->spl_gotten = 0;
+        state->spl_failed = FALSE;
+        break;
+    case TRN_TAG_ID:
+    case SPL_TAG_ID:
+    case SPL_TAG_ACCOUNT:
+    case SPL_TAG_LOT:
+        node.guid_ok = guid_attrs_valid (attrs, tag);
+        break;
+    case SLOT_TAG_VALUE:
+        node.type = slot_type_from_attrs (attrs);
+        if (node.type == SLOT_TYPE_GUID)
+            node.guid_ok = guid_attrs_valid (attrs, tag);
+        else if (node.type == SLOT_TYPE_FRAME)
+        {
+            if (state->off_thread)
+            {
+                state->deferred = TRUE;
+                return;
+            }
+            node.frame = new KvpFrame;
+        }
+        else if (node.type == SLOT_TYPE_GDATE)
+            g_date_clear (&node.date, 1);
+        break;
+    default:
+        break;
+    }
+
+    state->nodes.push_back (node);
+}
+
+void
+gnc_transaction_stage_characters (GncTransactionStage* state,
+                                  const gchar* text, int length)
+{
+    if (!state->deferred && length > 0 &&
+        trn_parse_collects_text (state->nodes.back ()))
+        g_string_append_len (state->text, text, length);
+}
+
+static void
+trn_parse_set_timespec (trn_parse_node* parent, TrnTag tag, const gchar* text)
+{
+    if (tag == TS_TAG_DATE)
+    {
+        if (parent->seen_s || !string_to_timespec_secs (text, &parent->ts))
+            parent->ts_failed = TRUE;
+        parent->seen_s = TRUE;
+    }
+    else
+    {
+        if (parent->seen_ns || !string_to_timespec_nsecs (text, &parent->ts))
+            parent->ts_failed = TRUE;
+        parent->seen_ns = TRUE;
+    }
+}
+
+/* The result of dom_tree_to_timespec() followed by
+ * dom_tree_valid_timespec(). */
+static gboolean
+trn_parse_get_timespec (trn_parse_node* node, const gchar* tag, Timespec* ts)
+{
+    Timespec zero = {0, 0};
+
+    if (!node->seen_s)
+        PERR ("no ts:date node found.");
+    *ts = (node->ts_failed || !node->seen_s) ? zero : node->ts;
+    if (ts->tv_sec || ts->tv_nsec)
         return TRUE;
+
+    g_warning ("Invalid timestamp in data file.  Look for a '%s' entry "
+               "with a date of 1969-12-31 or 1970-01-01.", tag);
+    return FALSE;
+}
+
+/* Like dom_tree_to_guid(), except that text that isn't a GUID only
+ * returns FALSE; the caller makes up a new one. */
+static gboolean
+trn_parse_guid (const gchar* text, GncGUID* guid)
+{
+    return guid_from_hex_buff (text, strlen (text), guid) ||
+           string_to_guid (text, guid);
+}
+
+static KvpValue*
+trn_parse_slot_value (trn_parse_state* state, trn_parse_node* node,
+                      const gchar* text)
+{
+    switch (node->type)
+    {
+    case SLOT_TYPE_INTEGER:
+    {
+        gint64 daint;
+        if (string_to_gint64 (text, &daint))
+            return new KvpValue {daint};
+        return NULL;
+    }
+    case SLOT_TYPE_DOUBLE:
+    {
+        double dadoub;
+        if (string_to_double (text, &dadoub))
+            return new KvpValue {dadoub};
+        return NULL;
+    }
+    case SLOT_TYPE_NUMERIC:
+    {
+        gnc_numeric danum;
+        if (string_to_gnc_numeric (text, &danum))
+            return new KvpValue {danum};
+        return NULL;
+    }
+    case SLOT_TYPE_STRING:
+    {
+        gchar* datext = g_strdup (text);
+        return new KvpValue {datext};
+    }
+    case SLOT_TYPE_GUID:
+    {
+        GncGUID guid;
+        if (!node->guid_ok)
+            return NULL;
+        if (!trn_parse_guid (text, &guid))
+        {
+            if (state->off_thread)
+            {
+                state->deferred = TRUE;
+                return NULL;
+            }
+            guid_replace (&guid);
+        }
+        auto daguid = guid_malloc ();
+        *daguid = guid;
+        return new KvpValue {daguid};
+    }
+    case SLOT_TYPE_TIMESPEC:
+    {
+        Timespec ts = {0, 0};
+        if (!node->seen_s)
+            PERR ("no ts:date node found.");
+        else if (!node->ts_failed)
+            ts = node->ts;
+        return new KvpValue {ts};
+    }
+    case SLOT_TYPE_GDATE:
+        if (!node->seen_date)
+            PWARN ("no gdate node found.");
+        if (!node->seen_date || node->date_failed)
+            return NULL;
+        return new KvpValue {node->date};
+    case SLOT_TYPE_LIST:
+    {
+        auto ret = new KvpValue {node->list};
+        node->list = NULL;
+        return ret;
+    }
+    case SLOT_TYPE_FRAME:
+    {
+        auto ret = new KvpValue {node->frame};
+        node->frame = NULL;
+        return ret;
     }
+    default:
+        return NULL;
+    }
+}
+
+/* Decode a closed element into an op for the transaction or split, or
+ * into its parent element. Nothing here touches the book. */
+static void
+trn_parse_element_end (trn_parse_state* state, trn_parse_node* node,
+                       trn_parse_node* parent, const gchar* tag,
+                       const gchar* text)
+{
+    trn_op* op;
+    Timespec ts;
+    gnc_numeric num;
 
-    g_return_val_if_fail (tree, FALSE);
+    if (node->tag >= TRN_TAG_ID && node->tag <= TRN_TAG_SPLITS)
+        state->trn_gotten |= TRN_GOT (node->tag);
+    else if (node->tag >= SPL_TAG_ID && node->tag <= SPL_TAG_SLOTS)
+        state->spl_gotten |= SPL_GOT (node->tag);
 
-    trn = dom_tree_to_transaction (tree,
-                                   static_cast<QofBook*> (gdata->bookdata));
-    if (trn != NULL)
+    switch (node->tag)
     {
-        gdata->cb (tag, gdata->parsedata, trn);
+    case TRN_TAG_ID:
+    case SPL_TAG_ID:
+    case SPL_TAG_ACCOUNT:
+    case SPL_TAG_LOT:
+        if (!node->guid_ok) break;
+        op = trn_parse_add_op (state, node->tag);
+        op->new_guid = !trn_parse_guid (text, &op->guid);
+        break;
+    case TRN_TAG_CURRENCY:
+        if (node->cmdty_failed || !node->space || !node->id)
+        {
+            PERR ("Invalid transaction currency");
+            break;
+        }
+        op = trn_parse_add_op (state, node->tag);
+        op->text = g_strstrip (node->space);
+        op->id = g_strstrip (node->id);
+        node->space = node->id = NULL;
+        break;
+    case TRN_TAG_NUM:
+    case TRN_TAG_DESCRIPTION:
+    case SPL_TAG_MEMO:
+    case SPL_TAG_ACTION:
+    case SPL_TAG_RECONCILED_STATE:
+        op = trn_parse_add_op (state, node->tag);
+        op->text = g_strdup (text);
+        break;
+    case TRN_TAG_DATE_POSTED:
+    case TRN_TAG_DATE_ENTERED:
+    case SPL_TAG_RECONCILE_DATE:
+        if (trn_parse_get_timespec (node, tag, &ts))
+            trn_parse_add_op (state, node->tag)->ts = ts;
+        break;
+    case TRN_TAG_SPLIT:
+        op = trn_parse_add_op (state, node->tag);
+        op->ok = !state->spl_failed &&
+                 (state->spl_gotten & spl_required) == spl_required;
+        if (!op->ok)
+        {
+            PERR ("didn't find all of the expected tags in the input");
+            state->splits_failed = TRUE;
+        }
+        break;
+    case SPL_TAG_VALUE:
+    case SPL_TAG_QUANTITY:
+        if (!string_to_gnc_numeric (text, &num))
+        {
+            PERR ("Invalid %s: %s", tag, text);
+            break;
+        }
+        trn_parse_add_op (state, node->tag)->num = num;
+        break;
+    case CMDTY_TAG_SPACE:
+    case CMDTY_TAG_ID:
+    {
+        auto field = node->tag == CMDTY_TAG_SPACE ? &parent->space : &parent->id;
+        if (*field)
+            parent->cmdty_failed = TRUE;
+        else
+            *field = g_strdup (text);
+        break;
     }
+    case TS_TAG_DATE:
+    case TS_TAG_NS:
+        trn_parse_set_timespec (parent, node->tag, text);
+        break;
+    case GDATE_TAG:
+    {
+        gint year, month, day;
+        if (parent->seen_date ||
+            sscanf (text, "%d-%d-%d", &year, &month, &day) != 3)
+        {
+            parent->date_failed = TRUE;
+        }
+        else
+        {
+            g_date_set_dmy (&parent->date, day,
+                            static_cast<GDateMonth> (month), year);
+            if (!g_date_valid (&parent->date))
+            {
+                PWARN ("invalid date");
+                parent->date_failed = TRUE;
+            }
+        }
+        parent->seen_date = TRUE;
+        break;
+    }
+    case SLOT_TAG_KEY:
+        g_free (parent->key);
+        parent->key = g_strdup (text);
+        break;
+    case SLOT_TAG_VALUE:
+    {
+        auto value = trn_parse_slot_value (state, node, text);
+        if (parent->tag == SLOT_TAG_SLOT)
+        {
+            delete parent->value;
+            parent->value = value;
+        }
+        else if (value)
+        {
+            parent->list = g_list_append (parent->list, value);
+        }
+        break;
+    }
+    case SLOT_TAG_SLOT:
+        if (!node->key || !node->value)
+            break;
+        if (parent->tag == TRN_TAG_SLOTS || parent->tag == SPL_TAG_SLOTS)
+        {
+            op = trn_parse_add_op (state, parent->tag);
+            op->text = node->key;
+            op->value = node->value;
+            node->key = NULL;
+        }
+        else
+        {
+            //We're deleting the old KvpValue returned by replace_nc().
+            delete parent->frame->set (node->key, node->value);
+        }
+        node->value = NULL;
+        break;
+    default:
+        break;
+    }
+}
+
+void
+gnc_transaction_stage_end_element (GncTransactionStage* state,
+                                   const gchar* tag)
+{
+    if (state->deferred)
+        return;
 
-    xmlFreeNode (tree);
+    auto node = state->nodes.back ();
+    state->nodes.pop_back ();
 
-    return trn != NULL;
+    if (node.tag != TRN_TAG_TRANSACTION)
+    {
+        auto text = state->text->str + node.text_start;
+        trn_parse_element_end (state, &node, &state->nodes.back (), tag, text);
+        g_string_truncate (state->text, node.text_start);
+    }
+    trn_parse_node_clear (&node);
 }
 
-Transaction*
-dom_tree_to_transaction (xmlNodePtr node, QofBook* book)
+static void
+trn_parse_split_account (QofBook* book, Split* split, const GncGUID* id)
 {
-    Transaction* trn;
-    gboolean successful;
-    struct trans_pdata pdata;
+    auto account = xaccAccountLookup (id, book);
+    if (!account && gnc_transaction_xml_v2_testing &&
+        !guid_equal (id, guid_null ()))
+    {
+        account = xaccMallocAccount (book);
+        xaccAccountSetGUID (account, id);
+        xaccAccountSetCommoditySCU (account, xaccSplitGetAmount (split).denom);
+    }
+    xaccAccountInsertSplit (account, split);
+}
 
-    g_return_val_if_fail (node, NULL);
-    g_return_val_if_fail (book, NULL);
+static void
+trn_parse_split_lot (QofBook* book, Split* split, const GncGUID* id)
+{
+    auto lot = gnc_lot_lookup (id, book);
+    if (!lot && gnc_transaction_xml_v2_testing &&
+        !guid_equal (id, guid_null ()))
+    {
+        lot = gnc_lot_new (book);
+        gnc_lot_set_guid (lot, *id);
+    }
+    gnc_lot_add_split (lot, split);
+}
 
-    trn = xaccMallocTransaction (book);
-    g_return_val_if_fail (trn, NULL);
-    xaccTransBeginEdit (trn);
+static void
+trn_parse_currency (QofBook* book, Transaction* trn, const trn_op* op)
+{
+    auto table = gnc_commodity_table_get_table (book);
+    auto currency = gnc_commodity_table_lookup (table, op->text, op->id);
+    if (!currency)
+    {
+        PERR ("Unknown transaction currency %s:%s", op->text, op->id);
+        return;
+    }
+    xaccTransSetCurrency (trn, currency);
+}
 
-    pdata.trans = trn;
-    pdata.book = book;
+/* Apply an op to the transaction or to split, making the split if this is
+ * its first. Returns the split that the next op applies to. */
+static Split*
+trn_stage_apply (QofBook* book, Transaction* trn, Split* split, trn_op* op)
+{
+    GncGUID guid = op->guid;
 
-    successful = dom_tree_generic_parse (node, trn_dom_handlers, &pdata);
+    if (op->new_guid)
+        guid_replace (&guid);
+    if (!split && op->tag >= SPL_TAG_ID && op->tag <= SPL_TAG_SLOTS)
+        split = xaccMallocSplit (book);
 
-    xaccTransCommitEdit (trn);
+    switch (op->tag)
+    {
+    case TRN_TAG_ID:
+        xaccTransSetGUID (trn, &guid);
+        break;
+    case TRN_TAG_CURRENCY:
+        trn_parse_currency (book, trn, op);
+        break;
+    case TRN_TAG_NUM:
+        xaccTransSetNum (trn, op->text);
+        break;
+    case TRN_TAG_DATE_POSTED:
+        xaccTransSetDatePostedTS (trn, &op->ts);
+        break;
+    case TRN_TAG_DATE_ENTERED:
+        xaccTransSetDateEnteredTS (trn, &op->ts);
+        break;
+    case TRN_TAG_DESCRIPTION:
+        xaccTransSetDescription (trn, op->text);
+        break;
+    case TRN_TAG_SLOTS:
+    case SPL_TAG_SLOTS:
+    {
+        auto inst = op->tag == TRN_TAG_SLOTS ? QOF_INSTANCE (trn) :
+                    QOF_INSTANCE (split);
+        //We're deleting the old KvpValue returned by replace_nc().
+        delete qof_instance_get_slots (inst)->set (op->text, op->value);
+        op->value = NULL;
+        break;
+    }
+    case TRN_TAG_SPLIT:
+        if (split && op->ok)
+            xaccTransAppendSplit (trn, split);
+        else if (split)
+            xaccSplitDestroy (split);
+        return NULL;
+    case SPL_TAG_ID:
+        xaccSplitSetGUID (split, &guid);
+        break;
+    case SPL_TAG_MEMO:
+        xaccSplitSetMemo (split, op->text);
+        break;
+    case SPL_TAG_ACTION:
+        xaccSplitSetAction (split, op->text);
+        break;
+    case SPL_TAG_RECONCILED_STATE:
+        xaccSplitSetReconcile (split, op->text[0]);
+        break;
+    case SPL_TAG_RECONCILE_DATE:
+        xaccSplitSetDateReconciledTS (split, &op->ts);
+        break;
+    case SPL_TAG_VALUE:
+        xaccSplitSetValue (split, op->num);
+        break;
+    case SPL_TAG_QUANTITY:
+        xaccSplitSetAmount (split, op->num);
+        break;
+    case SPL_TAG_ACCOUNT:
+        trn_parse_split_account (book, split, &guid);
+        break;
+    case SPL_TAG_LOT:
+        trn_parse_split_lot (book, split, &guid);
+        break;
+    default:
+        break;
+    }
+    return split;
+}
 
+GncTransactionStage*
+gnc_transaction_stage_new (void)
+{
+    return trn_parse_state_new (TRUE);
+}
+
+gboolean
+gnc_transaction_stage_is_deferred (GncTransactionStage* state)
+{
+    return state->deferred;
+}
+
+void
+gnc_transaction_stage_free (GncTransactionStage* state)
+{
+    trn_parse_state_free (state);
+}
+
+gboolean
+gnc_transaction_stage_commit (GncTransactionStage* state, gxpf_data* gdata,
+                              const gchar* tag)
+{
+    auto book = static_cast<QofBook*> (gdata->bookdata);
+    gboolean successful = !state->trn_failed &&
+        (state->trn_gotten & trn_required) == trn_required;
+    auto trn = xaccMallocTransaction (book);
+    Split* split = NULL;
+
+    if (!trn)
+    {
+        trn_parse_state_free (state);
+        return FALSE;
+    }
+
+    xaccTransBeginEdit (trn);
+    for (auto& op : state->ops)
+        split = trn_stage_apply (book, trn, split, &op);
+    /* A split the file didn't finish. */
+    if (split)
+        xaccSplitDestroy (split);
+
+    if (!successful)
+        PERR ("didn't find all of the expected tags in the input");
+    trn_parse_state_free (state);
+
+    xaccTransCommitEdit (trn);
     if (!successful)
     {
-        xmlElemDump (stdout, NULL, node);
+        PERR ("Failed to parse transaction");
         xaccTransBeginEdit (trn);
         xaccTransDestroy (trn);
         xaccTransCommitEdit (trn);
-        trn = NULL;
+        return FALSE;
     }
 
-    return trn;
+    gdata->cb (tag, gdata->parsedata, trn);
+    return TRUE;
+}
+
+static gboolean
+trn_stream_start_handler (GSList* sibling_data, gpointer parent_data,
+                          gpointer global_data, gpointer* data_for_children,
+                          gpointer* result, const gchar* tag, gchar** attrs)
+{
+    auto state = static_cast<trn_parse_state*> (parent_data);
+
+    /* Called with a NULL tag for the context's top frame when this is the
+       top level parser; the transaction starts with the first element. */
+    if (!tag)
+    {
+        *data_for_children = NULL;
+        *result = NULL;
+        return TRUE;
+    }
+
+    *result = NULL;
+    if (!state)
+    {
+        /* The <gnc:transaction> element itself. */
+        state = trn_parse_state_new (FALSE);
+        *result = state;
+    }
+    *data_for_children = state;
+    gnc_transaction_stage_start_element (state, tag, attrs);
+    return TRUE;
+}
+
+static gboolean
+trn_stream_chars_handler (GSList* sibling_data, gpointer parent_data,
+                          gpointer global_data, gpointer* result,
+                          const char* text, int length)
+{
+    auto state = static_cast<trn_parse_state*> (parent_data);
+
+    if (state)
+        gnc_transaction_stage_characters (state, text, length);
+    return TRUE;
+}
+
+static gboolean
+trn_stream_end_handler (gpointer data_for_children,
+                        GSList* data_from_children, GSList* sibling_data,
+                        gpointer parent_data, gpointer global_data,
+                        gpointer* result, const gchar* tag)
+{
+    auto state = static_cast<trn_parse_state*> (data_for_children);
+
+    /* The top level frame is closed with a NULL tag when this is the
+       top level parser; there's nothing to do for it. */
+    if (!state || !tag)
+        return TRUE;
+
+    gnc_transaction_stage_end_element (state, tag);
+    if (!state->nodes.empty ())
+        return TRUE;
+
+    /* </gnc:transaction> */
+    *result = NULL;
+    return gnc_transaction_stage_commit (state,
+                                         static_cast<gxpf_data*> (global_data),
+                                         tag);
+}
+
+static void
+trn_stream_fail_handler (gpointer data_for_children,
+                         GSList* data_from_children, GSList* sibling_data,
+                         gpointer parent_data, gpointer global_data,
+                         gpointer* result, const gchar* tag)
+{
+    /* Only the <gnc:transaction> frame owns the state. */
+    if (*result)
+    {
+        trn_parse_state_free (static_cast<trn_parse_state*> (*result));
+        *result = NULL;
+    }
 }
 
 sixtp*
 gnc_transaction_sixtp_parser_create (void)
 {
-    return sixtp_dom_parser_new (gnc_transaction_end_handler, NULL, NULL);
+    sixtp* top_level;
+
+    if (! (top_level =
+               sixtp_set_any (sixtp_new (), FALSE,
+                              SIXTP_START_HANDLER_ID, trn_stream_start_handler,
+                              SIXTP_CHARACTERS_HANDLER_ID, trn_stream_chars_handler,
+                              SIXTP_END_HANDLER_ID, trn_stream_end_handler,
+                              SIXTP_FAIL_HANDLER_ID, trn_stream_fail_handler,
+                              SIXTP_NO_MORE_HANDLERS)))
+    {
+        return NULL;
+    }
+
+    /* Every element inside a transaction is handled by this same node. */
+    if (!sixtp_add_sub_parser (top_level, SIXTP_MAGIC_CATCHER, top_level))
+    {
+        sixtp_destroy (top_level);
+        return NULL;
+    }
+
+    return top_level;
 }
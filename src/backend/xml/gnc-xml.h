@@ -35,6 +35,8 @@ extern "C"
 
 #include "gnc-xml-helper.h"
 #include "sixtp.h"
+#include "sixtp-xml-writer.h"
+#include "io-gncxml-gen.h"
 
 xmlNodePtr gnc_account_dom_tree_create (Account* act, gboolean exporting,
                                         gboolean allow_incompat);
@@ -63,8 +65,30 @@ xmlNodePtr gnc_budget_dom_tree_create (GncBudget* bgt);
 sixtp* gnc_budget_sixtp_parser_create (void);
 
 xmlNodePtr gnc_transaction_dom_tree_create (Transaction* txn);
+/* Writes what xmlElemDump() makes of gnc_transaction_dom_tree_create(). */
+void gnc_transaction_write_xml (xml_writer* w, Transaction* txn);
 sixtp* gnc_transaction_sixtp_parser_create (void);
 
+/* A <gnc:transaction> read from its SAX events without touching the book,
+ * so that the reading can be done on another thread. Feed it the
+ * transaction element's events, then commit it on the main thread to add
+ * the transaction to gdata's book just as the sixtp parser would have.
+ * A deferred stage couldn't be read off the main thread; its events have
+ * to go through the sixtp parser instead, and it only gets freed. */
+typedef struct trn_parse_state GncTransactionStage;
+GncTransactionStage* gnc_transaction_stage_new (void);
+void gnc_transaction_stage_start_element (GncTransactionStage* stage,
+                                          const gchar* tag, gchar** attrs);
+void gnc_transaction_stage_characters (GncTransactionStage* stage,
+                                       const gchar* text, int length);
+void gnc_transaction_stage_end_element (GncTransactionStage* stage,
+                                        const gchar* tag);
+gboolean gnc_transaction_stage_is_deferred (GncTransactionStage* stage);
+/* Frees the stage. Returns FALSE if the transaction failed to parse. */
+gboolean gnc_transaction_stage_commit (GncTransactionStage* stage,
+                                       gxpf_data* gdata, const gchar* tag);
+void gnc_transaction_stage_free (GncTransactionStage* stage);
+
 sixtp* gnc_template_transaction_sixtp_parser_create (void);
 
 #endif /* GNC_XML_H */
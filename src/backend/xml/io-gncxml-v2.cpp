@@ -54,6 +54,7 @@ extern "C"
 #include "Transaction.h"
 #include "TransactionP.h"
 #include "TransLog.h"
+#include "gnc-prefs.h"
 #if PLATFORM(WINDOWS)
 #ifdef __STRICT_ANSI_UNSET__
 #undef __STRICT_ANSI_UNSET__
@@ -74,6 +75,9 @@ extern "C"
 #include "sixtp-dom-parsers.h"
 #include "io-gncxml-v2.h"
 #include "io-gncxml-gen.h"
+#include "io-gzip.h"
+
+#include <vector>
 
 /* Do not treat -Wstrict-aliasing warnings as errors because of problems of the
  * G_LOCK* macros as declared by glib.  See
@@ -95,6 +99,8 @@ typedef struct
     gchar* filename;
     gchar* perms;
     gboolean compress;
+    gint level;
+    gint threads;
 } gz_thread_params_t;
 
 /* Callback structure */
@@ -106,6 +112,7 @@ struct file_backend
     const char*     tag;
     sixtp*          parser;
     FILE*           out;
+    xml_writer*     writer;
     QofBook*        book;
 };
 
@@ -698,6 +705,671 @@ gnc_sixtp_gdv2_new (
     return gd;
 }
 
+/***********************************************************************/
+/* Pipelined loading
+ *
+ * Most of a book is a long run of <gnc:transaction> elements, each of which
+ * stands alone. The loader below splits the (already decompressed) input
+ * into those runs while it reads it:
+ *
+ * - Everything outside the runs goes straight to the book's push parser.
+ * - Each run is cut into batches of whole transactions. A pool of worker
+ *   threads parses the batches with libxml2 and reads each transaction into
+ *   a GncTransactionStage: its ids, dates, amounts, strings and slots
+ *   decoded, ready to be set on the engine's objects.
+ * - The main thread commits the staged transactions, batch by batch and in
+ *   file order, creating the transactions and splits and adding them to the
+ *   book. Only the main thread touches the book.
+ *
+ * The few transactions a worker can't stage (those with kvp frames in
+ * their slots, see GncTransactionStage) keep the SAX events the worker
+ * recorded for them, which the main thread replays into the same sixtp
+ * handlers that would have seen them had the batch been parsed inline.
+ *
+ * The engine isn't thread safe, so creating the objects, looking up their
+ * accounts and commodities and the string cache stay on the main thread.
+ */
+
+#define PIPELINE_READ_SIZE (64 * 1024)
+#define PIPELINE_BATCH_SIZE (256 * 1024)
+#define PIPELINE_BATCH_START "<batch>"
+#define PIPELINE_BATCH_END "</batch>"
+
+/* A transaction as a worker left it: staged, or if it couldn't be, as the
+ * events recorded before events_end. */
+typedef struct
+{
+    GncTransactionStage* stage;
+    gsize events_end;
+} batch_item;
+
+/* A batch of transactions, along with the text between them, as read from
+ * the file and as parsed by a worker. */
+typedef struct
+{
+    GString* xml;
+    GString* events;
+    GArray* items;
+    GncTransactionStage* stage;     /* The transaction being read... */
+    gsize trn_events;               /* ...and where its events start. */
+    gint depth;
+    gboolean ok;
+    gboolean done;
+} xml_batch;
+
+typedef struct
+{
+    FILE* file;
+    xmlParserCtxtPtr ctxt;
+    sixtp_sax_data* sax;
+    GThreadPool* pool;
+    GAsyncQueue* finished;
+    GQueue pending;
+    guint max_pending;
+
+    GString* buf;
+    gsize scan;         /* Next byte to look at. */
+    gsize text_start;   /* The end of the last complete piece of markup. */
+    gsize fed;          /* Bytes before this have gone to ctxt. */
+    gsize run_start;    /* Start of the batch being collected... */
+    gsize run_end;      /* ...and the end of its last transaction. */
+    gboolean in_run;
+    gsize trn_start;
+    gboolean in_trn;
+    gint trn_depth;
+    gint depth;
+    gchar* names[2];    /* The root element and its open child. */
+    gboolean split;     /* FALSE once we've decided not to split the file. */
+    gboolean eof;
+} xml_pipeline;
+
+/* The events of each transaction are recorded as it is staged, and kept
+ * if the stage is deferred. They are stored back to back:
+ *   'S' name \0 count (attr \0 value \0)*
+ *   'C' length text
+ *   'E' name \0
+ * count being the number of strings after it. Values can be empty, so
+ * the count and not an empty string ends the attributes.
+ */
+static void
+batch_start_element (void* user_data, const xmlChar* name,
+                     const xmlChar** attrs)
+{
+    xml_batch* batch = static_cast<decltype (batch)> (user_data);
+    guint32 count = 0;
+
+    /* Skip the wrapper element. */
+    if (batch->depth++ == 0)
+        return;
+
+    if (batch->depth == 2)
+    {
+        batch->stage = gnc_transaction_stage_new ();
+        batch->trn_events = batch->events->len;
+    }
+    gnc_transaction_stage_start_element (batch->stage, (const gchar*)name,
+                                         (gchar**)attrs);
+
+    g_string_append_c (batch->events, 'S');
+    g_string_append_len (batch->events, (const gchar*)name,
+                         strlen ((const char*)name) + 1);
+    while (attrs && attrs[count])
+        count++;
+    g_string_append_len (batch->events, (const gchar*)&count, sizeof (count));
+    for (; count; count--, attrs++)
+        g_string_append_len (batch->events, (const gchar*)*attrs,
+                             strlen ((const char*)*attrs) + 1);
+}
+
+static void
+batch_characters (void* user_data, const xmlChar* text, int len)
+{
+    xml_batch* batch = static_cast<decltype (batch)> (user_data);
+    guint32 length = len;
+
+    /* Text between the transactions is whitespace the parser ignores. */
+    if (batch->depth < 2)
+        return;
+    gnc_transaction_stage_characters (batch->stage, (const gchar*)text, len);
+
+    g_string_append_c (batch->events, 'C');
+    g_string_append_len (batch->events, (const gchar*)&length, sizeof (length));
+    g_string_append_len (batch->events, (const gchar*)text, len);
+}
+
+static void
+batch_end_element (void* user_data, const xmlChar* name)
+{
+    xml_batch* batch = static_cast<decltype (batch)> (user_data);
+    batch_item item;
+
+    if (--batch->depth == 0)
+        return;
+
+    gnc_transaction_stage_end_element (batch->stage, (const gchar*)name);
+    g_string_append_c (batch->events, 'E');
+    g_string_append_len (batch->events, (const gchar*)name,
+                         strlen ((const char*)name) + 1);
+    if (batch->depth > 1)
+        return;
+
+    /* The end of the transaction. */
+    if (gnc_transaction_stage_is_deferred (batch->stage))
+    {
+        gnc_transaction_stage_free (batch->stage);
+        item.stage = NULL;
+    }
+    else
+    {
+        item.stage = batch->stage;
+        g_string_truncate (batch->events, batch->trn_events);
+    }
+    item.events_end = batch->events->len;
+    g_array_append_val (batch->items, item);
+    batch->stage = NULL;
+}
+
+static void
+batch_parse (gpointer data, gpointer user_data)
+{
+    xml_batch* batch = static_cast<decltype (batch)> (data);
+    GAsyncQueue* finished = static_cast<decltype (finished)> (user_data);
+    xmlSAXHandler handler;
+
+    /* A SAX1 handler, like the one sixtp uses, so that the namespace
+     * prefixes are passed through as part of the names. */
+    memset (&handler, 0, sizeof (handler));
+    handler.startElement = batch_start_element;
+    handler.endElement = batch_end_element;
+    handler.characters = batch_characters;
+    handler.getEntity = sixtp_sax_get_entity_handler;
+
+    batch->events = g_string_sized_new (1024);
+    batch->items = g_array_new (FALSE, FALSE, sizeof (batch_item));
+    batch->ok = xmlSAXUserParseMemory (&handler, batch, batch->xml->str,
+                                       batch->xml->len) == 0;
+    /* What's left of a transaction the parse stopped in. */
+    if (batch->stage)
+        gnc_transaction_stage_free (batch->stage);
+    batch->stage = NULL;
+
+    g_async_queue_push (finished, batch);
+}
+
+static void
+batch_free (xml_batch* batch)
+{
+    g_string_free (batch->xml, TRUE);
+    if (batch->events)
+        g_string_free (batch->events, TRUE);
+    if (batch->items)
+    {
+        for (guint i = 0; i < batch->items->len; i++)
+        {
+            auto item = &g_array_index (batch->items, batch_item, i);
+            if (item->stage)
+                gnc_transaction_stage_free (item->stage);
+        }
+        g_array_free (batch->items, TRUE);
+    }
+    g_free (batch);
+}
+
+static void
+batch_replay (const gchar* p, const gchar* end, sixtp_sax_data* sax)
+{
+    std::vector<const xmlChar*> attrs;
+
+    while (p < end && sax->parsing_ok)
+    {
+        switch (*p++)
+        {
+        case 'S':
+        {
+            const gchar* name = p;
+            guint32 count;
+            p += strlen (p) + 1;
+            memcpy (&count, p, sizeof (count));
+            p += sizeof (count);
+            attrs.clear ();
+            for (; count; count--)
+            {
+                attrs.push_back ((const xmlChar*)p);
+                p += strlen (p) + 1;
+            }
+            attrs.push_back (NULL);
+            sixtp_sax_start_handler (sax, (const xmlChar*)name,
+                                     attrs.size () > 1 ? attrs.data () : NULL);
+            break;
+        }
+        case 'C':
+        {
+            guint32 length;
+            memcpy (&length, p, sizeof (length));
+            p += sizeof (length);
+            sixtp_sax_characters_handler (sax, (const xmlChar*)p, length);
+            p += length;
+            break;
+        }
+        case 'E':
+            sixtp_sax_end_handler (sax, (const xmlChar*)p);
+            p += strlen (p) + 1;
+            break;
+        default:
+            g_assert_not_reached ();
+            sax->parsing_ok = FALSE;
+            return;
+        }
+    }
+}
+
+/* Add the batch's transactions to the book in file order. */
+static void
+batch_commit (xml_batch* batch, sixtp_sax_data* sax)
+{
+    gxpf_data* gdata = static_cast<decltype (gdata)> (sax->global_data);
+    gsize events_start = 0;
+
+    for (guint i = 0; i < batch->items->len && sax->parsing_ok; i++)
+    {
+        auto item = &g_array_index (batch->items, batch_item, i);
+
+        if (item->stage)
+        {
+            if (!gnc_transaction_stage_commit (item->stage, gdata,
+                                               TRANSACTION_TAG))
+                sax->parsing_ok = FALSE;
+            item->stage = NULL;
+        }
+        else
+        {
+            batch_replay (batch->events->str + events_start,
+                          batch->events->str + item->events_end, sax);
+        }
+        events_start = item->events_end;
+    }
+}
+
+/* Commit the oldest batch, waiting for a worker to finish it if need be. */
+static void
+pipeline_commit_next (xml_pipeline* pl)
+{
+    xml_batch* batch = static_cast<decltype (batch)> (
+                           g_queue_pop_head (&pl->pending));
+
+    while (!batch->done)
+    {
+        xml_batch* finished = static_cast<decltype (finished)> (
+                                  g_async_queue_pop (pl->finished));
+        finished->done = TRUE;
+    }
+
+    if (!batch->ok)
+    {
+        PERR ("Failed to parse a batch of transactions");
+        pl->sax->parsing_ok = FALSE;
+    }
+    else if (pl->sax->parsing_ok)
+    {
+        batch_commit (batch, pl->sax);
+    }
+    batch_free (batch);
+}
+
+static void
+pipeline_feed (xml_pipeline* pl, gsize upto)
+{
+    if (upto <= pl->fed)
+        return;
+
+    if (pl->sax->parsing_ok)
+    {
+        xmlParseChunk (pl->ctxt, pl->buf->str + pl->fed, upto - pl->fed, 0);
+        if (!pl->ctxt->wellFormed)
+            pl->sax->parsing_ok = FALSE;
+    }
+    pl->fed = upto;
+}
+
+/* Start collecting transactions at pos, unless the parser hasn't got as
+ * far as the element they belong in; replaying them then would put them
+ * in the wrong place. */
+static gboolean
+pipeline_start_run (xml_pipeline* pl, gsize pos)
+{
+    if (pl->in_run)
+        return TRUE;
+
+    pipeline_feed (pl, pos);
+    if (!pl->sax->parsing_ok ||
+        g_slist_length (pl->sax->stack) != (guint)pl->depth + 1)
+        return FALSE;
+
+    pl->in_run = TRUE;
+    pl->run_start = pl->run_end = pos;
+    return TRUE;
+}
+
+/* Hand the transactions collected so far to the workers. */
+static void
+pipeline_dispatch (xml_pipeline* pl)
+{
+    xml_batch* batch;
+
+    if (!pl->in_run || pl->run_end == pl->run_start)
+        return;
+
+    batch = g_new0 (xml_batch, 1);
+    batch->xml = g_string_sized_new (pl->run_end - pl->run_start + 32);
+    g_string_append (batch->xml, PIPELINE_BATCH_START);
+    g_string_append_len (batch->xml, pl->buf->str + pl->run_start,
+                         pl->run_end - pl->run_start);
+    g_string_append (batch->xml, PIPELINE_BATCH_END);
+
+    g_queue_push_tail (&pl->pending, batch);
+    if (pl->pool)
+        g_thread_pool_push (pl->pool, batch, NULL);
+    else
+        batch_parse (batch, pl->finished);
+
+    pl->run_start = pl->run_end;
+
+    if (g_queue_get_length (&pl->pending) > pl->max_pending)
+        pipeline_commit_next (pl);
+}
+
+/* Something other than a transaction follows the run: every transaction
+ * in it has to be in the book before the parser sees what comes next. */
+static void
+pipeline_end_run (xml_pipeline* pl)
+{
+    if (!pl->in_run)
+        return;
+
+    pipeline_dispatch (pl);
+    while (!g_queue_is_empty (&pl->pending))
+        pipeline_commit_next (pl);
+
+    pl->fed = pl->run_end;
+    pl->in_run = FALSE;
+}
+
+/* Only utf-8 files are split; anything else is left to libxml2. */
+static gboolean
+pipeline_check_declaration (const gchar* decl, gsize len)
+{
+    gchar* text = g_ascii_strdown (decl, len);
+    gchar* enc = strstr (text, "encoding");
+    gboolean ok = TRUE;
+
+    if (enc)
+    {
+        enc = strpbrk (enc, "\"'");
+        ok = enc && (strncmp (enc + 1, "utf-8", 5) == 0 ||
+                     strncmp (enc + 1, "utf8", 4) == 0);
+    }
+    g_free (text);
+    return ok;
+}
+
+static gboolean
+pipeline_is_transaction (xml_pipeline* pl, const gchar* name, gsize len)
+{
+    if (len != strlen (TRANSACTION_TAG) ||
+        strncmp (name, TRANSACTION_TAG, len) != 0)
+        return FALSE;
+
+    /* Book level transactions only, not the template transactions. */
+    if (g_strcmp0 (pl->names[0], GNC_V2_STRING) != 0)
+        return FALSE;
+    return pl->depth == 1 ||
+           (pl->depth == 2 && g_strcmp0 (pl->names[1], BOOK_TAG) == 0);
+}
+
+/* Find the end of a start tag, skipping '>' inside attribute values. */
+static const gchar*
+pipeline_find_tag_end (const gchar* p, const gchar* end)
+{
+    gchar quote = 0;
+
+    for (; p < end; p++)
+    {
+        if (quote)
+        {
+            if (*p == quote)
+                quote = 0;
+        }
+        else if (*p == '"' || *p == '\'')
+            quote = *p;
+        else if (*p == '>')
+            return p;
+    }
+    return NULL;
+}
+
+/* Look at whole pieces of markup in the buffer, moving the transactions
+ * into batches and everything else to the parser. Returns when the buffer
+ * ends in the middle of something. */
+static void
+pipeline_scan (xml_pipeline* pl)
+{
+    const gchar* str = pl->buf->str;
+    const gchar* end = str + pl->buf->len;
+
+    while (pl->split && pl->sax->parsing_ok)
+    {
+        const gchar* p = str + pl->scan;
+        const gchar* close;
+        gsize avail = end - p;
+        gsize text_start;
+
+        if (!avail)
+            break;
+
+        if (*p != '<')
+        {
+            const gchar* lt = static_cast<const gchar*> (memchr (p, '<', avail));
+            pl->scan = lt ? lt - str : pl->buf->len;
+            continue;
+        }
+
+        if (avail < 9)
+        {
+            if (pl->eof)
+                pl->split = FALSE;
+            break;
+        }
+
+        if (strncmp (p, "<!--", 4) == 0 || strncmp (p, "<![CDATA[", 9) == 0 ||
+            strncmp (p, "<?", 2) == 0 || strncmp (p, "<!", 2) == 0)
+        {
+            const gchar* terminator = p[1] == '?' ? "?>" :
+                                      p[2] == '-' ? "-->" :
+                                      p[2] == '[' ? "]]>" : ">";
+            close = g_strstr_len (p, avail, terminator);
+            if (!close)
+                break;
+            close += strlen (terminator) - 1;
+
+            if (strncmp (p, "<?xml ", 6) == 0 &&
+                !pipeline_check_declaration (p, close - p))
+                pl->split = FALSE;
+            else if (!pl->in_trn)
+                pipeline_end_run (pl);
+            pl->scan = pl->text_start = close + 1 - str;
+            continue;
+        }
+
+        close = pipeline_find_tag_end (p, end);
+        if (!close)
+            break;
+        text_start = pl->text_start;
+        pl->scan = pl->text_start = close + 1 - str;
+
+        if (p[1] == '/')
+        {
+            pl->depth--;
+            if (pl->in_trn)
+            {
+                if (pl->depth != pl->trn_depth)
+                    continue;
+
+                /* The end of a transaction. */
+                pl->in_trn = FALSE;
+                pl->run_end = pl->scan;
+                if (pl->run_end - pl->run_start >= PIPELINE_BATCH_SIZE)
+                    pipeline_dispatch (pl);
+                continue;
+            }
+            pipeline_end_run (pl);
+            if (pl->depth < 2)
+            {
+                g_free (pl->names[pl->depth]);
+                pl->names[pl->depth] = NULL;
+            }
+            continue;
+        }
+
+        if (pl->in_trn)
+        {
+            if (close[-1] != '/')
+                pl->depth++;
+            continue;
+        }
+
+        {
+            gsize len = strcspn (p + 1, " \t\r\n/>");
+            gboolean empty = close[-1] == '/';
+
+            if (!empty && pipeline_is_transaction (pl, p + 1, len) &&
+                pipeline_start_run (pl, text_start))
+            {
+                pl->in_trn = TRUE;
+                pl->trn_start = p - str;
+                pl->trn_depth = pl->depth++;
+                continue;
+            }
+
+            pipeline_end_run (pl);
+            if (!empty)
+            {
+                if (pl->depth < 2)
+                    pl->names[pl->depth] = g_strndup (p + 1, len);
+                pl->depth++;
+            }
+        }
+    }
+
+    if (!pl->split)
+    {
+        /* Hand whatever is left to the parser as is. */
+        pipeline_end_run (pl);
+        pl->scan = pl->text_start = pl->buf->len;
+    }
+
+    /* Text goes to the parser along with the markup after it, so that
+     * nothing is left waiting in the parser when a run starts. */
+    if (!pl->in_run)
+        pipeline_feed (pl, pl->text_start);
+}
+
+/* Drop the bytes that are no longer needed from the front of the buffer. */
+static void
+pipeline_compact (xml_pipeline* pl)
+{
+    gsize keep = pl->in_run ? pl->run_start : pl->fed;
+
+    if (pl->in_trn && pl->trn_start < keep)
+        keep = pl->trn_start;
+    if (!keep)
+        return;
+
+    g_string_erase (pl->buf, 0, keep);
+    pl->scan -= keep;
+    pl->text_start -= keep;
+    pl->fed -= keep;
+    if (pl->in_trn)
+        pl->trn_start -= keep;
+    if (pl->in_run)
+    {
+        pl->run_start -= keep;
+        pl->run_end -= keep;
+    }
+}
+
+static void
+pipeline_push_handler (xmlParserCtxtPtr xml_context, gpointer user_data)
+{
+    xml_pipeline* pl = static_cast<decltype (pl)> (user_data);
+    gchar* chunk = g_new (gchar, PIPELINE_READ_SIZE);
+    gint threads = gnc_prefs_get_file_load_threads ();
+    gint n_threads = 1;
+
+    pl->ctxt = xml_context;
+    pl->sax = static_cast<sixtp_sax_data*> (xml_context->userData);
+    pl->buf = g_string_sized_new (2 * PIPELINE_READ_SIZE);
+    pl->split = TRUE;
+    pl->finished = g_async_queue_new ();
+    g_queue_init (&pl->pending);
+
+#ifdef HAVE_GLIB_2_36
+    if (threads <= 0)
+        threads = g_get_num_processors ();
+#endif
+    /* The calling thread is one of them. */
+    if (threads > 0)
+        n_threads = threads - 1;
+    /* Without a spare core, splitting the file only adds work. */
+    if (n_threads < 1)
+        pl->split = FALSE;
+    else
+    {
+        /* The workers share the parser's global state. */
+        xmlInitParser ();
+        pl->pool = g_thread_pool_new (batch_parse, pl->finished, n_threads,
+                                      FALSE, NULL);
+    }
+    pl->max_pending = 2 * MAX (n_threads, 1);
+
+    while (!pl->eof && pl->sax->parsing_ok)
+    {
+        size_t n = fread (chunk, 1, PIPELINE_READ_SIZE, pl->file);
+
+        if (n < PIPELINE_READ_SIZE)
+        {
+            if (ferror (pl->file))
+            {
+                g_warning ("Error reading XML file");
+                pl->sax->parsing_ok = FALSE;
+            }
+            pl->eof = TRUE;
+        }
+        g_string_append_len (pl->buf, chunk, n);
+        pipeline_scan (pl);
+        pipeline_compact (pl);
+    }
+
+    /* A truncated file can leave a run behind. */
+    pipeline_end_run (pl);
+    pipeline_feed (pl, pl->buf->len);
+    if (pl->sax->parsing_ok)
+    {
+        xmlParseChunk (xml_context, NULL, 0, 1);
+        if (!xml_context->wellFormed)
+            pl->sax->parsing_ok = FALSE;
+    }
+
+    if (pl->pool)
+        g_thread_pool_free (pl->pool, FALSE, TRUE);
+    while (!g_queue_is_empty (&pl->pending))
+        batch_free (static_cast<xml_batch*> (g_queue_pop_head (&pl->pending)));
+    g_async_queue_unref (pl->finished);
+    g_string_free (pl->buf, TRUE);
+    g_free (pl->names[0]);
+    g_free (pl->names[1]);
+    g_free (chunk);
+}
+
 static gboolean
 qof_session_load_from_xml_file_v2_full (
     FileBackend* fbe, QofBook* book,
@@ -811,8 +1483,20 @@ qof_session_load_from_xml_file_v2_full (
         }
         else
         {
-            retval = gnc_xml_parse_fd (top_parser, file,
-                                       generic_callback, gd, book);
+            gpointer parse_result = NULL;
+            gxpf_data gpdata;
+            xml_pipeline pipeline;
+
+            gpdata.cb = generic_callback;
+            gpdata.parsedata = gd;
+            gpdata.bookdata = book;
+
+            memset (&pipeline, 0, sizeof (pipeline));
+            pipeline.file = file;
+
+            retval = sixtp_parse_push (top_parser, pipeline_push_handler,
+                                       &pipeline, NULL, &gpdata,
+                                       &parse_result);
             fclose (file);
             if (is_compressed)
                 wait_for_gzip (file);
@@ -842,15 +1526,10 @@ qof_session_load_from_xml_file_v2_full (
     be_data.book = book;
     qof_object_foreach_backend (GNC_FILE_BACKEND, scrub_cb, &be_data);
 
-    /* fix price quote sources */
+    /* Fix price quote sources, account and transaction commodities and
+     * split amount/value in one pass over the transactions. */
     root = gnc_book_get_root_account (book);
-    xaccAccountTreeScrubQuoteSources (root, gnc_commodity_table_get_table (book));
-
-    /* Fix account and transaction commodities */
-    xaccAccountTreeScrubCommodities (root);
-
-    /* Fix split amount/value */
-    xaccAccountTreeScrubSplits (root);
+    xaccAccountTreeScrubAfterLoad (root, gnc_commodity_table_get_table (book));
 
     /* commit all groups, this completes the BeginEdit started when the
      * account_end_handler finished reading the account.
@@ -1186,14 +1865,9 @@ static int
 xml_add_trn_data (Transaction* t, gpointer data)
 {
     struct file_backend* be_data = static_cast<decltype (be_data)> (data);
-    xmlNodePtr node;
-
-    node = gnc_transaction_dom_tree_create (t);
-
-    xmlElemDump (be_data->out, NULL, node);
-    xmlFreeNode (node);
 
-    if (ferror (be_data->out) || fprintf (be_data->out, "\n") < 0)
+    gnc_transaction_write_xml (be_data->writer, t);
+    if (ferror (be_data->out))
         return -1;
 
     be_data->gd->counter.transactions_loaded++;
@@ -1205,13 +1879,16 @@ static gboolean
 write_transactions (FILE* out, QofBook* book, sixtp_gdv2* gd)
 {
     struct file_backend be_data;
+    gboolean ok;
 
     be_data.out = out;
     be_data.gd = gd;
-    return 0 ==
-           xaccAccountTreeForEachTransaction (gnc_book_get_root_account (book),
-                                              xml_add_trn_data,
-                                              (gpointer) &be_data);
+    be_data.writer = xml_writer_new (out);
+    ok = 0 ==
+         xaccAccountTreeForEachTransaction (gnc_book_get_root_account (book),
+                                            xml_add_trn_data,
+                                            (gpointer) &be_data);
+    return xml_writer_destroy (be_data.writer) && ok;
 }
 
 static gboolean
@@ -1226,11 +1903,17 @@ write_template_transaction_data (FILE* out, QofBook* book, sixtp_gdv2* gd)
     ra = gnc_book_get_template_root (book);
     if (gnc_account_n_descendants (ra) > 0)
     {
+        gboolean ok;
+
         if (fprintf (out, "<%s>\n", TEMPLATE_TRANSACTION_TAG) < 0
-            || !write_account_tree (out, ra, gd)
-            || xaccAccountTreeForEachTransaction (ra, xml_add_trn_data, (gpointer)&be_data)
-            || fprintf (out, "</%s>\n", TEMPLATE_TRANSACTION_TAG) < 0)
+            || !write_account_tree (out, ra, gd))
+            return FALSE;
 
+        be_data.writer = xml_writer_new (out);
+        ok = 0 == xaccAccountTreeForEachTransaction (ra, xml_add_trn_data,
+                                                     (gpointer)&be_data);
+        if (!xml_writer_destroy (be_data.writer) || !ok
+            || fprintf (out, "</%s>\n", TEMPLATE_TRANSACTION_TAG) < 0)
             return FALSE;
     }
 
@@ -1415,17 +2098,82 @@ gnc_book_write_accounts_to_xml_filehandle_v2 (QofBackend* be, QofBook* book,
 
 #define BUFLEN 4096
 
+/* Compress what comes through the pipe on a pool of threads.
+ * Returns 1 on success or 0 otherwise. */
+static gint
+gz_thread_compress (gz_thread_params_t* params)
+{
+    gchar buffer[BUFLEN];
+    gssize bytes;
+    gz_parallel* gz;
+    FILE* file;
+    gint success = 1;
+
+    file = g_fopen (params->filename, "wb");
+    if (file == NULL)
+    {
+        g_warning ("Child threads fopen failed");
+        return 0;
+    }
+
+    gz = gz_parallel_new (file, params->level, params->threads);
+    while (success)
+    {
+        bytes = read (params->fd, buffer, BUFLEN);
+        if (bytes > 0)
+        {
+            if (!gz_parallel_write (gz, buffer, bytes))
+            {
+                g_warning ("Could not write the compressed file '%s'.",
+                           params->filename);
+                success = 0;
+            }
+        }
+        else if (bytes == 0)
+        {
+            break;
+        }
+        else
+        {
+            g_warning ("Could not read from pipe. The error is '%s' (errno %d)",
+                       g_strerror (errno) ? g_strerror (errno) : "", errno);
+            success = 0;
+        }
+    }
+
+    if (!gz_parallel_close (gz) && success)
+    {
+        g_warning ("Could not write the compressed file '%s'.",
+                   params->filename);
+        success = 0;
+    }
+    if (fclose (file) != 0)
+    {
+        g_warning ("Could not close the compressed file '%s'. The error is '%s' (errno %d)",
+                   params->filename, g_strerror (errno) ? g_strerror (errno) : "",
+                   errno);
+        success = 0;
+    }
+
+    return success;
+}
+
 /* Compress or decompress function that is to be run in a separate thread.
  * Returns 1 on success or 0 otherwise, stuffed into a pointer type. */
 static gpointer
 gz_thread_func (gz_thread_params_t* params)
 {
     gchar buffer[BUFLEN];
-    gssize bytes;
     gint gzval;
     gzFile file;
     gint success = 1;
 
+    if (params->compress)
+    {
+        success = gz_thread_compress (params);
+        goto cleanup_gz_thread_func;
+    }
+
 #ifdef G_OS_WIN32
     {
         gchar* conv_name = g_win32_locale_filename_from_utf8 (params->filename);
@@ -1459,67 +2207,36 @@ gz_thread_func (gz_thread_params_t* params)
         goto cleanup_gz_thread_func;
     }
 
-    if (params->compress)
-    {
-        while (success)
-        {
-            bytes = read (params->fd, buffer, BUFLEN);
-            if (bytes > 0)
-            {
-                if (gzwrite (file, buffer, bytes) <= 0)
-                {
-                    gint errnum;
-                    const gchar* error = gzerror (file, &errnum);
-                    g_warning ("Could not write the compressed file '%s'. The error is: '%s' (%d)",
-                               params->filename, error, errnum);
-                    success = 0;
-                }
-            }
-            else if (bytes == 0)
-            {
-                break;
-            }
-            else
-            {
-                g_warning ("Could not read from pipe. The error is '%s' (errno %d)",
-                           g_strerror (errno) ? g_strerror (errno) : "", errno);
-                success = 0;
-            }
-        }
-    }
-    else
+    while (success)
     {
-        while (success)
+        gzval = gzread (file, buffer, BUFLEN);
+        if (gzval > 0)
         {
-            gzval = gzread (file, buffer, BUFLEN);
-            if (gzval > 0)
-            {
-                if (
+            if (
 #if COMPILER(MSVC)
-                    _write
+                _write
 #else
-                    write
+                write
 #endif
-                    (params->fd, buffer, gzval) < 0)
-                {
-                    g_warning ("Could not write to pipe. The error is '%s' (%d)",
-                               g_strerror (errno) ? g_strerror (errno) : "", errno);
-                    success = 0;
-                }
-            }
-            else if (gzval == 0)
-            {
-                break;
-            }
-            else
+                (params->fd, buffer, gzval) < 0)
             {
-                gint errnum;
-                const gchar* error = gzerror (file, &errnum);
-                g_warning ("Could not read from compressed file '%s'. The error is: '%s' (%d)",
-                           params->filename, error, errnum);
+                g_warning ("Could not write to pipe. The error is '%s' (%d)",
+                           g_strerror (errno) ? g_strerror (errno) : "", errno);
                 success = 0;
             }
         }
+        else if (gzval == 0)
+        {
+            break;
+        }
+        else
+        {
+            gint errnum;
+            const gchar* error = gzerror (file, &errnum);
+            g_warning ("Could not read from compressed file '%s'. The error is: '%s' (%d)",
+                       params->filename, error, errnum);
+            success = 0;
+        }
     }
 
     if ((gzval = gzclose (file)) != Z_OK)
@@ -1571,6 +2288,8 @@ try_gz_open (const char* filename, const char* perms, gboolean use_gzip,
         params->filename = g_strdup (filename);
         params->perms = g_strdup (perms);
         params->compress = compress;
+        params->level = gnc_prefs_get_file_compression_level ();
+        params->threads = gnc_prefs_get_file_compression_threads ();
 
 #ifndef HAVE_GLIB_2_32
         thread = g_thread_create ((GThreadFunc) gz_thread_func, params,
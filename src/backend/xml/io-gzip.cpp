@@ -0,0 +1,307 @@
+/********************************************************************\
+ * io-gzip.cpp -- parallel gzip compression for gnucash files       *
+ *                                                                  *
+ * This program is free software; you can redistribute it and/or    *
+ * modify it under the terms of the GNU General Public License as   *
+ * published by the Free Software Foundation; either version 2 of   *
+ * the License, or (at your option) any later version.              *
+ *                                                                  *
+ * This program is distributed in the hope that it will be useful,  *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of   *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the    *
+ * GNU General Public License for more details.                     *
+ *                                                                  *
+ * You should have received a copy of the GNU General Public License*
+ * along with this program; if not, contact:                        *
+ *                                                                  *
+ * Free Software Foundation           Voice:  +1-617-542-5942       *
+ * 51 Franklin Street, Fifth Floor    Fax:    +1-617-542-2652       *
+ * Boston, MA  02110-1301,  USA       gnu@gnu.org                   *
+ *                                                                  *
+\********************************************************************/
+extern "C"
+{
+#include "config.h"
+
+#include <errno.h>
+#include <string.h>
+#include <zlib.h>
+
+#include "qof.h"
+#include "gnc-engine.h"
+}
+
+#include "io-gzip.h"
+
+static QofLogModule log_module = GNC_MOD_IO;
+
+/* Big enough that restarting deflate for each block costs next to
+ * nothing in size, small enough to keep every thread busy. */
+#define GZ_BLOCK_SIZE (128 * 1024)
+/* The deflate window: all of the previous block that can help. */
+#define GZ_DICT_SIZE (32 * 1024)
+
+typedef struct
+{
+    guchar* in;
+    gsize in_len;
+    guchar dict[GZ_DICT_SIZE];
+    gsize dict_len;
+    gboolean last;
+    gint level;
+
+    guchar* out;
+    gsize out_len;
+    guint32 crc;
+    gboolean ok;
+    gboolean done;
+} gz_block;
+
+struct gz_parallel
+{
+    FILE* out;
+    gint level;
+    GThreadPool* pool;
+    GAsyncQueue* finished;
+    GQueue pending;
+    guint max_pending;
+
+    /* The block being filled; it can't be compressed before we know
+     * whether it is the last. */
+    gz_block* filling;
+    guchar dict[GZ_DICT_SIZE];
+    gsize dict_len;
+
+    guint32 crc;
+    guint32 isize;
+    gboolean ok;
+};
+
+static gz_block*
+gz_block_new (gint level)
+{
+    gz_block* b = g_new0 (gz_block, 1);
+
+    b->in = static_cast<guchar*> (g_malloc (GZ_BLOCK_SIZE));
+    b->level = level;
+    return b;
+}
+
+static void
+gz_block_free (gz_block* b)
+{
+    g_free (b->in);
+    g_free (b->out);
+    g_free (b);
+}
+
+/* Runs on the pool: deflate one block as a raw stream that ends on a
+ * byte boundary, so that the blocks can simply be concatenated. */
+static void
+gz_block_compress (gpointer data, gpointer user_data)
+{
+    gz_block* b = static_cast<gz_block*> (data);
+    z_stream strm;
+    gsize size;
+    int flush = b->last ? Z_FINISH : Z_SYNC_FLUSH;
+    int rc;
+
+    b->crc = crc32 (0L, b->in, b->in_len);
+
+    memset (&strm, 0, sizeof (strm));
+    b->ok = deflateInit2 (&strm, b->level, Z_DEFLATED, -MAX_WBITS, 8,
+                          Z_DEFAULT_STRATEGY) == Z_OK;
+    if (b->ok && b->dict_len)
+        b->ok = deflateSetDictionary (&strm, b->dict, b->dict_len) == Z_OK;
+
+    if (b->ok)
+    {
+        size = deflateBound (&strm, b->in_len) + 16;
+        b->out = static_cast<guchar*> (g_malloc (size));
+        strm.next_in = b->in;
+        strm.avail_in = b->in_len;
+        strm.next_out = b->out;
+        strm.avail_out = size;
+
+        /* The bound should leave room for the flush marker, but a full
+         * output buffer would leave the flush unfinished. */
+        while ((rc = deflate (&strm, flush)) == Z_OK && strm.avail_out == 0)
+        {
+            b->out = static_cast<guchar*> (g_realloc (b->out, 2 * size));
+            strm.next_out = b->out + size;
+            strm.avail_out = size;
+            size *= 2;
+        }
+        b->out_len = strm.total_out;
+        b->ok = (rc == (b->last ? Z_STREAM_END : Z_OK)) && strm.avail_in == 0;
+        deflateEnd (&strm);
+    }
+
+    if (user_data)
+        g_async_queue_push (static_cast<GAsyncQueue*> (user_data), b);
+}
+
+static void
+gz_write_le32 (guchar* buf, guint32 val)
+{
+    buf[0] = val & 0xff;
+    buf[1] = (val >> 8) & 0xff;
+    buf[2] = (val >> 16) & 0xff;
+    buf[3] = (val >> 24) & 0xff;
+}
+
+static void
+gz_write_out (gz_parallel* gz, const guchar* data, gsize len)
+{
+    if (gz->ok && len && fwrite (data, 1, len, gz->out) != len)
+    {
+        PERR ("Could not write the compressed file: %s", g_strerror (errno));
+        gz->ok = FALSE;
+    }
+}
+
+/* Wait for the oldest block still out and write it. */
+static void
+gz_commit_next (gz_parallel* gz)
+{
+    gz_block* b = static_cast<gz_block*> (g_queue_peek_head (&gz->pending));
+
+    while (!b->done)
+    {
+        gz_block* finished =
+            static_cast<gz_block*> (g_async_queue_pop (gz->finished));
+        finished->done = TRUE;
+    }
+    g_queue_pop_head (&gz->pending);
+
+    if (!b->ok)
+    {
+        PERR ("Could not compress a block");
+        gz->ok = FALSE;
+    }
+    gz_write_out (gz, b->out, b->out_len);
+    gz->crc = crc32_combine (gz->crc, b->crc, b->in_len);
+    gz->isize += b->in_len;
+    gz_block_free (b);
+}
+
+static void
+gz_submit (gz_parallel* gz, gz_block* b, gboolean last)
+{
+    gsize tail;
+
+    b->last = last;
+    memcpy (b->dict, gz->dict, gz->dict_len);
+    b->dict_len = gz->dict_len;
+
+    tail = MIN (b->in_len, GZ_DICT_SIZE);
+    memcpy (gz->dict, b->in + b->in_len - tail, tail);
+    gz->dict_len = tail;
+
+    g_queue_push_tail (&gz->pending, b);
+    if (gz->pool)
+        g_thread_pool_push (gz->pool, b, NULL);
+    else
+    {
+        gz_block_compress (b, NULL);
+        b->done = TRUE;
+    }
+
+    while (g_queue_get_length (&gz->pending) > gz->max_pending)
+        gz_commit_next (gz);
+}
+
+gz_parallel*
+gz_parallel_new (FILE* out, gint level, gint n_threads)
+{
+    /* No file name or time stamp, and no extra flags. */
+    static const guchar header[10] =
+    { 0x1f, 0x8b, Z_DEFLATED, 0, 0, 0, 0, 0, 0, 3 };
+    gz_parallel* gz;
+
+    g_return_val_if_fail (out, NULL);
+
+    if (level < Z_DEFAULT_COMPRESSION || level > Z_BEST_COMPRESSION)
+    {
+        PWARN ("Invalid compression level %d", level);
+        level = Z_DEFAULT_COMPRESSION;
+    }
+    if (n_threads <= 0)
+    {
+        n_threads = 1;
+#ifdef HAVE_GLIB_2_36
+        n_threads = g_get_num_processors ();
+#endif
+    }
+
+    gz = g_new0 (gz_parallel, 1);
+    gz->out = out;
+    gz->level = level;
+    gz->ok = TRUE;
+    gz->crc = crc32 (0L, Z_NULL, 0);
+    g_queue_init (&gz->pending);
+    gz->max_pending = 2 * n_threads;
+    if (n_threads > 1)
+    {
+        gz->finished = g_async_queue_new ();
+        gz->pool = g_thread_pool_new (gz_block_compress, gz->finished,
+                                      n_threads, FALSE, NULL);
+    }
+    gz->filling = gz_block_new (level);
+
+    gz_write_out (gz, header, sizeof (header));
+    return gz;
+}
+
+gboolean
+gz_parallel_write (gz_parallel* gz, const void* data, gsize len)
+{
+    const guchar* p = static_cast<const guchar*> (data);
+
+    g_return_val_if_fail (gz, FALSE);
+
+    while (len)
+    {
+        gsize n;
+
+        /* More is coming, so a full block isn't the last one. */
+        if (gz->filling->in_len == GZ_BLOCK_SIZE)
+        {
+            gz_submit (gz, gz->filling, FALSE);
+            gz->filling = gz_block_new (gz->level);
+        }
+
+        n = MIN (len, GZ_BLOCK_SIZE - gz->filling->in_len);
+        memcpy (gz->filling->in + gz->filling->in_len, p, n);
+        gz->filling->in_len += n;
+        p += n;
+        len -= n;
+    }
+    return gz->ok;
+}
+
+gboolean
+gz_parallel_close (gz_parallel* gz)
+{
+    guchar trailer[8];
+    gboolean ok;
+
+    g_return_val_if_fail (gz, FALSE);
+
+    gz_submit (gz, gz->filling, TRUE);
+    while (!g_queue_is_empty (&gz->pending))
+        gz_commit_next (gz);
+
+    gz_write_le32 (trailer, gz->crc);
+    gz_write_le32 (trailer + 4, gz->isize);
+    gz_write_out (gz, trailer, sizeof (trailer));
+
+    if (gz->pool)
+    {
+        g_thread_pool_free (gz->pool, FALSE, TRUE);
+        g_async_queue_unref (gz->finished);
+    }
+    ok = gz->ok;
+    g_free (gz);
+    return ok;
+}
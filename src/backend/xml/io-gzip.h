@@ -0,0 +1,47 @@
+/********************************************************************\
+ * io-gzip.h -- parallel gzip compression for gnucash files         *
+ *                                                                  *
+ * This program is free software; you can redistribute it and/or    *
+ * modify it under the terms of the GNU General Public License as   *
+ * published by the Free Software Foundation; either version 2 of   *
+ * the License, or (at your option) any later version.              *
+ *                                                                  *
+ * This program is distributed in the hope that it will be useful,  *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of   *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the    *
+ * GNU General Public License for more details.                     *
+ *                                                                  *
+ * You should have received a copy of the GNU General Public License*
+ * along with this program; if not, contact:                        *
+ *                                                                  *
+ * Free Software Foundation           Voice:  +1-617-542-5942       *
+ * 51 Franklin Street, Fifth Floor    Fax:    +1-617-542-2652       *
+ * Boston, MA  02110-1301,  USA       gnu@gnu.org                   *
+ *                                                                  *
+\********************************************************************/
+
+#ifndef IO_GZIP_H
+#define IO_GZIP_H
+extern "C"
+{
+#include <stdio.h>
+#include <glib.h>
+}
+
+/* Compresses a stream into a single standard gzip member, the way pigz
+ * does: the input is cut into blocks that are deflated on a pool of
+ * threads, each primed with the end of the block before it, and the
+ * pieces are written out in order.  Anything that reads gzip files,
+ * gzread() included, reads the result unchanged. */
+typedef struct gz_parallel gz_parallel;
+
+/* level is a zlib compression level, Z_DEFAULT_COMPRESSION included.
+ * n_threads of 0 uses one thread per processor; with 1 everything is
+ * compressed on the calling thread. */
+gz_parallel* gz_parallel_new (FILE* out, gint level, gint n_threads);
+gboolean gz_parallel_write (gz_parallel* gz, const void* data, gsize len);
+/* Finishes the gzip member and frees gz, but doesn't close out.
+ * Returns FALSE if anything failed along the way. */
+gboolean gz_parallel_close (gz_parallel* gz);
+
+#endif /* IO_GZIP_H */
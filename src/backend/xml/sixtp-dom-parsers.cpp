@@ -61,11 +61,23 @@ dom_tree_to_guid (xmlNodePtr node)
         /* handle new and guid the same for the moment */
         if ((g_strcmp0 ("guid", type) == 0) || (g_strcmp0 ("new", type) == 0))
         {
-            auto gid = guid_new ();
-            char* guid_str;
+            auto gid = guid_malloc ();
+            auto text = node->xmlChildrenNode;
+
+            /* The id is nearly always a single text node; decode it in
+             * place rather than copying it out. */
+            if (text && text->type == XML_TEXT_NODE && !text->next &&
+                text->content &&
+                guid_from_hex_buff ((char*)text->content,
+                                    strlen ((char*)text->content), gid))
+            {
+                xmlFree (type);
+                return gid;
+            }
 
-            guid_str = (char*)xmlNodeGetContent (node->xmlChildrenNode);
-            string_to_guid (guid_str, gid);
+            auto guid_str = (char*)xmlNodeGetContent (text);
+            if (!string_to_guid (guid_str, gid))
+                guid_replace (gid);
             xmlFree (guid_str);
             xmlFree (type);
             return gid;
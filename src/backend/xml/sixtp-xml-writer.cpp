@@ -0,0 +1,470 @@
+/********************************************************************
+ * sixtp-xml-writer.cpp                                             *
+ *                                                                  *
+ * This program is free software; you can redistribute it and/or    *
+ * modify it under the terms of the GNU General Public License as   *
+ * published by the Free Software Foundation; either version 2 of   *
+ * the License, or (at your option) any later version.              *
+ *                                                                  *
+ * This program is distributed in the hope that it will be useful,  *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of   *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the    *
+ * GNU General Public License for more details.                     *
+ *                                                                  *
+ * You should have received a copy of the GNU General Public License*
+ * along with this program; if not, contact:                        *
+ *                                                                  *
+ * Free Software Foundation           Voice:  +1-617-542-5942       *
+ * 51 Franklin Street, Fifth Floor    Fax:    +1-617-542-2652       *
+ * Boston, MA  02110-1301,  USA       gnu@gnu.org                   *
+ *                                                                  *
+ ********************************************************************/
+extern "C"
+{
+#include "config.h"
+#include <glib.h>
+#include <string.h>
+
+#include <gnc-date.h>
+#include <qofinstance-p.h>
+}
+
+#include "gnc-xml-helper.h"
+#include "sixtp-dom-generators.h"
+#include "sixtp-xml-writer.h"
+
+#include <kvp_frame.hpp>
+#include <vector>
+
+static QofLogModule log_module = GNC_MOD_IO;
+
+/* Big enough that the file sees few, large writes. */
+#define XML_WRITER_BUFFER_SIZE (1 << 20)
+
+/* libxml2 stops indenting deeper than this. */
+#define XML_WRITER_MAX_INDENT 30
+
+typedef enum
+{
+    ELEM_OPEN,          /* The start tag isn't closed yet. */
+    ELEM_CHILDREN,
+    ELEM_TEXT
+} xml_writer_elem_state;
+
+struct xml_writer_elem
+{
+    const char* tag;
+    xml_writer_elem_state state;
+};
+
+struct xml_writer
+{
+    FILE* out;
+    GString* buf;
+    std::vector<xml_writer_elem> open;
+    gboolean failed;
+};
+
+xml_writer*
+xml_writer_new (FILE* out)
+{
+    auto w = new xml_writer;
+
+    w->out = out;
+    w->buf = g_string_sized_new (XML_WRITER_BUFFER_SIZE);
+    w->failed = FALSE;
+    return w;
+}
+
+gboolean
+xml_writer_flush (xml_writer* w)
+{
+    g_return_val_if_fail (w, FALSE);
+
+    if (w->buf->len && !w->failed &&
+        fwrite (w->buf->str, 1, w->buf->len, w->out) != w->buf->len)
+    {
+        PERR ("Error writing XML output");
+        w->failed = TRUE;
+    }
+    g_string_truncate (w->buf, 0);
+    return !w->failed;
+}
+
+gboolean
+xml_writer_destroy (xml_writer* w)
+{
+    gboolean ok;
+
+    g_return_val_if_fail (w, FALSE);
+
+    if (!w->open.empty ())
+        PERR ("%u elements left open", (unsigned)w->open.size ());
+    ok = xml_writer_flush (w);
+    g_string_free (w->buf, TRUE);
+    delete w;
+    return ok;
+}
+
+static void
+write_indent (xml_writer* w, size_t level)
+{
+    static const char spaces[2 * XML_WRITER_MAX_INDENT + 1] =
+        "                                                            ";
+
+    g_string_append_len (w->buf, spaces,
+                         2 * MIN (level, XML_WRITER_MAX_INDENT));
+}
+
+/* Escape the way xmlNodeDumpOutput() does, replacing the control
+ * characters checked_char_cast() would as we go. */
+static void
+write_escaped (xml_writer* w, const char* text, gboolean attr)
+{
+    const char* run = text;
+    const char* p;
+
+    for (p = text; *p; ++p)
+    {
+        const char* ent;
+        char c = *p;
+
+        switch (c)
+        {
+        case '<':
+            ent = "&lt;";
+            break;
+        case '>':
+            ent = "&gt;";
+            break;
+        case '&':
+            ent = "&amp;";
+            break;
+        case '\r':
+            ent = "&#13;";
+            break;
+        case '"':
+            ent = attr ? "&quot;" : NULL;
+            break;
+        case '\n':
+            ent = attr ? "&#10;" : NULL;
+            break;
+        case '\t':
+            ent = attr ? "&#9;" : NULL;
+            break;
+        default:
+            ent = (c > 0 && c < 0x20) ? "?" : NULL;
+            break;
+        }
+        if (!ent)
+            continue;
+
+        g_string_append_len (w->buf, run, p - run);
+        g_string_append (w->buf, ent);
+        run = p + 1;
+    }
+    g_string_append_len (w->buf, run, p - run);
+}
+
+/* Close the start tag of the innermost element before giving it
+ * content. */
+static void
+close_start_tag (xml_writer* w, xml_writer_elem_state state)
+{
+    if (w->open.empty ())
+        return;
+
+    auto& parent = w->open.back ();
+    if (parent.state == ELEM_OPEN)
+    {
+        g_string_append (w->buf, state == ELEM_CHILDREN ? ">\n" : ">");
+        parent.state = state;
+    }
+    else if (parent.state != state)
+        PERR ("<%s> can't hold both text and elements", parent.tag);
+}
+
+void
+xml_writer_start (xml_writer* w, const char* tag)
+{
+    g_return_if_fail (w && tag);
+
+    close_start_tag (w, ELEM_CHILDREN);
+    write_indent (w, w->open.size ());
+    g_string_append_c (w->buf, '<');
+    g_string_append (w->buf, tag);
+    w->open.push_back ({tag, ELEM_OPEN});
+}
+
+void
+xml_writer_attr (xml_writer* w, const char* name, const char* value)
+{
+    g_return_if_fail (w && name && value);
+    g_return_if_fail (!w->open.empty () && w->open.back ().state == ELEM_OPEN);
+
+    g_string_append_c (w->buf, ' ');
+    g_string_append (w->buf, name);
+    g_string_append (w->buf, "=\"");
+    write_escaped (w, value, TRUE);
+    g_string_append_c (w->buf, '"');
+}
+
+void
+xml_writer_text (xml_writer* w, const char* text)
+{
+    g_return_if_fail (w && !w->open.empty ());
+
+    if (!text)
+        return;
+
+    close_start_tag (w, ELEM_TEXT);
+    if (g_utf8_validate (text, -1, NULL))
+    {
+        write_escaped (w, text, FALSE);
+        return;
+    }
+
+    auto copy = g_strdup (text);
+    write_escaped (w, (const char*)checked_char_cast (copy), FALSE);
+    g_free (copy);
+}
+
+void
+xml_writer_end (xml_writer* w)
+{
+    g_return_if_fail (w && !w->open.empty ());
+
+    auto elem = w->open.back ();
+    w->open.pop_back ();
+
+    switch (elem.state)
+    {
+    case ELEM_OPEN:
+        g_string_append (w->buf, "/>\n");
+        break;
+    case ELEM_CHILDREN:
+        write_indent (w, w->open.size ());
+        /* Fall through */
+    case ELEM_TEXT:
+        g_string_append (w->buf, "</");
+        g_string_append (w->buf, elem.tag);
+        g_string_append (w->buf, ">\n");
+        break;
+    }
+
+    if (w->open.empty () && w->buf->len >= XML_WRITER_BUFFER_SIZE)
+        xml_writer_flush (w);
+}
+
+/***********************************************************************/
+
+void
+xml_writer_text_element (xml_writer* w, const char* tag, const char* text)
+{
+    xml_writer_start (w, tag);
+    xml_writer_text (w, text);
+    xml_writer_end (w);
+}
+
+void
+xml_writer_guid (xml_writer* w, const char* tag, const GncGUID* gid)
+{
+    char guid_str[GUID_ENCODING_LENGTH + 1];
+
+    if (!guid_to_string_buff (gid, guid_str))
+    {
+        PERR ("guid_to_string_buff failed\n");
+        return;
+    }
+
+    xml_writer_start (w, tag);
+    xml_writer_attr (w, "type", "guid");
+    xml_writer_text (w, guid_str);
+    xml_writer_end (w);
+}
+
+void
+xml_writer_commodity_ref (xml_writer* w, const char* tag,
+                          const gnc_commodity* c)
+{
+    g_return_if_fail (c);
+
+    if (!gnc_commodity_get_namespace (c) || !gnc_commodity_get_mnemonic (c))
+        return;
+
+    xml_writer_start (w, tag);
+    xml_writer_text_element (w, "cmdty:space",
+                             gnc_commodity_get_namespace_compat (c));
+    xml_writer_text_element (w, "cmdty:id", gnc_commodity_get_mnemonic (c));
+    xml_writer_end (w);
+}
+
+static void
+write_timespec (xml_writer* w, const char* tag, const char* type,
+                const Timespec* spec)
+{
+    gchar* date_str = timespec_sec_to_string (spec);
+
+    if (!date_str)
+        return;
+
+    xml_writer_start (w, tag);
+    if (type)
+        xml_writer_attr (w, "type", type);
+    xml_writer_text_element (w, "ts:date", date_str);
+    if (spec->tv_nsec > 0)
+    {
+        char ns_str[32];
+        g_snprintf (ns_str, sizeof (ns_str), "%ld", spec->tv_nsec);
+        xml_writer_text_element (w, "ts:ns", ns_str);
+    }
+    xml_writer_end (w);
+    g_free (date_str);
+}
+
+void
+xml_writer_timespec (xml_writer* w, const char* tag, const Timespec* spec)
+{
+    g_return_if_fail (spec);
+    write_timespec (w, tag, NULL, spec);
+}
+
+static void
+write_gdate (xml_writer* w, const char* tag, const char* type,
+             const GDate* date)
+{
+    gchar date_str[512];
+
+    g_date_strftime (date_str, sizeof (date_str), "%Y-%m-%d", date);
+    xml_writer_start (w, tag);
+    if (type)
+        xml_writer_attr (w, "type", type);
+    xml_writer_text_element (w, "gdate", date_str);
+    xml_writer_end (w);
+}
+
+void
+xml_writer_gdate (xml_writer* w, const char* tag, const GDate* date)
+{
+    g_return_if_fail (date);
+    write_gdate (w, tag, NULL, date);
+}
+
+void
+xml_writer_numeric (xml_writer* w, const char* tag, const gnc_numeric* num)
+{
+    gchar* numstr;
+
+    g_return_if_fail (num);
+
+    numstr = gnc_numeric_to_string (*num);
+    g_return_if_fail (numstr);
+
+    xml_writer_text_element (w, tag, numstr);
+    g_free (numstr);
+}
+
+/* Writes what add_kvp_value_node() in sixtp-dom-generators.cpp builds. */
+static void write_kvp_slot (const char* key, KvpValue* value, void* data);
+
+static void
+write_kvp_text_value (xml_writer* w, const char* tag, const char* type,
+                      gchar* text)
+{
+    xml_writer_start (w, tag);
+    xml_writer_attr (w, "type", type);
+    xml_writer_text (w, text);
+    xml_writer_end (w);
+    g_free (text);
+}
+
+static void
+write_kvp_value (xml_writer* w, const char* tag, KvpValue* val)
+{
+    switch (val->get_type ())
+    {
+    case KvpValue::Type::INT64:
+        write_kvp_text_value (w, tag, "integer",
+                              g_strdup_printf ("%" G_GINT64_FORMAT,
+                                               val->get<int64_t> ()));
+        break;
+    case KvpValue::Type::DOUBLE:
+        write_kvp_text_value (w, tag, "double",
+                              double_to_string (val->get<double> ()));
+        break;
+    case KvpValue::Type::NUMERIC:
+        write_kvp_text_value (w, tag, "numeric",
+                              gnc_numeric_to_string (val->get<gnc_numeric> ()));
+        break;
+    case KvpValue::Type::STRING:
+        xml_writer_start (w, tag);
+        xml_writer_attr (w, "type", "string");
+        xml_writer_text (w, val->get<const char*> ());
+        xml_writer_end (w);
+        break;
+    case KvpValue::Type::GUID:
+    {
+        gchar guidstr[GUID_ENCODING_LENGTH + 1];
+        guid_to_string_buff (val->get<GncGUID*> (), guidstr);
+        write_kvp_text_value (w, tag, "guid", g_strdup (guidstr));
+        break;
+    }
+    case KvpValue::Type::TIMESPEC:
+    {
+        auto ts = val->get<Timespec> ();
+        write_timespec (w, tag, "timespec", &ts);
+        break;
+    }
+    case KvpValue::Type::GDATE:
+    {
+        auto d = val->get<GDate> ();
+        write_gdate (w, tag, "gdate", &d);
+        break;
+    }
+    case KvpValue::Type::GLIST:
+        xml_writer_start (w, tag);
+        xml_writer_attr (w, "type", "list");
+        for (auto cursor = val->get<GList*> (); cursor; cursor = cursor->next)
+            write_kvp_value (w, "slot:value",
+                             static_cast<KvpValue*> (cursor->data));
+        xml_writer_end (w);
+        break;
+    case KvpValue::Type::FRAME:
+    {
+        xml_writer_start (w, tag);
+        xml_writer_attr (w, "type", "frame");
+        auto frame = val->get<KvpFrame*> ();
+        if (frame)
+            frame->for_each_slot (write_kvp_slot, static_cast<void*> (w));
+        xml_writer_end (w);
+        break;
+    }
+    default:
+        xml_writer_start (w, tag);
+        xml_writer_end (w);
+        break;
+    }
+}
+
+static void
+write_kvp_slot (const char* key, KvpValue* value, void* data)
+{
+    auto w = static_cast<xml_writer*> (data);
+
+    xml_writer_start (w, "slot");
+    xml_writer_text_element (w, "slot:key", key);
+    write_kvp_value (w, "slot:value", value);
+    xml_writer_end (w);
+}
+
+void
+xml_writer_slots (xml_writer* w, const char* tag, const QofInstance* inst)
+{
+    KvpFrame* frame = qof_instance_get_slots (inst);
+    if (!frame)
+        return;
+
+    xml_writer_start (w, tag);
+    frame->for_each_slot (write_kvp_slot, static_cast<void*> (w));
+    xml_writer_end (w);
+}
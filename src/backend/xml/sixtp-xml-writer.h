@@ -0,0 +1,76 @@
+/********************************************************************
+ * sixtp-xml-writer.h                                               *
+ *                                                                  *
+ * This program is free software; you can redistribute it and/or    *
+ * modify it under the terms of the GNU General Public License as   *
+ * published by the Free Software Foundation; either version 2 of   *
+ * the License, or (at your option) any later version.              *
+ *                                                                  *
+ * This program is distributed in the hope that it will be useful,  *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of   *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the    *
+ * GNU General Public License for more details.                     *
+ *                                                                  *
+ * You should have received a copy of the GNU General Public License*
+ * along with this program; if not, contact:                        *
+ *                                                                  *
+ * Free Software Foundation           Voice:  +1-617-542-5942       *
+ * 51 Franklin Street, Fifth Floor    Fax:    +1-617-542-2652       *
+ * Boston, MA  02110-1301,  USA       gnu@gnu.org                   *
+ *                                                                  *
+ ********************************************************************/
+
+#ifndef SIXTP_XML_WRITER_H
+#define SIXTP_XML_WRITER_H
+
+extern "C"
+{
+#include <glib.h>
+#include <stdio.h>
+
+#include "gnc-commodity.h"
+#include "qof.h"
+}
+
+/* Writes elements straight into a buffer instead of building them as
+ * libxml2 nodes and dumping those.  The output is byte for byte what
+ * xmlElemDump() makes of the equivalent tree from the *_to_dom_tree()
+ * generators in sixtp-dom-generators.h, followed by a newline, so the
+ * two can be mixed in one file.
+ *
+ * An element holds either child elements, which are indented, or a
+ * single piece of text, never both.  Tag and attribute names must be
+ * string literals, as only the pointers are kept.  The buffer is written
+ * to the file whenever it fills up between top-level elements, and by
+ * xml_writer_flush(); flush before writing anything else to the file.
+ */
+typedef struct xml_writer xml_writer;
+
+xml_writer* xml_writer_new (FILE* out);
+/* Flushes w and frees it, returning FALSE if any write failed. */
+gboolean xml_writer_destroy (xml_writer* w);
+gboolean xml_writer_flush (xml_writer* w);
+
+void xml_writer_start (xml_writer* w, const char* tag);
+/* Only between xml_writer_start() and the element's content. */
+void xml_writer_attr (xml_writer* w, const char* name, const char* value);
+/* text gets the same clean-up checked_char_cast() does.  NULL adds
+ * nothing, leaving an empty element; "" adds an empty text. */
+void xml_writer_text (xml_writer* w, const char* text);
+void xml_writer_end (xml_writer* w);
+
+/* The counterparts of xmlNewTextChild() and of the generators. */
+void xml_writer_text_element (xml_writer* w, const char* tag,
+                              const char* text);
+void xml_writer_guid (xml_writer* w, const char* tag, const GncGUID* gid);
+void xml_writer_commodity_ref (xml_writer* w, const char* tag,
+                               const gnc_commodity* c);
+void xml_writer_timespec (xml_writer* w, const char* tag,
+                          const Timespec* spec);
+void xml_writer_gdate (xml_writer* w, const char* tag, const GDate* date);
+void xml_writer_numeric (xml_writer* w, const char* tag,
+                         const gnc_numeric* num);
+void xml_writer_slots (xml_writer* w, const char* tag,
+                       const QofInstance* inst);
+
+#endif /* SIXTP_XML_WRITER_H */
@@ -39,6 +39,9 @@ extern "C"
 #include <glib/gstdio.h>
 
 #include <cashobjects.h>
+#include <Account.h>
+#include <Transaction.h>
+#include <gnc-commodity.h>
 #include <TransLog.h>
 #include <gnc-engine.h>
 #include <gnc-prefs.h>
@@ -77,10 +80,112 @@ remove_locks (const char* filename)
     remove_files_pattern (filename, ".LCK");
 }
 
+static QofSession*
+load_file (const char* filename, gboolean ignore_lock, gint threads)
+{
+    QofSession* session = qof_session_new ();
+
+    gnc_prefs_set_file_load_threads (threads);
+    qof_session_begin (session, filename, ignore_lock, FALSE, TRUE);
+    qof_session_load (session, NULL);
+    gnc_prefs_set_file_load_threads (0);
+    return session;
+}
+
+/* The scrub run on load gives the accounts and splits it creates new
+ * GUIDs, so the two books are matched by account position and by the
+ * GUIDs read from the file. */
+static void
+compare_accounts (Account* serial, Account* pipelined, const char* filename)
+{
+    auto name = gnc_account_get_full_name (serial);
+    auto children = gnc_account_get_children_sorted (serial);
+    auto pipelined_children = gnc_account_get_children_sorted (pipelined);
+
+    do_test_args (g_strcmp0 (xaccAccountGetName (pipelined),
+                             xaccAccountGetName (serial)) == 0 &&
+                  xaccAccountGetType (pipelined) == xaccAccountGetType (serial) &&
+                  gnc_commodity_equal (xaccAccountGetCommodity (pipelined),
+                                       xaccAccountGetCommodity (serial)) &&
+                  g_list_length (xaccAccountGetSplitList (pipelined)) ==
+                  g_list_length (xaccAccountGetSplitList (serial)) &&
+                  gnc_numeric_equal (xaccAccountGetBalance (pipelined),
+                                     xaccAccountGetBalance (serial)) &&
+                  g_list_length (pipelined_children) == g_list_length (children),
+                  "pipelined load accounts", __FILE__, __LINE__,
+                  "account %s of %s", name, filename);
+    for (auto a = children, b = pipelined_children; a && b;
+         a = a->next, b = b->next)
+        compare_accounts (static_cast<Account*> (a->data),
+                          static_cast<Account*> (b->data), filename);
+    g_list_free (children);
+    g_list_free (pipelined_children);
+    g_free (name);
+}
+
+static void
+compare_trans_cb (QofInstance* inst, gpointer data)
+{
+    auto book = static_cast<QofBook*> (data);
+    auto trans = xaccTransLookup (qof_instance_get_guid (inst), book);
+
+    do_test_args (trans && xaccTransEqual (GNC_TRANSACTION (inst), trans,
+                                           FALSE, TRUE, TRUE, TRUE),
+                  "pipelined transaction", __FILE__, __LINE__,
+                  "transaction %s", xaccTransGetDescription (GNC_TRANSACTION (inst)));
+}
+
+/* gnc_price_equal() compares commodities by their per-book namespace. */
+static gboolean
+compare_price_cb (GNCPrice* price, gpointer data)
+{
+    auto book = static_cast<QofBook*> (data);
+    auto other = gnc_price_lookup (qof_instance_get_guid (price), book);
+    Timespec ts1 = gnc_price_get_time (price);
+    Timespec ts2 = other ? gnc_price_get_time (other) : ts1;
+
+    do_test_args (other &&
+                  gnc_commodity_equal (gnc_price_get_commodity (price),
+                                       gnc_price_get_commodity (other)) &&
+                  gnc_commodity_equal (gnc_price_get_currency (price),
+                                       gnc_price_get_currency (other)) &&
+                  timespec_equal (&ts1, &ts2) &&
+                  gnc_price_get_source (price) == gnc_price_get_source (other) &&
+                  g_strcmp0 (gnc_price_get_typestr (price),
+                             gnc_price_get_typestr (other)) == 0 &&
+                  gnc_numeric_eq (gnc_price_get_value (price),
+                                  gnc_price_get_value (other)),
+                  "pipelined load prices", __FILE__, __LINE__,
+                  "price of %s", gnc_commodity_get_mnemonic (gnc_price_get_commodity (price)));
+    return TRUE;
+}
+
+/* The book loaded through the pipeline must be the one parsed serially. */
+static void
+compare_books (QofBook* serial, QofBook* pipelined, const char* filename)
+{
+    do_test_args (gnc_book_count_transactions (serial) ==
+                  gnc_book_count_transactions (pipelined),
+                  "pipelined load transaction count", __FILE__, __LINE__,
+                  "%u serial and %u pipelined transactions in %s",
+                  gnc_book_count_transactions (serial),
+                  gnc_book_count_transactions (pipelined), filename);
+    compare_accounts (gnc_book_get_root_account (serial),
+                      gnc_book_get_root_account (pipelined), filename);
+    do_test_args (gnc_pricedb_get_num_prices (gnc_pricedb_get_db (serial)) ==
+                  gnc_pricedb_get_num_prices (gnc_pricedb_get_db (pipelined)),
+                  "pipelined load price count", __FILE__, __LINE__,
+                  "prices of %s", filename);
+    gnc_pricedb_foreach_price (gnc_pricedb_get_db (serial), compare_price_cb,
+                               pipelined, FALSE);
+    qof_collection_foreach (qof_book_get_collection (serial, GNC_ID_TRANS),
+                            compare_trans_cb, pipelined);
+}
+
 static void
 test_load_file (const char* filename)
 {
-    QofSession* session;
+    QofSession* session, *pipelined;
     QofBook* book;
     Account* root;
     gboolean ignore_lock;
@@ -91,15 +196,12 @@ test_load_file (const char* filename)
     g_log_set_handler (logdomain, loglevel,
                        (GLogFunc)test_checked_handler, &check);
 
-    session = qof_session_new ();
-
     remove_locks (filename);
 
     ignore_lock = (g_strcmp0 (g_getenv ("SRCDIR"), ".") != 0);
     /*    gnc_prefs_set_file_save_compressed(FALSE); */
-    qof_session_begin (session, filename, ignore_lock, FALSE, TRUE);
-
-    qof_session_load (session, NULL);
+    /* Parse the whole file on this thread. */
+    session = load_file (filename, ignore_lock, 1);
     book = qof_session_get_book (session);
 
     root = gnc_book_get_root_account (book);
@@ -110,11 +212,122 @@ test_load_file (const char* filename)
                   "session load xml2", __FILE__, __LINE__,
                   "qof error=%d for file [%s]",
                   qof_session_get_error (session), filename);
+
+    /* And again with its transactions tokenized on three workers,
+     * however many cores this machine has. */
+    pipelined = load_file (filename, TRUE, 4);
+    do_test_args (qof_session_get_error (pipelined) == ERR_BACKEND_NO_ERR,
+                  "session load xml2 pipelined", __FILE__, __LINE__,
+                  "qof error=%d for file [%s]",
+                  qof_session_get_error (pipelined), filename);
+    compare_books (book, qof_session_get_book (pipelined), filename);
+    qof_session_end (pipelined);
+    qof_session_destroy (pipelined);
+
     /* Uncomment the line below to generate corrected files */
     /*    qof_session_save( session, NULL ); */
     qof_session_end (session);
 }
 
+/* Set GNC_XML_PERF_LOAD to a number of transactions to time loading a
+ * book that big serially and through the pipeline. */
+static void
+test_load_perf (void)
+{
+    const char* env = g_getenv ("GNC_XML_PERF_LOAD");
+    QofSession* session, *loaded;
+    QofBook* book;
+    Account* root, *accounts[20];
+    gnc_commodity* currency;
+    gchar* filename;
+    GTimer* timer;
+    double serial_time, pipelined_time;
+    gint num_trans, i, fd;
+
+    if (!env || atoi (env) <= 0)
+        return;
+
+    num_trans = atoi (env);
+    /* Loading a file turns the transaction log back on. */
+    xaccLogDisable ();
+    filename = g_strdup ("test_file_XXXXXX");
+    fd = g_mkstemp (filename);
+    close (fd);
+    /* Saving over an existing file would back it up first. */
+    g_unlink (filename);
+    session = qof_session_new ();
+    qof_session_begin (session, filename, TRUE, TRUE, TRUE);
+    book = qof_session_get_book (session);
+    root = gnc_book_get_root_account (book);
+    currency = gnc_commodity_table_lookup (gnc_commodity_table_get_table (book),
+                                           GNC_COMMODITY_NS_CURRENCY, "USD");
+    for (i = 0; i < (gint)G_N_ELEMENTS (accounts); i++)
+    {
+        auto name = g_strdup_printf ("Account %d", i);
+
+        accounts[i] = xaccMallocAccount (book);
+        xaccAccountBeginEdit (accounts[i]);
+        xaccAccountSetType (accounts[i], ACCT_TYPE_BANK);
+        xaccAccountSetName (accounts[i], name);
+        xaccAccountSetCommodity (accounts[i], currency);
+        gnc_account_append_child (root, accounts[i]);
+        xaccAccountCommitEdit (accounts[i]);
+        g_free (name);
+    }
+    for (i = 0; i < num_trans; i++)
+    {
+        auto trans = xaccMallocTransaction (book);
+        auto split_1 = xaccMallocSplit (book);
+        auto split_2 = xaccMallocSplit (book);
+        auto amount = gnc_numeric_create (i % 10000 + 1, 100);
+
+        xaccTransBeginEdit (trans);
+        xaccTransSetCurrency (trans, currency);
+        xaccTransSetDatePostedSecs (trans, 86400 * (i / 100));
+        xaccTransSetDescription (trans, "Performance test transaction");
+        xaccSplitSetParent (split_1, trans);
+        xaccSplitSetParent (split_2, trans);
+        xaccSplitSetAccount (split_1, accounts[i % G_N_ELEMENTS (accounts)]);
+        xaccSplitSetAccount (split_2,
+                             accounts[(i + 1) % G_N_ELEMENTS (accounts)]);
+        xaccSplitSetAmount (split_1, amount);
+        xaccSplitSetValue (split_1, amount);
+        xaccSplitSetAmount (split_2, gnc_numeric_neg (amount));
+        xaccSplitSetValue (split_2, gnc_numeric_neg (amount));
+        xaccTransCommitEdit (trans);
+    }
+
+    qof_session_save (session, NULL);
+    do_test (qof_session_get_error (session) == ERR_BACKEND_NO_ERR,
+             "xml load perf: write book");
+    qof_session_end (session);
+    qof_session_destroy (session);
+
+    timer = g_timer_new ();
+    loaded = load_file (filename, TRUE, 1);
+    serial_time = g_timer_elapsed (timer, NULL);
+    do_test (gnc_book_count_transactions (qof_session_get_book (loaded)) ==
+             (guint)num_trans, "xml load perf: serial");
+    qof_session_end (loaded);
+    qof_session_destroy (loaded);
+
+    g_timer_start (timer);
+    loaded = load_file (filename, TRUE, 0);
+    pipelined_time = g_timer_elapsed (timer, NULL);
+    do_test (gnc_book_count_transactions (qof_session_get_book (loaded)) ==
+             (guint)num_trans, "xml load perf: pipelined");
+    qof_session_end (loaded);
+    qof_session_destroy (loaded);
+
+    printf ("Loaded %d transactions: serially in %.3fs, "
+            "pipelined in %.3fs\n", num_trans, serial_time, pipelined_time);
+
+    g_timer_destroy (timer);
+    remove_locks (filename);
+    g_unlink (filename);
+    g_free (filename);
+}
+
 int
 main (int argc, char** argv)
 {
@@ -164,6 +377,9 @@ main (int argc, char** argv)
         failure ("handled 0 files in test-load-xml2");
     }
 
+    test_load_perf ();
+    fflush (stdout);
+
     print_test_results ();
     qof_close ();
     exit (get_rv ());
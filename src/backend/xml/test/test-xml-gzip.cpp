@@ -0,0 +1,215 @@
+/********************************************************************\
+ * test-xml-gzip.cpp -- test the parallel gzip writer               *
+ *                                                                  *
+ * This program is free software; you can redistribute it and/or    *
+ * modify it under the terms of the GNU General Public License as   *
+ * published by the Free Software Foundation; either version 2 of   *
+ * the License, or (at your option) any later version.              *
+ *                                                                  *
+ * This program is distributed in the hope that it will be useful,  *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of   *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the    *
+ * GNU General Public License for more details.                     *
+ *                                                                  *
+ * You should have received a copy of the GNU General Public License*
+ * along with this program; if not, contact:                        *
+ *                                                                  *
+ * Free Software Foundation           Voice:  +1-617-542-5942       *
+ * 51 Franklin Street, Fifth Floor    Fax:    +1-617-542-2652       *
+ * Boston, MA  02110-1301,  USA       gnu@gnu.org                   *
+ *                                                                  *
+\********************************************************************/
+extern "C"
+{
+#include "config.h"
+
+#include <glib.h>
+#include <glib/gstdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <zlib.h>
+
+#include "qof.h"
+#include "test-stuff.h"
+}
+
+#include "io-gzip.h"
+
+/* Something that compresses about as well as a book does. */
+static guchar*
+make_data (gsize len)
+{
+    static const char* words[] =
+    {
+        "<trn:split>\n", "  <split:value>", "1234/100", "</split:value>\n",
+        "<ts:date>2016-05-04 10:59:00 +0200</ts:date>\n", "Groceries",
+        "<slot:key>notes</slot:key>", "7f3c0a5e2b914d8e9a6c1d2e3f405162",
+    };
+    GRand* rand = g_rand_new_with_seed (42);
+    guchar* data = static_cast<guchar*> (g_malloc (len + 1));
+    gsize pos = 0;
+
+    while (pos < len)
+    {
+        const char* word = words[g_rand_int_range (rand, 0, G_N_ELEMENTS (words))];
+        gsize n = MIN (strlen (word), len - pos);
+
+        memcpy (data + pos, word, n);
+        pos += n;
+        if (pos < len && g_rand_int_range (rand, 0, 4) == 0)
+            data[pos++] = g_rand_int_range (rand, 0, 256);
+    }
+    g_rand_free (rand);
+    return data;
+}
+
+static gchar*
+write_parallel (const guchar* data, gsize len, gsize chunk, gint level,
+                gint threads)
+{
+    gchar* filename = g_strdup ("test_file_XXXXXX");
+    int fd = g_mkstemp (filename);
+    FILE* out = fdopen (fd, "wb");
+    gz_parallel* gz = gz_parallel_new (out, level, threads);
+    gboolean ok = TRUE;
+    gsize pos;
+
+    for (pos = 0; pos < len; pos += chunk)
+        ok = gz_parallel_write (gz, data + pos, MIN (chunk, len - pos)) && ok;
+    ok = gz_parallel_close (gz) && ok;
+    ok = fclose (out) == 0 && ok;
+
+    do_test_args (ok, "gz_parallel_write", __FILE__, __LINE__,
+                  "%" G_GSIZE_FORMAT " bytes, level %d, %d threads",
+                  len, level, threads);
+    return filename;
+}
+
+static gboolean
+read_matches (const gchar* filename, const guchar* data, gsize len)
+{
+    gzFile file = gzopen (filename, "rb");
+    guchar* back = static_cast<guchar*> (g_malloc (len + 1));
+    gsize got = 0;
+    int n;
+
+    if (!file)
+        return FALSE;
+    /* Ask for one more byte than there should be, to catch trailing junk. */
+    while ((n = gzread (file, back + got, len + 1 - got)) > 0)
+        got += n;
+    gzclose (file);
+
+    n = (got == len && memcmp (back, data, len) == 0);
+    g_free (back);
+    return n;
+}
+
+static void
+test_round_trip (const guchar* data, gsize len, gsize chunk, gint level,
+                 gint threads)
+{
+    gchar* filename = write_parallel (data, len, chunk, level, threads);
+
+    do_test_args (read_matches (filename, data, len), "gz_parallel round trip",
+                  __FILE__, __LINE__,
+                  "%" G_GSIZE_FORMAT " bytes in chunks of %" G_GSIZE_FORMAT
+                  ", level %d, %d threads", len, chunk, level, threads);
+    g_unlink (filename);
+    g_free (filename);
+}
+
+static void
+test_gzip_round_trips (void)
+{
+    static const gsize sizes[] =
+    {
+        0, 1, 1000, 128 * 1024 - 1, 128 * 1024, 128 * 1024 + 1,
+        3 * 128 * 1024 + 17, 5 * 1024 * 1024 + 3
+    };
+    static const gint threads[] = { 1, 2, 4, 0 };
+    static const gint levels[] = { Z_DEFAULT_COMPRESSION, 1, 6, 9 };
+    gsize max = sizes[G_N_ELEMENTS (sizes) - 1];
+    guchar* data = make_data (max);
+    guint i, j;
+
+    for (i = 0; i < G_N_ELEMENTS (sizes); i++)
+        for (j = 0; j < G_N_ELEMENTS (threads); j++)
+            test_round_trip (data, sizes[i], 4096, 6, threads[j]);
+
+    for (i = 0; i < G_N_ELEMENTS (levels); i++)
+        test_round_trip (data, 3 * 128 * 1024 + 17, 65536, levels[i], 4);
+
+    /* Writes that straddle block boundaries. */
+    test_round_trip (data, 300 * 1024, 1, 6, 4);
+    test_round_trip (data, max, max, 6, 4);
+
+    g_free (data);
+}
+
+/* Set GNC_XML_PERF_GZIP to a number of megabytes to compare the
+ * parallel writer with the single stream gzwrite() used before. */
+static void
+test_gzip_perf (void)
+{
+    const char* env = g_getenv ("GNC_XML_PERF_GZIP");
+    gsize len, pos;
+    guchar* data;
+    gchar* filename;
+    GTimer* timer;
+    GStatBuf st;
+    double single_time, parallel_time;
+    goffset single_size;
+    gzFile file;
+    int fd;
+
+    if (!env || atoi (env) <= 0)
+        return;
+
+    len = (gsize) atoi (env) * 1024 * 1024;
+    data = make_data (len);
+
+    filename = g_strdup ("test_file_XXXXXX");
+    fd = g_mkstemp (filename);
+    close (fd);
+    timer = g_timer_new ();
+    file = gzopen (filename, "wb");
+    for (pos = 0; pos < len; pos += 4096)
+        gzwrite (file, data + pos, MIN (4096, len - pos));
+    gzclose (file);
+    single_time = g_timer_elapsed (timer, NULL);
+    g_stat (filename, &st);
+    single_size = st.st_size;
+    g_unlink (filename);
+    g_free (filename);
+
+    g_timer_start (timer);
+    filename = write_parallel (data, len, 4096, 6, 0);
+    parallel_time = g_timer_elapsed (timer, NULL);
+    g_stat (filename, &st);
+    do_test_args (read_matches (filename, data, len), "gz_parallel perf",
+                  __FILE__, __LINE__, "%" G_GSIZE_FORMAT " bytes", len);
+    g_unlink (filename);
+    g_free (filename);
+
+    printf ("Compressed %" G_GSIZE_FORMAT " MB: gzwrite %.3fs to %"
+            G_GOFFSET_FORMAT " bytes, parallel %.3fs to %" G_GOFFSET_FORMAT
+            " bytes\n", len >> 20, single_time, single_size, parallel_time,
+            (goffset) st.st_size);
+
+    g_timer_destroy (timer);
+    g_free (data);
+}
+
+int
+main (int argc, char** argv)
+{
+    qof_log_init ();
+    fflush (stdout);
+    test_gzip_round_trips ();
+    test_gzip_perf ();
+    fflush (stdout);
+    print_test_results ();
+    exit (get_rv ());
+}
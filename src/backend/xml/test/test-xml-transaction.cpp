@@ -371,6 +371,46 @@ test_add_transaction (const char* tag, gpointer globaldata, gpointer data)
     return retval;
 }
 
+static GString*
+read_back (FILE* f)
+{
+    GString* str = g_string_new (NULL);
+    char buf[4096];
+    size_t n;
+
+    rewind (f);
+    while ((n = fread (buf, 1, sizeof (buf), f)) > 0)
+        g_string_append_len (str, buf, n);
+    fclose (f);
+    return str;
+}
+
+/* The file writer streams transactions; it has to produce exactly what
+ * dumping the DOM tree did. */
+static gboolean
+streamed_transaction_matches_dom (xmlNodePtr node, Transaction* trn)
+{
+    FILE* dom_out = tmpfile ();
+    FILE* stream_out = tmpfile ();
+    gboolean written, same;
+
+    xmlElemDump (dom_out, NULL, node);
+    fprintf (dom_out, "\n");
+
+    auto writer = xml_writer_new (stream_out);
+    gnc_transaction_write_xml (writer, trn);
+    written = xml_writer_destroy (writer);
+
+    auto dom_str = read_back (dom_out);
+    auto stream_str = read_back (stream_out);
+    same = written && g_string_equal (dom_str, stream_str);
+    if (!same)
+        printf ("DOM:\n%s\nStreamed:\n%s\n", dom_str->str, stream_str->str);
+    g_string_free (dom_str, TRUE);
+    g_string_free (stream_str, TRUE);
+    return same;
+}
+
 static void
 test_transaction (void)
 {
@@ -442,6 +482,17 @@ test_transaction (void)
             success_args ("transaction_xml", __FILE__, __LINE__, "%d", i);
         }
 
+        if (!streamed_transaction_matches_dom (test_node, ran_trn))
+        {
+            failure_args ("transaction_xml", __FILE__, __LINE__,
+                          "streamed transaction differs from the DOM tree");
+        }
+        else
+        {
+            success_args ("transaction_xml streamed", __FILE__, __LINE__,
+                          "%d", i);
+        }
+
         filename1 = g_strdup_printf ("test_file_XXXXXX");
 
         fd = g_mkstemp (filename1);
@@ -504,6 +555,119 @@ test_transaction (void)
     }
 }
 
+/* Load benchmark: set GNC_XML_PERF_TRANSACTIONS to the number of
+ * transactions to generate, and the book is loaded with both the
+ * streaming transaction parser and the DOM tree path it replaced. */
+static gboolean
+test_count_transaction (const char* tag, gpointer globaldata, gpointer data)
+{
+    int* count = static_cast<decltype (count)> (globaldata);
+
+    (*count)++;
+    really_get_rid_of_transaction ((Transaction*)data);
+    return TRUE;
+}
+
+static gboolean
+test_dom_transaction_end_handler (gpointer data_for_children,
+                                  GSList* data_from_children,
+                                  GSList* sibling_data,
+                                  gpointer parent_data, gpointer global_data,
+                                  gpointer* result, const gchar* tag)
+{
+    xmlNodePtr tree = (xmlNodePtr)data_for_children;
+    gxpf_data* gdata = (gxpf_data*)global_data;
+    Transaction* trn;
+
+    if (parent_data || !tag)
+        return TRUE;
+
+    trn = dom_tree_to_transaction (tree,
+                                   static_cast<QofBook*> (gdata->bookdata));
+    if (trn != NULL)
+        gdata->cb (tag, gdata->parsedata, trn);
+
+    xmlFreeNode (tree);
+    return trn != NULL;
+}
+
+static double
+test_load_transactions (sixtp* parser, const char* filename, int* count)
+{
+    sixtp* top_parser = sixtp_new ();
+    sixtp* main_parser = sixtp_new ();
+    GTimer* timer;
+    double elapsed;
+
+    sixtp_add_some_sub_parsers (top_parser, TRUE, "gnc-v2", main_parser,
+                                NULL, NULL);
+    sixtp_add_some_sub_parsers (main_parser, TRUE, "gnc:transaction", parser,
+                                NULL, NULL);
+
+    *count = 0;
+    timer = g_timer_new ();
+    if (!gnc_xml_parse_file (top_parser, filename, test_count_transaction,
+                             count, book))
+        failure_args ("transaction_load_perf", __FILE__, __LINE__,
+                      "gnc_xml_parse_file returned FALSE");
+    elapsed = g_timer_elapsed (timer, NULL);
+    g_timer_destroy (timer);
+
+    sixtp_destroy (top_parser);
+    return elapsed;
+}
+
+static void
+test_transaction_load_perf (void)
+{
+    const char* env = g_getenv ("GNC_XML_PERF_TRANSACTIONS");
+    int n_trans, stream_count, dom_count, i;
+    double stream_time, dom_time;
+    gchar* filename;
+    FILE* out;
+    int fd;
+
+    if (!env || (n_trans = atoi (env)) <= 0)
+        return;
+
+    get_random_account_tree (book);
+
+    filename = g_strdup ("test_file_XXXXXX");
+    fd = g_mkstemp (filename);
+    out = fdopen (fd, "w");
+    fprintf (out, "<?xml version=\"1.0\"?>\n<gnc-v2>\n");
+    for (i = 0; i < n_trans; i++)
+    {
+        Transaction* ran_trn = get_random_transaction (book);
+        xmlNodePtr node;
+
+        if (!ran_trn)
+            continue;
+        node = gnc_transaction_dom_tree_create (ran_trn);
+        xmlElemDump (out, NULL, node);
+        fprintf (out, "\n");
+        xmlFreeNode (node);
+        really_get_rid_of_transaction (ran_trn);
+    }
+    fprintf (out, "</gnc-v2>\n");
+    fclose (out);
+
+    stream_time = test_load_transactions (gnc_transaction_sixtp_parser_create (),
+                                          filename, &stream_count);
+    dom_time = test_load_transactions (
+        sixtp_dom_parser_new (test_dom_transaction_end_handler, NULL, NULL),
+        filename, &dom_count);
+
+    do_test_args (stream_count == dom_count, "transaction_load_perf",
+                  __FILE__, __LINE__, "streamed %d, DOM %d",
+                  stream_count, dom_count);
+    printf ("Loaded %d transactions: streaming %.3fs, DOM %.3fs\n",
+            stream_count, stream_time, dom_time);
+
+    g_unlink (filename);
+    g_free (filename);
+}
+
 static gboolean
 test_real_transaction (const char* tag, gpointer global_data, gpointer data)
 {
@@ -537,6 +701,7 @@ main (int argc, char** argv)
     else
     {
         test_transaction ();
+        test_transaction_load_perf ();
     }
 
     print_test_results ();
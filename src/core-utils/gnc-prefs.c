@@ -32,6 +32,9 @@ static gchar *namespace_regexp    = NULL;
 static gboolean is_debugging      = FALSE;
 static gboolean extras_enabled    = FALSE;
 static gboolean use_compression   = TRUE; // This is also the default in the prefs backend
+static gint compression_level     = 6;    // This is also the default in the prefs backend
+static gint compression_threads   = 0;    // 0 = one per processor, the default in the prefs backend
+static gint load_threads          = 0;    // 0 = one per processor, the default in the prefs backend
 static gint file_retention_policy = 1;    // 1 = "days", the default in the prefs backend
 static gint file_retention_days   = 30;   // This is also the default in the prefs backend
 
@@ -92,6 +95,42 @@ gnc_prefs_set_file_save_compressed(gboolean compressed)
     use_compression = compressed;
 }
 
+gint
+gnc_prefs_get_file_compression_level(void)
+{
+    return compression_level;
+}
+
+void
+gnc_prefs_set_file_compression_level(gint level)
+{
+    compression_level = level;
+}
+
+gint
+gnc_prefs_get_file_compression_threads(void)
+{
+    return compression_threads;
+}
+
+void
+gnc_prefs_set_file_compression_threads(gint threads)
+{
+    compression_threads = threads;
+}
+
+gint
+gnc_prefs_get_file_load_threads(void)
+{
+    return load_threads;
+}
+
+void
+gnc_prefs_set_file_load_threads(gint threads)
+{
+    load_threads = threads;
+}
+
 gint
 gnc_prefs_get_file_retention_policy(void)
 {
@@ -118,6 +118,11 @@ enum
 \********************************************************************/
 
 static void xaccAccountBringUpToDate (Account *acc);
+static void account_clear_splits (AccountPrivate *priv);
+static void account_set_balance_dirty_from (AccountPrivate *priv, gint pos);
+static void imap_bayes_index_free (struct imap_bayes_index *index);
+static void online_id_index_free (struct online_id_index *index);
+static void open_lot_index_free (struct open_lot_index *index);
 
 
 /********************************************************************\
@@ -272,9 +277,17 @@ gnc_account_init(Account* acc)
     priv->starting_cleared_balance = gnc_numeric_zero();
     priv->starting_reconciled_balance = gnc_numeric_zero();
     priv->balance_dirty = FALSE;
+    priv->balance_dirty_from = 0;
 
     priv->splits = NULL;
     priv->sort_dirty = FALSE;
+    priv->sort_dirty_splits = g_hash_table_new (g_direct_hash, g_direct_equal);
+    priv->sort_dirty_all = FALSE;
+    priv->split_seq = g_sequence_new (NULL);
+    priv->split_index = g_hash_table_new (g_direct_hash, g_direct_equal);
+    priv->imap_bayes = NULL;
+    priv->online_ids = NULL;
+    priv->open_lots = NULL;
 }
 
 static void
@@ -286,6 +299,23 @@ gnc_account_dispose (GObject *acctp)
 static void
 gnc_account_finalize(GObject* acctp)
 {
+    AccountPrivate *priv = GET_PRIVATE(acctp);
+
+    g_list_free (priv->splits);
+    priv->splits = NULL;
+    g_sequence_free (priv->split_seq);
+    priv->split_seq = NULL;
+    g_hash_table_destroy (priv->split_index);
+    priv->split_index = NULL;
+    g_hash_table_destroy (priv->sort_dirty_splits);
+    priv->sort_dirty_splits = NULL;
+    imap_bayes_index_free (priv->imap_bayes);
+    priv->imap_bayes = NULL;
+    online_id_index_free (priv->online_ids);
+    priv->online_ids = NULL;
+    open_lot_index_free (priv->open_lots);
+    priv->open_lots = NULL;
+
     G_OBJECT_CLASS(gnc_account_parent_class)->finalize(acctp);
 }
 
@@ -1221,6 +1251,8 @@ xaccFreeAccount (Account *acc)
         }
         g_list_free (priv->lots);
         priv->lots = NULL;
+        open_lot_index_free (priv->open_lots);
+        priv->open_lots = NULL;
     }
 
     /* Next, clean up the splits */
@@ -1267,7 +1299,9 @@ xaccFreeAccount (Account *acc)
     priv->commodity = NULL;
 
     priv->balance_dirty = FALSE;
+    priv->balance_dirty_from = 0;
     priv->sort_dirty = FALSE;
+    priv->sort_dirty_all = FALSE;
 
     /* qof_instance_release (&acc->inst); */
     g_object_unref(acc);
@@ -1359,8 +1393,7 @@ xaccAccountCommitEdit (Account *acc)
         }
         else
         {
-            g_list_free(priv->splits);
-            priv->splits = NULL;
+            account_clear_splits(priv);
         }
 
         /* It turns out there's a case where this assertion does not hold:
@@ -1385,6 +1418,8 @@ xaccAccountCommitEdit (Account *acc)
         }
         g_list_free(priv->lots);
         priv->lots = NULL;
+        open_lot_index_free (priv->open_lots);
+        priv->open_lots = NULL;
 
         qof_instance_set_dirty(&acc->inst);
         qof_instance_decrease_editlevel(acc);
@@ -1698,6 +1733,8 @@ gnc_account_set_sort_dirty (Account *acc)
 
     priv = GET_PRIVATE(acc);
     priv->sort_dirty = TRUE;
+    priv->sort_dirty_all = TRUE;
+    g_hash_table_remove_all (priv->sort_dirty_splits);
 }
 
 void
@@ -1711,43 +1748,343 @@ gnc_account_set_balance_dirty (Account *acc)
         return;
 
     priv = GET_PRIVATE(acc);
+    account_set_balance_dirty_from (priv, 0);
+}
+
+/* Note that the split s may be out of place.  Once a sizeable
+ * fraction of the account is out of place a full resort is cheaper
+ * than moving the splits one at a time, so stop tracking them. */
+static void
+account_set_split_unsorted (AccountPrivate *priv, Split *s)
+{
+    priv->sort_dirty = TRUE;
+    if (priv->sort_dirty_all)
+        return;
+    g_hash_table_insert (priv->sort_dirty_splits, s, s);
+    if (g_hash_table_size (priv->sort_dirty_splits) > 8 &&
+            g_hash_table_size (priv->sort_dirty_splits) * 8 >
+            (guint)g_sequence_get_length (priv->split_seq))
+    {
+        priv->sort_dirty_all = TRUE;
+        g_hash_table_remove_all (priv->sort_dirty_splits);
+    }
+}
+
+/* The running balances of the splits before pos are still good. */
+static void
+account_set_balance_dirty_from (AccountPrivate *priv, gint pos)
+{
+    if (!priv->balance_dirty || pos < priv->balance_dirty_from)
+        priv->balance_dirty_from = pos;
     priv->balance_dirty = TRUE;
 }
 
+void
+gnc_account_set_split_dirty (Account *acc, Split *s)
+{
+    AccountPrivate *priv;
+    GSequenceIter *iter;
+
+    g_return_if_fail(GNC_IS_ACCOUNT(acc));
+    g_return_if_fail(GNC_IS_SPLIT(s));
+
+    if (qof_instance_get_destroying(acc))
+        return;
+
+    priv = GET_PRIVATE(acc);
+    iter = g_hash_table_lookup (priv->split_index, s);
+    if (!iter)
+    {
+        gnc_account_set_sort_dirty (acc);
+        gnc_account_set_balance_dirty (acc);
+        return;
+    }
+    account_set_split_unsorted (priv, s);
+    account_set_balance_dirty_from (priv, g_sequence_iter_get_position (iter));
+}
+
 /********************************************************************\
 \********************************************************************/
 
+/* GSequence items are the nodes of priv->splits; order them by the
+ * split they hold. */
+static gint
+split_node_order (gconstpointer a, gconstpointer b, gpointer user_data)
+{
+    return xaccSplitOrder (((const GList*)a)->data, ((const GList*)b)->data);
+}
+
+/* Splice the list node held by iter into priv->splits so that the
+ * list follows the sequence order. */
+static void
+account_link_split_node (AccountPrivate *priv, GSequenceIter *iter)
+{
+    GList *node = g_sequence_get (iter);
+    GSequenceIter *next = g_sequence_iter_next (iter);
+
+    if (!g_sequence_iter_is_end (next))
+    {
+        GList *next_node = g_sequence_get (next);
+        node->next = next_node;
+        node->prev = next_node->prev;
+        if (next_node->prev)
+            next_node->prev->next = node;
+        else
+            priv->splits = node;
+        next_node->prev = node;
+    }
+    else if (!g_sequence_iter_is_begin (iter))
+    {
+        GList *prev_node = g_sequence_get (g_sequence_iter_prev (iter));
+        prev_node->next = node;
+        node->prev = prev_node;
+        node->next = NULL;
+    }
+    else
+    {
+        node->prev = node->next = NULL;
+        priv->splits = node;
+    }
+}
+
+/* Rebuild the links of priv->splits from the sequence.  The nodes
+ * themselves are reused, as g_list_sort() would, so a caller holding
+ * a node across a resort still has a valid pointer. */
+static void
+account_relink_splits (AccountPrivate *priv)
+{
+    GSequenceIter *iter = g_sequence_get_begin_iter (priv->split_seq);
+    GList *prev = NULL;
+
+    priv->splits = NULL;
+    for (; !g_sequence_iter_is_end (iter); iter = g_sequence_iter_next (iter))
+    {
+        GList *node = g_sequence_get (iter);
+        node->prev = prev;
+        node->next = NULL;
+        if (prev)
+            prev->next = node;
+        else
+            priv->splits = node;
+        prev = node;
+    }
+}
+
+static void
+account_clear_splits (AccountPrivate *priv)
+{
+    g_hash_table_remove_all (priv->sort_dirty_splits);
+    g_hash_table_remove_all (priv->split_index);
+    g_sequence_remove_range (g_sequence_get_begin_iter (priv->split_seq),
+                             g_sequence_get_end_iter (priv->split_seq));
+    g_list_free (priv->splits);
+    priv->splits = NULL;
+    online_id_index_free (priv->online_ids);
+    priv->online_ids = NULL;
+}
+
+/* The index behind xaccAccountFindSplitByOnlineId().  by_id maps each
+ * online id to a GPtrArray of the splits carrying it and by_split
+ * maps each split back to the key it is filed under, so that it can
+ * be moved when its id or its transaction's id changes. */
+struct online_id_index
+{
+    GHashTable *by_id;
+    GHashTable *by_split;
+};
+
+static struct online_id_index *
+online_id_index_new (void)
+{
+    struct online_id_index *index = g_new0 (struct online_id_index, 1);
+
+    index->by_id = g_hash_table_new_full (g_str_hash, g_str_equal, g_free,
+                                          (GDestroyNotify) g_ptr_array_unref);
+    index->by_split = g_hash_table_new (g_direct_hash, g_direct_equal);
+    return index;
+}
+
+static void
+online_id_index_free (struct online_id_index *index)
+{
+    if (!index)
+        return;
+    g_hash_table_destroy (index->by_split);
+    g_hash_table_destroy (index->by_id);
+    g_free (index);
+}
+
+/* The id an import compares against: the split's own online id if it
+ * has one, the transaction's otherwise.  Returns a newly allocated
+ * string or NULL. */
+static gchar *
+split_dup_online_id (const Split *s)
+{
+    GValue v = G_VALUE_INIT;
+    Transaction *trans;
+    gchar *id = NULL;
+
+    qof_instance_get_kvp (QOF_INSTANCE (s), "online_id", &v);
+    if (G_VALUE_HOLDS_STRING (&v))
+        id = g_value_dup_string (&v);
+    if (G_IS_VALUE (&v))
+        g_value_unset (&v);
+    if (id && *id)
+        return id;
+    g_free (id);
+    id = NULL;
+
+    trans = xaccSplitGetParent (s);
+    if (!trans)
+        return NULL;
+    qof_instance_get_kvp (QOF_INSTANCE (trans), "online_id", &v);
+    if (G_VALUE_HOLDS_STRING (&v))
+        id = g_value_dup_string (&v);
+    if (G_IS_VALUE (&v))
+        g_value_unset (&v);
+    return id;
+}
+
+static void
+online_id_index_add (struct online_id_index *index, Split *s)
+{
+    gchar *id = split_dup_online_id (s);
+    gpointer key, splits;
+
+    if (!id)
+        return;
+    if (g_hash_table_lookup_extended (index->by_id, id, &key, &splits))
+    {
+        g_free (id);
+    }
+    else
+    {
+        key = id;
+        splits = g_ptr_array_new ();
+        g_hash_table_insert (index->by_id, key, splits);
+    }
+    g_ptr_array_add (splits, s);
+    g_hash_table_insert (index->by_split, s, key);
+}
+
+static void
+online_id_index_remove (struct online_id_index *index, Split *s)
+{
+    gpointer key = g_hash_table_lookup (index->by_split, s);
+    GPtrArray *splits;
+
+    if (!key)
+        return;
+    g_hash_table_remove (index->by_split, s);
+    splits = g_hash_table_lookup (index->by_id, key);
+    g_ptr_array_remove_fast (splits, s);
+    if (splits->len == 0)
+        g_hash_table_remove (index->by_id, key);
+}
+
+static struct online_id_index *
+online_id_index_get (Account *acc)
+{
+    AccountPrivate *priv = GET_PRIVATE(acc);
+    GList *node;
+
+    if (priv->online_ids)
+        return priv->online_ids;
+
+    priv->online_ids = online_id_index_new ();
+    for (node = priv->splits; node; node = node->next)
+        online_id_index_add (priv->online_ids, node->data);
+    return priv->online_ids;
+}
+
+void
+gnc_account_online_id_changed (Account *acc, Split *s)
+{
+    AccountPrivate *priv;
+
+    g_return_if_fail(GNC_IS_ACCOUNT(acc));
+    g_return_if_fail(GNC_IS_SPLIT(s));
+
+    priv = GET_PRIVATE(acc);
+    /* Splits still waiting in an open transaction are filed when they
+     * are inserted. */
+    if (!priv->online_ids || !g_hash_table_lookup (priv->split_index, s))
+        return;
+    online_id_index_remove (priv->online_ids, s);
+    online_id_index_add (priv->online_ids, s);
+}
+
+Split *
+xaccAccountFindSplitByOnlineId (Account *acc, const char *online_id,
+                                const Split *exclude)
+{
+    GPtrArray *splits;
+    guint i;
+
+    g_return_val_if_fail(GNC_IS_ACCOUNT(acc), NULL);
+    if (!online_id)
+        return NULL;
+
+    splits = g_hash_table_lookup (online_id_index_get (acc)->by_id, online_id);
+    if (!splits)
+        return NULL;
+
+    for (i = 0; i < splits->len; i++)
+    {
+        Split *s = g_ptr_array_index (splits, i);
+
+        /* Only the transaction's first split in the account speaks
+         * for it. */
+        if (s != exclude &&
+            s == xaccTransFindSplitByAccount (xaccSplitGetParent (s), acc))
+            return s;
+    }
+    return NULL;
+}
+
 gboolean
 gnc_account_insert_split (Account *acc, Split *s)
 {
     AccountPrivate *priv;
+    GSequenceIter *iter;
     GList *node;
 
     g_return_val_if_fail(GNC_IS_ACCOUNT(acc), FALSE);
     g_return_val_if_fail(GNC_IS_SPLIT(s), FALSE);
 
     priv = GET_PRIVATE(acc);
-    node = g_list_find(priv->splits, s);
-    if (node)
+    if (g_hash_table_lookup (priv->split_index, s))
         return FALSE;
 
+    node = g_list_alloc ();
+    node->data = s;
+    /* Outside an edit, place the split now, as balances may be
+     * recomputed before the next sort.  If other splits are out of
+     * place the search may miss, so the next xaccAccountSortSplits()
+     * places this one again. */
     if (qof_instance_get_editlevel(acc) == 0)
     {
-        priv->splits = g_list_insert_sorted(priv->splits, s,
-                                            (GCompareFunc)xaccSplitOrder);
+        iter = g_sequence_insert_sorted (priv->split_seq, node,
+                                         split_node_order, NULL);
+        if (priv->sort_dirty)
+            account_set_split_unsorted (priv, s);
     }
     else
     {
-        priv->splits = g_list_prepend(priv->splits, s);
-        priv->sort_dirty = TRUE;
+        iter = g_sequence_prepend (priv->split_seq, node);
+        account_set_split_unsorted (priv, s);
     }
+    account_link_split_node (priv, iter);
+    g_hash_table_insert (priv->split_index, s, iter);
+    account_set_balance_dirty_from (priv, g_sequence_iter_get_position (iter));
+    if (priv->online_ids)
+        online_id_index_add (priv->online_ids, s);
 
     //FIXME: find better event
     qof_event_gen (&acc->inst, QOF_EVENT_MODIFY, NULL);
     /* Also send an event based on the account */
     qof_event_gen(&acc->inst, GNC_EVENT_ITEM_ADDED, s);
 
-    priv->balance_dirty = TRUE;
 //  DRH: Should the below be added? It is present in the delete path.
 //  xaccAccountRecomputeBalance(acc);
     return TRUE;
@@ -1757,40 +2094,106 @@ gboolean
 gnc_account_remove_split (Account *acc, Split *s)
 {
     AccountPrivate *priv;
+    GSequenceIter *iter;
     GList *node;
 
     g_return_val_if_fail(GNC_IS_ACCOUNT(acc), FALSE);
     g_return_val_if_fail(GNC_IS_SPLIT(s), FALSE);
 
     priv = GET_PRIVATE(acc);
-    node = g_list_find(priv->splits, s);
-    if (NULL == node)
+    iter = g_hash_table_lookup (priv->split_index, s);
+    if (NULL == iter)
         return FALSE;
 
+    node = g_sequence_get (iter);
+    account_set_balance_dirty_from (priv, g_sequence_iter_get_position (iter));
+    g_hash_table_remove (priv->split_index, s);
+    g_hash_table_remove (priv->sort_dirty_splits, s);
+    if (priv->online_ids)
+        online_id_index_remove (priv->online_ids, s);
+    g_sequence_remove (iter);
     priv->splits = g_list_delete_link(priv->splits, node);
     //FIXME: find better event type
     qof_event_gen(&acc->inst, QOF_EVENT_MODIFY, NULL);
     // And send the account-based event, too
     qof_event_gen(&acc->inst, GNC_EVENT_ITEM_REMOVED, s);
 
-    priv->balance_dirty = TRUE;
     xaccAccountRecomputeBalance(acc);
     return TRUE;
 }
 
+/* Move just the splits in sort_dirty_splits to their proper places.
+ * They are all taken out first so that the remaining sequence is
+ * sorted, then inserted again by binary search.  Returns the lowest
+ * position any of them occupied before or after, ahead of which the
+ * order is unchanged. */
+static gint
+account_resort_dirty_splits (AccountPrivate *priv)
+{
+    GHashTableIter hiter;
+    gpointer key;
+    GList *moved = NULL, *node, *next;
+    gint from = G_MAXINT;
+
+    g_hash_table_iter_init (&hiter, priv->sort_dirty_splits);
+    while (g_hash_table_iter_next (&hiter, &key, NULL))
+    {
+        GSequenceIter *iter = g_hash_table_lookup (priv->split_index, key);
+
+        from = MIN(from, g_sequence_iter_get_position (iter));
+        node = g_sequence_get (iter);
+        priv->splits = g_list_remove_link (priv->splits, node);
+        g_sequence_remove (iter);
+        /* Chain the unlinked nodes through their own next pointers. */
+        node->next = moved;
+        moved = node;
+    }
+
+    for (node = moved; node; node = next)
+    {
+        GSequenceIter *iter;
+
+        next = node->next;
+        iter = g_sequence_insert_sorted (priv->split_seq, node,
+                                         split_node_order, NULL);
+        account_link_split_node (priv, iter);
+        g_hash_table_insert (priv->split_index, node->data, iter);
+    }
+
+    g_hash_table_iter_init (&hiter, priv->sort_dirty_splits);
+    while (g_hash_table_iter_next (&hiter, &key, NULL))
+    {
+        GSequenceIter *iter = g_hash_table_lookup (priv->split_index, key);
+        from = MIN(from, g_sequence_iter_get_position (iter));
+    }
+    return from;
+}
+
 void
 xaccAccountSortSplits (Account *acc, gboolean force)
 {
     AccountPrivate *priv;
+    gint from = 0;
 
     g_return_if_fail(GNC_IS_ACCOUNT(acc));
 
     priv = GET_PRIVATE(acc);
     if (!priv->sort_dirty || (!force && qof_instance_get_editlevel(acc) > 0))
         return;
-    priv->splits = g_list_sort(priv->splits, (GCompareFunc)xaccSplitOrder);
+    if (priv->sort_dirty_all ||
+            g_hash_table_size (priv->sort_dirty_splits) == 0)
+    {
+        g_sequence_sort (priv->split_seq, split_node_order, NULL);
+        account_relink_splits (priv);
+    }
+    else
+    {
+        from = account_resort_dirty_splits (priv);
+    }
+    g_hash_table_remove_all (priv->sort_dirty_splits);
     priv->sort_dirty = FALSE;
-    priv->balance_dirty = TRUE;
+    priv->sort_dirty_all = FALSE;
+    account_set_balance_dirty_from (priv, from);
 }
 
 static void
@@ -1899,6 +2302,239 @@ gnc_account_set_policy (Account *acc, GNCPolicy *policy)
 /********************************************************************\
 \********************************************************************/
 
+/* An account's lot as the open lot index sees it.  The ordinal keeps
+ * the order of the account's lot list, later lots getting higher
+ * ones, to settle ties the way walking the list used to. */
+typedef struct
+{
+    GNCLot *lot;
+    guint64 ordinal;
+    gnc_commodity *currency;
+    Timespec opened;
+    gboolean positive;
+    GSequenceIter *iter;        /* NULL unless filed as open */
+} OpenLot;
+
+struct open_lot_index
+{
+    GHashTable *by_lot;         /* GNCLot* -> OpenLot*, every lot */
+    /* Indexed by the opening split being positive: currency ->
+     * GSequence of the OpenLots, earliest first. */
+    GHashTable *open[2];
+    GHashTable *dirty;          /* The lots to refile */
+    guint64 next_ordinal;
+};
+
+static struct open_lot_index *
+open_lot_index_new (void)
+{
+    struct open_lot_index *index = g_new0 (struct open_lot_index, 1);
+
+    index->by_lot = g_hash_table_new_full (g_direct_hash, g_direct_equal,
+                                           NULL, g_free);
+    index->open[FALSE] = g_hash_table_new_full (g_direct_hash, g_direct_equal,
+                                                NULL,
+                                                (GDestroyNotify) g_sequence_free);
+    index->open[TRUE] = g_hash_table_new_full (g_direct_hash, g_direct_equal,
+                                               NULL,
+                                               (GDestroyNotify) g_sequence_free);
+    index->dirty = g_hash_table_new (g_direct_hash, g_direct_equal);
+    return index;
+}
+
+static void
+open_lot_index_free (struct open_lot_index *index)
+{
+    if (!index)
+        return;
+    g_hash_table_destroy (index->dirty);
+    g_hash_table_destroy (index->open[TRUE]);
+    g_hash_table_destroy (index->open[FALSE]);
+    g_hash_table_destroy (index->by_lot);
+    g_free (index);
+}
+
+/* Earliest first, and of lots opened at the same time the one added
+ * to the account last. */
+static gint
+open_lot_order (gconstpointer a, gconstpointer b, gpointer user_data)
+{
+    const OpenLot *la = a, *lb = b;
+    gint cmp = timespec_cmp (&la->opened, &lb->opened);
+
+    if (cmp)
+        return cmp;
+    return la->ordinal < lb->ordinal ? 1 : la->ordinal > lb->ordinal ? -1 : 0;
+}
+
+static void
+open_lot_unfile (struct open_lot_index *index, OpenLot *ol)
+{
+    GSequence *seq;
+
+    if (!ol->iter)
+        return;
+    seq = g_sequence_iter_get_sequence (ol->iter);
+    g_sequence_remove (ol->iter);
+    ol->iter = NULL;
+    if (g_sequence_get_begin_iter (seq) == g_sequence_get_end_iter (seq))
+        g_hash_table_remove (index->open[ol->positive], ol->currency);
+}
+
+/* File the lot under the sign and currency of its opening split if it
+ * is open and its balance still has that sign; lots that are overfull
+ * can't take any more closing splits. */
+static void
+open_lot_refile (struct open_lot_index *index, OpenLot *ol)
+{
+    GSequence *seq;
+    Split *opening;
+    Transaction *trans;
+    gnc_numeric baln;
+
+    open_lot_unfile (index, ol);
+
+    baln = gnc_lot_get_balance (ol->lot);
+    if (gnc_numeric_zero_p (baln))
+        return;
+    opening = gnc_lot_get_earliest_split (ol->lot);
+    if (!opening || gnc_numeric_zero_p (xaccSplitGetAmount (opening)))
+        return;
+    ol->positive = gnc_numeric_positive_p (xaccSplitGetAmount (opening));
+    if (ol->positive != gnc_numeric_positive_p (baln))
+        return;
+
+    trans = xaccSplitGetParent (opening);
+    ol->currency = xaccTransGetCurrency (trans);
+    ol->opened = xaccTransRetDatePostedTS (trans);
+
+    seq = g_hash_table_lookup (index->open[ol->positive], ol->currency);
+    if (!seq)
+    {
+        seq = g_sequence_new (NULL);
+        g_hash_table_insert (index->open[ol->positive], ol->currency, seq);
+    }
+    ol->iter = g_sequence_insert_sorted (seq, ol, open_lot_order, NULL);
+}
+
+static void
+open_lot_index_add (struct open_lot_index *index, GNCLot *lot)
+{
+    OpenLot *ol = g_new0 (OpenLot, 1);
+
+    ol->lot = lot;
+    ol->ordinal = index->next_ordinal++;
+    g_hash_table_insert (index->by_lot, lot, ol);
+    g_hash_table_insert (index->dirty, lot, lot);
+}
+
+static void
+open_lot_index_remove (struct open_lot_index *index, GNCLot *lot)
+{
+    OpenLot *ol = g_hash_table_lookup (index->by_lot, lot);
+
+    if (!ol)
+        return;
+    open_lot_unfile (index, ol);
+    g_hash_table_remove (index->dirty, lot);
+    g_hash_table_remove (index->by_lot, lot);
+}
+
+/* Build the index, or refile the lots that changed since the last
+ * search. */
+static struct open_lot_index *
+open_lot_index_get (Account *acc)
+{
+    AccountPrivate *priv = GET_PRIVATE(acc);
+    GHashTableIter iter;
+    gpointer lot;
+    GList *node;
+
+    if (!priv->open_lots)
+    {
+        priv->open_lots = open_lot_index_new ();
+        /* The lot list is newest first. */
+        for (node = g_list_last (priv->lots); node; node = node->prev)
+            open_lot_index_add (priv->open_lots, node->data);
+    }
+
+    g_hash_table_iter_init (&iter, priv->open_lots->dirty);
+    while (g_hash_table_iter_next (&iter, &lot, NULL))
+    {
+        OpenLot *ol = g_hash_table_lookup (priv->open_lots->by_lot, lot);
+        if (ol)
+            open_lot_refile (priv->open_lots, ol);
+    }
+    g_hash_table_remove_all (priv->open_lots->dirty);
+    return priv->open_lots;
+}
+
+void
+gnc_account_lot_changed (Account *acc, GNCLot *lot)
+{
+    AccountPrivate *priv;
+
+    g_return_if_fail(GNC_IS_ACCOUNT(acc));
+
+    priv = GET_PRIVATE(acc);
+    if (priv->open_lots && g_hash_table_lookup (priv->open_lots->by_lot, lot))
+        g_hash_table_insert (priv->open_lots->dirty, lot, lot);
+}
+
+GNCLot *
+gnc_account_find_open_lot (Account *acc, gnc_numeric sign,
+                           gnc_commodity *currency, gboolean latest)
+{
+    struct open_lot_index *index;
+    GHashTableIter iter;
+    gpointer key, value;
+    OpenLot *best = NULL;
+
+    g_return_val_if_fail(GNC_IS_ACCOUNT(acc), NULL);
+
+    index = open_lot_index_get (acc);
+
+    /* A positive split closes lots that were opened negative. */
+    g_hash_table_iter_init (&iter,
+                            index->open[!gnc_numeric_positive_p (sign)]);
+    while (g_hash_table_iter_next (&iter, &key, &value))
+    {
+        GSequenceIter *it;
+        OpenLot *ol;
+
+        if (currency && !gnc_commodity_equiv (currency, key))
+            continue;
+
+        if (latest)
+        {
+            /* The first of the lots opened last. */
+            it = g_sequence_iter_prev (g_sequence_get_end_iter (value));
+            ol = g_sequence_get (it);
+            while (!g_sequence_iter_is_begin (it))
+            {
+                OpenLot *prev;
+
+                it = g_sequence_iter_prev (it);
+                prev = g_sequence_get (it);
+                if (timespec_cmp (&prev->opened, &ol->opened) != 0)
+                    break;
+                ol = prev;
+            }
+            if (!best || timespec_cmp (&ol->opened, &best->opened) > 0 ||
+                    (timespec_equal (&ol->opened, &best->opened) &&
+                     ol->ordinal > best->ordinal))
+                best = ol;
+        }
+        else
+        {
+            ol = g_sequence_get (g_sequence_get_begin_iter (value));
+            if (!best || open_lot_order (ol, best, NULL) < 0)
+                best = ol;
+        }
+    }
+    return best ? best->lot : NULL;
+}
+
 void
 xaccAccountRemoveLot (Account *acc, GNCLot *lot)
 {
@@ -1912,6 +2548,8 @@ xaccAccountRemoveLot (Account *acc, GNCLot *lot)
 
     ENTER ("(acc=%p, lot=%p)", acc, lot);
     priv->lots = g_list_remove(priv->lots, lot);
+    if (priv->open_lots)
+        open_lot_index_remove (priv->open_lots, lot);
     qof_event_gen (QOF_INSTANCE(lot), QOF_EVENT_REMOVE, NULL);
     qof_event_gen (&acc->inst, QOF_EVENT_MODIFY, NULL);
     LEAVE ("(acc=%p, lot=%p)", acc, lot);
@@ -1941,10 +2579,14 @@ xaccAccountInsertLot (Account *acc, GNCLot *lot)
         old_acc = lot_account;
         opriv = GET_PRIVATE(old_acc);
         opriv->lots = g_list_remove(opriv->lots, lot);
+        if (opriv->open_lots)
+            open_lot_index_remove (opriv->open_lots, lot);
     }
 
     priv = GET_PRIVATE(acc);
     priv->lots = g_list_prepend(priv->lots, lot);
+    if (priv->open_lots)
+        open_lot_index_add (priv->open_lots, lot);
     gnc_lot_set_account(lot, acc);
 
     /* Don't move the splits to the new account.  The caller will do this
@@ -2062,6 +2704,7 @@ xaccAccountRecomputeBalance (Account * acc)
     gnc_numeric  balance;
     gnc_numeric  cleared_balance;
     gnc_numeric  reconciled_balance;
+    GSequenceIter *iter;
     GList *lp;
 
     if (NULL == acc) return;
@@ -2072,13 +2715,30 @@ xaccAccountRecomputeBalance (Account * acc)
     if (qof_instance_get_destroying(acc)) return;
     if (qof_book_shutting_down(qof_instance_get_book(acc))) return;
 
-    balance            = priv->starting_balance;
-    cleared_balance    = priv->starting_cleared_balance;
-    reconciled_balance = priv->starting_reconciled_balance;
+    /* The running balances ahead of balance_dirty_from are still
+     * good, so pick up from the split just before it. */
+    iter = g_sequence_get_iter_at_pos (priv->split_seq,
+                                       priv->balance_dirty_from);
+    if (g_sequence_iter_is_begin (iter))
+    {
+        balance            = priv->starting_balance;
+        cleared_balance    = priv->starting_cleared_balance;
+        reconciled_balance = priv->starting_reconciled_balance;
+        lp = priv->splits;
+    }
+    else
+    {
+        Split *prev = ((GList*)g_sequence_get (g_sequence_iter_prev (iter)))->data;
+        balance            = prev->balance;
+        cleared_balance    = prev->cleared_balance;
+        reconciled_balance = prev->reconciled_balance;
+        lp = g_sequence_iter_is_end (iter) ? NULL : g_sequence_get (iter);
+    }
 
-    PINFO ("acct=%s starting baln=%" G_GINT64_FORMAT "/%" G_GINT64_FORMAT,
-           priv->accountName, balance.num, balance.denom);
-    for (lp = priv->splits; lp; lp = lp->next)
+    PINFO ("acct=%s starting baln=%" G_GINT64_FORMAT "/%" G_GINT64_FORMAT
+           " at split %d", priv->accountName, balance.num, balance.denom,
+           priv->balance_dirty_from);
+    for (; lp; lp = lp->next)
     {
         Split *split = (Split *) lp->data;
         gnc_numeric amt = xaccSplitGetAmount (split);
@@ -2107,6 +2767,7 @@ xaccAccountRecomputeBalance (Account * acc)
     priv->cleared_balance = cleared_balance;
     priv->reconciled_balance = reconciled_balance;
     priv->balance_dirty = FALSE;
+    priv->balance_dirty_from = 0;
 }
 
 /********************************************************************\
@@ -2221,7 +2882,7 @@ xaccAccountSetType (Account *acc, GNCAccountType tip)
 
     xaccAccountBeginEdit(acc);
     priv->type = tip;
-    priv->balance_dirty = TRUE; /* new type may affect balance computation */
+    account_set_balance_dirty_from (priv, 0); /* new type may affect balance computation */
     mark_account(acc);
     xaccAccountCommitEdit(acc);
 }
@@ -2397,7 +3058,7 @@ xaccAccountSetCommodity (Account * acc, gnc_commodity * com)
     }
 
     priv->sort_dirty = TRUE;  /* Not needed. */
-    priv->balance_dirty = TRUE;
+    account_set_balance_dirty_from (priv, 0);
     mark_account (acc);
 
     xaccAccountCommitEdit(acc);
@@ -3175,7 +3836,7 @@ gnc_account_set_start_balance (Account *acc, const gnc_numeric start_baln)
 
     priv = GET_PRIVATE(acc);
     priv->starting_balance = start_baln;
-    priv->balance_dirty = TRUE;
+    account_set_balance_dirty_from (priv, 0);
 }
 
 void
@@ -3188,7 +3849,7 @@ gnc_account_set_start_cleared_balance (Account *acc,
 
     priv = GET_PRIVATE(acc);
     priv->starting_cleared_balance = start_baln;
-    priv->balance_dirty = TRUE;
+    account_set_balance_dirty_from (priv, 0);
 }
 
 void
@@ -3201,7 +3862,7 @@ gnc_account_set_start_reconciled_balance (Account *acc,
 
     priv = GET_PRIVATE(acc);
     priv->starting_reconciled_balance = start_baln;
-    priv->balance_dirty = TRUE;
+    account_set_balance_dirty_from (priv, 0);
 }
 
 gnc_numeric
@@ -3263,76 +3924,95 @@ xaccAccountGetProjectedMinimumBalance (const Account *acc)
 /********************************************************************\
 \********************************************************************/
 
-gnc_numeric
-xaccAccountGetBalanceAsOfDate (Account *acc, time64 date)
+/* Comparison for g_sequence_search() against a posted date.  The date
+ * key is passed both as the item and as user_data so that it can be
+ * told apart from the split nodes; it sorts after every split posted
+ * before it and before every split posted on or after it, so the
+ * search lands on the first split posted at or after the date. */
+static gint
+split_node_posted_cmp (gconstpointer a, gconstpointer b, gpointer user_data)
 {
-    /* Ideally this could use xaccAccountForEachSplit, but
-     * it doesn't exist yet and I'm uncertain of exactly how
-     * it would work at this time, since it differs from
-     * xaccAccountForEachTransaction by using gpointer return
-     * values rather than gints.
-     */
-    AccountPrivate *priv;
-    GList   *lp;
-    Timespec ts, trans_ts;
-    gboolean found = FALSE;
-    gnc_numeric balance;
+    const Timespec *key = user_data;
+    const GList *node;
+    const Split *split;
+    gint sign;
 
-    g_return_val_if_fail(GNC_IS_ACCOUNT(acc), gnc_numeric_zero());
+    if (a == user_data)
+    {
+        node = b;
+        sign = -1;
+    }
+    else
+    {
+        node = a;
+        sign = 1;
+    }
+    split = node->data;
+    /* Splits without a parent sort after everything in xaccSplitOrder. */
+    if (!split->parent)
+        return sign;
+    if (timespec_cmp (&split->parent->date_posted, key) < 0)
+        return -sign;
+    return sign;
+}
+
+/* The account's splits are ordered by posted date first, so the
+ * running balances cached in the splits form a prefix sum over posted
+ * date and a balance as of a date is a binary search on the split
+ * sequence for the last split posted strictly before it.  If no split
+ * is posted on or after the date the account's own balance is current;
+ * if every split is, the balance is zero.
+ */
+static gnc_numeric
+account_balance_as_of_date (Account *acc, time64 date,
+                            gnc_numeric (*split_balance)(const Split*),
+                            xaccGetBalanceFn acc_balance)
+{
+    AccountPrivate *priv;
+    GSequenceIter *iter;
+    GList *node;
+    Timespec ts;
 
     xaccAccountSortSplits (acc, TRUE); /* just in case, normally a noop */
     xaccAccountRecomputeBalance (acc); /* just in case, normally a noop */
 
     priv = GET_PRIVATE(acc);
-    balance = priv->balance;
-
-    /* Since transaction post times are stored as a Timespec,
-     * convert date into a Timespec as well rather than converting
-     * each transaction's Timespec into a time64.
-     *
-     * FIXME: CAS: I think this comment is a bogus justification for
-     * using xaccTransGetDatePostedTS.  There's no benefit to using
-     * Timespec when the input argument is time64, and it's hard to
-     * imagine that casting long long to long and comparing two longs is
-     * worse than comparing two long longs every time.  IMO,
-     * xaccAccountGetPresentBalance gets this right, and its algorithm
-     * should be used here.
-     */
     ts.tv_sec = date;
     ts.tv_nsec = 0;
 
-    lp = priv->splits;
-    while ( lp && !found )
-    {
-        xaccTransGetDatePostedTS( xaccSplitGetParent( (Split *)lp->data ),
-                                  &trans_ts );
-        if ( timespec_cmp( &trans_ts, &ts ) >= 0 )
-            found = TRUE;
-        else
-            lp = lp->next;
-    }
+    iter = g_sequence_search (priv->split_seq, &ts, split_node_posted_cmp, &ts);
+    if (g_sequence_iter_is_end (iter))
+        return acc_balance (acc);
+    if (g_sequence_iter_is_begin (iter))
+        return gnc_numeric_zero();
 
-    if ( lp )
-    {
-        if ( lp->prev )
-        {
-            /* Since lp is now pointing to a split which was past the reconcile
-             * date, get the running balance of the previous split.
-             */
-            balance = xaccSplitGetBalance( (Split *)lp->prev->data );
-        }
-        else
-        {
-            /* AsOf date must be before any entries, return zero. */
-            balance = gnc_numeric_zero();
-        }
-    }
+    node = g_sequence_get (g_sequence_iter_prev (iter));
+    return split_balance ((Split *)node->data);
+}
 
-    /* Otherwise there were no splits posted after the given date,
-     * so the latest account balance should be good enough.
-     */
+gnc_numeric
+xaccAccountGetBalanceAsOfDate (Account *acc, time64 date)
+{
+    g_return_val_if_fail(GNC_IS_ACCOUNT(acc), gnc_numeric_zero());
+    return account_balance_as_of_date (acc, date, xaccSplitGetBalance,
+                                       xaccAccountGetBalance);
+}
+
+gnc_numeric
+xaccAccountGetClearedBalanceAsOfDate (Account *acc, time64 date)
+{
+    g_return_val_if_fail(GNC_IS_ACCOUNT(acc), gnc_numeric_zero());
+    return account_balance_as_of_date (acc, date, xaccSplitGetClearedBalance,
+                                       xaccAccountGetClearedBalance);
+}
 
-    return( balance );
+gnc_numeric
+xaccAccountGetReconciledBalanceAsOfDate (Account *acc, time64 date)
+{
+    g_return_val_if_fail(GNC_IS_ACCOUNT(acc), gnc_numeric_zero());
+    return account_balance_as_of_date (acc, date,
+                                       xaccSplitGetReconciledBalance,
+                                       xaccAccountGetReconciledBalance);
 }
 
 /*
@@ -3708,7 +4388,7 @@ xaccAccountCountSplits (const Account *acc, gboolean include_children)
     nr = 0;
     g_return_val_if_fail(GNC_IS_ACCOUNT(acc), 0);
 
-    nr = g_list_length(xaccAccountGetSplitList(acc));
+    nr = g_sequence_get_length(GET_PRIVATE(acc)->split_seq);
     if (include_children && (gnc_account_n_children(acc) != 0))
     {
         for (i=0; i < gnc_account_n_children(acc); i++)
@@ -5136,122 +5816,204 @@ gnc_account_imap_delete_account (GncImportMatchMap *imap,
 --------------------------------------------------------------------------*/
 
 
-struct account_token_count
+/* The bayes map lives in the account's KVP as
+ * import-map-bayes/<token>/<account guid> = <count>, where accounts
+ * mapped before guids were used are keyed by their full name instead.
+ * Searching it a path at a time is far too slow for a big import, so
+ * the first search turns it into an inverted index that maps each
+ * token to the accounts it was seen with.  Tokens and account keys are
+ * interned in the index's string chunk, and accounts are numbered so
+ * that a token's entries are a small array.
+ */
+struct imap_bayes_index
 {
-    char* account_guid;
-    gint64 token_count; /**< occurances of a given token for this account_guid */
+    GStringChunk *strings;
+    GHashTable *tokens;         /* token -> ImapBayesToken* */
+    GPtrArray *accounts;        /* account number -> account key */
+    GHashTable *account_numbers; /* account key -> account number + 1 */
 };
 
-/** total_count and the token_count for a given account let us calculate the
+typedef struct
+{
+    guint account;
+    gint64 count; /**< occurrences of the token for this account */
+} ImapBayesCount;
+
+/** total_count and the count for a given account let us calculate the
  * probability of a given account with any single token
  */
-struct token_accounts_info
+typedef struct
 {
-    GList *accounts; /**< array of struct account_token_count */
     gint64 total_count;
-};
+    GArray *counts; /**< of ImapBayesCount, one per account */
+} ImapBayesToken;
 
-/** gpointer is a pointer to a struct token_accounts_info
- * \note Can always assume that keys are unique, reduces code in this function
- */
 static void
-buildTokenInfo(const char *key, const GValue *value, gpointer data)
+imap_bayes_token_free (gpointer data)
 {
-    struct token_accounts_info *tokenInfo = (struct token_accounts_info*)data;
-    struct account_token_count* this_account;
+    ImapBayesToken *info = data;
 
-    //  PINFO("buildTokenInfo: account '%s', token_count: '%" G_GINT64_FORMAT "'", (char*)key,
-    //                  g_value_get_int64(value));
-
-    /* add the count to the total_count */
-    tokenInfo->total_count += g_value_get_int64(value);
-
-    /* allocate a new structure for this account and it's token count */
-    this_account = (struct account_token_count*)
-                   g_new0(struct account_token_count, 1);
-
-    /* fill in the account guid and number of tokens found for this account guid */
-    this_account->account_guid = (char*)key;
-    this_account->token_count = g_value_get_int64(value);
-
-    /* append onto the glist a pointer to the new account_token_count structure */
-    tokenInfo->accounts = g_list_prepend(tokenInfo->accounts, this_account);
+    g_array_free (info->counts, TRUE);
+    g_free (info);
 }
 
-/** intermediate values used to calculate the bayes probability of a given account
-  where p(AB) = (a*b)/[a*b + (1-a)(1-b)], product is (a*b),
-  product_difference is (1-a) * (1-b)
- */
-struct account_probability
+static struct imap_bayes_index *
+imap_bayes_index_new (void)
 {
-    double product; /* product of probabilities */
-    double product_difference; /* product of (1-probabilities) */
-};
+    struct imap_bayes_index *index = g_new0 (struct imap_bayes_index, 1);
+
+    index->strings = g_string_chunk_new (4096);
+    index->tokens = g_hash_table_new_full (g_str_hash, g_str_equal, NULL,
+                                           imap_bayes_token_free);
+    index->accounts = g_ptr_array_new ();
+    index->account_numbers = g_hash_table_new (g_str_hash, g_str_equal);
+    return index;
+}
 
-/** convert a hash table of account names and (struct account_probability*)
-  into a hash table of 100000x the percentage match value, ie. 10% would be
-  0.10 * 100000 = 10000
- */
-#define PROBABILITY_FACTOR 100000
 static void
-buildProbabilities(gpointer key, gpointer value, gpointer data)
+imap_bayes_index_free (struct imap_bayes_index *index)
 {
-    GHashTable *final_probabilities = (GHashTable*)data;
-    struct account_probability *account_p = (struct account_probability*)value;
+    if (!index) return;
 
-    /* P(AB) = A*B / [A*B + (1-A)*(1-B)]
-     * NOTE: so we only keep track of a running product(A*B*C...)
-     * and product difference ((1-A)(1-B)...)
-     */
-    gint32 probability =
-        (account_p->product /
-         (account_p->product + account_p->product_difference))
-        * PROBABILITY_FACTOR;
+    g_hash_table_destroy (index->tokens);
+    g_hash_table_destroy (index->account_numbers);
+    g_ptr_array_free (index->accounts, TRUE);
+    g_string_chunk_free (index->strings);
+    g_free (index);
+}
 
-    PINFO("P('%s') = '%d'", (char*)key, probability);
+/* Drop the index after the map was changed in a way it can't follow;
+ * the next search rebuilds it. */
+static void
+imap_bayes_index_invalidate (Account *acc)
+{
+    AccountPrivate *priv = GET_PRIVATE(acc);
 
-    g_hash_table_insert(final_probabilities, key, GINT_TO_POINTER(probability));
+    imap_bayes_index_free (priv->imap_bayes);
+    priv->imap_bayes = NULL;
 }
 
-/** Frees an array of the same time that buildProperties built */
 static void
-freeProbabilities(gpointer key, gpointer value, gpointer data)
+imap_bayes_index_add (struct imap_bayes_index *index, const char *token,
+                      const char *account_key, gint64 count)
 {
-    /* free up the struct account_probability that was allocated
-     * in gnc_account_find_account_bayes()
-     */
-    g_free(value);
+    ImapBayesToken *info = g_hash_table_lookup (index->tokens, token);
+    guint number = GPOINTER_TO_UINT (g_hash_table_lookup (index->account_numbers,
+                                                          account_key));
+    ImapBayesCount *entry;
+    ImapBayesCount new_entry;
+    guint i;
+
+    if (!info)
+    {
+        info = g_new0 (ImapBayesToken, 1);
+        info->counts = g_array_new (FALSE, FALSE, sizeof (ImapBayesCount));
+        g_hash_table_insert (index->tokens,
+                             g_string_chunk_insert_const (index->strings, token),
+                             info);
+    }
+    if (!number)
+    {
+        account_key = g_string_chunk_insert_const (index->strings, account_key);
+        g_ptr_array_add (index->accounts, (gpointer)account_key);
+        number = index->accounts->len;
+        g_hash_table_insert (index->account_numbers, (gpointer)account_key,
+                             GUINT_TO_POINTER (number));
+    }
+
+    info->total_count += count;
+    for (i = 0; i < info->counts->len; i++)
+    {
+        entry = &g_array_index (info->counts, ImapBayesCount, i);
+        if (entry->account == number - 1)
+        {
+            entry->count += count;
+            return;
+        }
+    }
+    new_entry.account = number - 1;
+    new_entry.count = count;
+    g_array_append_val (info->counts, new_entry);
 }
 
-/** holds an account guid and its corresponding integer probability
-  the integer probability is some factor of 10
- */
-struct account_info
+struct imap_bayes_walk
 {
-    char* account_guid;
-    gint32 probability;
+    Account *acc;
+    struct imap_bayes_index *index;
+    const char *path;   /**< the KVP path of the frame being walked */
+    const char *token;  /**< the token that path stands for, if any */
 };
 
-/** Find the highest probability and the corresponding account guid
-    store in data, a (struct account_info*)
-    NOTE: this is a g_hash_table_foreach() function for a hash table of entries
-    key is a  pointer to the account guid, value is a gint32, 100000x
-    the probability for this account
-*/
+/* Tokens may contain '/', which nests them in further frames, so every
+ * frame below import-map-bayes is walked and its int64 slots recorded
+ * against the token the frame's path spells. */
 static void
-highestProbability(gpointer key, gpointer value, gpointer data)
+imap_bayes_index_walk (const char *key, const GValue *value, gpointer data)
 {
-    struct account_info *account_i = (struct account_info*)data;
+    struct imap_bayes_walk *walk = data;
+    struct imap_bayes_walk child;
+    gchar *path, *token;
 
-    /* if the current probability is greater than the stored, store the current */
-    if (GPOINTER_TO_INT(value) > account_i->probability)
+    if (G_VALUE_HOLDS_INT64 (value))
     {
-        /* Save the new highest probability and the assoaciated account guid */
-        account_i->probability = GPOINTER_TO_INT(value);
-        account_i->account_guid = key;
+        if (walk->token)
+            imap_bayes_index_add (walk->index, walk->token, key,
+                                  g_value_get_int64 (value));
+        return;
     }
+    /* Frames come through as NULL strings. */
+    if (!G_VALUE_HOLDS (value, G_TYPE_STRING) || g_value_get_string (value))
+        return;
+
+    path = g_strconcat (walk->path, "/", key, NULL);
+    token = walk->token ? g_strconcat (walk->token, "/", key, NULL)
+                        : g_strdup (key);
+    child = *walk;
+    child.path = path;
+    child.token = token;
+    qof_instance_foreach_slot (QOF_INSTANCE (walk->acc), path,
+                               imap_bayes_index_walk, &child);
+    g_free (token);
+    g_free (path);
+}
+
+static struct imap_bayes_index *
+imap_bayes_index_get (Account *acc)
+{
+    AccountPrivate *priv = GET_PRIVATE(acc);
+    struct imap_bayes_walk walk;
+
+    if (priv->imap_bayes)
+        return priv->imap_bayes;
+
+    walk.acc = acc;
+    walk.index = imap_bayes_index_new ();
+    walk.path = IMAP_FRAME_BAYES;
+    walk.token = NULL;
+    qof_instance_foreach_slot (QOF_INSTANCE (acc), IMAP_FRAME_BAYES,
+                               imap_bayes_index_walk, &walk);
+    PINFO("indexed %u tokens for %u accounts",
+          g_hash_table_size (walk.index->tokens), walk.index->accounts->len);
+
+    priv->imap_bayes = walk.index;
+    return walk.index;
 }
 
+/** intermediate values used to calculate the bayes probability of a given account
+  where p(AB) = (a*b)/[a*b + (1-a)(1-b)], product is (a*b),
+  product_difference is (1-a) * (1-b)
+ */
+struct account_probability
+{
+    gboolean seen;
+    double product; /* product of probabilities */
+    double product_difference; /* product of (1-probabilities) */
+};
+
+/** convert the running probabilities into 100000x the percentage
+  match value, ie. 10% would be 0.10 * 100000 = 10000
+ */
+#define PROBABILITY_FACTOR 100000
 
 #define threshold (.90 * PROBABILITY_FACTOR) /* 90% */
 
@@ -5259,24 +6021,15 @@ highestProbability(gpointer key, gpointer value, gpointer data)
 Account*
 gnc_account_imap_find_account_bayes (GncImportMatchMap *imap, GList *tokens)
 {
-    struct token_accounts_info tokenInfo; /**< holds the accounts and total
-                                           * token count for a single token */
-    GList *current_token;                 /**< pointer to the current
-                                           * token from the input GList
-                                           * tokens */
-    GList *current_account_token;         /**< pointer to the struct
-                                           * account_token_count */
-    struct account_token_count *account_c; /**< an account name and the number
-                                            * of times a token has appeared
-                                            * for the account */
-    struct account_probability *account_p; /**< intermediate storage of values
-                                            * to compute the bayes probability
-                                            * of an account */
-    GHashTable *running_probabilities = g_hash_table_new(g_str_hash,
-                                                         g_str_equal);
-    GHashTable *final_probabilities = g_hash_table_new(g_str_hash,
-                                                       g_str_equal);
-    struct account_info account_i;
+    struct imap_bayes_index *index;
+    struct account_probability *probabilities; /**< intermediate storage of
+                                                * values to compute the bayes
+                                                * probability of each account,
+                                                * by account number */
+    GList *current_token;
+    const char *best_key = NULL;
+    gint32 best_probability = 0;
+    guint i;
 
     ENTER(" ");
 
@@ -5288,135 +6041,97 @@ gnc_account_imap_find_account_bayes (GncImportMatchMap *imap, GList *tokens)
         return NULL;
     }
 
+    index = imap_bayes_index_get (imap->acc);
+    probabilities = g_new0 (struct account_probability, index->accounts->len);
+
     /* find the probability for each account that contains any of the tokens
      * in the input tokens list
      */
     for (current_token = tokens; current_token;
          current_token = current_token->next)
     {
-        char* path = g_strdup_printf (IMAP_FRAME_BAYES "/%s",
-                                            (char*)current_token->data);
-        /* zero out the token_accounts_info structure */
-        memset(&tokenInfo, 0, sizeof(struct token_accounts_info));
+        ImapBayesToken *info;
 
+        if (!current_token->data)
+            continue;
         PINFO("token: '%s'", (char*)current_token->data);
 
-        /* process the accounts for this token, adding the account if it
-         * doesn't already exist or adding to the existing accounts token
-         * count if it does
-         */
-        qof_instance_foreach_slot(QOF_INSTANCE (imap->acc), path,
-                                  buildTokenInfo, &tokenInfo);
-        g_free (path);
-        /* for each account we have just found, see if the account
-         * already exists in the list of account probabilities, if not
-         * add it
-         */
-        for (current_account_token = tokenInfo.accounts; current_account_token;
-                current_account_token = current_account_token->next)
+        info = g_hash_table_lookup (index->tokens, current_token->data);
+        if (!info)
+            continue;
+
+        for (i = 0; i < info->counts->len; i++)
         {
-            /* get the account name and corresponding token count */
-            account_c = (struct account_token_count*)current_account_token->data;
+            ImapBayesCount *entry = &g_array_index (info->counts,
+                                                    ImapBayesCount, i);
+            struct account_probability *account_p =
+                &probabilities[entry->account];
+            double p = (double)entry->count / (double)info->total_count;
 
-            PINFO("account_c->account_guid('%s'), "
-                  "account_c->token_count('%" G_GINT64_FORMAT
+            PINFO("account '%s', token_count('%" G_GINT64_FORMAT
                   "')/total_count('%" G_GINT64_FORMAT "')",
-                  account_c->account_guid, account_c->token_count,
-                  tokenInfo.total_count);
-
-            account_p = g_hash_table_lookup(running_probabilities,
-                                            account_c->account_guid);
+                  (char*)g_ptr_array_index (index->accounts, entry->account),
+                  entry->count, info->total_count);
 
-            /* if the account exists in the list then continue
-             * the running probablities
-             */
-            if (account_p)
+            /* continue the running probabilities of accounts we've
+             * already seen, or start them */
+            if (account_p->seen)
             {
-                account_p->product = (((double)account_c->token_count /
-                                      (double)tokenInfo.total_count)
-                                      * account_p->product);
-                account_p->product_difference =
-                    ((double)1 - ((double)account_c->token_count /
-                                  (double)tokenInfo.total_count))
-                    * account_p->product_difference;
-                PINFO("product == %f, product_difference == %f",
-                      account_p->product, account_p->product_difference);
+                account_p->product *= p;
+                account_p->product_difference *= (double)1 - p;
             }
             else
             {
-                /* add a new entry */
-                PINFO("adding a new entry for this account");
-                account_p = (struct account_probability*)
-                            g_new0(struct account_probability, 1);
-
-                /* set the product and product difference values */
-                account_p->product = ((double)account_c->token_count /
-                                      (double)tokenInfo.total_count);
-                account_p->product_difference =
-                    (double)1 - ((double)account_c->token_count /
-                                 (double)tokenInfo.total_count);
-
-                PINFO("product == %f, product_difference == %f",
-                      account_p->product, account_p->product_difference);
-
-                /* add the account guid and (struct account_probability*)
-                 * to the hash table */
-                g_hash_table_insert(running_probabilities,
-                                    account_c->account_guid, account_p);
+                account_p->seen = TRUE;
+                account_p->product = p;
+                account_p->product_difference = (double)1 - p;
             }
-        } /* for all accounts in tokenInfo */
-
-        /* free the data in tokenInfo */
-        for (current_account_token = tokenInfo.accounts; current_account_token;
-                current_account_token = current_account_token->next)
-        {
-            /* free up each struct account_token_count we allocated */
-            g_free((struct account_token_count*)current_account_token->data);
+            PINFO("product == %f, product_difference == %f",
+                  account_p->product, account_p->product_difference);
         }
-
-        g_list_free(tokenInfo.accounts); /* free the accounts GList */
     }
 
-    /* build a hash table of account names and their final probabilities
-     * from each entry in the running_probabilties hash table
-     */
-    g_hash_table_foreach(running_probabilities, buildProbabilities,
-                         final_probabilities);
+    /* P(AB) = A*B / [A*B + (1-A)*(1-B)]; find the highest. */
+    for (i = 0; i < index->accounts->len; i++)
+    {
+        struct account_probability *account_p = &probabilities[i];
+        gint32 probability;
 
-    /* find the highest probabilty and the corresponding account */
-    memset(&account_i, 0, sizeof(struct account_info));
-    g_hash_table_foreach(final_probabilities, highestProbability, &account_i);
+        if (!account_p->seen)
+            continue;
 
-    /* free each element of the running_probabilities hash */
-    g_hash_table_foreach(running_probabilities, freeProbabilities, NULL);
+        probability = (account_p->product /
+                       (account_p->product + account_p->product_difference))
+                      * PROBABILITY_FACTOR;
+        PINFO("P('%s') = '%d'",
+              (char*)g_ptr_array_index (index->accounts, i), probability);
 
-    /* free the hash tables */
-    g_hash_table_destroy(running_probabilities);
-    g_hash_table_destroy(final_probabilities);
+        if (probability > best_probability)
+        {
+            best_probability = probability;
+            best_key = g_ptr_array_index (index->accounts, i);
+        }
+    }
+    g_free (probabilities);
 
     PINFO("highest P('%s') = '%d'",
-          account_i.account_guid ? account_i.account_guid : "(null)",
-          account_i.probability);
+          best_key ? best_key : "(null)", best_probability);
 
     /* has this probability met our threshold? */
-    if (account_i.probability >= threshold)
+    if (best_probability >= threshold)
     {
-        GncGUID *guid;
+        GncGUID guid;
         Account *account = NULL;
 
         PINFO("Probability has met threshold");
 
-        guid = g_new (GncGUID, 1);
-
-        if (string_to_guid (account_i.account_guid, guid))
-            account = xaccAccountLookup (guid, imap->book);
-
-        g_free (guid);
+        if (string_to_guid (best_key, &guid))
+            account = xaccAccountLookup (&guid, imap->book);
 
         if (account != NULL)
             LEAVE("Return account is '%s'", xaccAccountGetName (account));
         else
-            LEAVE("Return NULL, account for Guid '%s' can not be found", account_i.account_guid);
+            LEAVE("Return NULL, account for Guid '%s' can not be found", best_key);
 
         return account;
     }
@@ -5476,6 +6191,7 @@ gnc_account_imap_add_account_bayes (GncImportMatchMap *imap,
     gint64 token_count;
     char *account_fullname, *kvp_path;
     char *guid_string;
+    struct imap_bayes_index *index;
 
     ENTER(" ");
     if (!imap)
@@ -5487,6 +6203,8 @@ gnc_account_imap_add_account_bayes (GncImportMatchMap *imap,
     g_return_if_fail (acc != NULL);
     account_fullname = gnc_account_get_full_name(acc);
     xaccAccountBeginEdit (imap->acc);
+    /* Keep the index, if there is one yet, in step with the KVP. */
+    index = GET_PRIVATE(imap->acc)->imap_bayes;
 
     PINFO("account name: '%s'", account_fullname);
 
@@ -5515,6 +6233,9 @@ gnc_account_imap_add_account_bayes (GncImportMatchMap *imap,
 
         /* change the imap entry for the account */
         change_imap_entry (imap, kvp_path, token_count);
+        if (index)
+            imap_bayes_index_add (index, current_token->data, guid_string,
+                                  token_count);
 
         g_free (kvp_path);
     }
@@ -5734,6 +6455,7 @@ gnc_account_delete_map_entry (Account *acc, char *full_category, gboolean empty)
     if ((acc != NULL) && qof_instance_has_slot (QOF_INSTANCE(acc), kvp_path))
     {
         xaccAccountBeginEdit (acc);
+        imap_bayes_index_invalidate (acc);
 
         if (empty)
             qof_instance_slot_delete_if_empty (QOF_INSTANCE(acc), kvp_path);
@@ -356,6 +356,17 @@ void gnc_account_set_balance_dirty (Account *acc);
  *  @param acc Set the flag on this account. */
 void gnc_account_set_sort_dirty (Account *acc);
 
+/** Tell the account that the given split has changed in a way that
+ *  may affect its position in the account or the running balances
+ *  from it onwards.  Unlike gnc_account_set_sort_dirty() and
+ *  gnc_account_set_balance_dirty() this lets the account move just
+ *  that split and recompute balances only from it forwards.
+ *
+ *  @param acc The account holding the split.
+ *
+ *  @param s The split that changed. */
+void gnc_account_set_split_dirty (Account *acc, Split *s);
+
 /** Insert the given split from an account.
  *
  *  @param acc The account to which the split should be added.
@@ -550,6 +561,14 @@ gnc_numeric xaccAccountGetProjectedMinimumBalance (const Account *account);
 /** Get the balance of the account as of the date specified */
 gnc_numeric xaccAccountGetBalanceAsOfDate (Account *account,
         time64 date);
+/** Get the balance of the account as of the date specified, only
+    including cleared transactions */
+gnc_numeric xaccAccountGetClearedBalanceAsOfDate (Account *account,
+        time64 date);
+/** Get the balance of the account as of the date specified, only
+    including reconciled transactions */
+gnc_numeric xaccAccountGetReconciledBalanceAsOfDate (Account *account,
+        time64 date);
 
 /* These two functions convert a given balance from one commodity to
    another.  The account argument is only used to get the Book, and
@@ -1044,6 +1063,17 @@ Transaction * xaccAccountFindTransByDesc(const Account *account,
 Split * xaccAccountFindSplitByDesc(const Account *account,
                                    const char *description);
 
+/** Returns a split of the account carrying the given online id, the
+ * split's own or else its transaction's, or NULL if there is none.
+ * Only the first split of each transaction in the account is
+ * considered, and exclude is never returned.  The splits are indexed
+ * by id the first time an account is searched, so that importers can
+ * check each downloaded transaction for a duplicate in constant time.
+ * Returns a pointer to the split, not a copy. */
+Split * xaccAccountFindSplitByOnlineId(Account *account,
+                                       const char *online_id,
+                                       const Split *exclude);
+
 /** @} */
 
 /* ------------------ */
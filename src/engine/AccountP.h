@@ -109,9 +109,47 @@ typedef struct AccountPrivate
     gnc_numeric reconciled_balance;
 
     gboolean balance_dirty;     /* balances in splits incorrect */
+    /* Position of the first split whose running balances are stale;
+     * those of the splits before it are still good.  Only meaningful
+     * while balance_dirty is set, zero otherwise. */
+    gint balance_dirty_from;
 
     GList *splits;              /* list of split pointers */
     gboolean sort_dirty;        /* sort order of splits is bad */
+    /* The splits that may be out of place when sort_dirty is set, so
+     * that only those need to be moved.  If sort_dirty_all is set
+     * instead the whole sequence is resorted. */
+    GHashTable *sort_dirty_splits;
+    gboolean sort_dirty_all;
+
+    /* The splits are also held in a balanced sequence ordered by
+     * xaccSplitOrder(), whose items are the nodes of the splits list
+     * above.  Finding the insertion point is then O(log n) and the
+     * list node can be spliced in place, so the list stays valid for
+     * callers of xaccAccountGetSplitList().  split_index maps each
+     * Split to its GSequenceIter so that membership tests and removal
+     * don't have to walk the list.
+     */
+    GSequence  *split_seq;
+    GHashTable *split_index;
+
+    /* Inverted index of the import-map-bayes slots, from each token
+     * to the accounts it was seen with and how often.  Built from the
+     * KVP data the first time the map is searched; NULL until then or
+     * after the map was changed behind its back. */
+    struct imap_bayes_index *imap_bayes;
+
+    /* The splits by online id, the split's own or else its
+     * transaction's, for the importer's duplicate check.  Built the
+     * first time it is searched and from then on kept up to date as
+     * splits come and go and as their ids are set; NULL until then. */
+    struct online_id_index *online_ids;
+
+    /* The open lots by the sign and currency of their opening split,
+     * each set ordered by opening date, for the FIFO and LIFO lot
+     * finders of cap-gains.c.  Lots that changed are only noted and
+     * refiled at the next search.  NULL until the first search. */
+    struct open_lot_index *open_lots;
 
     LotList   *lots;		/* list of lot pointers */
     GNCPolicy *policy;		/* Cached pointer to policy method */
@@ -135,6 +173,22 @@ void xaccAccountSetGUID (Account *account, const GncGUID *guid);
 /* Register Accounts with the engine */
 gboolean xaccAccountRegister (void);
 
+/* Tell the account that the online id of s, or of its transaction,
+ * may have changed, so that xaccAccountFindSplitByOnlineId() files it
+ * under the new one. */
+void gnc_account_online_id_changed (Account *acc, Split *s);
+
+/* Tell the account that a split of lot was added, removed or changed,
+ * so that the lot may have opened, closed or moved in time. */
+void gnc_account_lot_changed (Account *acc, GNCLot *lot);
+
+/* Returns the open lot of the account opened earliest, or latest if
+ * latest is TRUE, whose balance has the opposite sign of sign and
+ * whose opening transaction is in currency (any if NULL).  Of lots
+ * opened at the same time, the one added to the account last wins. */
+GNCLot *gnc_account_find_open_lot (Account *acc, gnc_numeric sign,
+                                   gnc_commodity *currency, gboolean latest);
+
 /* Structure for accessing static functions for testing */
 typedef struct
 {
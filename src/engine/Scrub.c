@@ -1308,6 +1308,187 @@ xaccAccountTreeScrubQuoteSources (Account *root, gnc_commodity_table *table)
 
 /* ================================================================ */
 
+/* What xaccAccountTreeScrubAfterLoad must do to a transaction. */
+enum
+{
+    SCRUB_TRANS_CURRENCY = 1 << 0,
+    SCRUB_TRANS_SPLITS   = 1 << 1
+};
+
+typedef struct
+{
+    Transaction **trans;
+    guint8 *needs;
+    guint n_trans;
+} ScrubChunk;
+
+/* The tests xaccSplitScrub makes before it changes anything.  Like
+ * scrub_trans_needs, this runs on the worker threads, so it must
+ * neither log nor edit. */
+static gboolean
+scrub_split_needed (const Split *split, const gnc_commodity *currency)
+{
+    gnc_commodity *acc_commodity;
+    int scu;
+
+    if (gnc_numeric_check (split->value) || gnc_numeric_check (split->amount))
+        return TRUE;
+
+    acc_commodity = xaccAccountGetCommodity (split->acc);
+    if (!acc_commodity)
+        return TRUE;
+    if (!gnc_commodity_equiv (acc_commodity, currency))
+        return FALSE;
+
+    scu = MIN (xaccAccountGetCommoditySCU (split->acc),
+               gnc_commodity_get_fraction (currency));
+    return !gnc_numeric_same (split->amount, split->value, scu,
+                              GNC_HOW_RND_ROUND_HALF_UP);
+}
+
+/* The tests xaccTransScrubCurrency and xaccSplitScrub make.  A
+ * transaction whose currency is fixed has all its splits scrubbed
+ * afterwards, so the split tests only matter for the others, whose
+ * currency and accounts the fixes leave alone. */
+static guint8
+scrub_trans_needs (const Transaction *trans)
+{
+    guint8 needs = 0;
+    GList *node;
+
+    if (!gnc_commodity_is_currency (trans->common_currency))
+        needs |= SCRUB_TRANS_CURRENCY;
+
+    for (node = trans->splits; node; node = node->next)
+    {
+        const Split *split = node->data;
+
+        if (!split->acc)
+            needs |= SCRUB_TRANS_CURRENCY;
+        else if (scrub_split_needed (split, trans->common_currency))
+            needs |= SCRUB_TRANS_SPLITS;
+    }
+    return needs;
+}
+
+static void
+scrub_detect_chunk (gpointer data, gpointer user_data)
+{
+    ScrubChunk *chunk = data;
+    guint i;
+
+    for (i = 0; i < chunk->n_trans; i++)
+        chunk->needs[i] = scrub_trans_needs (chunk->trans[i]);
+}
+
+static int
+scrub_collect_trans (Transaction *trans, gpointer data)
+{
+    g_ptr_array_add ((GPtrArray *)data, trans);
+    return 0;
+}
+
+/* Fill needs[] for every transaction, spreading the work over the
+ * spare cores when there are enough transactions to be worth it. */
+static void
+scrub_detect (GPtrArray *trans, guint8 *needs)
+{
+    const guint min_chunk = 4096;
+    GThreadPool *pool = NULL;
+    ScrubChunk *chunks;
+    guint n_chunks = 1, chunk_size, i;
+
+#ifdef HAVE_GLIB_2_36
+    n_chunks = MAX (g_get_num_processors (), 1);
+#endif
+    n_chunks = MIN (n_chunks, trans->len / min_chunk);
+    if (n_chunks > 1)
+        pool = g_thread_pool_new (scrub_detect_chunk, NULL, n_chunks - 1,
+                                  FALSE, NULL);
+    if (!pool)
+        n_chunks = 1;
+
+    chunk_size = (trans->len + n_chunks - 1) / n_chunks;
+    chunks = g_new (ScrubChunk, n_chunks);
+    for (i = 0; i < n_chunks; i++)
+    {
+        guint start = i * chunk_size;
+
+        chunks[i].trans = (Transaction **)trans->pdata + start;
+        chunks[i].needs = needs + start;
+        chunks[i].n_trans = MIN (chunk_size, trans->len - start);
+    }
+
+    /* The calling thread takes the first chunk itself. */
+    for (i = 1; i < n_chunks; i++)
+        g_thread_pool_push (pool, &chunks[i], NULL);
+    scrub_detect_chunk (&chunks[0], NULL);
+    if (pool)
+        g_thread_pool_free (pool, FALSE, TRUE);
+    g_free (chunks);
+}
+
+void
+xaccAccountTreeScrubAfterLoad (Account *root, gnc_commodity_table *table)
+{
+    GPtrArray *trans;
+    guint8 *needs;
+    guint i, n_fixed = 0;
+    GTimer *timer;
+
+    if (!root) return;
+    ENTER ("(root=%p)", root);
+
+    timer = g_timer_new ();
+    xaccAccountTreeScrubQuoteSources (root, table);
+    PINFO ("quote sources: %.3f s", g_timer_elapsed (timer, NULL));
+
+    g_timer_start (timer);
+    trans = g_ptr_array_new ();
+    xaccAccountTreeForEachTransaction (root, scrub_collect_trans, trans);
+    needs = g_new (guint8, MAX (trans->len, 1));
+    scrub_detect (trans, needs);
+    PINFO ("checking %u transactions: %.3f s", trans->len,
+           g_timer_elapsed (timer, NULL));
+
+    /* The fixes go in the order the separate tree scrubs make them:
+     * transaction currencies, then account commodities, then splits. */
+    g_timer_start (timer);
+    for (i = 0; i < trans->len; i++)
+        if (needs[i] & SCRUB_TRANS_CURRENCY)
+            xaccTransScrubCurrency (g_ptr_array_index (trans, i));
+    PINFO ("transaction currencies: %.3f s", g_timer_elapsed (timer, NULL));
+
+    g_timer_start (timer);
+    scrub_account_commodity_helper (root, NULL);
+    gnc_account_foreach_descendant (root, scrub_account_commodity_helper, NULL);
+    PINFO ("account commodities: %.3f s", g_timer_elapsed (timer, NULL));
+
+    g_timer_start (timer);
+    for (i = 0; i < trans->len; i++)
+    {
+        Transaction *t = g_ptr_array_index (trans, i);
+        GList *node;
+
+        if (!needs[i]) continue;
+        n_fixed++;
+        for (node = t->splits; node; node = node->next)
+        {
+            Split *split = node->data;
+            if (split->acc)
+                xaccSplitScrub (split);
+        }
+    }
+    PINFO ("splits: %.3f s", g_timer_elapsed (timer, NULL));
+
+    g_timer_destroy (timer);
+    g_free (needs);
+    g_ptr_array_free (trans, TRUE);
+    LEAVE ("%u transactions fixed", n_fixed);
+}
+
+/* ================================================================ */
+
 void
 xaccAccountScrubKvp (Account *account)
 {
@@ -142,6 +142,20 @@ void xaccAccountTreeScrubCommodities (Account *acc);
  */
 void xaccAccountTreeScrubQuoteSources (Account *root, gnc_commodity_table *table);
 
+/** Run the scrubs a freshly loaded book needs, with the same results as
+ *  xaccAccountTreeScrubQuoteSources(), xaccAccountTreeScrubCommodities()
+ *  and xaccAccountTreeScrubSplits() called in turn.  Rather than a
+ *  separate pass over every transaction and every split for each of
+ *  them, the transactions are checked once, on all available cores, and
+ *  only those with something to fix are changed, one at a time.  The
+ *  time taken by each step is logged at the info level.
+ *
+ *  @param root The root account of the book.
+ *
+ *  @param table The commodity table of the book.
+ */
+void xaccAccountTreeScrubAfterLoad (Account *root, gnc_commodity_table *table);
+
 void xaccAccountScrubKvp (Account *account);
 
 #endif /* XACC_SCRUB_H */
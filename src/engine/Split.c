@@ -296,6 +296,8 @@ gnc_split_set_property(GObject         *object,
         case PROP_ONLINE_ACCOUNT:
             key = "online_id";
             qof_instance_set_kvp (QOF_INSTANCE (split), key, value);
+            if (split->acc)
+                gnc_account_online_id_changed (split->acc, split);
             break;
         case PROP_GAINS_SPLIT:
             key = "gains-split";
@@ -740,7 +742,7 @@ void mark_split (Split *s)
 {
     if (s->acc)
     {
-        g_object_set(s->acc, "sort-dirty", TRUE, "balance-dirty", TRUE, NULL);
+        gnc_account_set_split_dirty(s->acc, s);
     }
 
     /* set dirty flag on lot too. */
@@ -962,6 +964,7 @@ xaccSplitCommitEdit(Split *s)
 {
     Account *acc = NULL;
     Account *orig_acc = NULL;
+    gboolean destroying;
 
     g_return_if_fail(s);
     if (!qof_instance_is_dirty(QOF_INSTANCE(s)))
@@ -1021,13 +1024,17 @@ xaccSplitCommitEdit(Split *s)
        original and new transactions, for the _next_ begin/commit cycle. */
     s->orig_acc = s->acc;
     s->orig_parent = s->parent;
+    /* A destroyed split is freed by the commit, so ask now. */
+    destroying = qof_instance_get_destroying(s);
     if (!qof_commit_edit_part2(QOF_INSTANCE(s), commit_err, NULL,
                                (void (*) (QofInstance *)) xaccFreeSplit))
         return;
 
     if (acc)
     {
-        g_object_set(acc, "sort-dirty", TRUE, "balance-dirty", TRUE, NULL);
+        /* A destroyed split has already been taken out of acc above. */
+        if (!destroying)
+            gnc_account_set_split_dirty(acc, s);
         xaccAccountRecomputeBalance(acc);
     }
 }
@@ -1871,6 +1878,9 @@ xaccSplitSetParent(Split *s, Transaction *t)
         qof_event_gen(&old_trans->inst, GNC_EVENT_ITEM_REMOVED, &ed);
     }
     s->parent = t;
+    /* Without an id of its own the split goes by the transaction's. */
+    if (s->acc)
+        gnc_account_online_id_changed (s->acc, s);
 
     xaccTransCommitEdit(old_trans);
     qof_instance_set_dirty(QOF_INSTANCE(s));
@@ -61,6 +61,7 @@ struct timeval
 #include "gnc-commodity.h"
 #include "gnc-engine.h"
 #include "gnc-lot.h"
+#include "gnc-lot-p.h"
 #include "gnc-event.h"
 #include <gnc-gdate-utils.h>
 #include "SchedXaction.h"
@@ -300,6 +301,21 @@ gnc_transaction_finalize(GObject* txnp)
     G_OBJECT_CLASS(gnc_transaction_parent_class)->finalize(txnp);
 }
 
+/* Splits without an online id of their own go by the transaction's,
+ * so their accounts have to refile them when it changes. */
+static void
+trans_online_id_changed (Transaction *trans)
+{
+    GList *node;
+
+    for (node = trans->splits; node; node = node->next)
+    {
+        Split *s = node->data;
+        if (s->acc)
+            gnc_account_online_id_changed (s->acc, s);
+    }
+}
+
 /* Note that g_value_set_object() refs the object, as does
  * g_object_get(). But g_object_get() only unrefs once when it disgorges
  * the object, leaving an unbalanced ref, which leaks. So instead of
@@ -396,6 +412,7 @@ gnc_transaction_set_property(GObject* object,
     case PROP_ONLINE_ACCOUNT:
 	key = "online_id";
 	qof_instance_set_kvp (QOF_INSTANCE (tx), key, value);
+	trans_online_id_changed (tx);
 	break;
     default:
         G_OBJECT_WARN_INVALID_PROPERTY_ID(object, prop_id, pspec);
@@ -1809,6 +1826,10 @@ xaccTransRollbackEdit (Transaction *trans)
     g_list_free(slist);
     g_list_free(orig->splits);
     orig->splits = NULL;
+    trans_online_id_changed (trans);
+    /* The restored amounts and dates may have opened, closed or moved
+     * the lots of the splits. */
+    FOR_EACH_SPLIT(trans, if (s->lot) gnc_lot_set_closed_unknown (s->lot));
 
     /* Now that the engine copy is back to its original version,
      * get the backend to fix it in the database */
@@ -2879,7 +2900,45 @@ destroy_tx_on_book_close(QofInstance *ent, gpointer data)
     xaccTransDestroy(tx);
 }
 
+static void
+drop_lot_splits_on_book_close(QofInstance *ent, gpointer data)
+{
+    gnc_lot_drop_splits(GNC_LOT(ent));
+}
+
+/* Free a transaction and its splits without the usual commit.  By the
+ * time this runs the accounts are gone and the lots have let go of
+ * the splits, so there is nothing to unlink them from, no balance to
+ * recompute and nobody to tell about each split. */
+static void
+free_tx_on_book_close(QofInstance *ent, gpointer data)
+{
+    Transaction* tx = GNC_TRANSACTION(ent);
+    SplitList *node;
+
+    /* One that is still open is left for its editor to finish. */
+    if (qof_instance_get_editlevel(tx) > 0)
+    {
+        xaccTransDestroy(tx);
+        return;
+    }
+
+    qof_event_gen (&tx->inst, QOF_EVENT_DESTROY, NULL);
+    for (node = tx->splits; node; node = node->next)
+    {
+        Split *s = node->data;
+        if (s && s->parent == tx)
+            xaccFreeSplit(s);
+    }
+    g_list_free (tx->splits);
+    tx->splits = NULL;
+    xaccFreeTransaction (tx);
+}
+
 /** Handles book end - frees all transactions from the book
+ *
+ * When there is no backend to hear about each deletion the splits are
+ * released in bulk rather than being destroyed one at a time.
  *
  * @param book Book being closed
  */
@@ -2889,6 +2948,13 @@ gnc_transaction_book_end(QofBook* book)
     QofCollection *col;
 
     col = qof_book_get_collection(book, GNC_ID_TRANS);
+    if (qof_book_shutting_down(book) && !qof_book_get_backend(book))
+    {
+        qof_collection_foreach(qof_book_get_collection(book, GNC_ID_LOT),
+                               drop_lot_splits_on_book_close, NULL);
+        qof_collection_foreach(col, free_tx_on_book_close, NULL);
+        return;
+    }
     qof_collection_foreach(col, destroy_tx_on_book_close, NULL);
 }
 
@@ -102,91 +102,6 @@ xaccAccountHasTrades (const Account *acc)
 
 /* ============================================================== */
 
-struct find_lot_s
-{
-    GNCLot *lot;
-    gnc_commodity *currency;
-    Timespec ts;
-    int (*numeric_pred)(gnc_numeric);
-    gboolean (*date_pred)(Timespec e, Timespec tr);
-};
-
-static gboolean
-earliest_pred (Timespec earl, Timespec tran)
-{
-    return ((earl.tv_sec > tran.tv_sec)  ||
-            ((earl.tv_sec == tran.tv_sec) && (earl.tv_nsec > tran.tv_nsec)));
-}
-
-static gboolean
-latest_pred (Timespec earl, Timespec tran)
-{
-    return ((earl.tv_sec < tran.tv_sec)  ||
-            ((earl.tv_sec == tran.tv_sec) && (earl.tv_nsec < tran.tv_nsec)));
-}
-
-static gpointer
-finder_helper (GNCLot *lot,  gpointer user_data)
-{
-    struct find_lot_s *els = user_data;
-    Split *s;
-    Transaction *trans;
-    gnc_numeric bal;
-    gboolean opening_is_positive, bal_is_positive;
-
-    if (gnc_lot_is_closed (lot)) return NULL;
-
-    s = gnc_lot_get_earliest_split (lot);
-    if (s == NULL) return NULL;
-
-    /* We want a lot whose balance is of the correct sign.  All splits
-       in a lot must be the opposite sign of the opening split.  We also
-       want to ignore lots that are overfull, i.e., where the balance in
-       the lot is of opposite sign to the opening split in the lot. */
-    if (0 == (els->numeric_pred) (s->amount)) return NULL;
-    bal = gnc_lot_get_balance (lot);
-    opening_is_positive = gnc_numeric_positive_p (s->amount);
-    bal_is_positive = gnc_numeric_positive_p (bal);
-    if (opening_is_positive != bal_is_positive) return NULL;
-
-    trans = s->parent;
-    if (els->currency &&
-            (FALSE == gnc_commodity_equiv (els->currency,
-                                           trans->common_currency)))
-    {
-        return NULL;
-    }
-
-    if (els->date_pred (els->ts, trans->date_posted))
-    {
-        els->ts = trans->date_posted;
-        els->lot = lot;
-    }
-
-    return NULL;
-}
-
-static inline GNCLot *
-xaccAccountFindOpenLot (Account *acc, gnc_numeric sign,
-                        gnc_commodity *currency,
-                        gint64 guess,
-                        gboolean (*date_pred)(Timespec, Timespec))
-{
-    struct find_lot_s es;
-
-    es.lot = NULL;
-    es.currency = currency;
-    es.ts.tv_sec = guess;
-    es.ts.tv_nsec = 0;
-    es.date_pred = date_pred;
-
-    if (gnc_numeric_positive_p(sign)) es.numeric_pred = gnc_numeric_negative_p;
-    else es.numeric_pred = gnc_numeric_positive_p;
-
-    xaccAccountForEachLot (acc, finder_helper, &es);
-    return es.lot;
-}
-
 GNCLot *
 xaccAccountFindEarliestOpenLot (Account *acc, gnc_numeric sign,
                                 gnc_commodity *currency)
@@ -195,8 +110,7 @@ xaccAccountFindEarliestOpenLot (Account *acc, gnc_numeric sign,
     ENTER (" sign=%" G_GINT64_FORMAT "/%" G_GINT64_FORMAT, sign.num,
            sign.denom);
 
-    lot = xaccAccountFindOpenLot (acc, sign, currency,
-                                  G_MAXINT64, earliest_pred);
+    lot = gnc_account_find_open_lot (acc, sign, currency, FALSE);
     LEAVE ("found lot=%p %s baln=%s", lot, gnc_lot_get_title (lot),
            gnc_num_dbg_to_string(gnc_lot_get_balance(lot)));
     return lot;
@@ -210,8 +124,7 @@ xaccAccountFindLatestOpenLot (Account *acc, gnc_numeric sign,
     ENTER (" sign=%" G_GINT64_FORMAT "/%" G_GINT64_FORMAT,
            sign.num, sign.denom);
 
-    lot = xaccAccountFindOpenLot (acc, sign, currency,
-                                  G_MININT64, latest_pred);
+    lot = gnc_account_find_open_lot (acc, sign, currency, TRUE);
     LEAVE ("found lot=%p %s", lot, gnc_lot_get_title (lot));
     return lot;
 }
@@ -42,4 +42,9 @@
 /* Register with the Query engine */
 gboolean gnc_lot_register (void);
 
+/* Forget all of the lot's splits, and its account, without any of the
+ * bookkeeping gnc_lot_remove_split() does.  Only for use while the
+ * book is being closed, just before the splits are freed wholesale. */
+void gnc_lot_drop_splits (GNCLot *lot);
+
 #endif /* GNC_LOT_P_H */
@@ -408,6 +408,8 @@ gnc_lot_set_closed_unknown(GNCLot* lot)
     {
         priv = GET_PRIVATE(lot);
         priv->is_closed = LOT_CLOSED_UNKNOWN;
+        if (priv->account)
+            gnc_account_lot_changed (priv->account, lot);
     }
 }
 
@@ -619,6 +621,8 @@ gnc_lot_add_split (GNCLot *lot, Split *split)
 
     /* for recomputation of is-closed */
     priv->is_closed = LOT_CLOSED_UNKNOWN;
+    if (priv->account)
+        gnc_account_lot_changed (priv->account, lot);
     gnc_lot_commit_edit(lot);
 
     qof_event_gen (QOF_INSTANCE(lot), QOF_EVENT_MODIFY, NULL);
@@ -638,6 +642,8 @@ gnc_lot_remove_split (GNCLot *lot, Split *split)
     priv->splits = g_list_remove (priv->splits, split);
     xaccSplitSetLot(split, NULL);
     priv->is_closed = LOT_CLOSED_UNKNOWN;   /* force an is-closed computation */
+    if (priv->account)
+        gnc_account_lot_changed (priv->account, lot);
 
     if (NULL == priv->splits)
     {
@@ -649,6 +655,24 @@ gnc_lot_remove_split (GNCLot *lot, Split *split)
     LEAVE("removed from lot");
 }
 
+void
+gnc_lot_drop_splits (GNCLot *lot)
+{
+    LotPrivate* priv;
+    GList *node;
+    if (!lot) return;
+    priv = GET_PRIVATE(lot);
+
+    for (node = priv->splits; node; node = node->next)
+    {
+        Split *s = node->data;
+        s->lot = NULL;
+    }
+    g_list_free (priv->splits);
+    priv->splits = NULL;
+    priv->account = NULL;
+}
+
 /* ============================================================== */
 /* Utility function, get earliest split in lot */
 
@@ -57,6 +57,8 @@ struct gnc_price_db_s
     QofInstance inst;              /* globally unique object identifier */
     GHashTable *commodity_hash;
     gboolean bulk_update;		 /* TRUE while reading XML file, etc. */
+    GHashTable *rate_cache;        /* (from, to, date) -> conversion rate */
+    GHashTable *rate_graph;        /* commodity -> commodities priced with it */
 };
 
 struct _GncPriceDBClass
@@ -34,13 +34,17 @@ static QofLogModule log_module = GNC_MOD_PRICE;
 
 static gboolean add_price(GNCPriceDB *db, GNCPrice *p);
 static gboolean remove_price(GNCPriceDB *db, GNCPrice *p, gboolean cleanup);
+static void pricedb_invalidate_rates(GNCPriceDB *db);
+static GPtrArray *pricedb_get_series(GNCPriceDB *db,
+                                     const gnc_commodity *commodity,
+                                     const gnc_commodity *currency);
 static GNCPrice *lookup_nearest_in_time(GNCPriceDB *db, const gnc_commodity *c,
                                         const gnc_commodity *currency,
                                         Timespec t, gboolean sameday);
 static gboolean
-pricedb_pricelist_traversal(GNCPriceDB *db,
-                            gboolean (*f)(GList *p, gpointer user_data),
-                            gpointer user_data);
+pricedb_series_traversal(GNCPriceDB *db,
+                         gboolean (*f)(GPtrArray *p, gpointer user_data),
+                         gpointer user_data);
 
 enum
 {
@@ -566,6 +570,8 @@ gnc_price_set_value(GNCPrice *p, gnc_numeric value)
         p->value = value;
         gnc_price_set_dirty(p);
         gnc_price_commit_edit (p);
+        if (p->db)
+            pricedb_invalidate_rates (p->db);
     }
 }
 
@@ -818,15 +824,147 @@ gnc_price_list_equal(PriceList *prices1, PriceList *prices2)
     return TRUE;
 }
 
+/* ==================================================================== */
+/* price series manipulation functions
+
+   A price series holds the prices of one commodity in one currency in
+   a GPtrArray, in the same order as a PriceList: newest first, by
+   compare_prices_by_date().  Keeping them contiguous lets the lookups
+   bisect a series instead of walking a copy of it.  The series holds
+   a reference to each of its prices.
+ */
+
+/* Return the number of prices in the series that are later than t,
+ * which is also the index of the first one that isn't. */
+static guint
+price_series_bisect (GPtrArray *series, Timespec t)
+{
+    guint low = 0, high = series->len;
+
+    while (low < high)
+    {
+        guint mid = low + (high - low) / 2;
+        Timespec price_t = gnc_price_get_time (g_ptr_array_index (series, mid));
+
+        if (timespec_cmp (&price_t, &t) > 0)
+            low = mid + 1;
+        else
+            high = mid;
+    }
+    return low;
+}
+
+static gboolean
+price_series_has_duplicate (GPtrArray *series, guint index, GNCPrice *p)
+{
+    PriceListIsDuplStruct dupl;
+    Timespec day = timespecCanonicalDayTime (gnc_price_get_time (p));
+    guint i;
+
+    dupl.pPrice = p;
+    dupl.isDupl = FALSE;
+
+    /* The prices of the same day are all next to the slot of p. */
+    for (i = index; i > 0 && !dupl.isDupl; i--)
+    {
+        GNCPrice *other = g_ptr_array_index (series, i - 1);
+        Timespec other_day = timespecCanonicalDayTime (gnc_price_get_time (other));
+        if (!timespec_equal (&other_day, &day))
+            break;
+        price_list_is_duplicate (other, &dupl);
+    }
+    for (i = index; i < series->len && !dupl.isDupl; i++)
+    {
+        GNCPrice *other = g_ptr_array_index (series, i);
+        Timespec other_day = timespecCanonicalDayTime (gnc_price_get_time (other));
+        if (!timespec_equal (&other_day, &day))
+            break;
+        price_list_is_duplicate (other, &dupl);
+    }
+    return dupl.isDupl;
+}
+
+static void
+price_series_insert (GPtrArray *series, GNCPrice *p, gboolean check_dupl)
+{
+    guint low = 0, high = series->len;
+
+    while (low < high)
+    {
+        guint mid = low + (high - low) / 2;
+
+        if (compare_prices_by_date (g_ptr_array_index (series, mid), p) < 0)
+            low = mid + 1;
+        else
+            high = mid;
+    }
+
+    if (check_dupl && price_series_has_duplicate (series, low, p))
+        return;
+
+    gnc_price_ref (p);
+    g_ptr_array_add (series, NULL);
+    memmove (&series->pdata[low + 1], &series->pdata[low],
+             (series->len - low - 1) * sizeof (gpointer));
+    series->pdata[low] = p;
+}
+
+static gboolean
+price_series_remove (GPtrArray *series, GNCPrice *p)
+{
+    Timespec t = gnc_price_get_time (p);
+    guint i;
+
+    /* The price is among those of its time, unless its time was changed
+     * behind our back. */
+    for (i = price_series_bisect (series, t); i < series->len; i++)
+    {
+        GNCPrice *other = g_ptr_array_index (series, i);
+        Timespec other_t = gnc_price_get_time (other);
+        if (other == p || !timespec_equal (&other_t, &t))
+            break;
+    }
+    if (i < series->len && g_ptr_array_index (series, i) == p)
+        g_ptr_array_remove_index (series, i);
+    else if (!g_ptr_array_remove (series, p))
+        return FALSE;
+    gnc_price_unref (p);
+    return TRUE;
+}
+
+static PriceList *
+price_series_to_list (GPtrArray *series)
+{
+    PriceList *result = NULL;
+    guint i;
+
+    for (i = series->len; i > 0; i--)
+        result = g_list_prepend (result, g_ptr_array_index (series, i - 1));
+    return result;
+}
+
+static void
+price_series_destroy (GPtrArray *series)
+{
+    guint i;
+
+    for (i = 0; i < series->len; i++)
+    {
+        GNCPrice *p = g_ptr_array_index (series, i);
+        p->db = NULL;
+        gnc_price_unref (p);
+    }
+    g_ptr_array_free (series, TRUE);
+}
+
 /* ==================================================================== */
 /* GNCPriceDB functions
 
    Structurally a GNCPriceDB contains a hash mapping price commodities
    (of type gnc_commodity*) to hashes mapping price currencies (of
-   type gnc_commodity*) to GNCPrice lists (see gnc-pricedb.h for a
-   description of GNCPrice lists).  The top-level key is the commodity
-   you want the prices for, and the second level key is the commodity
-   that the value is expressed in terms of.
+   type gnc_commodity*) to price series (see above).  The top-level
+   key is the commodity you want the prices for, and the second level
+   key is the commodity that the value is expressed in terms of.
  */
 
 /* GObject Initialization */
@@ -885,18 +1023,7 @@ destroy_pricedb_currency_hash_data(gpointer key,
                                    gpointer data,
                                    gpointer user_data)
 {
-    GList *price_list = (GList *) data;
-    GList *node;
-    GNCPrice *p;
-
-    for (node = price_list; node; node = node->next)
-    {
-        p = node->data;
-
-        p->db = NULL;
-    }
-
-    gnc_price_list_destroy(price_list);
+    price_series_destroy ((GPtrArray *) data);
 }
 
 static void
@@ -924,6 +1051,7 @@ gnc_pricedb_destroy(GNCPriceDB *db)
     }
     g_hash_table_destroy (db->commodity_hash);
     db->commodity_hash = NULL;
+    pricedb_invalidate_rates (db);
     /* qof_instance_release (&db->inst); */
     g_object_unref(db);
 }
@@ -1006,7 +1134,7 @@ pricedb_equal_foreach_pricelist(gpointer key, gpointer val, gpointer user_data)
 {
     GNCPriceDBEqualData *equal_data = user_data;
     gnc_commodity *currency = key;
-    GList *price_list1 = val;
+    GList *price_list1 = price_series_to_list (val);
     GList *price_list2;
 
     price_list2 = gnc_pricedb_get_prices (equal_data->db2,
@@ -1016,6 +1144,7 @@ pricedb_equal_foreach_pricelist(gpointer key, gpointer val, gpointer user_data)
     if (!gnc_price_list_equal (price_list1, price_list2))
         equal_data->equal = FALSE;
 
+    g_list_free (price_list1);
     gnc_price_list_destroy (price_list2);
 }
 
@@ -1065,7 +1194,7 @@ add_price(GNCPriceDB *db, GNCPrice *p)
 {
     /* This function will use p, adding a ref, so treat p as read-only
        if this function succeeds. */
-    GList *price_list;
+    GPtrArray *series;
     gnc_commodity *commodity;
     gnc_commodity *currency;
     GHashTable *currency_hash;
@@ -1126,21 +1255,15 @@ add_price(GNCPriceDB *db, GNCPrice *p)
         g_hash_table_insert(db->commodity_hash, commodity, currency_hash);
     }
 
-    price_list = g_hash_table_lookup(currency_hash, currency);
-    if (!gnc_price_list_insert(&price_list, p, !db->bulk_update))
-    {
-        LEAVE ("gnc_price_list_insert failed");
-        return FALSE;
-    }
-
-    if (!price_list)
+    series = g_hash_table_lookup(currency_hash, currency);
+    if (!series)
     {
-        LEAVE (" no price list");
-        return FALSE;
+        series = g_ptr_array_new();
+        g_hash_table_insert(currency_hash, currency, series);
     }
-
-    g_hash_table_insert(currency_hash, currency, price_list);
+    price_series_insert(series, p, !db->bulk_update);
     p->db = db;
+    pricedb_invalidate_rates(db);
 
     qof_event_gen (&p->inst, QOF_EVENT_ADD, NULL);
 
@@ -1183,6 +1306,246 @@ gnc_pricedb_add_price(GNCPriceDB *db, GNCPrice *p)
     return TRUE;
 }
 
+/* Batch additions append the new prices to their series and sort each
+ * series once afterwards.  added maps each new price to its position in
+ * the batch, counting from 1, so that the later of two otherwise equal
+ * prices wins as it would if they were added one at a time. */
+
+static gint
+compare_series_prices (gconstpointer a, gconstpointer b)
+{
+    return compare_prices_by_date (*(GNCPrice * const *) a,
+                                   *(GNCPrice * const *) b);
+}
+
+static gboolean
+price_takes_precedence (GNCPrice *p, GNCPrice *other, GHashTable *added)
+{
+    if (p->source != other->source)
+        return p->source < other->source;
+    return GPOINTER_TO_UINT (g_hash_table_lookup (added, p)) >
+        GPOINTER_TO_UINT (g_hash_table_lookup (added, other));
+}
+
+static void
+price_series_drop (GNCPrice *p, GHashTable *added)
+{
+    if (!g_hash_table_lookup (added, p))
+    {
+        /* Was in the db before, so have the backend delete it. */
+        gnc_price_begin_edit (p);
+        qof_instance_set_destroying (p, TRUE);
+        gnc_price_commit_edit (p);
+    }
+    g_hash_table_remove (added, p);
+    p->db = NULL;
+    gnc_price_unref (p);
+}
+
+/* Sort the prices of a commodity in a currency and those of the currency
+ * in the commodity, either of which may be NULL, and keep one price per
+ * day across both wherever the batch added one: the one with the best
+ * source, the newest if they are equal. */
+static void
+price_series_merge_batch (GPtrArray *forward, GPtrArray *reverse,
+                          GHashTable *added)
+{
+    GPtrArray *series[2];
+    guint start[2] = {0, 0}, end[2], kept[2] = {0, 0};
+    int i;
+
+    series[0] = forward;
+    series[1] = reverse;
+    for (i = 0; i < 2; i++)
+        if (series[i])
+            g_ptr_array_sort (series[i], compare_series_prices);
+
+    /* Walk the days of both series together, newest first. */
+    while (TRUE)
+    {
+        Timespec day = {0, 0};
+        gboolean has_day = FALSE, has_new = FALSE;
+        GNCPrice *best = NULL;
+        guint j;
+
+        for (i = 0; i < 2; i++)
+        {
+            Timespec head;
+            if (!series[i] || start[i] >= series[i]->len) continue;
+            head = timespecCanonicalDayTime (
+                       gnc_price_get_time (g_ptr_array_index (series[i], start[i])));
+            if (!has_day || timespec_cmp (&head, &day) > 0)
+                day = head;
+            has_day = TRUE;
+        }
+        if (!has_day) break;
+
+        for (i = 0; i < 2; i++)
+        {
+            for (end[i] = start[i]; series[i] && end[i] < series[i]->len; end[i]++)
+            {
+                GNCPrice *p = g_ptr_array_index (series[i], end[i]);
+                Timespec p_day = timespecCanonicalDayTime (gnc_price_get_time (p));
+                if (!timespec_equal (&p_day, &day))
+                    break;
+                if (g_hash_table_lookup (added, p))
+                    has_new = TRUE;
+                if (!best || price_takes_precedence (p, best, added))
+                    best = p;
+            }
+        }
+
+        for (i = 0; i < 2; i++)
+        {
+            for (j = start[i]; j < end[i]; j++)
+            {
+                GNCPrice *p = g_ptr_array_index (series[i], j);
+                if (!has_new || p == best)
+                    series[i]->pdata[kept[i]++] = p;
+                else
+                    price_series_drop (p, added);
+            }
+            start[i] = end[i];
+        }
+    }
+
+    for (i = 0; i < 2; i++)
+        if (series[i])
+            g_ptr_array_set_size (series[i], kept[i]);
+}
+
+/* Forget the series of commodity in currency if a merge emptied it. */
+static void
+pricedb_remove_empty_series (GNCPriceDB *db, gnc_commodity *commodity,
+                             gnc_commodity *currency)
+{
+    GHashTable *currency_hash;
+    GPtrArray *series;
+
+    currency_hash = g_hash_table_lookup (db->commodity_hash, commodity);
+    if (!currency_hash) return;
+    series = g_hash_table_lookup (currency_hash, currency);
+    if (!series || series->len > 0) return;
+
+    g_ptr_array_free (series, TRUE);
+    g_hash_table_remove (currency_hash, currency);
+    if (g_hash_table_size (currency_hash) == 0)
+    {
+        g_hash_table_remove (db->commodity_hash, commodity);
+        g_hash_table_destroy (currency_hash);
+    }
+}
+
+/* The commodity and currency of a series the batch added to. */
+typedef struct
+{
+    gnc_commodity *commodity;
+    gnc_commodity *currency;
+} PriceSeriesPair;
+
+guint
+gnc_pricedb_add_prices(GNCPriceDB *db, PriceList *prices)
+{
+    GHashTable *added, *series_set, *merged;
+    GHashTableIter iter;
+    gpointer series, value;
+    GList *node;
+    guint count = 0;
+
+    if (!db || !prices) return 0;
+    ENTER ("db=%p, %d prices", db, g_list_length (prices));
+
+    added = g_hash_table_new (NULL, NULL);
+    series_set = g_hash_table_new_full (NULL, NULL, NULL, g_free);
+    merged = g_hash_table_new (NULL, NULL);
+
+    qof_event_suspend ();
+    for (node = prices; node; node = node->next)
+    {
+        GNCPrice *p = node->data;
+        GHashTable *currency_hash;
+        GPtrArray *price_series;
+
+        if (!p || p->db == db) continue;
+        if (!qof_instance_books_equal (db, p))
+        {
+            PERR ("attempted to mix up prices across different books");
+            continue;
+        }
+        if (!p->commodity || !p->currency)
+        {
+            PWARN ("no commodity or currency");
+            continue;
+        }
+
+        currency_hash = g_hash_table_lookup (db->commodity_hash, p->commodity);
+        if (!currency_hash)
+        {
+            currency_hash = g_hash_table_new (NULL, NULL);
+            g_hash_table_insert (db->commodity_hash, p->commodity, currency_hash);
+        }
+        price_series = g_hash_table_lookup (currency_hash, p->currency);
+        if (!price_series)
+        {
+            price_series = g_ptr_array_new ();
+            g_hash_table_insert (currency_hash, p->currency, price_series);
+        }
+
+        gnc_price_ref (p);
+        g_ptr_array_add (price_series, p);
+        p->db = db;
+        g_hash_table_insert (added, p, GUINT_TO_POINTER (++count));
+        if (!g_hash_table_lookup (series_set, price_series))
+        {
+            PriceSeriesPair *pair = g_new (PriceSeriesPair, 1);
+            pair->commodity = p->commodity;
+            pair->currency = p->currency;
+            g_hash_table_insert (series_set, price_series, pair);
+        }
+    }
+
+    /* A day's price in one direction stands for the other direction
+     * too, so each series is merged together with its reverse. */
+    g_hash_table_iter_init (&iter, series_set);
+    while (g_hash_table_iter_next (&iter, &series, &value))
+    {
+        PriceSeriesPair *pair = value;
+        GPtrArray *reverse;
+
+        if (g_hash_table_lookup (merged, series)) continue;
+        reverse = pricedb_get_series (db, pair->currency, pair->commodity);
+        price_series_merge_batch (series, reverse, added);
+        g_hash_table_insert (merged, series, series);
+        if (reverse)
+            g_hash_table_insert (merged, reverse, reverse);
+    }
+    g_hash_table_iter_init (&iter, series_set);
+    while (g_hash_table_iter_next (&iter, NULL, &value))
+    {
+        PriceSeriesPair *pair = value;
+        pricedb_remove_empty_series (db, pair->commodity, pair->currency);
+        pricedb_remove_empty_series (db, pair->currency, pair->commodity);
+    }
+    pricedb_invalidate_rates (db);
+    qof_event_resume ();
+
+    /* What the merges left of the batch */
+    count = g_hash_table_size (added);
+    if (count)
+    {
+        gnc_pricedb_begin_edit (db);
+        qof_instance_set_dirty (&db->inst);
+        gnc_pricedb_commit_edit (db);
+        qof_event_gen (&db->inst, QOF_EVENT_MODIFY, NULL);
+    }
+
+    g_hash_table_destroy (merged);
+    g_hash_table_destroy (series_set);
+    g_hash_table_destroy (added);
+    LEAVE ("db=%p, %u prices added", db, count);
+    return count;
+}
+
 /* remove_price() is a utility; its only function is to remove the price
  * from the double-hash tables.
  */
@@ -1190,7 +1553,7 @@ gnc_pricedb_add_price(GNCPriceDB *db, GNCPrice *p)
 static gboolean
 remove_price(GNCPriceDB *db, GNCPrice *p, gboolean cleanup)
 {
-    GList *price_list;
+    GPtrArray *series;
     gnc_commodity *commodity;
     gnc_commodity *currency;
     GHashTable *currency_hash;
@@ -1226,23 +1589,21 @@ remove_price(GNCPriceDB *db, GNCPrice *p, gboolean cleanup)
     }
 
     qof_event_gen (&p->inst, QOF_EVENT_REMOVE, NULL);
-    price_list = g_hash_table_lookup(currency_hash, currency);
+    series = g_hash_table_lookup(currency_hash, currency);
     gnc_price_ref(p);
-    if (!gnc_price_list_remove(&price_list, p))
+    if (!series || !price_series_remove(series, p))
     {
         gnc_price_unref(p);
-        LEAVE (" cannot remove price list");
+        LEAVE (" cannot remove price from its series");
         return FALSE;
     }
+    pricedb_invalidate_rates(db);
 
-    /* if the price list is empty, then remove this currency from the
+    /* if the price series is empty, then remove this currency from the
        commodity hash */
-    if (price_list)
-    {
-        g_hash_table_insert(currency_hash, currency, price_list);
-    }
-    else
+    if (series->len == 0)
     {
+        g_ptr_array_free(series, TRUE);
         g_hash_table_remove(currency_hash, currency);
 
         if (cleanup)
@@ -1338,18 +1699,16 @@ pricedb_remove_foreach_pricelist (gpointer key,
                                   gpointer val,
                                   gpointer user_data)
 {
-    GList *price_list = (GList *) val;
-    GList *node = price_list;
+    GPtrArray *series = (GPtrArray *) val;
     remove_info *data = (remove_info *) user_data;
+    guint i;
 
     ENTER("key %p, value %p, data %p", key, val, user_data);
 
-    /* The most recent price is the first in the list */
-    if (!data->delete_last)
-        node = g_list_next(node);
-
-    /* now check each item in the list */
-    g_list_foreach(node, (GFunc)check_one_price_date, data);
+    /* The most recent price is the first in the series; now check each
+       item in the series */
+    for (i = data->delete_last ? 0 : 1; i < series->len; i++)
+        check_one_price_date (g_ptr_array_index (series, i), data);
 
     LEAVE(" ");
 }
@@ -1419,30 +1778,33 @@ static void
 hash_values_helper(gpointer key, gpointer value, gpointer data)
 {
     GList ** l = data;
+    GList *price_list = price_series_to_list (value);
     if (*l)
     {
         GList *new_l;
-        new_l = pricedb_price_list_merge(*l, value);
+        new_l = pricedb_price_list_merge(*l, price_list);
         g_list_free (*l);
+        g_list_free (price_list);
         *l = new_l;
     }
     else
-        *l = g_list_copy (value);
+        *l = price_list;
 }
 
 static PriceList *
 price_list_from_hashtable (GHashTable *hash, const gnc_commodity *currency)
 {
-    GList *price_list = NULL, *result = NULL ;
+    GPtrArray *series;
+    GList *result = NULL ;
     if (currency)
     {
-        price_list = g_hash_table_lookup(hash, currency);
-        if (!price_list)
+        series = g_hash_table_lookup(hash, currency);
+        if (!series)
         {
             LEAVE (" no price list");
             return NULL;
         }
-        result = g_list_copy (price_list);
+        result = price_series_to_list (series);
     }
     else
     {
@@ -1531,26 +1893,80 @@ pricedb_get_prices_internal(GNCPriceDB *db, const gnc_commodity *commodity,
     return forward_list;
 }
 
+static GPtrArray *
+pricedb_get_series (GNCPriceDB *db, const gnc_commodity *commodity,
+                    const gnc_commodity *currency)
+{
+    GHashTable *currency_hash;
+
+    currency_hash = g_hash_table_lookup(db->commodity_hash, commodity);
+    if (!currency_hash)
+        return NULL;
+    return g_hash_table_lookup(currency_hash, currency);
+}
+
+/* Find the prices on either side of t among the prices of commodity in
+ * currency and of currency in commodity, as though both series were
+ * merged into one list: *later is set to the last price later than t
+ * and *not_later to the first one that isn't, or to NULL if there is
+ * no such price.  Nothing is copied; each series is bisected. */
+static void
+pricedb_find_around (GNCPriceDB *db, const gnc_commodity *commodity,
+                     const gnc_commodity *currency, Timespec t,
+                     GNCPrice **later, GNCPrice **not_later)
+{
+    GPtrArray *series[2];
+    int i;
+
+    series[0] = pricedb_get_series (db, commodity, currency);
+    series[1] = pricedb_get_series (db, currency, commodity);
+    *later = *not_later = NULL;
+
+    for (i = 0; i < 2; i++)
+    {
+        guint index;
+
+        if (!series[i]) continue;
+        index = price_series_bisect (series[i], t);
+        if (index > 0)
+        {
+            GNCPrice *p = g_ptr_array_index (series[i], index - 1);
+            if (!*later || compare_prices_by_date (*later, p) < 0)
+                *later = p;
+        }
+        if (index < series[i]->len)
+        {
+            GNCPrice *p = g_ptr_array_index (series[i], index);
+            if (!*not_later || compare_prices_by_date (p, *not_later) < 0)
+                *not_later = p;
+        }
+    }
+}
+
 GNCPrice *
 gnc_pricedb_lookup_latest(GNCPriceDB *db,
                           const gnc_commodity *commodity,
                           const gnc_commodity *currency)
 {
-    GList *price_list;
-    GNCPrice *result;
-    GHashTable *currency_hash;
+    GPtrArray *series, *reverse;
+    GNCPrice *result = NULL;
 
     if (!db || !commodity || !currency) return NULL;
     ENTER ("db=%p commodity=%p currency=%p", db, commodity, currency);
 
-    price_list = pricedb_get_prices_internal(db, commodity, currency, TRUE);
-    if (!price_list) return NULL;
+    series = pricedb_get_series (db, commodity, currency);
+    reverse = pricedb_get_series (db, currency, commodity);
     /* This works magically because prices are inserted in date-sorted
      * order, and the latest date always comes first. So return the
-     * first in the list.  */
-    result = price_list->data;
+     * first of either series.  */
+    if (series)
+        result = g_ptr_array_index (series, 0);
+    if (reverse && (!result ||
+                    compare_prices_by_date (g_ptr_array_index (reverse, 0),
+                                            result) < 0))
+        result = g_ptr_array_index (reverse, 0);
+    if (!result) return NULL;
     gnc_price_ref(result);
-    g_list_free (price_list);
     LEAVE(" ");
     return result;
 }
@@ -1560,13 +1976,13 @@ static void
 lookup_latest(gpointer key, gpointer val, gpointer user_data)
 {
     //gnc_commodity *currency = (gnc_commodity *)key;
-    GList *price_list = (GList *)val;
+    GPtrArray *series = (GPtrArray *)val;
     GList **return_list = (GList **)user_data;
 
-    if (!price_list) return;
+    if (!series || series->len == 0) return;
 
-    /* the latest price is the first in list */
-    gnc_price_list_insert(return_list, price_list->data, FALSE);
+    /* the latest price is the first in the series */
+    gnc_price_list_insert(return_list, g_ptr_array_index(series, 0), FALSE);
 }
 
 typedef struct
@@ -1576,65 +1992,67 @@ typedef struct
     Timespec t;
 } UsesCommodity;
 
-/* price_list_scan_any_currency is the helper function used with
- * pricedb_pricelist_traversal by the "any_currency" price lookup functions. It
+/* price_series_scan_any_currency is the helper function used with
+ * pricedb_series_traversal by the "any_currency" price lookup functions. It
  * builds a list of prices that are either to or from the commodity "com".
  * The resulting list will include the last price newer than "t" and the first
- * price older than "t".  All other prices will be ignored.  Since in the most
- * common cases we will be looking for recent prices which are at the front of
- * the various price lists, this is considerably faster than concatenating all
- * the relevant price lists and sorting the result.
+ * price older than "t".  All other prices will be ignored.  Since each series
+ * is bisected, this is considerably faster than concatenating all the
+ * relevant price lists and sorting the result.
 */
 
 static gboolean
-price_list_scan_any_currency(GList *price_list, gpointer data)
+price_series_scan_any_currency(GPtrArray *series, gpointer data)
 {
     UsesCommodity *helper = (UsesCommodity*)data;
-    GList *node = price_list;
+    GNCPrice *price;
     gnc_commodity *com;
     gnc_commodity *cur;
+    guint index;
 
-    if (!price_list)
+    if (!series || series->len == 0)
         return TRUE;
 
-    com = gnc_price_get_commodity(node->data);
-    cur = gnc_price_get_currency(node->data);
+    price = g_ptr_array_index(series, 0);
+    com = gnc_price_get_commodity(price);
+    cur = gnc_price_get_currency(price);
 
-    /* if this price list isn't for the commodity we are interested in,
+    /* if this price series isn't for the commodity we are interested in,
        ignore it. */
     if (com != helper->com && cur != helper->com)
         return TRUE;
 
-    /* The price list is sorted in decreasing order of time.  Find the first
-       price on it that is older than the requested time and add it and the
-       previous price to the result list. */
-    while (node != NULL)
+    /* The price series is sorted in decreasing order of time.  Find the
+       first price in it that is older than the requested time and add it
+       and the previous price to the result list. */
+    index = price_series_bisect(series, helper->t);
+    while (index < series->len)
     {
-        GNCPrice *price = node->data;
-        Timespec price_t = gnc_price_get_time(price);
+        Timespec price_t = gnc_price_get_time(g_ptr_array_index(series, index));
         if (timespec_cmp(&price_t, &helper->t) < 0)
-        {
-            /* If there is a previous price add it to the results. */
-            if (node->prev)
-            {
-                GNCPrice *prev_price = node->prev->data;
-                gnc_price_ref(prev_price);
-                *helper->list = g_list_prepend(*helper->list, prev_price);
-            }
-            /* Add the first price before the desired time */
-            gnc_price_ref(price);
-            *helper->list = g_list_prepend(*helper->list, price);
-            /* No point in looking further, they will all be older */
             break;
-        }
-        else if (node->next == NULL)
+        index++;
+    }
+
+    if (index < series->len)
+    {
+        /* If there is a previous price add it to the results. */
+        if (index > 0)
         {
-            /* The last price is later than given time, add it */
-            gnc_price_ref(price);
-            *helper->list = g_list_prepend(*helper->list, price);
+            GNCPrice *prev_price = g_ptr_array_index(series, index - 1);
+            gnc_price_ref(prev_price);
+            *helper->list = g_list_prepend(*helper->list, prev_price);
         }
-        node = node->next;
+        /* Add the first price before the desired time */
+        price = g_ptr_array_index(series, index);
+    }
+    else
+    {
+        /* The last price is later than given time, add it */
+        price = g_ptr_array_index(series, series->len - 1);
     }
+    gnc_price_ref(price);
+    *helper->list = g_list_prepend(*helper->list, price);
 
     return TRUE;
 }
@@ -1800,8 +2218,7 @@ gnc_pricedb_lookup_nearest_in_time_any_currency(GNCPriceDB *db,
     if (!db || !commodity) return NULL;
     ENTER ("db=%p commodity=%p", db, commodity);
 
-    pricedb_pricelist_traversal(db, price_list_scan_any_currency,
-                                       &helper);
+    pricedb_series_traversal(db, price_series_scan_any_currency, &helper);
     prices = g_list_sort(prices, compare_prices_by_date);
     result = nearest_to(prices, commodity, t);
     gnc_price_list_destroy(prices);
@@ -1821,8 +2238,7 @@ gnc_pricedb_lookup_latest_before_any_currency(GNCPriceDB *db,
     if (!db || !commodity) return NULL;
     ENTER ("db=%p commodity=%p", db, commodity);
 
-    pricedb_pricelist_traversal(db, price_list_scan_any_currency,
-                                       &helper);
+    pricedb_series_traversal(db, price_series_scan_any_currency, &helper);
     prices = g_list_sort(prices, compare_prices_by_date);
     result = latest_before(prices, commodity, t);
     gnc_price_list_destroy(prices);
@@ -1839,7 +2255,7 @@ gnc_pricedb_has_prices(GNCPriceDB *db,
                        const gnc_commodity *commodity,
                        const gnc_commodity *currency)
 {
-    GList *price_list;
+    GPtrArray *series;
     GHashTable *currency_hash;
     gint size;
 
@@ -1854,8 +2270,8 @@ gnc_pricedb_has_prices(GNCPriceDB *db,
 
     if (currency)
     {
-        price_list = g_hash_table_lookup(currency_hash, currency);
-        if (price_list)
+        series = g_hash_table_lookup(currency_hash, currency);
+        if (series)
         {
             LEAVE("yes");
             return TRUE;
@@ -1899,9 +2315,9 @@ static void
 price_count_helper(gpointer key, gpointer value, gpointer data)
 {
     int *result = data;
-    GList *price_list = value;
+    GPtrArray *series = value;
 
-    *result += g_list_length(price_list);
+    *result += series->len;
 }
 
 int
@@ -1950,17 +2366,18 @@ gnc_pricedb_nth_price (GNCPriceDB *db,
             g_hash_table_iter_init(&iter, currency_hash);
             if (g_hash_table_iter_next(&iter, &key, &value))
             {
-                PriceList *prices = value;
-                result = g_list_nth_data(prices, n);
+                GPtrArray *series = value;
+                if ((guint)n < series->len)
+                    result = g_ptr_array_index(series, n);
             }
         }
         else if (num_currencies > 1)
         {
             /* Prices for multiple currencies, must find the nth entry in the
                merged currency list. */
-            GList **price_array = (GList **)g_new(gpointer, num_currencies);
-            GList **next_list;
-            int i, j;
+            GPtrArray **series_array = g_new(GPtrArray *, num_currencies);
+            guint *next_index = g_new0(guint, num_currencies);
+            int i, j, next_series;
             GHashTableIter iter;
             gpointer key, value;
 
@@ -1969,41 +2386,45 @@ gnc_pricedb_nth_price (GNCPriceDB *db,
                  g_hash_table_iter_next(&iter, &key, &value) && i < num_currencies;
                  i++)
             {
-                price_array[i] = value;
+                series_array[i] = value;
             }
 
             /* Iterate n times to get the nth price, each time finding the currency
                with the latest price */
             for (i = 0; i <= n; i++)
             {
-                next_list = NULL;
+                next_series = -1;
                 for (j = 0; j < num_currencies; j++)
                 {
                     /* Save this entry if it's the first one or later than
                        the saved one. */
-                    if (price_array[j] != NULL &&
-                        (next_list == NULL || *next_list == NULL ||
-                        compare_prices_by_date((*next_list)->data, (price_array[j])->data) > 0))
+                    if (next_index[j] < series_array[j]->len &&
+                        (next_series < 0 ||
+                         compare_prices_by_date(g_ptr_array_index(series_array[next_series],
+                                                                  next_index[next_series]),
+                                                g_ptr_array_index(series_array[j],
+                                                                  next_index[j])) > 0))
                     {
-                        next_list = &price_array[j];
+                        next_series = j;
                     }
                 }
-                /* next_list points to the list with the latest price unless all
-                   the lists are empty */
-                if (next_list && *next_list)
+                /* next_series is the series with the latest price unless all
+                   the series are used up */
+                if (next_series >= 0)
                 {
-                    result = (*next_list)->data;
-                    *next_list = (*next_list)->next;
+                    result = g_ptr_array_index(series_array[next_series],
+                                               next_index[next_series]++);
                 }
                 else
                 {
-                    /* all the lists are empty, "n" is greater than the number
-                       of prices for this commodity. */
+                    /* all the series are used up, "n" is greater than the
+                       number of prices for this commodity. */
                     result = NULL;
                     break;
                 }
             }
-            g_free(price_array);
+            g_free(next_index);
+            g_free(series_array);
         }
     }
 
@@ -2026,27 +2447,20 @@ gnc_pricedb_lookup_at_time(GNCPriceDB *db,
                            const gnc_commodity *currency,
                            Timespec t)
 {
-    GList *price_list;
-    GList *item = NULL;
-    GHashTable *currency_hash;
+    GNCPrice *later, *p;
 
     if (!db || !c || !currency) return NULL;
     ENTER ("db=%p commodity=%p currency=%p", db, c, currency);
-    price_list = pricedb_get_prices_internal (db, c, currency, TRUE);
-    item = price_list;
-    while (item)
+    pricedb_find_around (db, c, currency, t, &later, &p);
+    if (p)
     {
-        GNCPrice *p = item->data;
         Timespec price_time = gnc_price_get_time(p);
         if (timespec_equal(&price_time, &t))
         {
             gnc_price_ref(p);
-            g_list_free (price_list);
             return p;
         }
-        item = item->next;
     }
-    g_list_free (price_list);
     LEAVE (" ");
     return NULL;
 }
@@ -2058,36 +2472,21 @@ lookup_nearest_in_time(GNCPriceDB *db,
                        Timespec t,
                        gboolean sameday)
 {
-    GList *price_list;
     GNCPrice *current_price = NULL;
     GNCPrice *next_price = NULL;
     GNCPrice *result = NULL;
-    GList *item = NULL;
-    GHashTable *currency_hash;
 
     if (!db || !c || !currency) return NULL;
     ENTER ("db=%p commodity=%p currency=%p", db, c, currency);
-    price_list = pricedb_get_prices_internal (db, c, currency, TRUE);
-    if (!price_list) return NULL;
-    item = price_list;
 
-    /* default answer */
-    current_price = item->data;
+    /* find the first candidate past the one we want and the one just
+       before it.  Remember that prices are in most-recent-first order. */
+    pricedb_find_around (db, c, currency, t, &current_price, &next_price);
+    if (!current_price && !next_price) return NULL;
 
-    /* find the first candidate past the one we want.  Remember that
-       prices are in most-recent-first order. */
-    while (!next_price && item)
-    {
-        GNCPrice *p = item->data;
-        Timespec price_time = gnc_price_get_time(p);
-        if (timespec_cmp(&price_time, &t) <= 0)
-        {
-            next_price = item->data;
-            break;
-        }
-        current_price = item->data;
-        item = item->next;
-    }
+    /* default answer */
+    if (!current_price)
+        current_price = next_price;
 
     if (current_price)      /* How can this be null??? */
     {
@@ -2159,7 +2558,6 @@ lookup_nearest_in_time(GNCPriceDB *db,
     }
 
     gnc_price_ref(result);
-    g_list_free (price_list);
     LEAVE (" ");
     return result;
 }
@@ -2179,176 +2577,251 @@ gnc_pricedb_lookup_latest_before (GNCPriceDB *db,
                                   gnc_commodity *currency,
                                   Timespec t)
 {
-    GList *price_list;
+    GNCPrice *later;
     GNCPrice *current_price = NULL;
-    /*  GNCPrice *next_price = NULL;
-        GNCPrice *result = NULL;*/
-    GList *item = NULL;
-    GHashTable *currency_hash;
-    Timespec price_time;
 
     if (!db || !c || !currency) return NULL;
     ENTER ("db=%p commodity=%p currency=%p", db, c, currency);
-    price_list = pricedb_get_prices_internal (db, c, currency, TRUE);
-    if (!price_list) return NULL;
-    item = price_list;
-    do
-    {
-        price_time = gnc_price_get_time (item->data);
-        if (timespec_cmp(&price_time, &t) <= 0)
-            current_price = item->data;
-        item = item->next;
-    }
-    while (timespec_cmp(&price_time, &t) > 0 && item);
+    pricedb_find_around (db, c, currency, t, &later, &current_price);
+    if (!later && !current_price) return NULL;
     gnc_price_ref(current_price);
-    g_list_free (price_list);
     LEAVE (" ");
     return current_price;
 }
 
-static gnc_numeric
-direct_balance_conversion (GNCPriceDB *db, gnc_numeric bal,
-                           const gnc_commodity *from, const gnc_commodity *to,
-                           Timespec *t)
+/* ==================================================================== */
+/* balance conversion
+
+   Conversions between commodities that have no price in common go
+   through the exchange-rate graph: its nodes are the commodities, with
+   an edge between any two that have prices between them.  The search
+   looks for the path with the fewest conversions, and among those for
+   the one whose prices are closest to the date in question.  The
+   resolved rates are cached per (from, to, date) until a price is
+   added to, removed from or changed in the db.
+ */
+
+typedef struct
 {
-    GNCPrice *price;
-    gnc_numeric retval = gnc_numeric_zero();
-    if (from == NULL || to == NULL)
-        return retval;
-    if (gnc_numeric_zero_p(bal))
-        return retval;
-    if (t != NULL)
-        price = gnc_pricedb_lookup_nearest_in_time(db, from, to, *t);
-    else
-        price = gnc_pricedb_lookup_latest(db, from, to);
-    if (price == NULL)
-        return retval;
-    if (gnc_price_get_commodity(price) == from)
-        retval = gnc_numeric_mul (bal, gnc_price_get_value (price),
-                                  gnc_commodity_get_fraction (to),
-                                  GNC_HOW_RND_ROUND);
-    else
-        retval = gnc_numeric_div (bal, gnc_price_get_value (price),
-                                  gnc_commodity_get_fraction (to),
-                                  GNC_HOW_RND_ROUND);
-    gnc_price_unref (price);
-    return retval;
+    const gnc_commodity *from;
+    const gnc_commodity *to;
+    Timespec t;
+    gboolean latest;
+} RateKey;
 
+static guint
+rate_key_hash (gconstpointer key)
+{
+    const RateKey *k = key;
+    return g_direct_hash (k->from) ^ (g_direct_hash (k->to) * 31) ^
+        (guint) k->t.tv_sec;
 }
 
-typedef struct
+static gboolean
+rate_key_equal (gconstpointer a, gconstpointer b)
+{
+    const RateKey *ka = a, *kb = b;
+    return ka->from == kb->from && ka->to == kb->to &&
+        ka->latest == kb->latest &&
+        (ka->latest || timespec_equal (&ka->t, &kb->t));
+}
+
+static void
+pricedb_invalidate_rates (GNCPriceDB *db)
+{
+    if (db->rate_cache)
+    {
+        g_hash_table_destroy (db->rate_cache);
+        db->rate_cache = NULL;
+    }
+    if (db->rate_graph)
+    {
+        g_hash_table_destroy (db->rate_graph);
+        db->rate_graph = NULL;
+    }
+}
+
+static void
+rate_graph_add_edge (GHashTable *graph, gnc_commodity *a, gnc_commodity *b)
 {
-    GNCPrice *from;
-    GNCPrice *to;
-} PriceTuple;
+    GList *neighbours = g_hash_table_lookup (graph, a);
+    if (g_list_find (neighbours, b)) return;
+    /* Replacing the value would free the list. */
+    g_hash_table_steal (graph, a);
+    g_hash_table_insert (graph, a, g_list_prepend (neighbours, b));
+}
 
-static PriceTuple
-extract_common_prices (PriceList *from_prices, PriceList *to_prices)
+static GHashTable *
+pricedb_get_rate_graph (GNCPriceDB *db)
 {
-    PriceTuple retval = {NULL, NULL};
-    GList *from_node = NULL, *to_node = NULL;
-    GNCPrice *from_price, *to_price;
+    GHashTableIter com_iter;
+    gpointer commodity, currency_hash;
+
+    if (db->rate_graph)
+        return db->rate_graph;
 
-    for (from_node = from_prices; from_node != NULL;
-         from_node = g_list_next(from_node))
+    db->rate_graph = g_hash_table_new_full (NULL, NULL, NULL,
+                                            (GDestroyNotify) g_list_free);
+    g_hash_table_iter_init (&com_iter, db->commodity_hash);
+    while (g_hash_table_iter_next (&com_iter, &commodity, &currency_hash))
     {
-        for (to_node = to_prices; to_node != NULL;
-             to_node = g_list_next(to_node))
+        GHashTableIter cur_iter;
+        gpointer currency, series;
+
+        g_hash_table_iter_init (&cur_iter, currency_hash);
+        while (g_hash_table_iter_next (&cur_iter, &currency, &series))
         {
-            gnc_commodity *to_com, *to_cur;
-            gnc_commodity *from_com, *from_cur;
-            to_price = GNC_PRICE(to_node->data);
-            from_price = GNC_PRICE(from_node->data);
-            to_com = gnc_price_get_commodity (to_price);
-            to_cur = gnc_price_get_currency (to_price);
-            from_com = gnc_price_get_commodity (from_price);
-            from_cur = gnc_price_get_currency (from_price);
-            if (to_com == from_com || to_com == from_cur ||
-                to_cur == from_com || to_cur == from_cur)
-                break;
-            to_price = NULL;
-            from_price = NULL;
+            rate_graph_add_edge (db->rate_graph, commodity, currency);
+            rate_graph_add_edge (db->rate_graph, currency, commodity);
         }
-        if (to_price != NULL && from_price != NULL)
-            break;
     }
-    if (from_price == NULL || to_price == NULL)
-        return retval;
-    gnc_price_ref(from_price);
-    gnc_price_ref(to_price);
-    retval.from = from_price;
-    retval.to = to_price;
-    return retval;
+    return db->rate_graph;
 }
 
-static gnc_numeric
-convert_balance(gnc_numeric bal, const gnc_commodity *from,
-                const gnc_commodity *to, PriceTuple tuple)
-{
-    gnc_commodity *from_com = gnc_price_get_commodity(tuple.from);
-    gnc_commodity *from_cur = gnc_price_get_currency(tuple.from);
-    gnc_commodity *to_com = gnc_price_get_commodity(tuple.to);
-    gnc_commodity *to_cur = gnc_price_get_currency(tuple.to);
-    gnc_numeric from_val = gnc_price_get_value(tuple.from);
-    gnc_numeric to_val = gnc_price_get_value(tuple.to);
-    int fraction = gnc_commodity_get_fraction(to);
-
-    int no_round = GNC_HOW_DENOM_EXACT | GNC_HOW_RND_NEVER;
-    if (from_cur == from && to_cur == to)
-        return gnc_numeric_div(gnc_numeric_mul(bal, to_val, GNC_DENOM_AUTO,
-                                               no_round),
-                               from_val, fraction, GNC_HOW_RND_ROUND);
-    if (from_com == from && to_com == to)
-        return gnc_numeric_div(gnc_numeric_mul(bal, from_val, GNC_DENOM_AUTO,
-                                               no_round),
-                               to_val, fraction, GNC_HOW_RND_ROUND);
-    if (from_cur == from)
-        return gnc_numeric_div(bal, gnc_numeric_mul(from_val, to_val,
-                                                    GNC_DENOM_AUTO, no_round),
-                               fraction, GNC_HOW_RND_ROUND);
-    return gnc_numeric_mul(bal, gnc_numeric_mul(from_val, to_val,
-                                                GNC_DENOM_AUTO, no_round),
-                           fraction, GNC_HOW_RND_ROUND);
+typedef struct rate_path_node RatePathNode;
+struct rate_path_node
+{
+    gnc_commodity *commodity;
+    guint hops;
+    gint64 staleness;
+    RatePathNode *prev;
+    GNCPrice *price;            /* converts from prev to commodity */
+};
 
+static void
+rate_path_node_free (gpointer data)
+{
+    RatePathNode *node = data;
+    gnc_price_unref (node->price);
+    g_free (node);
 }
+
+/* Breadth first search over the rate graph, keeping for each commodity
+ * the path with the least total distance between its prices and t.
+ * Returns the rate to multiply an amount of from by to get one of to,
+ * or zero if there is no path. */
 static gnc_numeric
-indirect_balance_conversion (GNCPriceDB *db, gnc_numeric bal,
-                             const gnc_commodity *from, const gnc_commodity *to,
-                             Timespec *t )
-{
-    GList *from_prices = NULL, *to_prices = NULL;
-    PriceTuple tuple;
-    gnc_numeric zero = gnc_numeric_zero();
-    if (from == NULL || to == NULL)
-        return zero;
-    if (gnc_numeric_zero_p(bal))
-        return zero;
-    if (t == NULL)
-    {
-        from_prices = gnc_pricedb_lookup_latest_any_currency(db, from);
-        /* "to" is often the book currency which may have lots of prices,
-            so avoid getting them if they aren't needed. */
-        if (from_prices)
-            to_prices = gnc_pricedb_lookup_latest_any_currency(db, to);
+pricedb_find_rate (GNCPriceDB *db, const gnc_commodity *from,
+                   const gnc_commodity *to, Timespec *t)
+{
+    GHashTable *graph = pricedb_get_rate_graph (db);
+    GHashTable *nodes = g_hash_table_new_full (NULL, NULL, NULL,
+                                               rate_path_node_free);
+    Timespec when = t ? *t : timespec_now ();
+    gnc_numeric rate = gnc_numeric_zero ();
+    GList *frontier, *next, *l;
+    RatePathNode *node;
+
+    node = g_new0 (RatePathNode, 1);
+    node->commodity = (gnc_commodity *) from;
+    g_hash_table_insert (nodes, node->commodity, node);
+    frontier = g_list_prepend (NULL, node);
+
+    while (frontier && !g_hash_table_lookup (nodes, to))
+    {
+        next = NULL;
+        for (l = frontier; l; l = l->next)
+        {
+            RatePathNode *here = l->data;
+            GList *n;
+
+            for (n = g_hash_table_lookup (graph, here->commodity); n; n = n->next)
+            {
+                RatePathNode *there = g_hash_table_lookup (nodes, n->data);
+                GNCPrice *price;
+                Timespec price_t;
+                gint64 staleness;
+
+                /* Already reached with fewer conversions */
+                if (there && there->hops <= here->hops)
+                    continue;
+                if (t)
+                    price = gnc_pricedb_lookup_nearest_in_time (db, here->commodity,
+                                                                n->data, *t);
+                else
+                    price = gnc_pricedb_lookup_latest (db, here->commodity,
+                                                       n->data);
+                if (!price)
+                    continue;
+                price_t = gnc_price_get_time (price);
+                staleness = here->staleness + ABS (price_t.tv_sec - when.tv_sec);
+                if (there && there->staleness <= staleness)
+                {
+                    gnc_price_unref (price);
+                    continue;
+                }
+                if (!there)
+                {
+                    there = g_new0 (RatePathNode, 1);
+                    there->commodity = n->data;
+                    there->hops = here->hops + 1;
+                    g_hash_table_insert (nodes, there->commodity, there);
+                    next = g_list_prepend (next, there);
+                }
+                gnc_price_unref (there->price);
+                there->price = price;
+                there->staleness = staleness;
+                there->prev = here;
+            }
+        }
+        g_list_free (frontier);
+        frontier = g_list_reverse (next);
     }
-    else
+    g_list_free (frontier);
+
+    node = g_hash_table_lookup (nodes, to);
+    if (node)
     {
-        from_prices = gnc_pricedb_lookup_nearest_in_time_any_currency(db,
-                                                                      from, *t);
-        if (from_prices)
-            to_prices = gnc_pricedb_lookup_nearest_in_time_any_currency(db,
-                                                                    to, *t);
+        rate = gnc_numeric_create (1, 1);
+        for (; node->prev; node = node->prev)
+        {
+            gnc_numeric value = gnc_price_get_value (node->price);
+            if (gnc_price_get_currency (node->price) == node->commodity)
+                rate = gnc_numeric_mul (rate, value, GNC_DENOM_AUTO,
+                                        GNC_HOW_DENOM_REDUCE | GNC_HOW_RND_NEVER);
+            else
+                rate = gnc_numeric_div (rate, value, GNC_DENOM_AUTO,
+                                        GNC_HOW_DENOM_REDUCE | GNC_HOW_RND_NEVER);
+        }
+        if (gnc_numeric_check (rate))
+            rate = gnc_numeric_zero ();
     }
-    if (from_prices == NULL || to_prices == NULL)
-        return zero;
-    tuple = extract_common_prices(from_prices, to_prices);
-    gnc_price_list_destroy(from_prices);
-    gnc_price_list_destroy(to_prices);
-    if (tuple.from)
-        return convert_balance(bal, from, to, tuple);
-    return zero;
+    g_hash_table_destroy (nodes);
+    return rate;
 }
 
+static gnc_numeric
+convert_balance (GNCPriceDB *db, gnc_numeric bal,
+                 const gnc_commodity *from, const gnc_commodity *to,
+                 Timespec *t)
+{
+    RateKey key;
+    gnc_numeric *rate;
+
+    memset (&key, 0, sizeof (key));
+    key.from = from;
+    key.to = to;
+    if (t)
+        key.t = *t;
+    key.latest = (t == NULL);
+
+    if (!db->rate_cache)
+        db->rate_cache = g_hash_table_new_full (rate_key_hash, rate_key_equal,
+                                                g_free, g_free);
+    rate = g_hash_table_lookup (db->rate_cache, &key);
+    if (!rate)
+    {
+        RateKey *new_key = g_new (RateKey, 1);
+        *new_key = key;
+        rate = g_new (gnc_numeric, 1);
+        *rate = pricedb_find_rate (db, from, to, t);
+        g_hash_table_insert (db->rate_cache, new_key, rate);
+    }
+    if (gnc_numeric_zero_p (*rate))
+        return gnc_numeric_zero ();
+    return gnc_numeric_mul (bal, *rate, gnc_commodity_get_fraction (to),
+                            GNC_HOW_RND_ROUND);
+}
 
 /*
  * Convert a balance from one currency to another.
@@ -2359,24 +2832,15 @@ gnc_pricedb_convert_balance_latest_price(GNCPriceDB *pdb,
         const gnc_commodity *balance_currency,
         const gnc_commodity *new_currency)
 {
-    gnc_numeric new_value;
-
     if (gnc_numeric_zero_p (balance) ||
             gnc_commodity_equiv (balance_currency, new_currency))
         return balance;
+    if (!pdb || !balance_currency || !new_currency)
+        return gnc_numeric_zero();
 
-    /* Look for a direct price. */
-    new_value = direct_balance_conversion(pdb, balance, balance_currency,
-                                          new_currency, NULL);
-    if (!gnc_numeric_zero_p(new_value))
-        return new_value;
-
-    /*
-     * no direct price found, try if we find a price in another currency
-     * and convert in two stages
-     */
-    return indirect_balance_conversion(pdb, balance, balance_currency,
-                                       new_currency, NULL);
+    /* Use a direct price if there is one, otherwise convert in as few
+     * stages as we can. */
+    return convert_balance(pdb, balance, balance_currency, new_currency, NULL);
 }
 
 gnc_numeric
@@ -2386,24 +2850,15 @@ gnc_pricedb_convert_balance_nearest_price(GNCPriceDB *pdb,
         const gnc_commodity *new_currency,
         Timespec t)
 {
-    gnc_numeric new_value;
-
     if (gnc_numeric_zero_p (balance) ||
         gnc_commodity_equiv (balance_currency, new_currency))
         return balance;
+    if (!pdb || !balance_currency || !new_currency)
+        return gnc_numeric_zero();
 
-    /* Look for a direct price. */
-    new_value = direct_balance_conversion(pdb, balance, balance_currency,
-                                          new_currency, &t);
-    if (!gnc_numeric_zero_p(new_value))
-        return new_value;
-
-    /*
-     * no direct price found, try if we find a price in another currency
-     * and convert in two stages
-     */
-    return indirect_balance_conversion(pdb, balance, balance_currency,
-                                       new_currency, &t);
+    /* Use a direct price if there is one, otherwise convert in as few
+     * stages as we can. */
+    return convert_balance(pdb, balance, balance_currency, new_currency, &t);
 }
 
 
@@ -2421,16 +2876,15 @@ typedef struct
 static void
 pricedb_foreach_pricelist(gpointer key, gpointer val, gpointer user_data)
 {
-    GList *price_list = (GList *) val;
-    GList *node = price_list;
+    GPtrArray *series = (GPtrArray *) val;
     GNCPriceDBForeachData *foreach_data = (GNCPriceDBForeachData *) user_data;
+    guint i;
 
     /* stop traversal when func returns FALSE */
-    while (foreach_data->ok && node)
+    for (i = 0; foreach_data->ok && i < series->len; i++)
     {
-        GNCPrice *p = (GNCPrice *) node->data;
+        GNCPrice *p = (GNCPrice *) g_ptr_array_index (series, i);
         foreach_data->ok = foreach_data->func(p, foreach_data->user_data);
-        node = node->next;
     }
 }
 
@@ -2463,38 +2917,38 @@ unstable_price_traversal(GNCPriceDB *db,
     return foreach_data.ok;
 }
 
-/* foreach_pricelist */
+/* foreach_series */
 typedef struct
 {
     gboolean ok;
-    gboolean (*func)(GList *p, gpointer user_data);
+    gboolean (*func)(GPtrArray *p, gpointer user_data);
     gpointer user_data;
-} GNCPriceListForeachData;
+} GNCPriceSeriesForeachData;
 
 static void
-pricedb_pricelist_foreach_pricelist(gpointer key, gpointer val, gpointer user_data)
+pricedb_series_foreach_series(gpointer key, gpointer val, gpointer user_data)
 {
-    GList *price_list = (GList *) val;
-    GNCPriceListForeachData *foreach_data = (GNCPriceListForeachData *) user_data;
+    GPtrArray *series = (GPtrArray *) val;
+    GNCPriceSeriesForeachData *foreach_data = (GNCPriceSeriesForeachData *) user_data;
     if (foreach_data->ok)
     {
-        foreach_data->ok = foreach_data->func(price_list, foreach_data->user_data);
+        foreach_data->ok = foreach_data->func(series, foreach_data->user_data);
     }
 }
 
 static void
-pricedb_pricelist_foreach_currencies_hash(gpointer key, gpointer val, gpointer user_data)
+pricedb_series_foreach_currencies_hash(gpointer key, gpointer val, gpointer user_data)
 {
     GHashTable *currencies_hash = (GHashTable *) val;
-    g_hash_table_foreach(currencies_hash, pricedb_pricelist_foreach_pricelist, user_data);
+    g_hash_table_foreach(currencies_hash, pricedb_series_foreach_series, user_data);
 }
 
 static gboolean
-pricedb_pricelist_traversal(GNCPriceDB *db,
-                         gboolean (*f)(GList *p, gpointer user_data),
+pricedb_series_traversal(GNCPriceDB *db,
+                         gboolean (*f)(GPtrArray *p, gpointer user_data),
                          gpointer user_data)
 {
-    GNCPriceListForeachData foreach_data;
+    GNCPriceSeriesForeachData foreach_data;
 
     if (!db || !f) return FALSE;
     foreach_data.ok = TRUE;
@@ -2505,7 +2959,7 @@ pricedb_pricelist_traversal(GNCPriceDB *db,
         return FALSE;
     }
     g_hash_table_foreach(db->commodity_hash,
-                         pricedb_pricelist_foreach_currencies_hash,
+                         pricedb_series_foreach_currencies_hash,
                          &foreach_data);
 
     return foreach_data.ok;
@@ -2563,12 +3017,12 @@ stable_price_traversal(GNCPriceDB *db,
         for (j = price_lists; j; j = j->next)
         {
             HashEntry *pricelist_entry = (HashEntry *) j->data;
-            GList *price_list = (GList *) pricelist_entry->value;
-            GList *node;
+            GPtrArray *series = (GPtrArray *) pricelist_entry->value;
+            guint k;
 
-            for (node = (GList *) price_list; node; node = node->next)
+            for (k = 0; k < series->len; k++)
             {
-                GNCPrice *price = (GNCPrice *) node->data;
+                GNCPrice *price = (GNCPrice *) g_ptr_array_index (series, k);
 
                 /* stop traversal when f returns FALSE */
                 if (FALSE == ok) break;
@@ -2788,15 +3242,14 @@ VoidGNCPriceDBForeachData;
 static void
 void_pricedb_foreach_pricelist(gpointer key, gpointer val, gpointer user_data)
 {
-    GList *price_list = (GList *) val;
-    GList *node = price_list;
+    GPtrArray *series = (GPtrArray *) val;
     VoidGNCPriceDBForeachData *foreach_data = (VoidGNCPriceDBForeachData *) user_data;
+    guint i;
 
-    while (node)
+    for (i = 0; i < series->len; i++)
     {
-        GNCPrice *p = (GNCPrice *) node->data;
+        GNCPrice *p = (GNCPrice *) g_ptr_array_index (series, i);
         foreach_data->func(p, foreach_data->user_data);
-        node = node->next;
     }
 }
 
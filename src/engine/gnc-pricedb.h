@@ -364,6 +364,26 @@ void gnc_pricedb_set_bulk_update(GNCPriceDB *db, gboolean bulk_update);
  */
 gboolean     gnc_pricedb_add_price(GNCPriceDB *db, GNCPrice *p);
 
+/** @brief Add a batch of prices to the pricedb.
+ *
+ * The prices are appended to their price lists unsorted and each list is
+ * sorted once at the end, which is much faster than adding them one at a
+ * time.  As with gnc_pricedb_add_price(), there is only one price per
+ * pair of commodities and day, whichever way round it is quoted: the one
+ * with the better source, or the one added last if the sources are equal.
+ *
+ * A single QOF_EVENT_MODIFY on the pricedb replaces the events for the
+ * individual prices.  Models that follow the prices' own events, such as
+ * the price editor's GncTreeModelPrice, will not see a batch, so code
+ * that has one of those open should use gnc_pricedb_add_price() instead.
+ *
+ * You may drop your references to the prices after this returns.
+ * @param db The pricedb
+ * @param prices The GNCPrices to add.
+ * @return The number of prices that were added.
+ */
+guint        gnc_pricedb_add_prices(GNCPriceDB *db, PriceList *prices);
+
 /** @brief Remove a price from the pricedb and unref the price.
  * @param db The Pricedb
  * @param p The price to remove.
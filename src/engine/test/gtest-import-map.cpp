@@ -315,6 +315,45 @@ TEST_F(ImapBayesTest, AddAccountBayes)
     EXPECT_EQ(2, value->get<int64_t>());
 }
 
+TEST_F(ImapBayesTest, FindAccountBayesAfterChanges)
+{
+    static const char* slashed = "fish/chips";
+    auto acct2_guid = guid_to_string (xaccAccountGetGUID(t_expense_account2));
+    GList *t_list6 = g_list_prepend(nullptr, const_cast<char*>(slashed));
+
+    qof_instance_increase_editlevel(QOF_INSTANCE(t_bank_account));
+    gnc_account_imap_add_account_bayes(t_imap, t_list1, t_expense_account1);
+    gnc_account_imap_add_account_bayes(t_imap, t_list6, t_expense_account1);
+    EXPECT_EQ(t_expense_account1, gnc_account_imap_find_account_bayes(t_imap, t_list1));
+    EXPECT_EQ(t_expense_account1, gnc_account_imap_find_account_bayes(t_imap, t_list6));
+    EXPECT_EQ(nullptr, gnc_account_imap_find_account_bayes(t_imap, t_list5));
+
+    // Learned after the first search
+    gnc_account_imap_add_account_bayes(t_imap, t_list5, t_expense_account2);
+    EXPECT_EQ(t_expense_account2, gnc_account_imap_find_account_bayes(t_imap, t_list5));
+    gnc_account_imap_add_account_bayes(t_imap, t_list1, t_expense_account2);
+    EXPECT_EQ(nullptr, gnc_account_imap_find_account_bayes(t_imap, t_list1));
+    gnc_account_imap_add_account_bayes(t_imap, t_list1, t_expense_account2);
+    gnc_account_imap_add_account_bayes(t_imap, t_list1, t_expense_account2);
+    gnc_account_imap_add_account_bayes(t_imap, t_list1, t_expense_account2);
+    gnc_account_imap_add_account_bayes(t_imap, t_list1, t_expense_account2);
+    EXPECT_EQ(t_expense_account2, gnc_account_imap_find_account_bayes(t_imap, t_list1));
+
+    // Forgotten through the map editor
+    gnc_account_delete_map_entry(t_bank_account,
+                                 g_strdup_printf("%s/%s/%s", IMAP_FRAME_BAYES,
+                                                 pork, acct2_guid), FALSE);
+    gnc_account_delete_map_entry(t_bank_account,
+                                 g_strdup_printf("%s/%s/%s", IMAP_FRAME_BAYES,
+                                                 sausage, acct2_guid), FALSE);
+    EXPECT_EQ(nullptr, gnc_account_imap_find_account_bayes(t_imap, t_list5));
+    EXPECT_EQ(t_expense_account1, gnc_account_imap_find_account_bayes(t_imap, t_list6));
+    qof_instance_reset_editlevel(QOF_INSTANCE(t_bank_account));
+
+    g_list_free(t_list6);
+    g_free(acct2_guid);
+}
+
 
 TEST_F(ImapBayesTest, ConvertAccountBayes)
 {
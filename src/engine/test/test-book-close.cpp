@@ -0,0 +1,303 @@
+/********************************************************************\
+ * test-book-close.cpp -- test releasing transactions at book close *
+ *                                                                  *
+ * This program is free software; you can redistribute it and/or    *
+ * modify it under the terms of the GNU General Public License as   *
+ * published by the Free Software Foundation; either version 2 of   *
+ * the License, or (at your option) any later version.              *
+ *                                                                  *
+ * This program is distributed in the hope that it will be useful,  *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of   *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the    *
+ * GNU General Public License for more details.                     *
+ *                                                                  *
+ * You should have received a copy of the GNU General Public License*
+ * along with this program; if not, contact:                        *
+ *                                                                  *
+ * Free Software Foundation           Voice:  +1-617-542-5942       *
+ * 51 Franklin Street, Fifth Floor    Fax:    +1-617-542-2652       *
+ * Boston, MA  02110-1301,  USA       gnu@gnu.org                   *
+ *                                                                  *
+\********************************************************************/
+extern "C"
+{
+#include "config.h"
+
+#include <glib.h>
+#include <stdio.h>
+#include <stdlib.h>
+#ifdef __linux__
+#include <sys/resource.h>
+#include <unistd.h>
+#endif
+
+#include "qof.h"
+#include "qofbackend-p.h"
+#include "Account.h"
+#include "Transaction.h"
+#include "gnc-commodity.h"
+#include "gnc-event.h"
+#include "gnc-lot.h"
+#include "cashobjects.h"
+#include "test-stuff.h"
+}
+
+/* What the close told the event handlers. */
+struct CloseEvents
+{
+    guint txn_destroyed;
+    guint split_removed;
+    guint lot_modified;
+};
+
+static void
+count_close_events (QofInstance* ent, QofEventId event_type,
+                    gpointer handler_data, gpointer event_data)
+{
+    auto events = static_cast<CloseEvents*> (handler_data);
+
+    if (GNC_IS_TRANSACTION (ent))
+    {
+        if (event_type == QOF_EVENT_DESTROY)
+            ++events->txn_destroyed;
+        else if (event_type == GNC_EVENT_ITEM_REMOVED)
+            ++events->split_removed;
+    }
+    else if (GNC_IS_LOT (ent) && event_type == QOF_EVENT_MODIFY)
+        ++events->lot_modified;
+}
+
+static void
+count_finalized (gpointer data, GObject *where_the_object_was)
+{
+    ++*static_cast<guint*> (data);
+}
+
+static Transaction*
+add_transaction (Account* acct, Account* other, gnc_commodity* curr,
+                 time64 date, gint64 amount, Split** split_out)
+{
+    auto book = gnc_account_get_book (acct);
+    auto txn = xaccMallocTransaction (book);
+    auto split = xaccMallocSplit (book);
+    auto balancing = xaccMallocSplit (book);
+    gnc_numeric amt = gnc_numeric_create (amount, 100);
+
+    xaccTransBeginEdit (txn);
+    xaccTransSetCurrency (txn, curr);
+    xaccTransSetDatePostedSecs (txn, date);
+    xaccTransSetDescription (txn, "Groceries");
+    xaccSplitSetParent (split, txn);
+    xaccSplitSetAccount (split, acct);
+    xaccSplitSetAmount (split, amt);
+    xaccSplitSetValue (split, amt);
+    xaccSplitSetMemo (split, "weekly shop");
+    xaccSplitSetParent (balancing, txn);
+    xaccSplitSetAccount (balancing, other);
+    xaccSplitSetAmount (balancing, gnc_numeric_neg (amt));
+    xaccSplitSetValue (balancing, gnc_numeric_neg (amt));
+    xaccTransCommitEdit (txn);
+    *split_out = split;
+    return txn;
+}
+
+static void
+watch (Transaction* txn, guint* finalized)
+{
+    GList* node;
+
+    g_object_weak_ref (G_OBJECT (txn), count_finalized, finalized);
+    for (node = xaccTransGetSplitList (txn); node; node = node->next)
+        g_object_weak_ref (G_OBJECT (node->data), count_finalized, finalized);
+}
+
+/* Fill a book with num_txns two-split transactions between two
+ * accounts, putting one split of every fourth of them into a lot of
+ * its own, and watch for all of them being finalized.  Returns the
+ * number of transactions and splits being watched; *acct_out and
+ * *other_out get the accounts. */
+static guint
+make_book (QofBook* book, gint num_txns, guint* finalized,
+           Account** acct_out, Account** other_out)
+{
+    auto root = gnc_book_get_root_account (book);
+    auto curr = gnc_commodity_new (book, "Gnu Rand", "CURRENCY", "GNR", "", 100);
+    auto acct = xaccMallocAccount (book);
+    auto other = xaccMallocAccount (book);
+    time64 start = gnc_time (NULL) - (time64)num_txns * 3600;
+
+    xaccAccountSetCommodity (acct, curr);
+    xaccAccountSetCommodity (other, curr);
+    gnc_account_append_child (root, acct);
+    gnc_account_append_child (root, other);
+
+    xaccAccountBeginEdit (acct);
+    xaccAccountBeginEdit (other);
+    for (gint i = 0; i < num_txns; ++i)
+    {
+        Split* split;
+        auto txn = add_transaction (acct, other, curr,
+                                    start + (time64)i * 3600, i % 1000 + 1,
+                                    &split);
+        if (i % 4 == 0)
+            gnc_lot_add_split (gnc_lot_new (book), split);
+        watch (txn, finalized);
+    }
+    xaccAccountCommitEdit (acct);
+    xaccAccountCommitEdit (other);
+
+    *acct_out = acct;
+    *other_out = other;
+    return 3 * num_txns;
+}
+
+static void
+test_book_close (void)
+{
+    QofBook* book = qof_book_new ();
+    CloseEvents events = { 0, 0, 0 };
+    guint finalized = 0, open_finalized = 0;
+    Account *acct, *other;
+    guint watched = make_book (book, 100, &finalized, &acct, &other);
+    Split* open_split;
+    auto open_txn = add_transaction (acct, other,
+                                     xaccAccountGetCommodity (acct),
+                                     gnc_time (NULL), 500, &open_split);
+    gint handler;
+
+    gnc_lot_add_split (gnc_lot_new (book), open_split);
+    watch (open_txn, &open_finalized);
+    /* Someone is still editing this one when the book closes. */
+    xaccTransBeginEdit (open_txn);
+
+    handler = qof_event_register_handler (count_close_events, &events);
+    qof_book_destroy (book);
+    qof_event_unregister_handler (handler);
+
+    do_test_args (finalized == watched, "book close frees transactions",
+                  __FILE__, __LINE__, "%u of %u finalized", finalized, watched);
+    /* The bulk release tells about each transaction but not about the
+     * splits leaving it or their lots. */
+    do_test_args (events.txn_destroyed == 100 && events.split_removed == 0
+                  && events.lot_modified == 0, "book close releases in bulk",
+                  __FILE__, __LINE__, "%u destroyed, %u split removals, "
+                  "%u lot changes", events.txn_destroyed, events.split_removed,
+                  events.lot_modified);
+    do_test (open_finalized == 0 && qof_instance_get_destroying (open_txn)
+             && xaccSplitGetLot (open_split) == NULL,
+             "book close leaves an open transaction to its editor");
+}
+
+#ifdef __linux__
+/* The peak and current resident set sizes in kilobytes. */
+static glong
+peak_rss_kb (void)
+{
+    struct rusage usage;
+
+    if (getrusage (RUSAGE_SELF, &usage) != 0)
+        return 0;
+    return usage.ru_maxrss;
+}
+
+static glong
+current_rss_kb (void)
+{
+    gchar* contents = NULL;
+    glong pages = 0;
+
+    if (!g_file_get_contents ("/proc/self/statm", &contents, NULL, NULL))
+        return 0;
+    sscanf (contents, "%*s %ld", &pages);
+    g_free (contents);
+    return pages * (sysconf (_SC_PAGESIZE) / 1024);
+}
+#else
+static glong peak_rss_kb (void) { return 0; }
+static glong current_rss_kb (void) { return 0; }
+#endif
+
+/* Set GNC_ENGINE_PERF_BOOK_CLOSE to a number of transactions to time
+ * closing a book that big, with two splits to each transaction.  Set
+ * GNC_ENGINE_PERF_BOOK_CLOSE_OLD as well to close it the way a book
+ * with a backend is, destroying each transaction in turn.  Run the two
+ * separately so that neither sees the other's peak. */
+static void
+test_book_close_perf (void)
+{
+    const char* env = g_getenv ("GNC_ENGINE_PERF_BOOK_CLOSE");
+    gboolean old_path = g_getenv ("GNC_ENGINE_PERF_BOOK_CLOSE_OLD") != NULL;
+    QofBook* book;
+    QofBackend* be = NULL;
+    Account *acct, *other;
+    GTimer* timer;
+    GTypeQuery txn_type, split_type;
+    guint finalized = 0, watched;
+    double load_time, close_time;
+    glong rss_start, rss_loaded, rss_closed, peak;
+    gint num_txns;
+
+    if (!env || atoi (env) <= 0)
+        return;
+
+    num_txns = atoi (env);
+    rss_start = current_rss_kb ();
+    book = qof_book_new ();
+    timer = g_timer_new ();
+    watched = make_book (book, num_txns, &finalized, &acct, &other);
+    load_time = g_timer_elapsed (timer, NULL);
+    rss_loaded = current_rss_kb ();
+    peak = peak_rss_kb ();
+
+    if (old_path)
+    {
+        /* A backend that does nothing, but is there to be told. */
+        be = g_new0 (QofBackend, 1);
+        qof_backend_init (be);
+        qof_book_set_backend (book, be);
+    }
+    g_timer_start (timer);
+    qof_book_destroy (book);
+    close_time = g_timer_elapsed (timer, NULL);
+    rss_closed = current_rss_kb ();
+    do_test_args (finalized == watched, "book close perf", __FILE__, __LINE__,
+                  "%u of %u finalized", finalized, watched);
+
+    g_type_query (GNC_TYPE_TRANSACTION, &txn_type);
+    g_type_query (GNC_TYPE_SPLIT, &split_type);
+    printf ("Book of %d transactions (%u bytes each) and %d splits "
+            "(%u bytes each), closed %s:\n"
+            "  loaded in %.3fs, RSS %ld kB -> %ld kB, peak %ld kB\n"
+            "  closed in %.3fs, RSS %ld kB\n",
+            num_txns, txn_type.instance_size, 2 * num_txns,
+            split_type.instance_size,
+            old_path ? "one transaction at a time" : "in bulk",
+            load_time, rss_start, rss_loaded, peak, close_time, rss_closed);
+
+    if (be)
+    {
+        qof_backend_destroy (be);
+        g_free (be);
+    }
+    g_timer_destroy (timer);
+}
+
+int
+main (int argc, char** argv)
+{
+    qof_init ();
+    if (!cashobjects_register ())
+        exit (1);
+
+    /* Any tests that cause an error or warning to be printed
+     * automatically fail! */
+    g_log_set_always_fatal ((GLogLevelFlags)(G_LOG_LEVEL_CRITICAL | G_LOG_LEVEL_WARNING));
+
+    test_book_close ();
+    test_book_close_perf ();
+    fflush (stdout);
+    print_test_results ();
+
+    qof_close ();
+    return get_rv ();
+}
@@ -0,0 +1,267 @@
+/********************************************************************\
+ * test-scrub.cpp -- test the scrubs run on a freshly loaded book   *
+ *                                                                  *
+ * This program is free software; you can redistribute it and/or    *
+ * modify it under the terms of the GNU General Public License as   *
+ * published by the Free Software Foundation; either version 2 of   *
+ * the License, or (at your option) any later version.              *
+ *                                                                  *
+ * This program is distributed in the hope that it will be useful,  *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of   *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the    *
+ * GNU General Public License for more details.                     *
+ *                                                                  *
+ * You should have received a copy of the GNU General Public License*
+ * along with this program; if not, contact:                        *
+ *                                                                  *
+ * Free Software Foundation           Voice:  +1-617-542-5942       *
+ * 51 Franklin Street, Fifth Floor    Fax:    +1-617-542-2652       *
+ * Boston, MA  02110-1301,  USA       gnu@gnu.org                   *
+ *                                                                  *
+\********************************************************************/
+extern "C"
+{
+#include "config.h"
+
+#include <glib.h>
+#include <stdlib.h>
+
+#include "qof.h"
+#include "Account.h"
+#include "Scrub.h"
+#include "Transaction.h"
+#include "TransactionP.h"
+#include "gnc-commodity.h"
+#include "cashobjects.h"
+#include "test-stuff.h"
+}
+
+/* Enough transactions for the checks to be spread over threads. */
+#define NUM_TRANSACTIONS (3 * 4096)
+
+enum Fault
+{
+    FAULT_NONE,
+    FAULT_NO_CURRENCY,
+    FAULT_ORPHAN,
+    FAULT_AMOUNT
+};
+
+static Account*
+add_account (QofBook* book, const char* name, gnc_commodity* commodity)
+{
+    auto acct = xaccMallocAccount (book);
+
+    xaccAccountBeginEdit (acct);
+    xaccAccountSetName (acct, name);
+    xaccAccountSetType (acct, ACCT_TYPE_BANK);
+    xaccAccountSetCommodity (acct, commodity);
+    gnc_account_append_child (gnc_book_get_root_account (book), acct);
+    xaccAccountCommitEdit (acct);
+    return acct;
+}
+
+static Split*
+add_split (Transaction* trans, Account* acct, gint64 amount, gint64 value)
+{
+    auto split = xaccMallocSplit (xaccTransGetBook (trans));
+
+    xaccSplitSetParent (split, trans);
+    if (acct)
+        xaccSplitSetAccount (split, acct);
+    xaccSplitSetAmount (split, gnc_numeric_create (amount, 100));
+    xaccSplitSetValue (split, gnc_numeric_create (value, 100));
+    return split;
+}
+
+/* A transaction between checking and expenses, with one of the faults
+ * a book may be loaded with.  Some clean ones go to the travel account
+ * instead, which is in another currency, so that their splits' amounts
+ * and values rightly differ. */
+static Transaction*
+add_transaction (Account* checking, Account* expenses, Account* travel,
+                 gint i, Fault fault)
+{
+    auto book = gnc_account_get_book (checking);
+    auto trans = xaccMallocTransaction (book);
+    gint64 cents = 100 * (i % 50) + 99;
+
+    xaccTransBeginEdit (trans);
+    if (fault != FAULT_NO_CURRENCY)
+        xaccTransSetCurrency (trans, xaccAccountGetCommodity (checking));
+    xaccTransSetDatePostedSecs (trans, 1420070400 + (time64)i * 3600);
+    xaccTransSetDescription (trans, "Load test");
+    add_split (trans, checking, -cents, -cents);
+    if (fault == FAULT_AMOUNT)
+        add_split (trans, expenses, cents + 7, cents);
+    else if (fault == FAULT_ORPHAN)
+        add_split (trans, NULL, cents, cents);
+    else if (fault == FAULT_NONE && i % 3 == 0)
+        add_split (trans, travel, cents * 9 / 10, cents);
+    else
+        add_split (trans, expenses, cents, cents);
+    xaccTransCommitEdit (trans);
+    return trans;
+}
+
+/* Fill a book the way the XML loader does, without the scrubbing that
+ * committing a transaction normally does, with a few faulty
+ * transactions among clean ones. */
+static GPtrArray*
+make_book (QofBook* book)
+{
+    auto table = gnc_commodity_table_get_table (book);
+    auto usd = gnc_commodity_table_lookup (table, GNC_COMMODITY_NS_CURRENCY,
+                                           "USD");
+    auto eur = gnc_commodity_table_lookup (table, GNC_COMMODITY_NS_CURRENCY,
+                                           "EUR");
+    auto checking = add_account (book, "Checking", usd);
+    auto expenses = add_account (book, "Expenses", usd);
+    auto travel = add_account (book, "Travel", eur);
+    auto trans = g_ptr_array_new ();
+
+    xaccDisableDataScrubbing ();
+    for (gint i = 0; i < NUM_TRANSACTIONS; ++i)
+    {
+        Fault fault = FAULT_NONE;
+
+        if (i % 1000 == 17)
+            fault = FAULT_NO_CURRENCY;
+        else if (i % 1000 == 523)
+            fault = FAULT_ORPHAN;
+        else if (i % 1000 == 871)
+            fault = FAULT_AMOUNT;
+        g_ptr_array_add (trans, add_transaction (checking, expenses, travel,
+                                                 i, fault));
+    }
+    xaccEnableDataScrubbing ();
+    return trans;
+}
+
+static gboolean
+same_split (Split* split_1, Split* split_2)
+{
+    auto acct_1 = xaccSplitGetAccount (split_1);
+    auto acct_2 = xaccSplitGetAccount (split_2);
+
+    if (!acct_1 || !acct_2)
+        return !acct_1 && !acct_2;
+    return g_strcmp0 (xaccAccountGetName (acct_1),
+                      xaccAccountGetName (acct_2)) == 0 &&
+           gnc_numeric_equal (xaccSplitGetAmount (split_1),
+                              xaccSplitGetAmount (split_2)) &&
+           gnc_numeric_equal (xaccSplitGetValue (split_1),
+                              xaccSplitGetValue (split_2));
+}
+
+static gboolean
+same_transaction (Transaction* trans_1, Transaction* trans_2)
+{
+    gint n = xaccTransCountSplits (trans_1);
+
+    /* The books' commodities have different namespaces, which
+     * gnc_commodity_equiv compares by address. */
+    if (!gnc_commodity_equal (xaccTransGetCurrency (trans_1),
+                              xaccTransGetCurrency (trans_2)) ||
+        n != xaccTransCountSplits (trans_2))
+        return FALSE;
+    for (gint i = 0; i < n; ++i)
+        if (!same_split (xaccTransGetSplit (trans_1, i),
+                         xaccTransGetSplit (trans_2, i)))
+            return FALSE;
+    return TRUE;
+}
+
+static gboolean
+same_account_names (Account* root_1, Account* root_2)
+{
+    auto accts_1 = gnc_account_get_descendants_sorted (root_1);
+    auto accts_2 = gnc_account_get_descendants_sorted (root_2);
+    GList *node_1, *node_2;
+
+    for (node_1 = accts_1, node_2 = accts_2; node_1 && node_2;
+         node_1 = node_1->next, node_2 = node_2->next)
+        if (g_strcmp0 (xaccAccountGetName (GNC_ACCOUNT (node_1->data)),
+                       xaccAccountGetName (GNC_ACCOUNT (node_2->data))) != 0)
+            break;
+    g_list_free (accts_1);
+    g_list_free (accts_2);
+    return !node_1 && !node_2;
+}
+
+/* xaccAccountTreeScrubAfterLoad must leave a book just as the separate
+ * tree scrubs that loading used to run one after the other do. */
+static void
+test_scrub_after_load (void)
+{
+    auto book_old = qof_book_new ();
+    auto book_new = qof_book_new ();
+    auto trans_old = make_book (book_old);
+    auto trans_new = make_book (book_new);
+    auto root_old = gnc_book_get_root_account (book_old);
+    auto root_new = gnc_book_get_root_account (book_new);
+    guint i, n_same = 0, n_faulty = 0;
+
+    xaccAccountTreeScrubQuoteSources (root_old,
+                                      gnc_commodity_table_get_table (book_old));
+    xaccAccountTreeScrubCommodities (root_old);
+    xaccAccountTreeScrubSplits (root_old);
+
+    xaccAccountTreeScrubAfterLoad (root_new,
+                                   gnc_commodity_table_get_table (book_new));
+
+    for (i = 0; i < trans_new->len; ++i)
+    {
+        auto trans = static_cast<Transaction*> (g_ptr_array_index (trans_new, i));
+        GList* node;
+
+        if (same_transaction (static_cast<Transaction*> (g_ptr_array_index (trans_old, i)),
+                              trans))
+            ++n_same;
+        if (!gnc_commodity_is_currency (xaccTransGetCurrency (trans)))
+            ++n_faulty;
+        for (node = xaccTransGetSplitList (trans); node; node = node->next)
+        {
+            auto split = static_cast<Split*> (node->data);
+            auto acct = xaccSplitGetAccount (split);
+
+            if (!acct)
+                ++n_faulty;
+            else if (gnc_commodity_equiv (xaccAccountGetCommodity (acct),
+                                          xaccTransGetCurrency (trans)) &&
+                     !gnc_numeric_equal (xaccSplitGetAmount (split),
+                                         xaccSplitGetValue (split)))
+                ++n_faulty;
+        }
+    }
+    do_test_args (n_same == trans_new->len, "scrub after load", __FILE__,
+                  __LINE__, "%u of %u transactions as the tree scrubs leave them",
+                  n_same, trans_new->len);
+    do_test_args (n_faulty == 0, "scrub after load fixes", __FILE__, __LINE__,
+                  "%u faults left", n_faulty);
+    do_test (same_account_names (root_old, root_new),
+             "scrub after load makes the same accounts");
+
+    g_ptr_array_free (trans_old, TRUE);
+    g_ptr_array_free (trans_new, TRUE);
+    qof_book_destroy (book_old);
+    qof_book_destroy (book_new);
+}
+
+int
+main (int argc, char** argv)
+{
+    qof_init ();
+    if (!cashobjects_register ())
+        exit (1);
+
+    /* Any tests that cause an error or warning to be printed
+     * automatically fail! */
+    g_log_set_always_fatal ((GLogLevelFlags)(G_LOG_LEVEL_CRITICAL | G_LOG_LEVEL_WARNING));
+
+    test_scrub_after_load ();
+    print_test_results ();
+
+    qof_close ();
+    return get_rv ();
+}
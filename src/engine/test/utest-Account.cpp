@@ -32,7 +32,9 @@ extern "C"
 #include "../Account.h"
 #include "../AccountP.h"
 #include "../Split.h"
+#include "../SplitP.h"
 #include "../Transaction.h"
+#include "../cap-gains.h"
 #include "../gnc-lot.h"
 
 #ifdef HAVE_GLIB_2_38
@@ -1191,6 +1193,16 @@ test_gnc_account_insert_remove_split (Fixture *fixture, gconstpointer pData)
     g_assert (!priv->balance_dirty);
     test_signal_assert_hits (sig1, 4);
     test_signal_assert_hits (sig3, 1);
+    g_assert_cmpint (xaccAccountCountSplits (fixture->acct, FALSE), ==, 2);
+    /* Resorting relinks the list nodes in xaccSplitOrder order. */
+    xaccAccountSortSplits (fixture->acct, TRUE);
+    g_assert (!priv->sort_dirty);
+    g_assert_cmpuint (g_list_length (priv->splits), == , 2);
+    g_assert (priv->splits->prev == NULL);
+    g_assert (priv->splits->next->prev == priv->splits);
+    g_assert_cmpint (xaccSplitOrder (static_cast<Split*>(priv->splits->data),
+                                     static_cast<Split*>(priv->splits->next->data)),
+                     <, 0);
 
     /* Clean up the handlers */
     test_signal_free (sig3);
@@ -1350,6 +1362,164 @@ test_xaccAccountRecomputeBalance (Fixture *fixture, gconstpointer pData)
     g_assert (!priv->balance_dirty);
 }
 
+/* Check that the account's splits are in order and that the running
+ * balances cached in them are the prefix sums of their amounts. */
+static void
+check_running_balances (AccountPrivate *priv)
+{
+    gnc_numeric bal = priv->starting_balance;
+    gnc_numeric clr_bal = priv->starting_cleared_balance;
+    gnc_numeric rec_bal = priv->starting_reconciled_balance;
+    for (GList *node = priv->splits; node; node = node->next)
+    {
+        auto split = static_cast<Split*>(node->data);
+        if (node->next)
+            g_assert_cmpint (xaccSplitOrder (split,
+                                             static_cast<Split*>(node->next->data)),
+                             <, 0);
+        bal = gnc_numeric_add_fixed (bal, split->amount);
+        if (split->reconciled != NREC)
+            clr_bal = gnc_numeric_add_fixed (clr_bal, split->amount);
+        if (split->reconciled == YREC || split->reconciled == FREC)
+            rec_bal = gnc_numeric_add_fixed (rec_bal, split->amount);
+        g_assert (gnc_numeric_eq (split->balance, bal));
+        g_assert (gnc_numeric_eq (split->cleared_balance, clr_bal));
+        g_assert (gnc_numeric_eq (split->reconciled_balance, rec_bal));
+    }
+    g_assert (gnc_numeric_eq (priv->balance, bal));
+}
+
+/* Changing one split only moves that split and recomputes the running
+ * balances from the first position affected. */
+static void
+test_xaccAccountRecomputeBalance_incremental (Fixture *fixture,
+                                              gconstpointer pData)
+{
+    AccountPrivate *priv = fixture->func->get_private (fixture->acct);
+
+    xaccAccountSortSplits (fixture->acct, TRUE);
+    xaccAccountRecomputeBalance (fixture->acct);
+    check_running_balances (priv);
+
+    auto first = static_cast<Split*>(priv->splits->data);
+    auto middle = static_cast<Split*>(g_list_nth_data (priv->splits, 2));
+    auto txn = xaccSplitGetParent (middle);
+
+    /* Move the middle transaction to the end.  The fixture's
+     * transactions aren't fully committed, so bypass
+     * xaccTransCommitEdit's scrubbing as setup does. */
+    qof_begin_edit (QOF_INSTANCE (txn));
+    xaccTransSetDatePostedSecs (txn, gnc_time (NULL) + 24 * 3600 * 30);
+    qof_commit_edit (QOF_INSTANCE (txn));
+    g_assert (priv->sort_dirty);
+    g_assert (!priv->sort_dirty_all);
+    g_assert (g_hash_table_lookup (priv->sort_dirty_splits, middle));
+    g_assert_cmpint (priv->balance_dirty_from, ==, 2);
+    xaccAccountSortSplits (fixture->acct, TRUE);
+    g_assert (!priv->sort_dirty);
+    g_assert_cmpuint (g_hash_table_size (priv->sort_dirty_splits), ==, 0);
+    g_assert (priv->balance_dirty);
+    g_assert_cmpint (priv->balance_dirty_from, ==, 2);
+    xaccAccountRecomputeBalance (fixture->acct);
+    g_assert (g_list_last (priv->splits)->data == middle);
+    g_assert (priv->splits->data == first);
+    check_running_balances (priv);
+
+    /* Change the amount of the first split */
+    txn = xaccSplitGetParent (first);
+    qof_begin_edit (QOF_INSTANCE (txn));
+    xaccSplitSetAmount (first, gnc_numeric_create (100, 1));
+    qof_commit_edit (QOF_INSTANCE (txn));
+    g_assert_cmpint (priv->balance_dirty_from, ==, 0);
+    xaccAccountSortSplits (fixture->acct, TRUE);
+    xaccAccountRecomputeBalance (fixture->acct);
+    g_assert (!priv->balance_dirty);
+    check_running_balances (priv);
+}
+
+/* Edit latency on a large account.  Only run with -m perf. */
+static void
+test_xaccAccountRecomputeBalance_perf (void)
+{
+    if (!g_test_perf ())
+        return;
+
+    const int num_txns = 500000, num_edits = 100;
+    QofBook *book = qof_book_new ();
+    auto curr = gnc_commodity_new (book, "Gnu Rand", "CURRENCY", "GNR", "", 240);
+    auto acct = xaccMallocAccount (book);
+    auto other = xaccMallocAccount (book);
+    auto splits = g_new0 (Split*, num_txns);
+    time64 start = gnc_time (NULL) - (time64)num_txns * 3600;
+    gdouble elapsed;
+
+    xaccAccountSetCommodity (acct, curr);
+    xaccAccountSetCommodity (other, curr);
+    xaccAccountBeginEdit (acct);
+    xaccAccountBeginEdit (other);
+    g_test_timer_start ();
+    for (int i = 0; i < num_txns; ++i)
+    {
+        auto txn = xaccMallocTransaction (book);
+        auto split = xaccMallocSplit (book);
+        auto balancing = xaccMallocSplit (book);
+        gnc_numeric amt = gnc_numeric_create (i % 1000 + 1, 240);
+
+        xaccTransBeginEdit (txn);
+        xaccTransSetCurrency (txn, curr);
+        xaccTransSetDatePostedSecs (txn, start + (time64)i * 3600);
+        xaccSplitSetParent (split, txn);
+        xaccSplitSetAccount (split, acct);
+        xaccSplitSetAmount (split, amt);
+        xaccSplitSetValue (split, amt);
+        xaccSplitSetParent (balancing, txn);
+        xaccSplitSetAccount (balancing, other);
+        xaccSplitSetAmount (balancing, gnc_numeric_neg (amt));
+        xaccSplitSetValue (balancing, gnc_numeric_neg (amt));
+        xaccTransCommitEdit (txn);
+        splits[i] = split;
+    }
+    xaccAccountCommitEdit (acct);
+    xaccAccountCommitEdit (other);
+    elapsed = g_test_timer_elapsed ();
+    g_test_message ("Loaded %d splits in %g s", num_txns, elapsed);
+
+    /* Edit transactions from the last week, the way the register would,
+     * then bring the account up to date. */
+    g_test_timer_start ();
+    for (int i = 0; i < num_edits; ++i)
+    {
+        auto split = splits[num_txns - 1 - (i * 7) % 168];
+        auto txn = xaccSplitGetParent (split);
+        gnc_numeric amt = gnc_numeric_create (i + 1, 240);
+
+        xaccTransBeginEdit (txn);
+        xaccSplitSetAmount (split, amt);
+        xaccSplitSetValue (split, amt);
+        xaccTransSetDatePostedSecs (txn, xaccTransGetDate (txn) - 60);
+        xaccTransCommitEdit (txn);
+        xaccAccountSortSplits (acct, FALSE);
+        xaccAccountRecomputeBalance (acct);
+    }
+    elapsed = g_test_timer_elapsed ();
+    g_test_minimized_result (elapsed / num_edits,
+                             "Edit latency on a %d split account: %g ms",
+                             num_txns, elapsed * 1000 / num_edits);
+
+    g_test_timer_start ();
+    gnc_account_set_sort_dirty (acct);
+    gnc_account_set_balance_dirty (acct);
+    xaccAccountSortSplits (acct, FALSE);
+    xaccAccountRecomputeBalance (acct);
+    elapsed = g_test_timer_elapsed ();
+    g_test_minimized_result (elapsed,
+                             "Full resort and recompute of %d splits: %g ms",
+                             num_txns, elapsed * 1000);
+
+    g_free (splits);
+    qof_book_destroy (book);
+}
+
 /* xaccAccountOrder
 int
 xaccAccountOrder (const Account *aa, const Account *ab)// C: 11 in 3 */
@@ -1952,6 +2122,21 @@ test_xaccAccountGetBalanceAsOfDate (Fixture *fixture, gconstpointer pData)
                                          (gnc_time (NULL) - offset));
     dval = gnc_numeric_to_double (val);
     g_assert_cmpfloat (dval, == , dbal);
+    /* Only the second transaction is cleared and neither is reconciled */
+    val = xaccAccountGetClearedBalanceAsOfDate (fixture->acct,
+                                                (gnc_time (NULL) - offset));
+    g_assert (gnc_numeric_equal (val, t_arr[1].splits[1].amount));
+    val = xaccAccountGetReconciledBalanceAsOfDate (fixture->acct,
+                                                   (gnc_time (NULL) - offset));
+    g_assert (gnc_numeric_zero_p (val));
+    /* Before the first split the balance is zero */
+    val = xaccAccountGetBalanceAsOfDate (fixture->acct,
+                                         (gnc_time (NULL) - 10 * offset));
+    g_assert (gnc_numeric_zero_p (val));
+    /* After the last split it is the account balance */
+    val = xaccAccountGetBalanceAsOfDate (fixture->acct,
+                                         (gnc_time (NULL) + 10 * offset));
+    g_assert (gnc_numeric_equal (val, xaccAccountGetBalance (fixture->acct)));
 }
 /* xaccAccountGetPresentBalance
 gnc_numeric
@@ -2059,6 +2244,148 @@ test_xaccAccountFindOpenLots (Fixture *fixture, gconstpointer pData)
     count_sorts = 0;
 }
 
+/* xaccAccountFindEarliestOpenLot and xaccAccountFindLatestOpenLot are in
+ * cap-gains.c, but search the open lot index of the account. */
+static Split *
+add_lot_split (Account *acct, Account *other, gnc_commodity *curr,
+               time64 date, gint64 amount, GNCLot *lot)
+{
+    auto book = gnc_account_get_book (acct);
+    auto txn = xaccMallocTransaction (book);
+    auto split = xaccMallocSplit (book);
+    auto balancing = xaccMallocSplit (book);
+    gnc_numeric amt = gnc_numeric_create (amount, 100);
+
+    xaccTransBeginEdit (txn);
+    xaccTransSetCurrency (txn, curr);
+    xaccTransSetDatePostedSecs (txn, date);
+    xaccSplitSetParent (split, txn);
+    xaccSplitSetAccount (split, acct);
+    xaccSplitSetAmount (split, amt);
+    xaccSplitSetValue (split, amt);
+    xaccSplitSetParent (balancing, txn);
+    xaccSplitSetAccount (balancing, other);
+    xaccSplitSetAmount (balancing, gnc_numeric_neg (amt));
+    xaccSplitSetValue (balancing, gnc_numeric_neg (amt));
+    xaccTransCommitEdit (txn);
+    gnc_lot_add_split (lot, split);
+    return split;
+}
+
+static void
+test_xaccAccountFindEarliestOpenLot (void)
+{
+    QofBook *book = qof_book_new ();
+    auto gnr = gnc_commodity_new (book, "Gnu Rand", "CURRENCY", "GNR", "", 100);
+    auto eur = gnc_commodity_new (book, "Euro", "CURRENCY", "EUR", "", 100);
+    auto acct = xaccMallocAccount (book);
+    auto other = xaccMallocAccount (book);
+    time64 day = 24 * 3600, start = gnc_time (NULL) - 30 * day;
+    gnc_numeric sell = gnc_numeric_create (-1, 1);
+    gnc_numeric buy = gnc_numeric_create (1, 1);
+    auto lot_a = gnc_lot_new (book), lot_b = gnc_lot_new (book);
+    auto lot_c = gnc_lot_new (book), lot_d = gnc_lot_new (book);
+    auto lot_e = gnc_lot_new (book);
+    Split *closing, *split_c;
+
+    xaccAccountSetCommodity (acct, gnr);
+    xaccAccountSetCommodity (other, gnr);
+    add_lot_split (acct, other, gnr, start + day, 1000, lot_a);
+    add_lot_split (acct, other, gnr, start + 3 * day, 500, lot_b);
+    split_c = add_lot_split (acct, other, eur, start + 2 * day, 700, lot_c);
+    add_lot_split (acct, other, gnr, start, -300, lot_d);
+
+    g_assert (xaccAccountFindEarliestOpenLot (acct, sell, gnr) == lot_a);
+    g_assert (xaccAccountFindEarliestOpenLot (acct, sell, NULL) == lot_a);
+    g_assert (xaccAccountFindEarliestOpenLot (acct, sell, eur) == lot_c);
+    g_assert (xaccAccountFindLatestOpenLot (acct, sell, gnr) == lot_b);
+    g_assert (xaccAccountFindLatestOpenLot (acct, sell, NULL) == lot_b);
+    g_assert (xaccAccountFindEarliestOpenLot (acct, buy, NULL) == lot_d);
+    g_assert (xaccAccountFindLatestOpenLot (acct, buy, eur) == NULL);
+
+    /* Closing a lot takes it out, reopening it puts it back. */
+    closing = add_lot_split (acct, other, gnr, start + 4 * day, -1000, lot_a);
+    g_assert (gnc_lot_is_closed (lot_a));
+    g_assert (xaccAccountFindEarliestOpenLot (acct, sell, gnr) == lot_b);
+    gnc_lot_remove_split (lot_a, closing);
+    g_assert (xaccAccountFindEarliestOpenLot (acct, sell, gnr) == lot_a);
+
+    /* Moving the opening transaction moves the lot. */
+    xaccTransBeginEdit (xaccSplitGetParent (split_c));
+    xaccTransSetDatePostedSecs (xaccSplitGetParent (split_c), start);
+    xaccTransCommitEdit (xaccSplitGetParent (split_c));
+    g_assert (xaccAccountFindEarliestOpenLot (acct, sell, NULL) == lot_c);
+    g_assert (xaccAccountFindLatestOpenLot (acct, sell, NULL) == lot_b);
+
+    /* Of lots opened together the one added last wins either way, as
+     * it did when the lot list was walked. */
+    add_lot_split (acct, other, gnr, start + day, 100, lot_e);
+    g_assert (xaccAccountFindEarliestOpenLot (acct, sell, gnr) == lot_e);
+    add_lot_split (acct, other, gnr, start + 3 * day, -500, lot_b);
+    g_assert (xaccAccountFindLatestOpenLot (acct, sell, gnr) == lot_e);
+
+    qof_book_destroy (book);
+}
+
+/* Lot assignment on an account with a long history.  Only run with
+ * -m perf. */
+static void
+test_xaccAccountFindEarliestOpenLot_perf (void)
+{
+    if (!g_test_perf ())
+        return;
+
+    const int num_lots = 50000, num_open = 2000, num_sales = 1000;
+    QofBook *book = qof_book_new ();
+    auto curr = gnc_commodity_new (book, "Gnu Rand", "CURRENCY", "GNR", "", 100);
+    auto acct = xaccMallocAccount (book);
+    auto other = xaccMallocAccount (book);
+    time64 start = gnc_time (NULL) - (time64)num_lots * 2 * 3600;
+    time64 last = 0;
+    gnc_numeric sell = gnc_numeric_create (-1, 1);
+    gdouble elapsed;
+
+    xaccAccountSetCommodity (acct, curr);
+    xaccAccountSetCommodity (other, curr);
+    xaccAccountBeginEdit (acct);
+    xaccAccountBeginEdit (other);
+    g_test_timer_start ();
+    for (int i = 0; i < num_lots; ++i)
+    {
+        auto lot = gnc_lot_new (book);
+        time64 date = start + (time64)i * 2 * 3600;
+
+        add_lot_split (acct, other, curr, date, i % 1000 + 1, lot);
+        if (i < num_lots - num_open)
+            add_lot_split (acct, other, curr, date + 3600, -(i % 1000 + 1), lot);
+    }
+    xaccAccountCommitEdit (acct);
+    xaccAccountCommitEdit (other);
+    elapsed = g_test_timer_elapsed ();
+    g_test_message ("Loaded %d lots in %g s", num_lots, elapsed);
+
+    /* Sell out the oldest lots one at a time, the way the FIFO policy
+     * does on each commit. */
+    g_test_timer_start ();
+    for (int i = 0; i < num_sales; ++i)
+    {
+        auto lot = xaccAccountFindEarliestOpenLot (acct, sell, curr);
+        auto opening = gnc_lot_get_earliest_split (lot);
+        time64 date = xaccTransGetDate (xaccSplitGetParent (opening));
+
+        g_assert (date >= last);
+        last = date;
+        add_lot_split (acct, other, curr, date + 3600,
+                       -gnc_lot_get_balance (lot).num, lot);
+    }
+    elapsed = g_test_timer_elapsed ();
+    g_test_minimized_result (elapsed / num_sales,
+                             "Sale latency on a %d lot account: %g ms",
+                             num_lots, elapsed * 1000 / num_sales);
+
+    qof_book_destroy (book);
+}
+
 static gpointer
 bogus_for_each_lot_func (GNCLot *lot, gpointer data)
 {
@@ -2353,6 +2680,45 @@ test_xaccAccountFindTransByDesc (Fixture *fixture, gconstpointer pData)
     g_assert_cmpstr (desc, == , "pepper");
     g_free (desc);
 }
+/* xaccAccountFindSplitByOnlineId
+Split *
+xaccAccountFindSplitByOnlineId (Account *acc, const char *online_id,
+                                const Split *exclude)*/
+static void
+test_xaccAccountFindSplitByOnlineId (Fixture *fixture, gconstpointer pData)
+{
+    Account *root = gnc_account_get_root (fixture->acct);
+    Account *baz = gnc_account_lookup_by_name (root, "baz");
+    Split *split = xaccAccountFindSplitByDesc (baz, "pepper");
+    Transaction *txn = xaccSplitGetParent (split);
+
+    /* Builds the index before any ids are set. */
+    g_assert (!xaccAccountFindSplitByOnlineId (baz, "x123", NULL));
+
+    qof_instance_increase_editlevel (txn);
+    g_object_set (split, "online-id", "x123", NULL);
+    qof_instance_decrease_editlevel (txn);
+    g_assert (xaccAccountFindSplitByOnlineId (baz, "x123", NULL) == split);
+    g_assert (!xaccAccountFindSplitByOnlineId (baz, "x123", split));
+    g_assert (!xaccAccountFindSplitByOnlineId (root, "x123", NULL));
+
+    /* The split's own id wins over the transaction's... */
+    qof_instance_increase_editlevel (txn);
+    g_object_set (txn, "online-id", "t456", NULL);
+    qof_instance_decrease_editlevel (txn);
+    g_assert (!xaccAccountFindSplitByOnlineId (baz, "t456", NULL));
+    /* ...but without one it goes by the transaction's. */
+    qof_instance_increase_editlevel (txn);
+    g_object_set (split, "online-id", "", NULL);
+    qof_instance_decrease_editlevel (txn);
+    g_assert (!xaccAccountFindSplitByOnlineId (baz, "x123", NULL));
+    g_assert (xaccAccountFindSplitByOnlineId (baz, "t456", NULL) == split);
+
+    g_assert (gnc_account_remove_split (baz, split));
+    g_assert (!xaccAccountFindSplitByOnlineId (baz, "t456", NULL));
+    g_assert (gnc_account_insert_split (baz, split));
+    g_assert (xaccAccountFindSplitByOnlineId (baz, "t456", NULL) == split);
+}
 /* gnc_account_join_children
 void
 gnc_account_join_children (Account *to_parent, Account *from_parent)// C: 4 in 2 SCM: 3 in 3*/
@@ -2553,6 +2919,8 @@ test_suite_account (void)
     GNC_TEST_ADD (suitename, "gnc account insert & remove split", Fixture, NULL, setup, test_gnc_account_insert_remove_split,  teardown );
     GNC_TEST_ADD (suitename, "xaccAccount Insert and Remove Lot", Fixture, &good_data, setup, test_xaccAccountInsertRemoveLot,  teardown );
     GNC_TEST_ADD (suitename, "xaccAccountRecomputeBalance", Fixture, &some_data, setup, test_xaccAccountRecomputeBalance,  teardown );
+    GNC_TEST_ADD (suitename, "xaccAccountRecomputeBalance incremental", Fixture, &some_data, setup, test_xaccAccountRecomputeBalance_incremental,  teardown );
+    GNC_TEST_ADD_FUNC (suitename, "xaccAccountRecomputeBalance perf", test_xaccAccountRecomputeBalance_perf);
     GNC_TEST_ADD_FUNC (suitename, "xaccAccountOrder", test_xaccAccountOrder );
     GNC_TEST_ADD (suitename, "qofAccountSetParent", Fixture, &some_data, setup, test_qofAccountSetParent,  teardown );
     GNC_TEST_ADD (suitename, "gnc account append/remove child", Fixture, NULL, setup, test_gnc_account_append_remove_child,  teardown );
@@ -2573,6 +2941,8 @@ test_suite_account (void)
     GNC_TEST_ADD (suitename, "xaccAccountGetBalanceAsOfDate", Fixture, &some_data, setup, test_xaccAccountGetBalanceAsOfDate,  teardown );
     GNC_TEST_ADD (suitename, "xaccAccountGetPresentBalance", Fixture, &some_data, setup, test_xaccAccountGetPresentBalance,  teardown );
     GNC_TEST_ADD (suitename, "xaccAccountFindOpenLots", Fixture, &complex_data, setup, test_xaccAccountFindOpenLots,  teardown );
+    GNC_TEST_ADD_FUNC (suitename, "xaccAccountFindEarliestOpenLot", test_xaccAccountFindEarliestOpenLot);
+    GNC_TEST_ADD_FUNC (suitename, "xaccAccountFindEarliestOpenLot perf", test_xaccAccountFindEarliestOpenLot_perf);
     GNC_TEST_ADD (suitename, "xaccAccountForEachLot", Fixture, &complex_data, setup, test_xaccAccountForEachLot,  teardown );
 
     GNC_TEST_ADD (suitename, "xaccAccountHasAncestor", Fixture, &complex, setup, test_xaccAccountHasAncestor,  teardown );
@@ -2580,6 +2950,7 @@ test_suite_account (void)
     GNC_TEST_ADD_FUNC (suitename, "AccountType Compatibility", test_xaccAccountType_Compatibility);
     GNC_TEST_ADD (suitename, "xaccAccountFindSplitByDesc", Fixture, &complex_data, setup, test_xaccAccountFindSplitByDesc,  teardown );
     GNC_TEST_ADD (suitename, "xaccAccountFindTransByDesc", Fixture, &complex_data, setup, test_xaccAccountFindTransByDesc,  teardown );
+    GNC_TEST_ADD (suitename, "xaccAccountFindSplitByOnlineId", Fixture, &complex_data, setup, test_xaccAccountFindSplitByOnlineId,  teardown );
     GNC_TEST_ADD (suitename, "gnc account join children", Fixture, &complex, setup, test_gnc_account_join_children,  teardown );
     GNC_TEST_ADD (suitename, "gnc account merge children", Fixture, &complex_data, setup, test_gnc_account_merge_children,  teardown );
     GNC_TEST_ADD (suitename, "xaccAccountForEachTransaction", Fixture, &complex_data, setup, test_xaccAccountForEachTransaction,  teardown );
@@ -102,6 +102,8 @@ setup (Fixture *fixture, gconstpointer pData)
     qof_instance_mark_clean (QOF_INSTANCE (acc));
     qof_instance_mark_clean (QOF_INSTANCE (txn));
     fixture->hdlrs = NULL;
+    /* PINFO only logs when the module is at least at INFO. */
+    qof_log_set_level ("gnc.engine", QOF_LOG_INFO);
 }
 
 static void
@@ -122,6 +124,7 @@ teardown (Fixture *fixture, gconstpointer pData)
     g_free (fixture->func);
     g_slist_free_full (fixture->hdlrs, test_free_log_handler);
     test_clear_error_list();
+    qof_log_set_level ("gnc.engine", QOF_LOG_WARNING);
 }
 
 /* gnc_split_init
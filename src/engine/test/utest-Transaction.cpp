@@ -170,6 +170,8 @@ setup (Fixture *fixture, gconstpointer pData)
     qof_instance_mark_clean (QOF_INSTANCE (txn));
     fixture->func = _utest_trans_fill_functions();
     fixture->hdlrs = NULL;
+    /* PINFO only logs when the module is at least at INFO. */
+    qof_log_set_level ("gnc.engine", QOF_LOG_INFO);
 }
 
 static void
@@ -222,6 +224,7 @@ teardown (Fixture *fixture, gconstpointer pData)
     qof_book_destroy(book);
     g_slist_free_full (fixture->hdlrs, test_free_log_handler);
     test_clear_error_list();
+    qof_log_set_level ("gnc.engine", QOF_LOG_WARNING);
 }
 
 static void
@@ -1358,6 +1361,7 @@ test_xaccTransBeginEdit ()
                                     (GLogFunc)test_list_handler, NULL);
     test_add_error (check1);
     test_add_error (check2);
+    qof_log_set_level (logdomain, QOF_LOG_INFO);
 
 
     g_assert_cmpint (0, ==, qof_instance_get_editlevel (QOF_INSTANCE (txn)));
@@ -1395,6 +1399,7 @@ test_xaccTransBeginEdit ()
     g_assert_cmpint (2, ==, check2->hits);
 
     g_log_remove_handler (logdomain, hdlr);
+    qof_log_set_level (logdomain, QOF_LOG_WARNING);
     test_clear_error_list ();
     test_error_struct_free (check1);
     test_error_struct_free (check2);
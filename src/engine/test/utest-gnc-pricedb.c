@@ -697,6 +697,95 @@ gnc_pricedb_add_price(GNCPriceDB *db, GNCPrice *p)// C: 7 in 7 SCM: 1  Local: 0:
 test_gnc_pricedb_add_price (Fixture *fixture, gconstpointer pData)
 {
 }*/
+/* gnc_pricedb_add_prices
+guint
+gnc_pricedb_add_prices(GNCPriceDB *db, PriceList *prices)
+*/
+static void
+test_gnc_pricedb_add_prices (PriceDBFixture *fixture, gconstpointer pData)
+{
+    GNCPriceDB *db = fixture->pricedb;
+    QofBook *book = qof_instance_get_book(QOF_INSTANCE(db));
+    Commodities *c = fixture->com;
+    Timespec t_new = gnc_dmy2timespec(5, 5, 2015);
+    Timespec t_old = gnc_dmy2timespec(12, 11, 2014);
+    GNCPrice *fq = construct_price(book, c->usd, c->aud, t_new,
+                                   PRICE_SOURCE_FQ,
+                                   gnc_numeric_create(120000, 100000));
+    GNCPrice *edit = construct_price(book, c->usd, c->aud, t_new,
+                                     PRICE_SOURCE_EDIT_DLG,
+                                     gnc_numeric_create(121000, 100000));
+    GNCPrice *replace = construct_price(book, c->usd, c->aud, t_old,
+                                        PRICE_SOURCE_FQ,
+                                        gnc_numeric_create(115000, 100000));
+    GNCPrice *xfer = construct_price(book, c->usd, c->aud, t_old,
+                                     PRICE_SOURCE_XFER_DLG_VAL,
+                                     gnc_numeric_create(116000, 100000));
+    GList *prices = NULL;
+
+    prices = g_list_prepend(prices, xfer);
+    prices = g_list_prepend(prices, replace);
+    prices = g_list_prepend(prices, edit);
+    prices = g_list_prepend(prices, fq);
+    /* The editor's price beats Finance::Quote's of the same day, the new
+     * quote replaces the one already there and the transfer dialog's
+     * price loses to it. */
+    g_assert_cmpuint(gnc_pricedb_add_prices(db, prices), ==, 2);
+    g_assert_cmpint(gnc_pricedb_get_num_prices(db), ==, 33);
+    g_assert(gnc_pricedb_lookup_day(db, c->usd, c->aud, t_new) == edit);
+    g_assert(gnc_pricedb_lookup_day(db, c->usd, c->aud, t_old) == replace);
+    g_assert(gnc_pricedb_lookup_latest(db, c->usd, c->aud) == edit);
+    g_assert(fq->db == NULL);
+    g_assert(xfer->db == NULL);
+    g_list_free(prices);
+}
+
+/* A price quoted the other way round stands for the same day. */
+static void
+test_gnc_pricedb_add_prices_inverse (PriceDBFixture *fixture, gconstpointer pData)
+{
+    GNCPriceDB *db = fixture->pricedb;
+    QofBook *book = qof_instance_get_book(QOF_INSTANCE(db));
+    Commodities *c = fixture->com;
+    Timespec t_new = gnc_dmy2timespec(6, 5, 2015);
+    Timespec t_old = gnc_dmy2timespec(12, 11, 2014);
+    Timespec t_kept = gnc_dmy2timespec(1, 8, 2013);
+    GNCPrice *old_price = gnc_pricedb_lookup_day(db, c->usd, c->aud, t_old);
+    GNCPrice *kept = gnc_pricedb_lookup_day(db, c->usd, c->aud, t_kept);
+    GNCPrice *replace = construct_price(book, c->aud, c->usd, t_old,
+                                        PRICE_SOURCE_FQ,
+                                        gnc_numeric_create(87000, 100000));
+    GNCPrice *xfer = construct_price(book, c->aud, c->usd, t_kept,
+                                     PRICE_SOURCE_XFER_DLG_VAL,
+                                     gnc_numeric_create(89000, 100000));
+    GNCPrice *edit = construct_price(book, c->usd, c->aud, t_new,
+                                     PRICE_SOURCE_EDIT_DLG,
+                                     gnc_numeric_create(121000, 100000));
+    GNCPrice *fq = construct_price(book, c->aud, c->usd, t_new,
+                                   PRICE_SOURCE_FQ,
+                                   gnc_numeric_create(83000, 100000));
+    GList *prices = NULL;
+
+    g_assert(old_price != NULL && kept != NULL);
+    prices = g_list_prepend(prices, fq);
+    prices = g_list_prepend(prices, edit);
+    prices = g_list_prepend(prices, xfer);
+    prices = g_list_prepend(prices, replace);
+    /* The reverse quote replaces the day's price, the transfer dialog's
+     * loses to the quote already there and of the two new prices of one
+     * day quoted opposite ways the editor's wins. */
+    g_assert_cmpuint(gnc_pricedb_add_prices(db, prices), ==, 2);
+    g_assert_cmpint(gnc_pricedb_get_num_prices(db), ==, 33);
+    g_assert(gnc_pricedb_lookup_day(db, c->usd, c->aud, t_old) == replace);
+    g_assert(gnc_pricedb_lookup_day(db, c->aud, c->usd, t_old) == replace);
+    g_assert(gnc_pricedb_lookup_day(db, c->usd, c->aud, t_kept) == kept);
+    g_assert(gnc_pricedb_lookup_day(db, c->usd, c->aud, t_new) == edit);
+    g_assert(gnc_pricedb_lookup_day(db, c->aud, c->usd, t_new) == edit);
+    g_assert(old_price->db == NULL);
+    g_assert(xfer->db == NULL);
+    g_assert(fq->db == NULL);
+    g_list_free(prices);
+}
 /* remove_price
 static gboolean
 remove_price(GNCPriceDB *db, GNCPrice *p, gboolean cleanup)// Local: 4:0:0
@@ -709,10 +798,29 @@ test_remove_price (Fixture *fixture, gconstpointer pData)
 gboolean
 gnc_pricedb_remove_price(GNCPriceDB *db, GNCPrice *p)// C: 2 in 2  Local: 1:0:0
 */
-/* static void
-test_gnc_pricedb_remove_price (Fixture *fixture, gconstpointer pData)
+static void
+test_gnc_pricedb_remove_price (PriceDBFixture *fixture, gconstpointer pData)
 {
-}*/
+    GNCPriceDB *db = fixture->pricedb;
+    QofBook *book = qof_instance_get_book(QOF_INSTANCE(db));
+    Commodities *c = fixture->com;
+    Timespec t = gnc_dmy2timespec(12, 11, 2014);
+    GNCPrice *stray = construct_price(book, c->usd, c->aud, t,
+                                      PRICE_SOURCE_FQ,
+                                      gnc_numeric_create(114784, 100000));
+    GNCPrice *price;
+
+    /* A price that was never added can't be removed. */
+    g_assert(!gnc_pricedb_remove_price(db, stray));
+    g_assert_cmpint(gnc_pricedb_get_num_prices(db), ==, 32);
+
+    price = gnc_pricedb_lookup_day(db, c->usd, c->aud, t);
+    g_assert(price != NULL && price != stray);
+    g_assert(gnc_pricedb_remove_price(db, price));
+    g_assert_cmpint(gnc_pricedb_get_num_prices(db), ==, 31);
+    g_assert(gnc_pricedb_lookup_day(db, c->usd, c->aud, t) == NULL);
+    gnc_price_unref(price);
+}
 /* check_one_price_date
 static gboolean
 check_one_price_date (GNCPrice *price, gpointer user_data)// Local: 0:1:0
@@ -985,11 +1093,32 @@ test_gnc_pricedb_lookup_day (PriceDBFixture *fixture, gconstpointer pData)
     g_assert(price == NULL);
 }
 
-// Not Used
 /* gnc_pricedb_lookup_at_time
 GNCPrice *
 gnc_pricedb_lookup_at_time(GNCPriceDB *db,// Local: 0:0:0
 */
+static void
+test_gnc_pricedb_lookup_at_time (PriceDBFixture *fixture, gconstpointer pData)
+{
+    Timespec t = gnc_dmy2timespec(1, 8, 2013);
+    GNCPrice *price = gnc_pricedb_lookup_at_time(fixture->pricedb,
+                                                 fixture->com->usd,
+                                                 fixture->com->aud, t);
+    g_assert_cmpstr(GET_COM_NAME(price), ==, "USD");
+    g_assert_cmpstr(GET_CUR_NAME(price), ==, "AUD");
+    g_assert(timespec_equal(&price->tmspec, &t));
+    /* Stored the other way around */
+    t = gnc_dmy2timespec(20, 7, 2011);
+    price = gnc_pricedb_lookup_at_time(fixture->pricedb, fixture->com->usd,
+                                       fixture->com->aud, t);
+    g_assert_cmpstr(GET_COM_NAME(price), ==, "AUD");
+    g_assert_cmpstr(GET_CUR_NAME(price), ==, "USD");
+    g_assert(timespec_equal(&price->tmspec, &t));
+    t = gnc_dmy2timespec(2, 8, 2013);
+    price = gnc_pricedb_lookup_at_time(fixture->pricedb, fixture->com->usd,
+                                       fixture->com->aud, t);
+    g_assert(price == NULL);
+}
 /* lookup_nearest_in_time
 static GNCPrice *
 lookup_nearest_in_time(GNCPriceDB *db,// Local: 2:0:0
@@ -1017,11 +1146,83 @@ test_gnc_pricedb_lookup_nearest_in_time (PriceDBFixture *fixture, gconstpointer
     g_assert_cmpstr(GET_CUR_NAME(price), ==, "AUD");
     g_assert_cmpstr(GET_COM_NAME(price), ==, "USD");
 }
-// Not Used
+/* Prices of the same instant quoted in both directions are taken in the
+ * order of their GUIDs, as they were when the two directions were merged
+ * into one list sorted by compare_prices_by_date. */
+static void
+test_gnc_pricedb_lookup_nearest_in_time_tie (PriceDBFixture *fixture, gconstpointer pData)
+{
+    GNCPriceDB *db = fixture->pricedb;
+    QofBook *book = qof_instance_get_book(QOF_INSTANCE(db));
+    Commodities *c = fixture->com;
+    Timespec t = gnc_dmy2timespec(3, 3, 2015);
+    Timespec before = gnc_dmy2timespec(2, 3, 2015);
+    Timespec after = gnc_dmy2timespec(4, 3, 2015);
+    GNCPrice *forward = construct_price(book, c->usd, c->aud, t,
+                                        PRICE_SOURCE_FQ,
+                                        gnc_numeric_create(120000, 100000));
+    GNCPrice *reverse = construct_price(book, c->aud, c->usd, t,
+                                        PRICE_SOURCE_FQ,
+                                        gnc_numeric_create(83000, 100000));
+    GNCPrice *first, *last;
+
+    /* Bulk update lets both of the day's prices in. */
+    gnc_pricedb_set_bulk_update(db, TRUE);
+    gnc_pricedb_add_price(db, forward);
+    gnc_pricedb_add_price(db, reverse);
+    gnc_pricedb_set_bulk_update(db, FALSE);
+
+    if (guid_compare(gnc_price_get_guid(forward),
+                     gnc_price_get_guid(reverse)) < 0)
+    {
+        first = forward;
+        last = reverse;
+    }
+    else
+    {
+        first = reverse;
+        last = forward;
+    }
+
+    /* At or after the instant the first of them is the latest not later
+     * than the time asked for; before it the last of them is the earliest
+     * later one. */
+    g_assert(gnc_pricedb_lookup_nearest_in_time(db, c->usd, c->aud, t) == first);
+    g_assert(gnc_pricedb_lookup_nearest_in_time(db, c->aud, c->usd, t) == first);
+    g_assert(gnc_pricedb_lookup_nearest_in_time(db, c->usd, c->aud, after) == first);
+    g_assert(gnc_pricedb_lookup_nearest_in_time(db, c->aud, c->usd, after) == first);
+    g_assert(gnc_pricedb_lookup_nearest_in_time(db, c->usd, c->aud, before) == last);
+    g_assert(gnc_pricedb_lookup_nearest_in_time(db, c->aud, c->usd, before) == last);
+}
 /* gnc_pricedb_lookup_latest_before
 GNCPrice *
 gnc_pricedb_lookup_latest_before (GNCPriceDB *db,// Local: 0:0:0
 */
+static void
+test_gnc_pricedb_lookup_latest_before (PriceDBFixture *fixture, gconstpointer pData)
+{
+    Timespec t = gnc_dmy2timespec(1, 1, 2012);
+    Timespec t_price = gnc_dmy2timespec(20, 7, 2011);
+    GNCPrice *price = gnc_pricedb_lookup_latest_before(fixture->pricedb,
+                                                       fixture->com->usd,
+                                                       fixture->com->aud, t);
+    g_assert_cmpstr(GET_COM_NAME(price), ==, "AUD");
+    g_assert_cmpstr(GET_CUR_NAME(price), ==, "USD");
+    g_assert(timespec_equal(&price->tmspec, &t_price));
+    t = gnc_dmy2timespec(1, 1, 2014);
+    t_price = gnc_dmy2timespec(1, 8, 2013);
+    price = gnc_pricedb_lookup_latest_before(fixture->pricedb,
+                                             fixture->com->usd,
+                                             fixture->com->aud, t);
+    g_assert_cmpstr(GET_COM_NAME(price), ==, "USD");
+    g_assert_cmpstr(GET_CUR_NAME(price), ==, "AUD");
+    g_assert(timespec_equal(&price->tmspec, &t_price));
+    t = gnc_dmy2timespec(1, 1, 2009);
+    price = gnc_pricedb_lookup_latest_before(fixture->pricedb,
+                                             fixture->com->usd,
+                                             fixture->com->aud, t);
+    g_assert(price == NULL);
+}
 /* direct_balance_conversion
 static gnc_numeric
 direct_balance_conversion (GNCPriceDB *db, gnc_numeric bal,// Local: 2:0:0
@@ -1128,6 +1329,45 @@ test_gnc_pricedb_convert_balance_nearest_price (PriceDBFixture *fixture, gconstp
     g_assert_cmpint(result.denom, ==, 100);
 
 }
+
+static void
+test_gnc_pricedb_convert_balance_cache (PriceDBFixture *fixture, gconstpointer pData)
+{
+    Timespec t = gnc_dmy2timespec(15, 8, 2011);
+    gnc_numeric from = gnc_numeric_create(10000, 100);
+    QofBook *book = qof_instance_get_book(QOF_INSTANCE(fixture->pricedb));
+    gnc_numeric result;
+    int i;
+
+    for (i = 0; i < 3; i++)
+    {
+        result = gnc_pricedb_convert_balance_nearest_price(fixture->pricedb,
+                                                           from,
+                                                           fixture->com->usd,
+                                                           fixture->com->eur,
+                                                           t);
+        g_assert_cmpint(result.num, ==, 7009);
+    }
+    g_assert_cmpint(g_hash_table_size(fixture->pricedb->rate_cache), ==, 1);
+
+    /* A new price on the path replaces the cached rate. */
+    gnc_pricedb_add_price(fixture->pricedb,
+                          construct_price(book, fixture->com->gbp,
+                                          fixture->com->eur, t,
+                                          PRICE_SOURCE_FQ,
+                                          gnc_numeric_create(15, 10)));
+    g_assert(fixture->pricedb->rate_cache == NULL);
+    result = gnc_pricedb_convert_balance_nearest_price(fixture->pricedb, from,
+                                                       fixture->com->usd,
+                                                       fixture->com->eur, t);
+    g_assert_cmpint(result.num, ==, 9280);
+    g_assert_cmpint(result.denom, ==, 100);
+    /* No path at all */
+    result = gnc_pricedb_convert_balance_nearest_price(fixture->pricedb, from,
+                                                       fixture->com->usd,
+                                                       fixture->com->bgn, t);
+    g_assert(gnc_numeric_zero_p(result));
+}
 /* pricedb_foreach_pricelist
 static void
 pricedb_foreach_pricelist(gpointer key, gpointer val, gpointer user_data)// Local: 0:1:0
@@ -1354,8 +1594,10 @@ test_suite_gnc_pricedb (void)
 // GNC_TEST_ADD (suitename, "insert or replace price", Fixture, NULL, setup, test_insert_or_replace_price, teardown);
 // GNC_TEST_ADD (suitename, "add price", Fixture, NULL, setup, test_add_price, teardown);
 // GNC_TEST_ADD (suitename, "gnc pricedb add price", Fixture, NULL, setup, test_gnc_pricedb_add_price, teardown);
+    GNC_TEST_ADD (suitename, "gnc pricedb add prices", PriceDBFixture, NULL, setup, test_gnc_pricedb_add_prices, teardown);
+    GNC_TEST_ADD (suitename, "gnc pricedb add prices inverse", PriceDBFixture, NULL, setup, test_gnc_pricedb_add_prices_inverse, teardown);
 // GNC_TEST_ADD (suitename, "remove price", Fixture, NULL, setup, test_remove_price, teardown);
-// GNC_TEST_ADD (suitename, "gnc pricedb remove price", Fixture, NULL, setup, test_gnc_pricedb_remove_price, teardown);
+    GNC_TEST_ADD (suitename, "gnc pricedb remove price", PriceDBFixture, NULL, setup, test_gnc_pricedb_remove_price, teardown);
 // GNC_TEST_ADD (suitename, "check one price date", Fixture, NULL, setup, test_check_one_price_date, teardown);
 // GNC_TEST_ADD (suitename, "pricedb remove foreach pricelist", Fixture, NULL, setup, test_pricedb_remove_foreach_pricelist, teardown);
 // GNC_TEST_ADD (suitename, "pricedb remove foreach currencies hash", Fixture, NULL, setup, test_pricedb_remove_foreach_currencies_hash, teardown);
@@ -1376,14 +1618,18 @@ test_suite_gnc_pricedb (void)
     GNC_TEST_ADD (suitename, "gnc pricedb has prices", PriceDBFixture, NULL, setup, test_gnc_pricedb_has_prices, teardown);
     GNC_TEST_ADD (suitename, "gnc pricedb get prices", PriceDBFixture, NULL, setup, test_gnc_pricedb_get_prices, teardown);
     GNC_TEST_ADD (suitename, "gnc pricedb lookup day", PriceDBFixture, NULL, setup, test_gnc_pricedb_lookup_day, teardown);
+    GNC_TEST_ADD (suitename, "gnc pricedb lookup at time", PriceDBFixture, NULL, setup, test_gnc_pricedb_lookup_at_time, teardown);
 // GNC_TEST_ADD (suitename, "lookup nearest in time", Fixture, NULL, setup, test_lookup_nearest_in_time, teardown);
     GNC_TEST_ADD (suitename, "gnc pricedb lookup nearest in time", PriceDBFixture, NULL, setup, test_gnc_pricedb_lookup_nearest_in_time, teardown);
+    GNC_TEST_ADD (suitename, "gnc pricedb lookup nearest in time tie", PriceDBFixture, NULL, setup, test_gnc_pricedb_lookup_nearest_in_time_tie, teardown);
+    GNC_TEST_ADD (suitename, "gnc pricedb lookup latest before", PriceDBFixture, NULL, setup, test_gnc_pricedb_lookup_latest_before, teardown);
 // GNC_TEST_ADD (suitename, "direct balance conversion", Fixture, NULL, setup, test_direct_balance_conversion, teardown);
 // GNC_TEST_ADD (suitename, "extract common prices", Fixture, NULL, setup, test_extract_common_prices, teardown);
 // GNC_TEST_ADD (suitename, "convert balance", Fixture, NULL, setup, test_convert_balance, teardown);
 // GNC_TEST_ADD (suitename, "indirect balance conversion", Fixture, NULL, setup, test_indirect_balance_conversion, teardown);
     GNC_TEST_ADD (suitename, "gnc pricedb convert balance latest price", PriceDBFixture, NULL, setup, test_gnc_pricedb_convert_balance_latest_price, teardown);
     GNC_TEST_ADD (suitename, "gnc pricedb convert balance nearest price", PriceDBFixture, NULL, setup, test_gnc_pricedb_convert_balance_nearest_price, teardown);
+    GNC_TEST_ADD (suitename, "gnc pricedb convert balance cache", PriceDBFixture, NULL, setup, test_gnc_pricedb_convert_balance_cache, teardown);
 // GNC_TEST_ADD (suitename, "pricedb foreach pricelist", Fixture, NULL, setup, test_pricedb_foreach_pricelist, teardown);
 // GNC_TEST_ADD (suitename, "pricedb foreach currencies hash", Fixture, NULL, setup, test_pricedb_foreach_currencies_hash, teardown);
 // GNC_TEST_ADD (suitename, "unstable price traversal", Fixture, NULL, setup, test_unstable_price_traversal, teardown);
@@ -806,6 +806,125 @@ static void split_find_match (GNCImportTransInfo * trans_info,
 }/* end split_find_match */
 
 
+/* A split of an import account that imported transactions may match. */
+typedef struct
+{
+    time64 date;
+    Split *split;
+} MatchCandidate;
+
+static gint
+compare_candidate_date (gconstpointer a, gconstpointer b)
+{
+    time64 date_a = ((const MatchCandidate *)a)->date;
+    time64 date_b = ((const MatchCandidate *)b)->date;
+
+    return date_a < date_b ? -1 : date_a > date_b ? 1 : 0;
+}
+
+/* Score those of the candidates, sorted by date, that lie within
+   match_date_hardlimit days of the imported transaction. */
+static void
+find_matches_in_candidates (GNCImportTransInfo *trans_info,
+                            GArray *candidates,
+                            gint process_threshold,
+                            double fuzzy_amount_difference,
+                            gint match_date_hardlimit)
+{
+    time64 download_time = xaccTransGetDate (gnc_import_TransInfo_get_trans (trans_info));
+    time64 earliest = download_time - match_date_hardlimit * 86400;
+    time64 latest = download_time + match_date_hardlimit * 86400;
+    guint low = 0, high = candidates->len;
+
+    /* Find the first candidate on or after the earliest date. */
+    while (low < high)
+    {
+        guint mid = low + (high - low) / 2;
+
+        if (g_array_index (candidates, MatchCandidate, mid).date < earliest)
+            low = mid + 1;
+        else
+            high = mid;
+    }
+
+    for (; low < candidates->len; low++)
+    {
+        MatchCandidate *candidate = &g_array_index (candidates, MatchCandidate, low);
+
+        if (candidate->date > latest)
+            break;
+        split_find_match (trans_info, candidate->split,
+                          process_threshold, fuzzy_amount_difference);
+    }
+}
+
+/* Match all imported transactions of one account with a single query
+   over the date range they span. */
+static void
+find_account_split_matches (Account *importaccount,
+                            GList *trans_info_list,
+                            gint process_threshold,
+                            double fuzzy_amount_difference,
+                            gint match_date_hardlimit)
+{
+    Query *query = qof_query_create_for(GNC_ID_SPLIT);
+    GArray *candidates = g_array_new (FALSE, FALSE, sizeof (MatchCandidate));
+    time64 earliest = G_MAXINT64, latest = G_MININT64;
+    GList *node;
+
+    for (node = trans_info_list; node; node = node->next)
+    {
+        time64 download_time =
+            xaccTransGetDate (gnc_import_TransInfo_get_trans (node->data));
+
+        earliest = MIN (earliest, download_time);
+        latest = MAX (latest, download_time);
+    }
+
+    /* We used to traverse *all* splits of the account by using
+       xaccAccountGetSplitList, which is a bad idea because 90% of these
+       splits are outside the date range that is interesting. We rather
+       use a query according to the date region, run once for the whole
+       import, and then look only at the window around each transaction.
+    */
+    qof_query_set_book (query, gnc_get_current_book());
+    xaccQueryAddSingleAccountMatch (query, importaccount,
+                                    QOF_QUERY_AND);
+    xaccQueryAddDateMatchTT (query,
+                             TRUE, earliest - match_date_hardlimit * 86400,
+                             TRUE, latest + match_date_hardlimit * 86400,
+                             QOF_QUERY_AND);
+
+    for (node = qof_query_run (query); node; node = node->next)
+    {
+        Transaction *trans = xaccSplitGetParent (node->data);
+        MatchCandidate candidate;
+
+        /* split_find_match() ignores the transactions open for edit,
+           which were just downloaded, anyway. */
+        if (xaccTransIsOpen (trans))
+            continue;
+        candidate.date = xaccTransGetDate (trans);
+        candidate.split = node->data;
+        g_array_append_val (candidates, candidate);
+    }
+    qof_query_destroy (query);
+
+    g_array_sort (candidates, compare_candidate_date);
+
+    /* The split and transaction getters only read, so this could be
+       spread over threads the way xaccAccountTreeScrubAfterLoad checks
+       transactions.  It is not, because split_find_match() also calls
+       gnc_get_num_action(), which may create the current session and
+       reads the book option through its GObject property. */
+    for (node = trans_info_list; node; node = node->next)
+        find_matches_in_candidates (node->data, candidates, process_threshold,
+                                    fuzzy_amount_difference,
+                                    match_date_hardlimit);
+
+    g_array_free (candidates, TRUE);
+}
+
 /** /brief Iterate through all splits of the originating account of the given
    transaction, and find all matching splits there. */
 void gnc_import_find_split_matches(GNCImportTransInfo *trans_info,
@@ -813,55 +932,50 @@ void gnc_import_find_split_matches(GNCImportTransInfo *trans_info,
                                    double fuzzy_amount_difference,
                                    gint match_date_hardlimit)
 {
-    GList * list_element;
-    Query *query = qof_query_create_for(GNC_ID_SPLIT);
+    GList *trans_info_list;
     g_assert (trans_info);
 
-    /* Get list of splits of the originating account. */
+    trans_info_list = g_list_prepend (NULL, trans_info);
+    gnc_import_find_split_matches_batch (trans_info_list, process_threshold,
+                                         fuzzy_amount_difference,
+                                         match_date_hardlimit);
+    g_list_free (trans_info_list);
+}
+
+void gnc_import_find_split_matches_batch (GList *trans_info_list,
+                                          gint process_threshold,
+                                          double fuzzy_amount_difference,
+                                          gint match_date_hardlimit)
+{
+    GHashTable *by_account = g_hash_table_new (g_direct_hash, g_direct_equal);
+    GList *accounts = NULL, *node;
+
+    /* Group the transactions by originating account. */
+    for (node = trans_info_list; node; node = node->next)
     {
-        /* We used to traverse *all* splits of the account by using
-           xaccAccountGetSplitList, which is a bad idea because 90% of these
-           splits are outside the date range that is interesting. We should
-           rather use a query according to the date region, which is
-           implemented here.
-        */
         Account *importaccount =
-            xaccSplitGetAccount (gnc_import_TransInfo_get_fsplit (trans_info));
-        time64 download_time = xaccTransGetDate (gnc_import_TransInfo_get_trans (trans_info));
-
-        qof_query_set_book (query, gnc_get_current_book());
-        xaccQueryAddSingleAccountMatch (query, importaccount,
-                                        QOF_QUERY_AND);
-        xaccQueryAddDateMatchTT (query,
-                                 TRUE, download_time - match_date_hardlimit * 86400,
-                                 TRUE, download_time + match_date_hardlimit * 86400,
-                                 QOF_QUERY_AND);
-        list_element = qof_query_run (query);
-        /* Sigh. Doesnt help too much. We still create and run one query
-           for each imported transaction. Maybe it would improve
-           performance further if there is one single (master-)query at
-           the beginning, matching the full date range and all accounts in
-           question. However, this doesnt quite work because this function
-           here is called from each gnc_gen_trans_list_add_trans(), which
-           is called one at a time. Therefore the whole importer would
-           have to change its behaviour: Accept the imported txns via
-           gnc_gen_trans_list_add_trans(), and only when
-           gnc_gen_trans_list_run() is called, then calculate all the
-           different match candidates. That's too much work for now.
-        */
+            xaccSplitGetAccount (gnc_import_TransInfo_get_fsplit (node->data));
+        GList *account_list = g_hash_table_lookup (by_account, importaccount);
+
+        if (!account_list)
+            accounts = g_list_prepend (accounts, importaccount);
+        g_hash_table_insert (by_account, importaccount,
+                             g_list_prepend (account_list, node->data));
     }
 
-    /* Traverse that list, calling split_find_match on each one. Note
-       that xaccAccountForEachSplit is declared in Account.h but
-       implemented nowhere :-( */
-    while (list_element != NULL)
+    for (node = accounts; node; node = node->next)
     {
-        split_find_match (trans_info, list_element->data,
-                          process_threshold, fuzzy_amount_difference);
-        list_element = g_list_next (list_element);
+        GList *account_list = g_hash_table_lookup (by_account, node->data);
+
+        find_account_split_matches (node->data, account_list,
+                                    process_threshold,
+                                    fuzzy_amount_difference,
+                                    match_date_hardlimit);
+        g_list_free (account_list);
     }
 
-    qof_query_destroy (query);
+    g_list_free (accounts);
+    g_hash_table_destroy (by_account);
 }
 
 
@@ -1082,49 +1196,6 @@ gnc_import_process_trans_item (GncImportMatchMap *matchmap,
     return FALSE;
 }
 
-/********************************************************************\
- * check_trans_online_id() Callback function used by
- * gnc_import_exists_online_id.  Takes pointers to transaction and split,
- * returns 0 if their online_ids  do NOT match, or if the split
- * belongs to the transaction
-\********************************************************************/
-static gint check_trans_online_id(Transaction *trans1, void *user_data)
-{
-    Account *account;
-    Split *split1;
-    Split *split2 = user_data;
-    const gchar *online_id1;
-    const gchar *online_id2;
-
-    account = xaccSplitGetAccount(split2);
-    split1 = xaccTransFindSplitByAccount(trans1, account);
-    if (split1 == split2)
-        return 0;
-
-    /* hack - we really want to iterate over the _splits_ of the account
-       instead of the transactions */
-    g_assert(split1 != NULL);
-
-    if (gnc_import_split_has_online_id(split1))
-        online_id1 = gnc_import_get_split_online_id(split1);
-    else
-        online_id1 = gnc_import_get_trans_online_id(trans1);
-
-    online_id2 = gnc_import_get_split_online_id(split2);
-
-    if ((online_id1 == NULL) ||
-            (online_id2 == NULL) ||
-            (strcmp(online_id1, online_id2) != 0))
-    {
-        return 0;
-    }
-    else
-    {
-        /*printf("test_trans_online_id(): Duplicate found\n");*/
-        return 1;
-    }
-}
-
 /** Checks whether the given transaction's online_id already exists in
   its parent account. */
 gboolean gnc_import_exists_online_id (Transaction *trans)
@@ -1139,9 +1210,10 @@ gboolean gnc_import_exists_online_id (Transaction *trans)
 
     /* DEBUG("%s%d%s","Checking split ",i," for duplicates"); */
     dest_acct = xaccSplitGetAccount(source_split);
-    online_id_exists = xaccAccountForEachTransaction(dest_acct,
-                       check_trans_online_id,
-                       source_split);
+    online_id_exists =
+        xaccAccountFindSplitByOnlineId (dest_acct,
+                                        gnc_import_get_split_online_id (source_split),
+                                        source_split) != NULL;
 
     /* If it does, abort the process for this transaction, since it is
        already in the system. */
@@ -1191,23 +1263,14 @@ static gint compare_probability (gconstpointer a,
            ((GNCImportMatchInfo *)a)->probability);
 }
 
-/** Iterates through all splits of the originating account of
- * trans_info. Sorts the resulting list and sets the selected_match
- * and action fields in the trans_info.
+/** Sorts the match list of trans_info and sets the selected_match
+ * and action fields in the trans_info from it.
  */
-void
-gnc_import_TransInfo_init_matches (GNCImportTransInfo *trans_info,
-                                   GNCImportSettings *settings)
+static void
+select_best_match (GNCImportTransInfo *trans_info,
+                   GNCImportSettings *settings)
 {
     GNCImportMatchInfo * best_match = NULL;
-    g_assert (trans_info);
-
-
-    /* Find all split matches in originating account. */
-    gnc_import_find_split_matches(trans_info,
-                                  gnc_import_Settings_get_display_threshold (settings),
-                                  gnc_import_Settings_get_fuzzy_amount (settings),
-                                  gnc_import_Settings_get_match_date_hardlimit (settings));
 
     if (trans_info->match_list != NULL)
     {
@@ -1258,6 +1321,39 @@ gnc_import_TransInfo_init_matches (GNCImportTransInfo *trans_info,
     trans_info->previous_action = trans_info->action;
 }
 
+/** Iterates through all splits of the originating account of
+ * trans_info. Sorts the resulting list and sets the selected_match
+ * and action fields in the trans_info.
+ */
+void
+gnc_import_TransInfo_init_matches (GNCImportTransInfo *trans_info,
+                                   GNCImportSettings *settings)
+{
+    g_assert (trans_info);
+
+    /* Find all split matches in originating account. */
+    gnc_import_find_split_matches(trans_info,
+                                  gnc_import_Settings_get_display_threshold (settings),
+                                  gnc_import_Settings_get_fuzzy_amount (settings),
+                                  gnc_import_Settings_get_match_date_hardlimit (settings));
+    select_best_match (trans_info, settings);
+}
+
+void
+gnc_import_TransInfo_init_matches_batch (GList *trans_info_list,
+                                         GNCImportSettings *settings)
+{
+    GList *node;
+
+    /* Find all split matches in the originating accounts. */
+    gnc_import_find_split_matches_batch (trans_info_list,
+                                         gnc_import_Settings_get_display_threshold (settings),
+                                         gnc_import_Settings_get_fuzzy_amount (settings),
+                                         gnc_import_Settings_get_match_date_hardlimit (settings));
+    for (node = trans_info_list; node; node = node->next)
+        select_best_match (node->data, settings);
+}
+
 
 /* Try to automatch a transaction to a destination account if the */
 /* transaction hasn't already been manually assigned to another account */
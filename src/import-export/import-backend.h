@@ -87,6 +87,21 @@ void gnc_import_find_split_matches(GNCImportTransInfo *trans_info,
                                    double fuzzy_amount_difference,
                                    gint match_date_hardlimit);
 
+/** Like gnc_import_find_split_matches(), but for a whole set of
+ * imported transactions at once: the splits of each originating
+ * account are fetched with one query over the dates of all of its
+ * transactions and sorted by date, so that each transaction only looks
+ * at the splits within match_date_hardlimit days of it.
+ *
+ * @param trans_info_list A GList of GNCImportTransInfo.
+ *
+ * The other parameters are those of gnc_import_find_split_matches().
+ */
+void gnc_import_find_split_matches_batch (GList *trans_info_list,
+                                          gint process_threshold,
+                                          double fuzzy_amount_difference,
+                                          gint match_date_hardlimit);
+
 /** Iterates through all splits of the originating account of
  * trans_info. Sorts the resulting list and sets the selected_match
  * and action fields in the trans_info.
@@ -100,6 +115,14 @@ void
 gnc_import_TransInfo_init_matches (GNCImportTransInfo *trans_info,
                                    GNCImportSettings *settings);
 
+/** Does gnc_import_TransInfo_init_matches() for each GNCImportTransInfo
+ * of trans_info_list, finding the matches of all of them with
+ * gnc_import_find_split_matches_batch().
+ */
+void
+gnc_import_TransInfo_init_matches_batch (GList *trans_info_list,
+                                         GNCImportSettings *settings);
+
 /** This function is intended to be called when the importer dialog is
  * finished. It should be called once for each imported transaction
  * and processes each ImportTransInfo according to its selected action:
@@ -63,6 +63,10 @@ struct _main_matcher_info
     int selected_row;
     GNCTransactionProcessedCB transaction_processed_cb;
     gpointer user_data;
+    /* Transactions added but not yet shown.  Their matches are found
+       all at once, from an idle handler, before they are. */
+    GList *pending;
+    guint pending_idle;
 };
 
 enum downloaded_cols
@@ -102,16 +106,34 @@ automatch_store_transactions(GNCImportMainMatcher *info,
 static void
 refresh_model_row(GNCImportMainMatcher *gui, GtkTreeModel *model,
                   GtkTreeIter *iter, GNCImportTransInfo *info);
+static void
+gnc_gen_trans_list_add_pending (GNCImportMainMatcher *info);
 
 void gnc_gen_trans_list_delete (GNCImportMainMatcher *info)
 {
     GtkTreeModel *model;
     GtkTreeIter iter;
     GNCImportTransInfo *trans_info;
+    GList *node;
 
     if (info == NULL)
         return;
 
+    if (info->pending_idle)
+        g_source_remove (info->pending_idle);
+    for (node = info->pending; node; node = node->next)
+    {
+        if (info->transaction_processed_cb)
+        {
+            info->transaction_processed_cb(node->data,
+                                           FALSE,
+                                           info->user_data);
+        }
+
+        gnc_import_TransInfo_delete(node->data);
+    }
+    g_list_free (info->pending);
+
     model = gtk_tree_view_get_model(info->view);
     if (gtk_tree_model_get_iter_first(model, &iter))
     {
@@ -157,6 +179,7 @@ on_matcher_ok_clicked (GtkButton *button,
 
     /*   DEBUG ("Begin") */
 
+    gnc_gen_trans_list_add_pending (info);
     model = gtk_tree_view_get_model(info->view);
     if (!gtk_tree_model_get_iter_first(model, &iter))
         return;
@@ -659,6 +682,7 @@ gboolean gnc_gen_trans_list_run (GNCImportMainMatcher *info)
     gboolean result;
 
     /* DEBUG("Begin"); */
+    gnc_gen_trans_list_add_pending (info);
     result = gtk_dialog_run (GTK_DIALOG (info->dialog));
     /* DEBUG("Result was %d", result); */
 
@@ -881,6 +905,46 @@ refresh_model_row (GNCImportMainMatcher *gui,
     gtk_tree_selection_unselect_all(selection);
 }
 
+/* Find the matches of the pending transactions and show them. */
+static void
+gnc_gen_trans_list_add_pending (GNCImportMainMatcher *info)
+{
+    GtkTreeModel *model;
+    GtkTreeIter iter;
+    GList *pending, *node;
+
+    if (info->pending_idle)
+    {
+        g_source_remove (info->pending_idle);
+        info->pending_idle = 0;
+    }
+    if (info->pending == NULL)
+        return;
+
+    pending = g_list_reverse (info->pending);
+    info->pending = NULL;
+
+    gnc_import_TransInfo_init_matches_batch (pending, info->user_settings);
+
+    model = gtk_tree_view_get_model(info->view);
+    for (node = pending; node; node = node->next)
+    {
+        gtk_list_store_append(GTK_LIST_STORE(model), &iter);
+        refresh_model_row (info, model, &iter, node->data);
+    }
+    g_list_free (pending);
+}
+
+static gboolean
+add_pending_idle_cb (gpointer user_data)
+{
+    GNCImportMainMatcher *info = user_data;
+
+    info->pending_idle = 0;
+    gnc_gen_trans_list_add_pending (info);
+    return FALSE;
+}
+
 void gnc_gen_trans_list_add_trans(GNCImportMainMatcher *gui, Transaction *trans)
 {
     gnc_gen_trans_list_add_trans_with_ref_id(gui, trans, 0);
@@ -890,8 +954,6 @@ void gnc_gen_trans_list_add_trans(GNCImportMainMatcher *gui, Transaction *trans)
 void gnc_gen_trans_list_add_trans_with_ref_id(GNCImportMainMatcher *gui, Transaction *trans, guint32 ref_id)
 {
     GNCImportTransInfo * transaction_info = NULL;
-    GtkTreeModel *model;
-    GtkTreeIter iter;
     g_assert (gui);
     g_assert (trans);
 
@@ -903,12 +965,11 @@ void gnc_gen_trans_list_add_trans_with_ref_id(GNCImportMainMatcher *gui, Transac
         transaction_info = gnc_import_TransInfo_new(trans, NULL);
         gnc_import_TransInfo_set_ref_id(transaction_info, ref_id);
 
-        gnc_import_TransInfo_init_matches(transaction_info,
-                                          gui->user_settings);
-
-        model = gtk_tree_view_get_model(gui->view);
-        gtk_list_store_append(GTK_LIST_STORE(model), &iter);
-        refresh_model_row (gui, model, &iter, transaction_info);
+        /* Importers add their transactions one at a time, so matching
+           each right away would query the account once per line. */
+        gui->pending = g_list_prepend (gui->pending, transaction_info);
+        if (!gui->pending_idle)
+            gui->pending_idle = g_idle_add (add_pending_idle_cb, gui);
     }
     return;
 }/* end gnc_import_add_trans_with_ref_id() */
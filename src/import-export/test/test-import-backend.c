@@ -0,0 +1,247 @@
+/*
+ * test-import-backend.c -- Test the transaction matching of import-backend.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, contact:
+ *
+ * Free Software Foundation           Voice:  +1-617-542-5942
+ * 51 Franklin Street, Fifth Floor    Fax:    +1-617-542-2652
+ * Boston, MA  02110-1301,  USA       gnu@gnu.org
+ */
+
+#include "config.h"
+#include <glib.h>
+#include <libguile.h>
+
+#include "gnc-module.h"
+#include "gnc-ui-util.h"
+#include "Account.h"
+#include "Transaction.h"
+#include "import-backend.h"
+
+#include "test-stuff.h"
+
+#define NUM_DAYS 90
+#define MATCH_DATE_HARDLIMIT 10
+#define DAY 86400
+
+typedef struct
+{
+    const char *account;
+    int day;
+    gint64 cents;
+    const char *num;
+    const char *description;
+} Import;
+
+/* Spread over the days of the book, some close enough together that
+   their match windows overlap and some at its ends. */
+static const Import imports[] =
+{
+    { "Checking", 0, -1000, "100", "Payee 0" },
+    { "Checking", 3, -4000, "", "Payee" },
+    { "Checking", 20, -2000, "120", "Someone else" },
+    { "Checking", 24, -3100, "", "Payee 3" },
+    { "Checking", 51, -5000, "999", "" },
+    { "Savings", 40, -1000, "", "Payee 5" },
+    { "Checking", 89, -5000, "189", "Payee 5" },
+    { "Savings", 70, 7000, "", "Transfer" },
+};
+#define NUM_IMPORTS (sizeof (imports) / sizeof (imports[0]))
+
+static Account *
+add_account (QofBook *book, const char *name, gnc_commodity *currency)
+{
+    Account *acct = xaccMallocAccount (book);
+
+    xaccAccountBeginEdit (acct);
+    xaccAccountSetName (acct, name);
+    xaccAccountSetType (acct, ACCT_TYPE_BANK);
+    xaccAccountSetCommodity (acct, currency);
+    gnc_account_append_child (gnc_book_get_root_account (book), acct);
+    xaccAccountCommitEdit (acct);
+    return acct;
+}
+
+static Transaction *
+add_transaction (Account *acct, Account *other, time64 date, gint64 cents,
+                 const char *num, const char *description)
+{
+    QofBook *book = gnc_account_get_book (acct);
+    Transaction *trans = xaccMallocTransaction (book);
+    Split *split = xaccMallocSplit (book);
+    gnc_numeric amount = gnc_numeric_create (cents, 100);
+
+    xaccTransBeginEdit (trans);
+    xaccTransSetCurrency (trans, xaccAccountGetCommodity (acct));
+    xaccTransSetDatePostedSecs (trans, date);
+    xaccTransSetNum (trans, num);
+    xaccTransSetDescription (trans, description);
+    xaccSplitSetParent (split, trans);
+    xaccSplitSetAccount (split, acct);
+    xaccSplitSetAmount (split, amount);
+    xaccSplitSetValue (split, amount);
+    if (other)
+    {
+        Split *balancing = xaccMallocSplit (book);
+
+        xaccSplitSetParent (balancing, trans);
+        xaccSplitSetAccount (balancing, other);
+        xaccSplitSetAmount (balancing, gnc_numeric_neg (amount));
+        xaccSplitSetValue (balancing, gnc_numeric_neg (amount));
+        xaccTransCommitEdit (trans);
+    }
+    /* Imported transactions stay open for edit, as the importers leave
+       them. */
+    return trans;
+}
+
+static GNCImportTransInfo *
+import_transaction (QofBook *book, const Import *import, time64 start)
+{
+    Account *acct =
+        gnc_account_lookup_by_name (gnc_book_get_root_account (book),
+                                    import->account);
+
+    return gnc_import_TransInfo_new (add_transaction (acct, NULL,
+                                                      start + import->day * DAY,
+                                                      import->cents,
+                                                      import->num,
+                                                      import->description),
+                                     NULL);
+}
+
+static GNCImportMatchInfo *
+find_match (GList *match_list, Split *split)
+{
+    for (; match_list; match_list = match_list->next)
+        if (gnc_import_MatchInfo_get_split (match_list->data) == split)
+            return match_list->data;
+    return NULL;
+}
+
+/* Matching a whole import at once must find the same matches with the
+   same probabilities as matching its transactions one at a time, and
+   exactly the splits of the account within match_date_hardlimit days. */
+static void
+test_find_split_matches_batch (void)
+{
+    QofBook *book = gnc_get_current_book ();
+    gnc_commodity *currency =
+        gnc_commodity_new (book, "US Dollar", GNC_COMMODITY_NS_CURRENCY,
+                           "USD", "840", 100);
+    Account *checking, *savings, *expenses;
+    time64 start = gnc_dmy2timespec (1, 3, 2016).tv_sec + 12 * 3600;
+    GList *batch = NULL, *node;
+    GNCImportTransInfo *single[NUM_IMPORTS];
+    guint i, total = 0;
+
+    gnc_commodity_table_insert (gnc_commodity_table_get_table (book), currency);
+    checking = add_account (book, "Checking", currency);
+    savings = add_account (book, "Savings", currency);
+    expenses = add_account (book, "Expenses", currency);
+
+    for (i = 0; i < NUM_DAYS; i++)
+    {
+        char *num = g_strdup_printf ("%u", 100 + i);
+        char *description = g_strdup_printf ("Payee %u", i % 7);
+
+        add_transaction (checking, expenses, start + i * DAY,
+                         -1000 * (gint64)(i % 5 + 1), num, description);
+        if (i % 3 == 0)
+            add_transaction (savings, expenses, start + i * DAY + 3600,
+                             -1000 * (gint64)(i % 4 + 1), "", description);
+        g_free (num);
+        g_free (description);
+    }
+
+    for (i = 0; i < NUM_IMPORTS; i++)
+    {
+        batch = g_list_prepend (batch,
+                                import_transaction (book, &imports[i], start));
+        single[i] = import_transaction (book, &imports[i], start);
+        gnc_import_find_split_matches (single[i], -100, 0.0,
+                                       MATCH_DATE_HARDLIMIT);
+    }
+    batch = g_list_reverse (batch);
+    gnc_import_find_split_matches_batch (batch, -100, 0.0,
+                                         MATCH_DATE_HARDLIMIT);
+
+    for (i = 0, node = batch; node; i++, node = node->next)
+    {
+        GNCImportTransInfo *info = node->data;
+        Account *acct =
+            xaccSplitGetAccount (gnc_import_TransInfo_get_fsplit (info));
+        time64 date = xaccTransGetDate (gnc_import_TransInfo_get_trans (info));
+        GList *matches = gnc_import_TransInfo_get_match_list (info);
+        GList *single_matches = gnc_import_TransInfo_get_match_list (single[i]);
+        GList *splits;
+        guint expected = 0;
+        gboolean same = TRUE;
+
+        for (splits = xaccAccountGetSplitList (acct); splits;
+             splits = splits->next)
+        {
+            Split *split = splits->data;
+            time64 split_date = xaccTransGetDate (xaccSplitGetParent (split));
+            GNCImportMatchInfo *match, *single_match;
+
+            /* The other imported transactions are no candidates. */
+            if (xaccTransIsOpen (xaccSplitGetParent (split)))
+                continue;
+            match = find_match (matches, split);
+            single_match = find_match (single_matches, split);
+            if (split_date >= date - MATCH_DATE_HARDLIMIT * DAY &&
+                split_date <= date + MATCH_DATE_HARDLIMIT * DAY)
+            {
+                expected++;
+                if (!match || !single_match ||
+                    gnc_import_MatchInfo_get_probability (match) !=
+                    gnc_import_MatchInfo_get_probability (single_match))
+                    same = FALSE;
+            }
+            else if (match || single_match)
+                same = FALSE;
+        }
+        do_test_args (same && g_list_length (matches) == expected &&
+                      g_list_length (single_matches) == expected,
+                      "batch matches", __FILE__, __LINE__,
+                      "import %u: %u batch and %u single matches, %u expected",
+                      i, g_list_length (matches),
+                      g_list_length (single_matches), expected);
+        total += expected;
+    }
+    do_test (total > 0, "imports have candidates");
+
+    for (i = 0; i < NUM_IMPORTS; i++)
+        gnc_import_TransInfo_delete (single[i]);
+    g_list_free_full (batch, (GDestroyNotify)gnc_import_TransInfo_delete);
+}
+
+static void
+main_helper (void *closure, int argc, char **argv)
+{
+    gnc_module_system_init ();
+    gnc_module_load ("gnucash/import-export", 0);
+    test_find_split_matches_batch ();
+    print_test_results ();
+    exit (get_rv ());
+}
+
+int
+main (int argc, char **argv)
+{
+    g_setenv ("GNC_UNINSTALLED", "1", TRUE);
+    scm_boot_guile (argc, argv, main_helper, NULL);
+    return 0;
+}
@@ -112,6 +112,8 @@ gnc_localtime (const time64 *secs)
 struct tm*
 gnc_localtime_r (const time64 *secs, struct tm* time)
 {
+    if (GncDateTime::local_tm(*secs, *time))
+        return time;
     try
     {
 	*time = static_cast<struct tm>(GncDateTime(*secs));
@@ -204,6 +206,9 @@ gnc_mktime (struct tm* time)
     try
     {
 	normalize_struct_tm (time);
+	time64 secs;
+	if (GncDateTime::local_time64(*time, secs))
+	    return secs;
 	GncDateTime gncdt(*time);
 	return static_cast<time64>(gncdt) - gncdt.offset();
     }
@@ -1142,11 +1147,111 @@ gnc_date_timestamp (void)
  */
 
 #define ISO_DATE_FORMAT "%d-%d-%d %d:%d:%lf%s"
+
+/* Reads exactly n decimal digits from *str into *value, advancing *str. */
+static inline bool
+iso8601_read_digits (const char** str, int n, int* value)
+{
+    int result = 0;
+    for (int i = 0; i < n; ++i)
+    {
+        auto c = (*str)[i];
+        if (c < '0' || c > '9')
+            return false;
+        result = result * 10 + (c - '0');
+    }
+    *str += n;
+    *value = result;
+    return true;
+}
+
+/* Days from 1970-01-01 to the given proleptic Gregorian date. */
+static inline time64
+iso8601_days_from_civil (int year, int month, int day)
+{
+    year -= month <= 2;
+    const time64 era = (year >= 0 ? year : year - 399) / 400;
+    const int yoe = year - era * 400;
+    const int doy = (153 * (month + (month > 2 ? -3 : 9)) + 2) / 5 + day - 1;
+    const int doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+    return era * 146097 + doe - 719468;
+}
+
+/* Parses the "YYYY-MM-DD HH:MM:SS[.fff][ ]±HH[[:]MM]" layout that GnuCash
+ * itself writes without constructing a GncDateTime. Returns false for
+ * anything else so that the caller can hand the string to the full
+ * parser, which also reports the errors.
+ */
+static bool
+iso8601_fast_parse (const char* str, time64* secs)
+{
+    int year, month, day, hour, minute, second;
+    int tz_hour = 0, tz_minute = 0, tz_sign = 1;
+    bool has_fraction = false;
+
+    if (!(iso8601_read_digits (&str, 4, &year) && *str++ == '-' &&
+          iso8601_read_digits (&str, 2, &month) && *str++ == '-' &&
+          iso8601_read_digits (&str, 2, &day) && *str++ == ' ' &&
+          iso8601_read_digits (&str, 2, &hour) && *str++ == ':' &&
+          iso8601_read_digits (&str, 2, &minute) && *str++ == ':' &&
+          iso8601_read_digits (&str, 2, &second)))
+        return false;
+
+    if (*str == '.')
+    {
+        /* Only whole seconds are kept, but a non-zero fraction (to the
+         * microsecond resolution of the full parser) changes how negative
+         * times truncate. */
+        if (!g_ascii_isdigit (*++str))
+            return false;
+        for (int i = 0; g_ascii_isdigit (*str); ++i, ++str)
+            if (i < 6 && *str != '0')
+                has_fraction = true;
+    }
+
+    if (*str == ' ')
+        ++str;
+    if (*str == '+' || *str == '-')
+    {
+        tz_sign = *str++ == '-' ? -1 : 1;
+        if (!iso8601_read_digits (&str, 2, &tz_hour))
+            return false;
+        if (*str == ':' && !g_ascii_isdigit (str[1]))
+            return false;
+        if (*str == ':')
+            ++str;
+        if (*str && !iso8601_read_digits (&str, 2, &tz_minute))
+            return false;
+    }
+    else if (str[-1] == ' ')
+        return false;
+
+    if (*str != '\0' ||
+        year < static_cast<int>(TimeZoneProvider::min_year) ||
+        year > static_cast<int>(TimeZoneProvider::max_year) ||
+        month < 1 || month > 12 ||
+        day < 1 || day > gnc_date_get_last_mday (month - 1, year) ||
+        hour > 23 || minute > 59 || second > 59 ||
+        tz_hour > 23 || tz_minute > 59)
+        return false;
+
+    auto time = iso8601_days_from_civil (year, month, day) * 86400 +
+        hour * 3600 + minute * 60 + second -
+        tz_sign * (tz_hour * 3600 + tz_minute * 60);
+    /* GncDateTime truncates the fractional seconds toward zero. */
+    if (has_fraction && time < 0)
+        ++time;
+    *secs = time;
+    return true;
+}
+
 Timespec
 gnc_iso8601_to_timespec_gmt(const char *cstr)
 {
     time64 time;
     if (!cstr) return {0, 0};
+    if (iso8601_fast_parse (cstr, &time))
+        return {time, 0};
     try
     {
         GncDateTime gncdt(cstr);
@@ -1161,20 +1266,66 @@ gnc_iso8601_to_timespec_gmt(const char *cstr)
 /********************************************************************\
 \********************************************************************/
 
+/* Writes value as exactly n zero-padded decimal digits. */
+static inline char*
+iso8601_write_digits (char* buff, int n, int value)
+{
+    for (int i = n - 1; i >= 0; --i)
+    {
+        buff[i] = '0' + value % 10;
+        value /= 10;
+    }
+    return buff + n;
+}
+
+/* Produces the same "%Y-%m-%d %H:%M:%s %q" text as GncDateTime::format,
+ * e.g. "2016-03-01 12:34:56.000000 -0500", without the locale and
+ * stream machinery.  The local time comes from the cached zone table,
+ * so nothing is allocated; gnc_localtime_r only builds a GncDateTime
+ * for years the table doesn't cover.
+ */
 char *
 gnc_timespec_to_iso8601_buff (Timespec ts, char * buff)
 {
-    constexpr size_t max_iso_date_length = 32;
-    const char* format = "%Y-%m-%d %H:%M:%s %q";
+    struct tm tm;
+    long offset;
 
     if (! buff) return NULL;
 
-    GncDateTime gncdt(ts.tv_sec);
-    auto sstr = gncdt.format(format);
+    if (!gnc_localtime_r (&ts.tv_sec, &tm))
+    {
+        *buff = '\0';
+        return buff;
+    }
+#if HAVE_STRUCT_TM_GMTOFF
+    offset = tm.tm_gmtoff;
+#else
+    offset = iso8601_days_from_civil (tm.tm_year + 1900, tm.tm_mon + 1,
+                                      tm.tm_mday) * 86400 +
+        tm.tm_hour * 3600 + tm.tm_min * 60 + tm.tm_sec - ts.tv_sec;
+#endif
 
-    memset(buff, 0, sstr.length() + 1);
-    strncpy(buff, sstr.c_str(), sstr.length());
-    return buff + sstr.length();
+    auto p = iso8601_write_digits (buff, 4, tm.tm_year + 1900);
+    *p++ = '-';
+    p = iso8601_write_digits (p, 2, tm.tm_mon + 1);
+    *p++ = '-';
+    p = iso8601_write_digits (p, 2, tm.tm_mday);
+    *p++ = ' ';
+    p = iso8601_write_digits (p, 2, tm.tm_hour);
+    *p++ = ':';
+    p = iso8601_write_digits (p, 2, tm.tm_min);
+    *p++ = ':';
+    p = iso8601_write_digits (p, 2, tm.tm_sec);
+    /* GncDateTime is built from whole seconds. */
+    memcpy (p, ".000000 ", 8);
+    p += 8;
+    *p++ = offset < 0 ? '-' : '+';
+    if (offset < 0)
+        offset = -offset;
+    p = iso8601_write_digits (p, 2, offset / 3600);
+    p = iso8601_write_digits (p, 2, offset % 3600 / 60);
+    *p = '\0';
+    return p;
 }
 
 void
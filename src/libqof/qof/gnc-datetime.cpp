@@ -315,3 +315,82 @@ GncDateTime::format(const char* format) const
 {
     return m_impl->format(format);
 }
+
+/* Days from 1970-01-01 of a proleptic Gregorian date and back; see
+ * http://howardhinnant.github.io/date_algorithms.html.
+ */
+static time64
+days_from_civil(int year, unsigned month, unsigned day) noexcept
+{
+    year -= month <= 2;
+    const time64 era = (year >= 0 ? year : year - 399) / 400;
+    const unsigned yoe = static_cast<unsigned>(year - era * 400);
+    const unsigned doy = (153 * (month + (month > 2 ? -3 : 9)) + 2) / 5 + day - 1;
+    const unsigned doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+    return era * 146097 + static_cast<time64>(doe) - 719468;
+}
+
+static void
+civil_from_days(time64 days, int& year, unsigned& month, unsigned& day) noexcept
+{
+    days += 719468;
+    const time64 era = (days >= 0 ? days : days - 146096) / 146097;
+    const unsigned doe = static_cast<unsigned>(days - era * 146097);
+    const unsigned yoe = (doe - doe / 1460 + doe / 36524 - doe / 146096) / 365;
+    const unsigned doy = doe - (365 * yoe + yoe / 4 - yoe / 100);
+    const unsigned mp = (5 * doy + 2) / 153;
+    day = doy - (153 * mp + 2) / 5 + 1;
+    month = mp < 10 ? mp + 3 : mp - 9;
+    year = static_cast<int>(yoe + era * 400) + (month <= 2);
+}
+
+bool
+GncDateTime::local_tm(time64 time, struct tm& tm) noexcept
+{
+    long offset;
+    bool is_dst;
+    if (!tzp.get_offset(time, offset, is_dst))
+        return false;
+
+    auto local = time + offset;
+    auto days = local / 86400;
+    auto secs = static_cast<int>(local % 86400);
+    if (secs < 0)
+    {
+        secs += 86400;
+        --days;
+    }
+    int year;
+    unsigned month, day;
+    civil_from_days(days, year, month, day);
+
+    tm = {};
+    tm.tm_year = year - 1900;
+    tm.tm_mon = month - 1;
+    tm.tm_mday = day;
+    tm.tm_hour = secs / 3600;
+    tm.tm_min = secs % 3600 / 60;
+    tm.tm_sec = secs % 60;
+    tm.tm_wday = static_cast<int>((days % 7 + 11) % 7); //1970-01-01 was a Thursday
+    tm.tm_yday = static_cast<int>(days - days_from_civil(year, 1, 1));
+    tm.tm_isdst = is_dst ? 1 : 0;
+#if HAVE_STRUCT_TM_GMTOFF
+    tm.tm_gmtoff = offset;
+#endif
+    return true;
+}
+
+bool
+GncDateTime::local_time64(const struct tm& tm, time64& time) noexcept
+{
+    /* Like LDT_from_struct_tm the fields are taken as UTC and the offset
+     * in effect at that instant is then removed. */
+    auto utc = days_from_civil(tm.tm_year + 1900, tm.tm_mon + 1, tm.tm_mday) *
+        86400 + tm.tm_hour * 3600 + tm.tm_min * 60 + tm.tm_sec;
+    long offset;
+    bool is_dst;
+    if (!tzp.get_offset(utc, offset, is_dst))
+        return false;
+    time = utc - offset;
+    return true;
+}
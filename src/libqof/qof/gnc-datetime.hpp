@@ -159,6 +159,24 @@ public:
  *  according to the format.
  */
     std::string format(const char* format) const;
+/** Break a time64 down into local time like the struct tm cast, but from
+ *  the time zone's precomputed transition table instead of a constructed
+ *  GncDateTime.
+ *  @param time: Seconds from the POSIX epoch.
+ *  @param tm: Receives the local time.
+ *  @return false if the table can't answer for that time, in which case
+ *  tm is untouched and the caller must construct a GncDateTime.
+ */
+    static bool local_tm(time64 time, struct tm& tm) noexcept;
+/** Convert a struct tm to a time64 the way casting GncDateTime(tm) to
+ *  time64 and subtracting its offset() does, using the precomputed
+ *  transition table.
+ *  @param tm: A normalized struct tm.
+ *  @param time: Receives the seconds from the POSIX epoch.
+ *  @return false if the table can't answer for that time, in which case
+ *  the caller must construct a GncDateTime.
+ */
+    static bool local_time64(const struct tm& tm, time64& time) noexcept;
 
 private:
     std::unique_ptr<GncDateTimeImpl> m_impl;
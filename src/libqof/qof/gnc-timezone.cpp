@@ -46,6 +46,8 @@ using calc_rule_ptr = boost::local_time::dst_calc_rule_ptr;
 
 const unsigned int TimeZoneProvider::min_year = 1400;
 const unsigned int TimeZoneProvider::max_year = 9999;
+const unsigned int TimeZoneProvider::table_min_year = 1900;
+const unsigned int TimeZoneProvider::table_max_year = 2199;
 
 template<typename T>
 T*
@@ -272,6 +274,7 @@ TimeZoneProvider::TimeZoneProvider (const std::string& identifier) :
     if (key_name.empty())
     {
         load_windows_default_tz();
+        build_year_table();
         return;
     }
     std::string subkey = reg_key + key_name;
@@ -291,6 +294,7 @@ TimeZoneProvider::TimeZoneProvider (const std::string& identifier) :
 	this->load_windows_classic_tz (key, names);
     else
 	throw std::invalid_argument ("No data for TZ " + key_name);
+    build_year_table();
 }
 #elif PLATFORM(POSIX)
 using std::to_string;
@@ -652,9 +656,108 @@ TimeZoneProvider::TimeZoneProvider(const std::string& tzname) :  zone_vector {}
 	zone_vector.push_back(zone_no_dst(max_year, last_info));
     else //Last DST rule forever after.
 	zone_vector.push_back(zone_from_rule(max_year, last_rule));
+    build_year_table();
 }
 #endif
 
+/* Resolve each year's zone from zone_vector into a TZ_Year. A year whose
+ * rules boost can't evaluate is marked invalid and left to get().
+ */
+void
+TimeZoneProvider::build_year_table()
+{
+    using boost::gregorian::date;
+    using boost::posix_time::ptime;
+    const ptime epoch(date(1970, 1, 1));
+
+    year_table.reserve(table_max_year - table_min_year + 1);
+    for (auto year = table_min_year; year <= table_max_year; ++year)
+    {
+        TZ_Year entry {};
+        try
+        {
+            auto tz = get(year);
+            entry.begin = (ptime(date(year, 1, 1)) - epoch).total_seconds();
+            entry.end = (ptime(date(year + 1, 1, 1)) - epoch).total_seconds();
+            entry.std_offset = tz->base_utc_offset().total_seconds();
+            entry.has_dst = tz->has_dst();
+            entry.valid = true;
+            if (entry.has_dst)
+            {
+                auto dst_start = tz->dst_local_start_time(year);
+                auto dst_end = tz->dst_local_end_time(year);
+                /* boost decides DST by comparing the calendar day first
+                 * and then the time of day in whole minutes. Rules that
+                 * start and end on the same day or change on a
+                 * fractional minute (a few LMT-era zones) don't reduce to
+                 * a pair of instants, so leave them to boost.
+                 */
+                entry.valid = dst_start.date() != dst_end.date() &&
+                    dst_start.time_of_day().seconds() == 0 &&
+                    dst_end.time_of_day().seconds() == 0 &&
+                    tz->dst_offset().seconds() == 0;
+                entry.dst_offset = tz->dst_offset().total_seconds();
+                entry.dst_start = (dst_start - epoch).total_seconds();
+                /* Because of the day comparison a change back at or just
+                 * after midnight DST ends the period at midnight standard
+                 * time rather than the hour before.
+                 */
+                auto end_time = dst_end.time_of_day() - tz->dst_offset();
+                if (end_time.is_negative())
+                    end_time = duration(0, 0, 0);
+                entry.dst_end =
+                    (ptime(dst_end.date(), end_time) - epoch).total_seconds();
+            }
+        }
+        catch(std::exception& err)
+        {
+            PWARN("Unable to resolve the time zone for year %u: %s",
+                  year, err.what());
+        }
+        year_table.push_back(entry);
+    }
+}
+
+bool
+TimeZoneProvider::get_offset(int64_t time, long& offset,
+                             bool& is_dst) const noexcept
+{
+    if (year_table.empty() || time < year_table.front().begin ||
+        time >= year_table.back().end)
+        return false;
+
+    /* Guess the year from the mean Gregorian year length, then correct. */
+    auto index = static_cast<size_t>((time - year_table.front().begin) /
+                                     31556952);
+    if (index >= year_table.size())
+        index = year_table.size() - 1;
+    while (time < year_table[index].begin)
+        --index;
+    while (time >= year_table[index].end)
+        ++index;
+
+    auto& entry = year_table[index];
+    if (!entry.valid)
+        return false;
+    /* boost picks the zone by the UTC year but evaluates its DST rules in
+     * the year of the standard local time; leave the few hours where those
+     * differ to the slow path. */
+    auto local = time + entry.std_offset;
+    if (local < entry.begin || local >= entry.end)
+        return false;
+
+    is_dst = false;
+    if (entry.has_dst)
+    {
+        if (entry.dst_start < entry.dst_end)
+            is_dst = local >= entry.dst_start && local < entry.dst_end;
+        else //Southern hemisphere, DST spans the new year.
+            is_dst = local >= entry.dst_start || local < entry.dst_end;
+    }
+    offset = entry.std_offset + (is_dst ? entry.dst_offset : 0);
+    return true;
+}
+
 
 TZ_Ptr
 TimeZoneProvider::get(int year) const noexcept
@@ -32,6 +32,8 @@ extern "C"
 
 #define BOOST_ERROR_CODE_HEADER_ONLY
 #include <boost/date_time/local_time/local_time.hpp>
+#include <cstdint>
+#include <vector>
 
 namespace gnc
 {
@@ -44,6 +46,24 @@ using TZ_Entry = std::pair<int, TZ_Ptr>;
 using TZ_Vector = std::vector<TZ_Entry>;
 using time_zone_names = boost::local_time::time_zone_names;
 
+/* One year of a zone's rules resolved to plain numbers so that UTC
+ * offsets can be found without boost arithmetic. Times are seconds from
+ * the POSIX epoch; the DST bounds are in the zone's standard time, with
+ * the end already moved back by the DST adjustment.
+ */
+struct TZ_Year
+{
+    int64_t begin;      // Jan 1 00:00 of the year
+    int64_t end;        // Jan 1 00:00 of the next year
+    int64_t dst_start;
+    int64_t dst_end;
+    int32_t std_offset; // seconds east of UTC
+    int32_t dst_offset; // added to std_offset during DST
+    bool has_dst;
+    bool valid;
+};
+using TZ_Year_Vector = std::vector<TZ_Year>;
+
 class TimeZoneProvider
 {
 public:
@@ -55,10 +75,26 @@ public:
     TimeZoneProvider operator=(const TimeZoneProvider&) = delete;
     TimeZoneProvider operator=(const TimeZoneProvider&&) = delete;
     TZ_Ptr get (int year) const noexcept;
+    /** Look up the UTC offset in effect at a time in the table of
+     * resolved transitions built by the constructor. It agrees with a
+     * boost::local_time::local_date_time built from the time and
+     * get(year).
+     * @param time Seconds from the POSIX epoch.
+     * @param offset Receives the offset from UTC in seconds, east positive.
+     * @param is_dst Receives whether daylight time is in effect.
+     * @return false if the time is outside of table_min_year to
+     * table_max_year or too close to a year boundary to decide cheaply;
+     * callers must then use get().
+     */
+    bool get_offset (int64_t time, long& offset, bool& is_dst) const noexcept;
     static const unsigned int min_year; //1400
     static const unsigned int max_year; //9999
+    static const unsigned int table_min_year; //1900
+    static const unsigned int table_max_year; //2199
 private:
+    void build_year_table ();
     TZ_Vector zone_vector;
+    TZ_Year_Vector year_table;
 #if PLATFORM(WINDOWS)
     void load_windows_dynamic_tz(HKEY, time_zone_names);
     void load_windows_classic_tz(HKEY, time_zone_names);
@@ -190,12 +190,65 @@ guid_to_string_buff (const GncGUID * guid, gchar *str)
     return &str[GUID_ENCODING_LENGTH];
 }
 
+/* The value of each hex digit, or -1 for anything else. */
+static const int8_t hex_digit_values[256] =
+{
+#define X16 -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1
+    X16, X16, X16,
+    0, 1, 2, 3, 4, 5, 6, 7, 8, 9, -1, -1, -1, -1, -1, -1,
+    -1, 10, 11, 12, 13, 14, 15, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    X16,
+    -1, 10, 11, 12, 13, 14, 15, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    X16, X16, X16, X16, X16, X16, X16, X16, X16
+#undef X16
+};
+
+/* Decode GUID_ENCODING_LENGTH hex digits into data, stopping at the first
+ * character that isn't one, so a shorter null-terminated string is never
+ * read past its end. */
+static bool
+decode_hex_guid (const char * str, unsigned char * data)
+{
+    for (unsigned i {0}; i < GUID_DATA_SIZE; ++i)
+    {
+        int hi {hex_digit_values[static_cast<unsigned char> (str[2 * i])]};
+        if (hi < 0)
+            return false;
+        int lo {hex_digit_values[static_cast<unsigned char> (str[2 * i + 1])]};
+        if (lo < 0)
+            return false;
+        data[i] = static_cast<unsigned char> (hi << 4 | lo);
+    }
+    return true;
+}
+
+gboolean
+guid_from_hex_buff (const gchar * str, gsize len, GncGUID * guid)
+{
+    unsigned char data[GUID_DATA_SIZE];
+
+    if (!guid || !str || len != GUID_ENCODING_LENGTH ||
+        !decode_hex_guid (str, data))
+        return false;
+
+    memcpy (guid->reserved, data, sizeof data);
+    return true;
+}
+
 gboolean
 string_to_guid (const char * str, GncGUID * guid)
 {
     if (!guid || !str)
         return false;
 
+    /* The plain hex form, which is what we write, doesn't need boost. */
+    unsigned char data[GUID_DATA_SIZE];
+    if (decode_hex_guid (str, data) && str[GUID_ENCODING_LENGTH] == '\0')
+    {
+        memcpy (guid->reserved, data, sizeof data);
+        return true;
+    }
+
     try 
     {
         static boost::uuids::string_generator strgen;
@@ -242,14 +295,20 @@ guid_hash_to_guint (gconstpointer ptr)
         return 0;
     }
 
-    guint hash {0};
-    unsigned retspot {0};
-    for (auto guidspot : *guid)
-    {
-        hash <<= 4;
-        hash |= guidspot;
-    }
-    return hash;
+    /* The GUIDs are random, so folding the two 64-bit halves together
+     * loses nothing; the multiply-xorshift finalizer (from MurmurHash3)
+     * then spreads every input bit over the whole result, which is
+     * what GHashTable's power-of-two bucket masking needs. */
+    uint64_t lo, hi;
+    memcpy (&lo, guid->data, sizeof lo);
+    memcpy (&hi, guid->data + sizeof lo, sizeof hi);
+    uint64_t hash {lo ^ (hi * UINT64_C (0x9e3779b97f4a7c15))};
+    hash ^= hash >> 33;
+    hash *= UINT64_C (0xff51afd7ed558ccd);
+    hash ^= hash >> 33;
+    hash *= UINT64_C (0xc4ceb9fe1a85ec53);
+    hash ^= hash >> 33;
+    return static_cast<guint> (hash ^ (hash >> 32));
 }
 
 gint
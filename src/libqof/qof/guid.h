@@ -155,6 +155,23 @@ gchar * guid_to_string_buff (const GncGUID * guid, /*@ out @*/ gchar *buff);
  */
 gboolean string_to_guid(const gchar * string, /*@ out @*/ GncGUID * guid);
 
+/** Decode a GncGUID from the GUID_ENCODING_LENGTH hex digits that
+ * guid_to_string_buff() writes, straight into the caller's storage.
+ * Unlike string_to_guid(), the digits don't need a null terminator and
+ * nothing else is accepted: no dashes, braces or whitespace. Nothing is
+ * allocated and no exception is thrown, which makes it the one to use on
+ * the hot paths of the file and database loaders.
+ *
+ * @param string The hex digits, upper or lower case.
+ * @param len The number of characters at string. Anything but
+ * GUID_ENCODING_LENGTH fails.
+ * @param guid Receives the result. It is left untouched on failure.
+ *
+ * @return TRUE if string held a GncGUID, FALSE otherwise.
+ */
+gboolean guid_from_hex_buff (const gchar * string, gsize len,
+                             /*@ out @*/ GncGUID * guid);
+
 
 /** Given two GUIDs, return TRUE if they are non-NULL and equal.
  * Return FALSE, otherwise. */
@@ -42,24 +42,251 @@ extern "C"
 
 static QofLogModule log_module = QOF_MOD_ENGINE;
 
+/* The entities of a collection live in a flat open-addressing table
+ * with linear probing, keyed by the GncGUID embedded in each
+ * instance.  Each slot caches the GUID's hash so that probing and
+ * rehashing never have to touch the instance itself.
+ *
+ * An empty slot has a NULL key.  Removal normally shifts the rest of
+ * the probe run back so no markers are left behind, but while the
+ * table is being traversed by qof_collection_foreach a removed slot is
+ * only cleared to a tombstone (key set, inst NULL) so that entries do
+ * not move under the iterator.  If the table must grow during a
+ * traversal the old slot array is retired rather than freed; the
+ * iterator keeps walking it and removals are mirrored into it.
+ * Retired arrays and tombstones are disposed of when the outermost
+ * traversal finishes.
+ */
+typedef struct
+{
+    guint          hash;
+    const GncGUID *key;
+    QofInstance   *inst;
+} EntitySlot;
+
+typedef struct
+{
+    EntitySlot *slots;
+    guint       mask;       /* capacity - 1; capacity is a power of two */
+} EntitySlotArray;
+
+typedef struct
+{
+    EntitySlotArray array;
+    guint           count;      /* live entries */
+    guint           filled;     /* live entries plus tombstones */
+    guint           iterating;  /* nesting depth of active traversals */
+    GSList         *retired;    /* EntitySlotArray*s still walked by iterators */
+} EntityTable;
+
+#define ENTITY_TABLE_MIN_SIZE 8
+
+static const GncGUID entity_tombstone = {{0}};
+
 struct QofCollection_s
 {
     QofIdType    e_type;
     gboolean     is_dirty;
 
-    GHashTable * hash_of_entities;
+    EntityTable  entities;
     gpointer     data;       /* place where object class can hang arbitrary data */
 };
 
 /* =============================================================== */
 
+static void
+entity_table_init (EntityTable *table)
+{
+    memset (table, 0, sizeof (*table));
+}
+
+static void
+entity_table_free_retired (EntityTable *table)
+{
+    GSList *node;
+
+    for (node = table->retired; node; node = node->next)
+    {
+        EntitySlotArray *array = static_cast<EntitySlotArray*>(node->data);
+        g_free (array->slots);
+        g_free (array);
+    }
+    g_slist_free (table->retired);
+    table->retired = NULL;
+}
+
+static void
+entity_table_destroy (EntityTable *table)
+{
+    entity_table_free_retired (table);
+    g_free (table->array.slots);
+    memset (table, 0, sizeof (*table));
+}
+
+/* Returns the slot holding guid in array, or NULL. */
+static EntitySlot *
+entity_array_find (const EntitySlotArray *array, guint hash,
+                   const GncGUID *guid)
+{
+    guint i;
+
+    if (!array->slots) return NULL;
+    for (i = hash & array->mask; array->slots[i].key;
+         i = (i + 1) & array->mask)
+    {
+        EntitySlot *slot = &array->slots[i];
+        if (slot->hash == hash && slot->inst && guid_equal (slot->key, guid))
+            return slot;
+    }
+    return NULL;
+}
+
+/* Places an entry known not to be present into a tombstone-free array. */
+static void
+entity_array_place (EntitySlotArray *array, guint hash, const GncGUID *key,
+                    QofInstance *inst)
+{
+    guint i = hash & array->mask;
+
+    while (array->slots[i].key)
+        i = (i + 1) & array->mask;
+    array->slots[i].hash = hash;
+    array->slots[i].key = key;
+    array->slots[i].inst = inst;
+}
+
+/* Rebuilds the table with room for at least min_count live entries,
+ * dropping any tombstones.  While a traversal is active the old slot
+ * array is kept alive for it. */
+static void
+entity_table_resize (EntityTable *table, guint min_count)
+{
+    EntitySlotArray old = table->array;
+    guint size = ENTITY_TABLE_MIN_SIZE, i;
+
+    while (size < min_count * 2)
+        size <<= 1;
+
+    table->array.slots = g_new0 (EntitySlot, size);
+    table->array.mask = size - 1;
+    table->filled = table->count;
+
+    if (!old.slots) return;
+    for (i = 0; i <= old.mask; i++)
+        if (old.slots[i].inst)
+            entity_array_place (&table->array, old.slots[i].hash,
+                                old.slots[i].key, old.slots[i].inst);
+
+    if (table->iterating)
+        table->retired = g_slist_prepend (table->retired,
+                                          g_memdup (&old, sizeof (old)));
+    else
+        g_free (old.slots);
+}
+
+static QofInstance *
+entity_table_lookup (const EntityTable *table, const GncGUID *guid)
+{
+    EntitySlot *slot = entity_array_find (&table->array,
+                                          guid_hash_to_guint (guid), guid);
+    return slot ? slot->inst : NULL;
+}
+
+/* Inserts or replaces the entity stored under guid. */
+static void
+entity_table_insert (EntityTable *table, const GncGUID *guid,
+                     QofInstance *inst)
+{
+    guint hash = guid_hash_to_guint (guid);
+    EntitySlot *slot, *free_slot = NULL;
+    guint i;
+
+    /* Keep the load, tombstones included, at or below 3/4. */
+    if ((table->filled + 1) * 4 > (table->array.mask + 1) * 3
+        || !table->array.slots)
+        entity_table_resize (table, table->count + 1);
+
+    for (i = hash & table->array.mask; table->array.slots[i].key;
+         i = (i + 1) & table->array.mask)
+    {
+        slot = &table->array.slots[i];
+        if (!slot->inst)
+        {
+            if (!free_slot) free_slot = slot;
+        }
+        else if (slot->hash == hash && guid_equal (slot->key, guid))
+        {
+            slot->key = guid;
+            slot->inst = inst;
+            return;
+        }
+    }
+
+    if (!free_slot)
+    {
+        free_slot = &table->array.slots[i];
+        table->filled++;
+    }
+    free_slot->hash = hash;
+    free_slot->key = guid;
+    free_slot->inst = inst;
+    table->count++;
+}
+
+static void
+entity_table_remove (EntityTable *table, const GncGUID *guid)
+{
+    guint hash = guid_hash_to_guint (guid);
+    EntitySlotArray *array = &table->array;
+    EntitySlot *slot = entity_array_find (array, hash, guid);
+    guint i, j;
+    GSList *node;
+
+    if (!slot) return;
+    table->count--;
+
+    if (table->iterating)
+    {
+        slot->key = &entity_tombstone;
+        slot->inst = NULL;
+        for (node = table->retired; node; node = node->next)
+        {
+            slot = entity_array_find (static_cast<EntitySlotArray*>(node->data),
+                                      hash, guid);
+            if (!slot) continue;
+            slot->key = &entity_tombstone;
+            slot->inst = NULL;
+        }
+        return;
+    }
+
+    /* Backward-shift deletion: pull later members of the probe run into
+     * the hole unless that would move them before their home slot. */
+    table->filled--;
+    i = slot - array->slots;
+    for (j = (i + 1) & array->mask; array->slots[j].key;
+         j = (j + 1) & array->mask)
+    {
+        guint home = array->slots[j].hash & array->mask;
+        if (((j - home) & array->mask) >= ((j - i) & array->mask))
+        {
+            array->slots[i] = array->slots[j];
+            i = j;
+        }
+    }
+    array->slots[i].key = NULL;
+    array->slots[i].inst = NULL;
+}
+
+/* =============================================================== */
+
 QofCollection *
 qof_collection_new (QofIdType type)
 {
     QofCollection *col;
     col = g_new0(QofCollection, 1);
     col->e_type = static_cast<QofIdType>(CACHE_INSERT (type));
-    col->hash_of_entities = guid_hash_table_new();
+    entity_table_init (&col->entities);
     col->data = NULL;
     return col;
 }
@@ -68,9 +295,8 @@ void
 qof_collection_destroy (QofCollection *col)
 {
     CACHE_REMOVE (col->e_type);
-    g_hash_table_destroy(col->hash_of_entities);
+    entity_table_destroy (&col->entities);
     col->e_type = NULL;
-    col->hash_of_entities = NULL;
     col->data = NULL;   /** XXX there should be a destroy notifier for this */
     g_free (col);
 }
@@ -96,7 +322,7 @@ qof_collection_remove_entity (QofInstance *ent)
     col = qof_instance_get_collection(ent);
     if (!col) return;
     guid = qof_instance_get_guid(ent);
-    g_hash_table_remove (col->hash_of_entities, guid);
+    entity_table_remove (&col->entities, guid);
     qof_instance_set_collection(ent, NULL);
 }
 
@@ -110,7 +336,7 @@ qof_collection_insert_entity (QofCollection *col, QofInstance *ent)
     if (guid_equal(guid, guid_null())) return;
     g_return_if_fail (col->e_type == ent->e_type);
     qof_collection_remove_entity (ent);
-    g_hash_table_insert (col->hash_of_entities, (gpointer)guid, ent);
+    entity_table_insert (&col->entities, guid, ent);
     qof_instance_set_collection(ent, col);
 }
 
@@ -136,7 +362,7 @@ qof_collection_add_entity (QofCollection *coll, QofInstance *ent)
     {
         return FALSE;
     }
-    g_hash_table_insert (coll->hash_of_entities, (gpointer)guid, ent);
+    entity_table_insert (&coll->entities, guid, ent);
     return TRUE;
 }
 
@@ -223,8 +449,7 @@ qof_collection_lookup_entity (const QofCollection *col, const GncGUID * guid)
     QofInstance *ent;
     g_return_val_if_fail (col, NULL);
     if (guid == NULL) return NULL;
-    ent = static_cast<QofInstance*>(g_hash_table_lookup (col->hash_of_entities,
-							 guid));
+    ent = entity_table_lookup (&col->entities, guid);
     return ent;
 }
 
@@ -252,7 +477,7 @@ qof_collection_count (const QofCollection *col)
 {
     guint c;
 
-    c = g_hash_table_size(col->hash_of_entities);
+    c = col->entities.count;
     return c;
 }
 
@@ -309,40 +534,41 @@ qof_collection_set_data (QofCollection *col, gpointer user_data)
 
 /* =============================================================== */
 
-struct _iterate
-{
-    QofInstanceForeachCB      fcn;
-    gpointer                data;
-};
-
-static void
-foreach_cb (gpointer item, gpointer arg)
-{
-    struct _iterate *iter = static_cast<_iterate*>(arg);
-    QofInstance *ent = static_cast<QofInstance*>(item);
-
-    iter->fcn (ent, iter->data);
-}
-
 void
 qof_collection_foreach (const QofCollection *col, QofInstanceForeachCB cb_func,
                         gpointer user_data)
 {
-    struct _iterate iter;
-    GList *entries;
+    EntityTable *table;
+    EntitySlotArray array;
+    guint i;
 
     g_return_if_fail (col);
     g_return_if_fail (cb_func);
 
-    iter.fcn = cb_func;
-    iter.data = user_data;
+    /* The table is walked in place.  Marking it as being iterated makes
+     * removals leave tombstones and keeps the slot array alive if an
+     * insertion forces it to grow, so the callback may add or remove
+     * entities freely.  Entities removed before their turn are not
+     * visited; entities added during the walk may or may not be. */
+    table = const_cast<EntityTable*>(&col->entities);
+    array = table->array;
 
-    PINFO("Hash Table size of %s before is %d", col->e_type, g_hash_table_size(col->hash_of_entities));
+    PINFO("Hash Table size of %s before is %d", col->e_type, table->count);
 
-    entries = g_hash_table_get_values (col->hash_of_entities);
-    g_list_foreach (entries, foreach_cb, &iter);
-    g_list_free (entries);
+    table->iterating++;
+    for (i = 0; array.slots && i <= array.mask; i++)
+    {
+        QofInstance *ent = array.slots[i].inst;
+        if (ent)
+            cb_func (ent, user_data);
+    }
+    if (--table->iterating == 0)
+    {
+        entity_table_free_retired (table);
+        if (table->filled != table->count)
+            entity_table_resize (table, table->count);
+    }
 
-    PINFO("Hash Table size of %s after is %d", col->e_type, g_hash_table_size(col->hash_of_entities));
+    PINFO("Hash Table size of %s after is %d", col->e_type, table->count);
 }
 /* =============================================================== */
@@ -140,7 +140,7 @@ print error message if its bad  */
 
 @param e_type QofIdType
 @param is_dirty gboolean
-@param hash_of_entities GHashTable
+@param entities open-addressing table of QofInstance keyed by GncGUID
 @param data gpointer, place where object class can hang arbitrary data
 
 */
@@ -167,7 +167,9 @@ QofInstance * qof_collection_lookup_entity (const QofCollection *, const GncGUID
 /** Callback type for qof_collection_foreach */
 typedef void (*QofInstanceForeachCB) (QofInstance *, gpointer user_data);
 
-/** Call the callback for each entity in the collection. */
+/** Call the callback for each entity in the collection.  The callback
+ *  may add or remove entities; removed entities are not visited, added
+ *  ones may or may not be. */
 void qof_collection_foreach (const QofCollection *, QofInstanceForeachCB,
                              gpointer user_data);
 
@@ -72,6 +72,15 @@ static gint qof_log_num_spaces = 0;
 static GHashTable *log_table = NULL;
 static GLogFunc previous_handler = NULL;
 
+gint qof_log_generation = 1;
+
+/* The threshold of each log domain checked so far, valid as long as
+ * log_cache_generation matches qof_log_generation.  Guarded by the
+ * lock, as the log handler runs on whichever thread logs. */
+static GHashTable *log_cache = NULL;
+static gint log_cache_generation = 0;
+G_LOCK_DEFINE_STATIC (log_cache);
+
 void
 qof_log_indent(void)
 {
@@ -226,6 +235,15 @@ qof_log_shutdown (void)
         g_hash_table_destroy(log_table);
         log_table = NULL;
     }
+    g_atomic_int_inc(&qof_log_generation);
+
+    G_LOCK(log_cache);
+    if (log_cache != NULL)
+    {
+        g_hash_table_destroy(log_cache);
+        log_cache = NULL;
+    }
+    G_UNLOCK(log_cache);
 
     if (previous_handler != NULL)
     {
@@ -246,6 +264,7 @@ qof_log_set_level(QofLogModule log_module, QofLogLevel level)
         log_table = g_hash_table_new(g_str_hash, g_str_equal);
     }
     g_hash_table_insert(log_table, g_strdup((gchar*)log_module), GINT_TO_POINTER((gint)level));
+    g_atomic_int_inc(&qof_log_generation);
 }
 
 const char *
@@ -373,8 +392,8 @@ qof_log_parse_log_config(const char *filename)
     g_key_file_free(conf);
 }
 
-gboolean
-qof_log_check(QofLogModule log_domain, QofLogLevel log_level)
+static QofLogLevel
+qof_log_find_threshold(QofLogModule log_domain)
 {
 //#define _QLC_DBG(x) x
 #define _QLC_DBG(x)
@@ -419,7 +438,40 @@ _QLC_DBG( { printf("trying [%s] (%d):", log_domain, log_levels != NULL ? g_hash_
     _QLC_DBG( { printf(" found [%d]\n", longest_match_level); });
     g_free(domain_copy);
 
-    return log_level <= longest_match_level;
+    return longest_match_level;
+}
+
+QofLogLevel
+qof_log_get_threshold(QofLogModule log_domain)
+{
+    const gchar *domain = log_domain == NULL ? "" : log_domain;
+    gint generation = g_atomic_int_get(&qof_log_generation);
+    gpointer level;
+
+    G_LOCK(log_cache);
+    if (log_cache == NULL)
+        log_cache = g_hash_table_new_full(g_str_hash, g_str_equal,
+                                          g_free, NULL);
+    if (log_cache_generation != generation)
+    {
+        g_hash_table_remove_all(log_cache);
+        log_cache_generation = generation;
+    }
+
+    if (!g_hash_table_lookup_extended(log_cache, domain, NULL, &level))
+    {
+        level = GINT_TO_POINTER((gint)qof_log_find_threshold(domain));
+        g_hash_table_insert(log_cache, g_strdup(domain), level);
+    }
+    G_UNLOCK(log_cache);
+
+    return (QofLogLevel)GPOINTER_TO_INT(level);
+}
+
+gboolean
+qof_log_check(QofLogModule log_domain, QofLogLevel log_level)
+{
+    return log_level <= qof_log_get_threshold(log_domain);
 }
 
 void
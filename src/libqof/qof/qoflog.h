@@ -168,6 +168,27 @@ const gchar * qof_log_prettify (const gchar *name);
  * @a log_level.  This implements the "log.path.hierarchy" logic. **/
 gboolean qof_log_check(QofLogModule log_module, QofLogLevel log_level);
 
+/** Return the most verbose level the given @a log_module logs at.  The
+ * result is remembered for each module until the next level change. **/
+QofLogLevel qof_log_get_threshold(QofLogModule log_module);
+
+/** Bumped whenever a log level is set, so that thresholds cached by the
+ * PINFO, DEBUG, ENTER and LEAVE macros are looked up again. **/
+extern gint qof_log_generation;
+
+/* Used by PINFO, DEBUG, ENTER and LEAVE: caches the threshold of
+ * log_module at the call site, so that when their level is off they cost
+ * no more than two integer compares. */
+#define QOF_LOG_CACHED_CHECK(level, result) do { \
+    static gint qof_log_cached_generation = 0; \
+    static gint qof_log_cached_threshold = 0; \
+    if (G_UNLIKELY(qof_log_cached_generation != qof_log_generation)) { \
+      qof_log_cached_threshold = qof_log_get_threshold(log_module); \
+      qof_log_cached_generation = qof_log_generation; \
+    } \
+    result = (level) <= qof_log_cached_threshold; \
+} while (0)
+
 /** Set the default level for QOF-related log paths. **/
 void qof_log_set_default(QofLogLevel log_level);
 
@@ -197,19 +218,27 @@ void qof_log_set_default(QofLogLevel log_level);
 
 /** Print an informational note */
 #define PINFO(format, ...) do { \
-    g_log (log_module, G_LOG_LEVEL_INFO, \
-      "[%s] " format, PRETTY_FUNC_NAME , __VA_ARGS__); \
+    gboolean qof_log_enabled; \
+    QOF_LOG_CACHED_CHECK(G_LOG_LEVEL_INFO, qof_log_enabled); \
+    if (G_UNLIKELY(qof_log_enabled)) \
+      g_log (log_module, G_LOG_LEVEL_INFO, \
+        "[%s] " format, PRETTY_FUNC_NAME , __VA_ARGS__); \
 } while (0)
 
 /** Print a debugging message */
 #define DEBUG(format, ...) do { \
-    g_log (log_module, G_LOG_LEVEL_DEBUG, \
-      "[%s] " format, PRETTY_FUNC_NAME , __VA_ARGS__); \
+    gboolean qof_log_enabled; \
+    QOF_LOG_CACHED_CHECK(G_LOG_LEVEL_DEBUG, qof_log_enabled); \
+    if (G_UNLIKELY(qof_log_enabled)) \
+      g_log (log_module, G_LOG_LEVEL_DEBUG, \
+        "[%s] " format, PRETTY_FUNC_NAME , __VA_ARGS__); \
 } while (0)
 
 /** Print a function entry debugging message */
 #define ENTER(format, ...) do { \
-    if (qof_log_check(log_module, (QofLogLevel)G_LOG_LEVEL_DEBUG)) { \
+    gboolean qof_log_enabled; \
+    QOF_LOG_CACHED_CHECK(G_LOG_LEVEL_DEBUG, qof_log_enabled); \
+    if (G_UNLIKELY(qof_log_enabled)) { \
       g_log (log_module, G_LOG_LEVEL_DEBUG, \
         "[enter %s:%s()] " format, __FILE__, \
         PRETTY_FUNC_NAME , __VA_ARGS__); \
@@ -219,7 +248,9 @@ void qof_log_set_default(QofLogLevel log_level);
 
 /** Print a function exit debugging message. **/
 #define LEAVE(format, ...) do { \
-    if (qof_log_check(log_module, (QofLogLevel)G_LOG_LEVEL_DEBUG)) { \
+    gboolean qof_log_enabled; \
+    QOF_LOG_CACHED_CHECK(G_LOG_LEVEL_DEBUG, qof_log_enabled); \
+    if (G_UNLIKELY(qof_log_enabled)) { \
       qof_log_dedent(); \
       g_log (log_module, G_LOG_LEVEL_DEBUG, \
         "[leave %s()] " format, \
@@ -249,19 +280,27 @@ void qof_log_set_default(QofLogLevel log_level);
 
 /** Print an informational note */
 #define PINFO(format, args...) do { \
-    g_log (log_module, G_LOG_LEVEL_INFO, \
-      "[%s] " format, PRETTY_FUNC_NAME , ## args); \
+    gboolean qof_log_enabled; \
+    QOF_LOG_CACHED_CHECK(G_LOG_LEVEL_INFO, qof_log_enabled); \
+    if (G_UNLIKELY(qof_log_enabled)) \
+      g_log (log_module, G_LOG_LEVEL_INFO, \
+        "[%s] " format, PRETTY_FUNC_NAME , ## args); \
 } while (0)
 
 /** Print a debugging message */
 #define DEBUG(format, args...) do { \
-    g_log (log_module, G_LOG_LEVEL_DEBUG, \
-      "[%s] " format, PRETTY_FUNC_NAME , ## args); \
+    gboolean qof_log_enabled; \
+    QOF_LOG_CACHED_CHECK(G_LOG_LEVEL_DEBUG, qof_log_enabled); \
+    if (G_UNLIKELY(qof_log_enabled)) \
+      g_log (log_module, G_LOG_LEVEL_DEBUG, \
+        "[%s] " format, PRETTY_FUNC_NAME , ## args); \
 } while (0)
 
 /** Print a function entry debugging message */
 #define ENTER(format, args...) do { \
-    if (qof_log_check(log_module, (QofLogLevel)G_LOG_LEVEL_DEBUG)) { \
+    gboolean qof_log_enabled; \
+    QOF_LOG_CACHED_CHECK(G_LOG_LEVEL_DEBUG, qof_log_enabled); \
+    if (G_UNLIKELY(qof_log_enabled)) { \
       g_log (log_module, G_LOG_LEVEL_DEBUG, \
         "[enter %s:%s()] " format, __FILE__, \
         PRETTY_FUNC_NAME , ## args); \
@@ -271,7 +310,9 @@ void qof_log_set_default(QofLogLevel log_level);
 
 /** Print a function exit debugging message. **/
 #define LEAVE(format, args...) do { \
-    if (qof_log_check(log_module, (QofLogLevel)G_LOG_LEVEL_DEBUG)) { \
+    gboolean qof_log_enabled; \
+    QOF_LOG_CACHED_CHECK(G_LOG_LEVEL_DEBUG, qof_log_enabled); \
+    if (G_UNLIKELY(qof_log_enabled)) { \
       qof_log_dedent(); \
       g_log (log_module, G_LOG_LEVEL_DEBUG, \
         "[leave %s()] " format, \
@@ -62,3 +62,73 @@ TEST(gnc_timezone_constructors, test_bogus_time_constructor)
     EXPECT_THROW (TimeZoneProvider tzp ("New York Standard Time"),
 		  std::invalid_argument);
 }
+
+static void
+check_offsets_against_boost(const TimeZoneProvider& tzp, int year)
+{
+    using boost::posix_time::ptime;
+    using boost::posix_time::hours;
+    using boost::posix_time::seconds;
+    using boost::local_time::local_date_time;
+    const ptime epoch(boost::gregorian::date(1970, 1, 1));
+    auto tz = tzp.get(year);
+    ASSERT_TRUE(tz->has_dst());
+    auto std_off = tz->base_utc_offset().total_seconds();
+    auto dst_start = (tz->dst_local_start_time(year) - epoch).total_seconds() - std_off;
+    auto dst_end = (tz->dst_local_end_time(year) - epoch).total_seconds() - std_off;
+    for (auto transition : {dst_start, dst_end})
+        for (int64_t time = transition - 7200; time <= transition + 7200;
+             time += 300)
+        {
+            long offset;
+            bool is_dst;
+            ASSERT_TRUE(tzp.get_offset(time, offset, is_dst));
+            ptime utc(epoch.date(), hours(time / 3600) + seconds(time % 3600));
+            local_date_time ldt(utc, tzp.get(utc.date().year()));
+            EXPECT_EQ((ldt.local_time() - ldt.utc_time()).total_seconds(),
+                      offset) << "at " << time;
+            EXPECT_EQ(ldt.is_dst(), is_dst) << "at " << time;
+        }
+}
+
+TEST(gnc_timezone_offsets, test_pacific_time_offsets)
+{
+#if PLATFORM(WINDOWS)
+    std::string timezone("Pacific Standard Time");
+#else
+    std::string timezone("America/Los_Angeles");
+#endif
+    TimeZoneProvider tzp (timezone);
+    long offset;
+    bool is_dst;
+    EXPECT_TRUE(tzp.get_offset(1404518400, offset, is_dst)); //2014-07-05 00:00 UTC
+    EXPECT_EQ(-7 * 3600, offset);
+    EXPECT_TRUE(is_dst);
+    EXPECT_TRUE(tzp.get_offset(1389744000, offset, is_dst)); //2014-01-15 00:00 UTC
+    EXPECT_EQ(-8 * 3600, offset);
+    EXPECT_FALSE(is_dst);
+    //Hours after New Year's in UTC are still the previous year locally.
+    EXPECT_FALSE(tzp.get_offset(1388534400, offset, is_dst)); //2014-01-01 00:00 UTC
+    EXPECT_FALSE(tzp.get_offset(INT64_C(-3000000000), offset, is_dst));
+    check_offsets_against_boost(tzp, 2006);
+    check_offsets_against_boost(tzp, 2014);
+}
+
+TEST(gnc_timezone_offsets, test_southern_hemisphere_offsets)
+{
+#if PLATFORM(WINDOWS)
+    std::string timezone("AUS Eastern Standard Time");
+#else
+    std::string timezone("Australia/Sydney");
+#endif
+    TimeZoneProvider tzp (timezone);
+    long offset;
+    bool is_dst;
+    EXPECT_TRUE(tzp.get_offset(1389744000, offset, is_dst)); //2014-01-15 00:00 UTC
+    EXPECT_EQ(11 * 3600, offset);
+    EXPECT_TRUE(is_dst);
+    EXPECT_TRUE(tzp.get_offset(1404518400, offset, is_dst)); //2014-07-05 00:00 UTC
+    EXPECT_EQ(10 * 3600, offset);
+    EXPECT_FALSE(is_dst);
+    check_offsets_against_boost(tzp, 2014);
+}
@@ -1723,6 +1723,109 @@ test_gnc_timespec_to_iso8601_buff (FixtureA *f, gconstpointer pData)
     g_assert_cmpstr (buff, ==, time_str);
     g_free (time_str);
 }
+
+/* The fixed layout must be byte for byte what GncDateTime::format writes,
+ * out to the ends of the years the zone table covers. */
+static void
+check_iso8601_buff_matches_print (time64 secs)
+{
+    gchar buff[ISO8601_SIZE];
+    Timespec ts = { secs, 0 };
+    gchar *end = gnc_timespec_to_iso8601_buff (ts, buff);
+    gchar *str = gnc_print_time64 (secs, "%Y-%m-%d %H:%M:%s %q");
+
+    g_assert_cmpint (end - buff, ==, strlen (str));
+    g_assert (memcmp (buff, str, strlen (str) + 1) == 0);
+    free (str);
+}
+
+static void
+test_gnc_timespec_to_iso8601_buff_print (void)
+{
+    const time64 start = -631152000; /* 1950-01-01 */
+    const time64 step = 3517 * 97;
+    int i;
+
+    for (i = 0; i < 10000; ++i)
+        check_iso8601_buff_matches_print (start + i * step);
+    check_iso8601_buff_matches_print (G_GINT64_CONSTANT (-17987356800)); /* 1400-01-02 */
+    check_iso8601_buff_matches_print (G_GINT64_CONSTANT (253402128000)); /* 9999-12-30 */
+}
+/* Conversion throughput of the fixed "YYYY-MM-DD HH:MM:SS.ffffff +HHMM"
+ * layout against the GncDateTime format and parse path, which is still
+ * what gnc_print_time64 uses and what gnc_iso8601_to_timespec_gmt falls
+ * back to for a 'T' date/time separator. Only run with -m perf.
+ */
+static void
+test_gnc_iso8601_perf (void)
+{
+    const int count = 1000000;
+    const time64 start = -631152000; /* 1950-01-01 */
+    const time64 step = 3517;
+    gchar *strs, *tstrs, *buff;
+    gdouble elapsed;
+    int i;
+
+    if (!g_test_perf ())
+        return;
+
+    strs = g_new0 (gchar, (gsize)count * ISO8601_SIZE);
+    tstrs = g_new0 (gchar, (gsize)count * ISO8601_SIZE);
+
+    g_test_timer_start ();
+    for (i = 0; i < count; ++i)
+    {
+        Timespec ts = { start + i * step, 0 };
+        gnc_timespec_to_iso8601_buff (ts, strs + i * ISO8601_SIZE);
+    }
+    elapsed = g_test_timer_elapsed ();
+    g_test_minimized_result (elapsed, "gnc_timespec_to_iso8601_buff: "
+                             "%d conversions in %g s", count, elapsed);
+
+    g_test_timer_start ();
+    for (i = 0; i < count; ++i)
+    {
+        gchar *str = gnc_print_time64 (start + i * step,
+                                       "%Y-%m-%d %H:%M:%s %q");
+        g_strlcpy (tstrs + i * ISO8601_SIZE, str, ISO8601_SIZE);
+        free (str);
+    }
+    elapsed = g_test_timer_elapsed ();
+    g_test_minimized_result (elapsed, "gnc_print_time64: "
+                             "%d conversions in %g s", count, elapsed);
+
+    /* The two must agree byte for byte, terminator included. */
+    for (i = 0; i < count; ++i)
+    {
+        buff = tstrs + i * ISO8601_SIZE;
+        g_assert (memcmp (strs + i * ISO8601_SIZE, buff,
+                          strlen (buff) + 1) == 0);
+        buff[10] = 'T';
+    }
+
+    g_test_timer_start ();
+    for (i = 0; i < count; ++i)
+    {
+        Timespec ts = gnc_iso8601_to_timespec_gmt (strs + i * ISO8601_SIZE);
+        g_assert_cmpint (ts.tv_sec, ==, start + i * step);
+    }
+    elapsed = g_test_timer_elapsed ();
+    g_test_minimized_result (elapsed, "gnc_iso8601_to_timespec_gmt: "
+                             "%d conversions in %g s", count, elapsed);
+
+    g_test_timer_start ();
+    for (i = 0; i < count; ++i)
+    {
+        Timespec ts = gnc_iso8601_to_timespec_gmt (tstrs + i * ISO8601_SIZE);
+        g_assert_cmpint (ts.tv_sec, ==, start + i * step);
+    }
+    elapsed = g_test_timer_elapsed ();
+    g_test_minimized_result (elapsed, "GncDateTime parse: "
+                             "%d conversions in %g s", count, elapsed);
+
+    g_free (strs);
+    g_free (tstrs);
+}
 /* gnc_timespec2dmy
 void
 gnc_timespec2dmy (Timespec t, int *day, int *month, int *year)// C: 1  Local: 0:0:0
@@ -2156,6 +2259,8 @@ test_suite_gnc_date (void)
     GNC_TEST_ADD_FUNC (suitename, "gnc_date_timestamp", test_gnc_date_timestamp);
     GNC_TEST_ADD (suitename, "gnc iso8601 to timespec gmt", FixtureA, NULL, setup, test_gnc_iso8601_to_timespec_gmt, NULL);
     GNC_TEST_ADD (suitename, "gnc timespec to iso8601 buff", FixtureA, NULL, setup, test_gnc_timespec_to_iso8601_buff, NULL);
+    GNC_TEST_ADD_FUNC (suitename, "gnc timespec to iso8601 buff print", test_gnc_timespec_to_iso8601_buff_print);
+    GNC_TEST_ADD_FUNC (suitename, "gnc iso8601 perf", test_gnc_iso8601_perf);
     GNC_TEST_ADD (suitename, "gnc timespec2dmy", FixtureA, NULL, setup, test_gnc_timespec2dmy, NULL);
 // GNC_TEST_ADD_FUNC (suitename, "gnc dmy2timespec internal", test_gnc_dmy2timespec_internal);
     GNC_TEST_ADD (suitename, "gnc dmy2timespec", FixtureB, NULL, setup_begin, test_gnc_dmy2timespec, NULL);
@@ -27,6 +27,9 @@ extern "C"
 #include <string.h>
 #include <glib.h>
 #include <unittest-support.h>
+#include "../qofbook.h"
+#include "../qofid.h"
+#include "../qofinstance.h"
 void test_suite_gnc_guid (void);
 }
 
@@ -186,6 +189,109 @@ static void test_gnc_guid_from_string (void) {
     guid_free (guid);
 }
 
+static void test_gnc_guid_from_hex_buff (void) {
+    GncGUID guid, expected;
+    const char * good {"0123456789abcdef1234567890ABCDEF"};
+    g_assert (string_to_guid (good, &expected));
+
+    g_assert (!guid_from_hex_buff (nullptr, GUID_ENCODING_LENGTH, &guid));
+    g_assert (!guid_from_hex_buff (good, GUID_ENCODING_LENGTH, nullptr));
+
+    g_assert (guid_from_hex_buff (good, GUID_ENCODING_LENGTH, &guid));
+    g_assert (guid_equal (&guid, &expected));
+
+    /* The digits needn't be terminated, just counted. */
+    gchar padded [GUID_ENCODING_LENGTH + 8];
+    memcpy (padded, good, GUID_ENCODING_LENGTH);
+    memcpy (padded + GUID_ENCODING_LENGTH, "</guid>", 8);
+    guid_replace (&guid);
+    g_assert (guid_from_hex_buff (padded, GUID_ENCODING_LENGTH, &guid));
+    g_assert (guid_equal (&guid, &expected));
+
+    /* Failures leave the GncGUID alone. */
+    guid_replace (&guid);
+    GncGUID before {guid};
+    g_assert (!guid_from_hex_buff (good, GUID_ENCODING_LENGTH - 1, &guid));
+    g_assert (!guid_from_hex_buff (padded, GUID_ENCODING_LENGTH + 1, &guid));
+    const char * bad_digit {"0123456789abcdef1234567890abcdeg"};
+    g_assert (!guid_from_hex_buff (bad_digit, GUID_ENCODING_LENGTH, &guid));
+    g_assert (guid_equal (&guid, &before));
+
+    /* Only the plain hex form; string_to_guid still takes the others. */
+    const char * dashed {"01234567-89ab-cdef-1234-567890abcdef"};
+    g_assert (!guid_from_hex_buff (dashed, strlen (dashed), &guid));
+    g_assert (string_to_guid (dashed, &guid));
+    g_assert (guid_equal (&guid, &expected));
+}
+
+/* The hash guid_hash_to_guint used to compute, kept to compare against. */
+static guint
+legacy_guid_hash (gconstpointer ptr)
+{
+    auto guid = static_cast<const GncGUID*> (ptr);
+    guint hash {0};
+    for (auto byte : guid->reserved)
+    {
+        hash <<= 4;
+        hash |= byte;
+    }
+    return hash;
+}
+
+static gdouble
+time_guid_lookups (GHashTable *table, QofInstance **insts, int count)
+{
+    g_test_timer_start ();
+    for (int i = 0; i < count; ++i)
+        g_assert (g_hash_table_lookup (table, qof_instance_get_guid (insts[i])) == insts[i]);
+    return g_test_timer_elapsed ();
+}
+
+/* Lookup throughput with a million entities.  Only run with -m perf. */
+static void test_gnc_guid_hash_perf (void)
+{
+    if (!g_test_perf ())
+        return;
+
+    const int num_insts {1000000};
+    auto book = qof_book_new ();
+    auto insts = g_new (QofInstance*, num_insts);
+    auto legacy = g_hash_table_new (legacy_guid_hash, guid_g_hash_table_equal);
+    auto current = guid_hash_table_new ();
+
+    for (int i = 0; i < num_insts; ++i)
+    {
+        insts[i] = static_cast<QofInstance*>(g_object_new (QOF_TYPE_INSTANCE, NULL));
+        qof_instance_init_data (insts[i], "PerfTest", book);
+        auto guid = qof_instance_get_guid (insts[i]);
+        g_hash_table_insert (legacy, (gpointer)guid, insts[i]);
+        g_hash_table_insert (current, (gpointer)guid, insts[i]);
+    }
+
+    auto elapsed = time_guid_lookups (legacy, insts, num_insts);
+    g_test_maximized_result (num_insts / elapsed,
+                             "Shift-or hash: %g lookups/s", num_insts / elapsed);
+    elapsed = time_guid_lookups (current, insts, num_insts);
+    g_test_maximized_result (num_insts / elapsed,
+                             "guid_hash_to_guint: %g lookups/s", num_insts / elapsed);
+
+    auto col = qof_book_get_collection (book, "PerfTest");
+    g_test_timer_start ();
+    for (int i = 0; i < num_insts; ++i)
+        g_assert (qof_collection_lookup_entity (col, qof_instance_get_guid (insts[i])) == insts[i]);
+    elapsed = g_test_timer_elapsed ();
+    g_test_maximized_result (num_insts / elapsed,
+                             "qof_collection_lookup_entity: %g lookups/s",
+                             num_insts / elapsed);
+
+    g_hash_table_destroy (legacy);
+    g_hash_table_destroy (current);
+    for (int i = 0; i < num_insts; ++i)
+        g_object_unref (insts[i]);
+    g_free (insts);
+    qof_book_destroy (book);
+}
+
 void test_suite_gnc_guid (void)
 {
     GNC_TEST_ADD_FUNC (suitename, "gnc create guid", test_create_gnc_guid);
@@ -194,6 +300,8 @@ void test_suite_gnc_guid (void)
     GNC_TEST_ADD_FUNC (suitename, "gnc guid equal", test_gnc_guid_equals);
     GNC_TEST_ADD_FUNC (suitename, "gnc guid string roundtrip", test_gnc_guid_roundtrip);
     GNC_TEST_ADD_FUNC (suitename, "gnc guid from string", test_gnc_guid_from_string);
+    GNC_TEST_ADD_FUNC (suitename, "gnc guid from hex buff", test_gnc_guid_from_hex_buff);
     GNC_TEST_ADD_FUNC (suitename, "gnc guid replace", test_gnc_guid_replace);
+    GNC_TEST_ADD_FUNC (suitename, "gnc guid hash perf", test_gnc_guid_hash_perf);
 }
 
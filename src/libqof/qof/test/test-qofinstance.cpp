@@ -820,6 +820,104 @@ test_instance_get_referring_object_list_from_collection( void )
     g_object_unref( ref );
 }
 
+static struct
+{
+    QofBook *book;
+    GPtrArray *insts;
+    guint next_victim;
+    GHashTable *visited;
+    GHashTable *removed;
+    guint added;
+} collection_foreach_struct;
+
+static void
+collection_foreach_mutate_cb( QofInstance *inst, gpointer user_data )
+{
+    auto data = &collection_foreach_struct;
+    guint visits;
+
+    g_assert( !g_hash_table_lookup( data->removed, inst ) );
+    g_assert( !g_hash_table_lookup( data->visited, inst ) );
+    g_hash_table_insert( data->visited, inst, inst );
+    visits = g_hash_table_size( data->visited );
+
+    /* Remove an entity that hasn't been visited yet... */
+    while ( data->next_victim > 0 )
+    {
+        auto victim = static_cast<QofInstance*>(g_ptr_array_index( data->insts,
+                                                --data->next_victim ));
+        if ( g_hash_table_lookup( data->visited, victim ) ||
+             g_hash_table_lookup( data->removed, victim ) )
+            continue;
+        qof_collection_remove_entity( victim );
+        g_hash_table_insert( data->removed, victim, victim );
+        break;
+    }
+    /* ...and add enough new ones to make the table grow under us. */
+    if ( visits % 2 == 0 )
+    {
+        auto added = static_cast<QofInstance*>(g_object_new( QOF_TYPE_INSTANCE, NULL ));
+        qof_instance_init_data( added, "test type", data->book );
+        g_ptr_array_add( data->insts, added );
+        data->added++;
+    }
+}
+
+static void
+test_instance_collection_foreach_mutate( void )
+{
+    auto data = &collection_foreach_struct;
+    const guint count = 200;
+    QofCollection *coll;
+    guint i;
+
+    data->book = qof_book_new();
+    data->insts = g_ptr_array_new();
+    data->visited = g_hash_table_new( g_direct_hash, g_direct_equal );
+    data->removed = g_hash_table_new( g_direct_hash, g_direct_equal );
+    data->added = 0;
+    for ( i = 0; i < count; i++ )
+    {
+        auto inst = static_cast<QofInstance*>(g_object_new( QOF_TYPE_INSTANCE, NULL ));
+        qof_instance_init_data( inst, "test type", data->book );
+        g_ptr_array_add( data->insts, inst );
+    }
+    data->next_victim = count;
+    coll = qof_book_get_collection( data->book, "test type" );
+    g_assert_cmpint( qof_collection_count( coll ), == , count );
+
+    g_test_message( "Test removing and adding entities during foreach" );
+    qof_collection_foreach( coll, collection_foreach_mutate_cb, NULL );
+    g_assert_cmpint( g_hash_table_size( data->removed ), > , 0 );
+    g_assert_cmpint( qof_collection_count( coll ), == ,
+                     count + data->added - g_hash_table_size( data->removed ) );
+    for ( i = 0; i < data->insts->len; i++ )
+    {
+        auto inst = static_cast<QofInstance*>(g_ptr_array_index( data->insts, i ));
+        auto found = qof_collection_lookup_entity( coll, qof_instance_get_guid( inst ) );
+        if ( g_hash_table_lookup( data->removed, inst ) )
+            g_assert( found == NULL );
+        else
+            g_assert( found == inst );
+    }
+
+    g_test_message( "Test that a later foreach sees exactly the survivors" );
+    g_hash_table_remove_all( data->visited );
+    data->next_victim = 0;
+    data->added = 0;
+    /* Every other visit adds one; count the survivors before that happens. */
+    i = qof_collection_count( coll );
+    qof_collection_foreach( coll, collection_foreach_mutate_cb, NULL );
+    g_assert_cmpint( g_hash_table_size( data->visited ), >= , i );
+    g_assert_cmpint( qof_collection_count( coll ), == , i + data->added );
+
+    g_ptr_array_foreach( data->insts, (GFunc) g_object_unref, NULL );
+    g_ptr_array_free( data->insts, TRUE );
+    g_hash_table_destroy( data->visited );
+    g_hash_table_destroy( data->removed );
+    qof_book_destroy( data->book );
+}
+
 static struct
 {
     gpointer inst;
@@ -1052,6 +1150,7 @@ test_suite_qofinstance ( void )
     GNC_TEST_ADD( suitename, "commit edit part 2", Fixture, NULL, setup, test_instance_commit_edit_part2, teardown );
     GNC_TEST_ADD( suitename, "instance refers to object", Fixture, NULL, setup, test_instance_refers_to_object, teardown );
     GNC_TEST_ADD_FUNC( suitename, "instance get referring object list from collection", test_instance_get_referring_object_list_from_collection );
+    GNC_TEST_ADD_FUNC( suitename, "collection foreach add and remove", test_instance_collection_foreach_mutate );
     GNC_TEST_ADD_FUNC( suitename, "instance get typed referring object list", test_instance_get_typed_referring_object_list);
     GNC_TEST_ADD_FUNC( suitename, "instance get referring object list", test_instance_get_referring_object_list );
 }
@@ -0,0 +1,109 @@
+/********************************************************************
+ * test-qoflog.c: GLib g_test test suite for qoflog.cpp.            *
+ *                                                                  *
+ * This program is free software; you can redistribute it and/or    *
+ * modify it under the terms of the GNU General Public License as   *
+ * published by the Free Software Foundation; either version 2 of   *
+ * the License, or (at your option) any later version.              *
+ *                                                                  *
+ * This program is distributed in the hope that it will be useful,  *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of   *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the    *
+ * GNU General Public License for more details.                     *
+ *                                                                  *
+ * You should have received a copy of the GNU General Public License*
+ * along with this program; if not, contact:                        *
+ *                                                                  *
+ * Free Software Foundation           Voice:  +1-617-542-5942       *
+ * 51 Franklin Street, Fifth Floor    Fax:    +1-617-542-2652       *
+ * Boston, MA  02110-1301,  USA       gnu@gnu.org                   *
+********************************************************************/
+
+#include "config.h"
+#include <string.h>
+#include <glib.h>
+#include <unittest-support.h>
+#include "qof.h"
+
+static const gchar *suitename = "/qof/qoflog";
+static QofLogModule log_module = "test.qoflog.macros";
+void test_suite_qoflog ( void );
+
+static void
+test_qof_log_hierarchy( void )
+{
+    g_assert_cmpint( qof_log_get_threshold( "test.qoflog.tree.leaf" ),
+                     ==, QOF_LOG_WARNING );
+
+    qof_log_set_level( "test.qoflog.tree", QOF_LOG_INFO );
+    g_assert_cmpint( qof_log_get_threshold( "test.qoflog.tree.leaf" ),
+                     ==, QOF_LOG_INFO );
+    g_assert_cmpint( qof_log_get_threshold( "test.qoflog.tree" ),
+                     ==, QOF_LOG_INFO );
+    g_assert_cmpint( qof_log_get_threshold( "test.qoflog.treetop" ),
+                     ==, QOF_LOG_WARNING );
+
+    qof_log_set_level( "test.qoflog.tree.leaf", QOF_LOG_DEBUG );
+    g_assert_cmpint( qof_log_get_threshold( "test.qoflog.tree.leaf" ),
+                     ==, QOF_LOG_DEBUG );
+    g_assert( qof_log_check( "test.qoflog.tree.leaf", QOF_LOG_DEBUG ) );
+    g_assert( !qof_log_check( "test.qoflog.tree", QOF_LOG_DEBUG ) );
+    g_assert( qof_log_check( "test.qoflog.tree", QOF_LOG_INFO ) );
+}
+
+static void
+test_qof_log_generation( void )
+{
+    gint generation = qof_log_generation;
+
+    /* Looking levels up doesn't invalidate anything... */
+    qof_log_check( "test.qoflog.generation", QOF_LOG_DEBUG );
+    g_assert_cmpint( qof_log_generation, ==, generation );
+    /* ...setting one does. */
+    qof_log_set_level( "test.qoflog.generation", QOF_LOG_DEBUG );
+    g_assert_cmpint( qof_log_generation, !=, generation );
+}
+
+static void
+log_enter_leave( void )
+{
+    ENTER( "" );
+    LEAVE( "" );
+}
+
+static void
+count_handler( const gchar *log_domain, GLogLevelFlags log_level,
+               const gchar *message, gpointer user_data )
+{
+    ++*(guint*)user_data;
+}
+
+static void
+test_qof_log_enter_leave( void )
+{
+    guint hits = 0;
+    guint handler = g_log_set_handler( log_module, G_LOG_LEVEL_DEBUG,
+                                       count_handler, &hits );
+
+    log_enter_leave();
+    g_assert_cmpuint( hits, ==, 0 );
+
+    /* The thresholds cached at the call sites have to follow. */
+    qof_log_set_level( log_module, QOF_LOG_DEBUG );
+    log_enter_leave();
+    g_assert_cmpuint( hits, ==, 2 );
+
+    qof_log_set_level( log_module, QOF_LOG_WARNING );
+    log_enter_leave();
+    g_assert_cmpuint( hits, ==, 2 );
+
+    g_log_remove_handler( log_module, handler );
+}
+
+void
+test_suite_qoflog ( void )
+{
+    GNC_TEST_ADD_FUNC( suitename, "log hierarchy", test_qof_log_hierarchy );
+    GNC_TEST_ADD_FUNC( suitename, "log generation", test_qof_log_generation );
+    GNC_TEST_ADD_FUNC( suitename, "enter and leave", test_qof_log_enter_leave );
+}
@@ -453,13 +453,19 @@
 
   (define (book-add-prices! book prices)
     (let ((pricedb (gnc-pricedb-get-db book)))
+      ;; Without the UI no price editor can be watching the prices'
+      ;; own events, so add them in one batch.
+      (if (gnucash-ui-is-running)
+          (for-each
+           (lambda (price)
+             (if price
+                 (gnc-pricedb-add-price pricedb price)))
+           prices)
+          (gnc-pricedb-add-prices pricedb prices))
       (for-each
        (lambda (price)
          (if price
-             (begin
-               (gnc-pricedb-add-price pricedb price)
-               (gnc-price-unref price)
-               #f)))
+             (gnc-price-unref price)))
        prices)))
 
   ;; FIXME: uses of gnc:warn in here need to be cleaned up.  Right